@@ -0,0 +1,362 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Benchmark and verify the compression algorithms on linear and scatter
+ * ABDs.  Every algorithm is run against the same data laid out as:
+ *
+ *   linear  - a linear ABD
+ *   scatter - a scatter ABD, passed to the algorithm's ABD entry points
+ *             when it provides them
+ *   copy    - a scatter ABD copied to a linear buffer before each call,
+ *             which is how scatter ABDs are handled by algorithms without
+ *             ABD entry points
+ *
+ * The compressed output must be identical for every layout, and must
+ * decompress back to the original data, otherwise the tool fails.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/abd.h>
+#include <sys/spa.h>
+#include <sys/zio.h>
+#include <sys/zio_compress.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef enum cb_layout {
+	CB_LINEAR,
+	CB_SCATTER,
+	CB_COPY,
+	CB_LAYOUTS
+} cb_layout_t;
+
+static const char *cb_layout_name[CB_LAYOUTS] = {
+	"linear", "scatter", "copy"
+};
+
+static const char *cb_words[] = {
+	"zfs", "pool", "dataset", "snapshot", "block", "record", "checksum",
+	"compression", "the", "of", "and", "a", "to", "in", "is", "data",
+	"metadata", "transaction", "group", "vdev", "mirror", "raidz"
+};
+
+static char *cb_algs = "lzjb,gzip-1,gzip-6,zle,lz4";
+static char *cb_data_type = "text";
+static size_t cb_bsize = 128 * 1024;
+static int cb_iters = 100;
+
+static void
+usage(int code)
+{
+	(void) fprintf(stderr,
+	    "Usage: compress_bench [-c algorithm[,algorithm]...] "
+	    "[-b blocksize] [-d text|random|mixed] [-n iterations]\n"
+	    "\n"
+	    "  -c  algorithms to run (default: %s)\n"
+	    "  -b  block size in bytes, accepts K and M suffixes "
+	    "(default: 128K)\n"
+	    "  -d  type of data to compress (default: %s)\n"
+	    "  -n  iterations per measurement (default: %d)\n",
+	    cb_algs, cb_data_type, cb_iters);
+	exit(code);
+}
+
+static size_t
+cb_parse_size(const char *arg)
+{
+	char *end;
+	size_t size = strtoull(arg, &end, 0);
+
+	switch (*end) {
+	case 'k':
+	case 'K':
+		size <<= 10;
+		end++;
+		break;
+	case 'm':
+	case 'M':
+		size <<= 20;
+		end++;
+		break;
+	}
+
+	if (*end != '\0' || size == 0 || size > SPA_MAXBLOCKSIZE ||
+	    !IS_P2ALIGNED(size, SPA_MINBLOCKSIZE)) {
+		(void) fprintf(stderr, "invalid block size '%s'\n", arg);
+		usage(1);
+	}
+
+	return (size);
+}
+
+static void
+cb_fill_text(char *buf, size_t size)
+{
+	size_t off = 0;
+
+	while (off < size) {
+		const char *word = cb_words[rand() % ARRAY_SIZE(cb_words)];
+		size_t len = MIN(strlen(word), size - off);
+
+		(void) memcpy(buf + off, word, len);
+		off += len;
+		if (off < size)
+			buf[off++] = (rand() % 8 == 0) ? '\n' : ' ';
+	}
+}
+
+static void
+cb_fill_random(char *buf, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		buf[i] = rand();
+}
+
+static void
+cb_fill(char *buf, size_t size)
+{
+	srand(1);
+
+	if (strcmp(cb_data_type, "text") == 0) {
+		cb_fill_text(buf, size);
+	} else if (strcmp(cb_data_type, "random") == 0) {
+		cb_fill_random(buf, size);
+	} else if (strcmp(cb_data_type, "mixed") == 0) {
+		/* Alternate between compressible and random 4K regions */
+		for (size_t off = 0; off < size; off += 4096) {
+			size_t len = MIN(4096, size - off);
+
+			if ((off / 4096) % 2 == 0)
+				cb_fill_text(buf + off, len);
+			else
+				cb_fill_random(buf + off, len);
+		}
+	} else {
+		(void) fprintf(stderr, "invalid data type '%s'\n",
+		    cb_data_type);
+		usage(1);
+	}
+}
+
+static enum zio_compress
+cb_lookup(const char *name)
+{
+	for (enum zio_compress c = 0; c < ZIO_COMPRESS_FUNCTIONS; c++) {
+		if (zio_compress_table[c].ci_compress != NULL &&
+		    strcmp(zio_compress_table[c].ci_name, name) == 0)
+			return (c);
+	}
+
+	(void) fprintf(stderr, "invalid compression algorithm '%s'\n", name);
+	usage(1);
+	return (ZIO_COMPRESS_OFF);
+}
+
+static abd_t *
+cb_abd_alloc(cb_layout_t layout, size_t size)
+{
+	if (layout == CB_LINEAR)
+		return (abd_alloc_linear(size, B_FALSE));
+
+	return (abd_alloc(size, B_FALSE));
+}
+
+static size_t
+cb_compress(cb_layout_t layout, enum zio_compress c, abd_t *src, void *dst,
+    size_t s_len)
+{
+	zio_compress_info_t *ci = &zio_compress_table[c];
+	size_t c_len, d_len;
+	void *tmp;
+
+	if (layout != CB_COPY)
+		return (zio_compress_data(c, src, dst, s_len));
+
+	d_len = s_len - (s_len >> 3);
+	tmp = abd_borrow_buf_copy(src, s_len);
+	c_len = ci->ci_compress(tmp, dst, s_len, d_len, ci->ci_level);
+	abd_return_buf(src, tmp, s_len);
+
+	return (c_len > d_len ? s_len : c_len);
+}
+
+static int
+cb_decompress(cb_layout_t layout, enum zio_compress c, abd_t *src,
+    void *dst, size_t s_len, size_t d_len)
+{
+	void *tmp;
+	int err;
+
+	if (layout != CB_COPY)
+		return (zio_decompress_data(c, src, dst, s_len, d_len));
+
+	tmp = abd_borrow_buf_copy(src, s_len);
+	err = zio_decompress_data_buf(c, tmp, dst, s_len, d_len);
+	abd_return_buf(src, tmp, s_len);
+
+	return (err);
+}
+
+static double
+cb_mibps(size_t bytes, hrtime_t ns)
+{
+	return ((double)bytes * NANOSEC / MAX(ns, 1) / (1 << 20));
+}
+
+/*
+ * Run one algorithm against every layout.  Returns non-zero if any
+ * layout produced different compressed data or failed to round trip.
+ */
+static int
+cb_run(enum zio_compress c, const char *data)
+{
+	size_t bsize = cb_bsize;
+	char *ref = umem_alloc(bsize, UMEM_NOFAIL);
+	char *cbuf = umem_alloc(bsize, UMEM_NOFAIL);
+	char *dbuf = umem_alloc(bsize, UMEM_NOFAIL);
+	size_t ref_len = 0;
+	int errors = 0;
+
+	for (cb_layout_t l = 0; l < CB_LAYOUTS; l++) {
+		abd_t *src, *cabd;
+		size_t c_len = 0, c_len_valid;
+		hrtime_t start, ctime, dtime;
+		char dstr[32];
+
+		src = cb_abd_alloc(l, bsize);
+		abd_copy_from_buf(src, data, bsize);
+
+		start = gethrtime();
+		for (int i = 0; i < cb_iters; i++)
+			c_len = cb_compress(l, c, src, cbuf, bsize);
+		ctime = gethrtime() - start;
+		abd_free(src);
+
+		/* The buffer contents are only meaningful when compressed */
+		if (c_len == bsize)
+			c_len_valid = 0;
+		else
+			c_len_valid = c_len;
+
+		if (l == CB_LINEAR) {
+			ref_len = c_len;
+			(void) memcpy(ref, cbuf, c_len_valid);
+		} else if (c_len != ref_len ||
+		    memcmp(ref, cbuf, c_len_valid) != 0) {
+			(void) fprintf(stderr, "%s: %s compressed data differs "
+			    "from linear\n", zio_compress_table[c].ci_name,
+			    cb_layout_name[l]);
+			errors++;
+		}
+
+		(void) strcpy(dstr, "-");
+		if (c_len != 0 && c_len < bsize) {
+			cabd = cb_abd_alloc(l, c_len);
+			abd_copy_from_buf(cabd, cbuf, c_len);
+
+			start = gethrtime();
+			for (int i = 0; i < cb_iters; i++) {
+				(void) memset(dbuf, 0, bsize);
+				if (cb_decompress(l, c, cabd, dbuf, c_len,
+				    bsize) != 0 ||
+				    memcmp(dbuf, data, bsize) != 0) {
+					(void) fprintf(stderr, "%s: %s "
+					    "decompression failed\n",
+					    zio_compress_table[c].ci_name,
+					    cb_layout_name[l]);
+					errors++;
+					break;
+				}
+			}
+			dtime = gethrtime() - start;
+			abd_free(cabd);
+
+			(void) snprintf(dstr, sizeof (dstr), "%.1f",
+			    cb_mibps(bsize * cb_iters, dtime));
+		}
+
+		(void) printf("%-12s %-8s %7.2fx %14.1f %14s\n",
+		    zio_compress_table[c].ci_name, cb_layout_name[l],
+		    (c_len == 0 || c_len >= bsize) ? 1.0 :
+		    (double)bsize / c_len,
+		    cb_mibps(bsize * cb_iters, ctime), dstr);
+	}
+
+	umem_free(ref, bsize);
+	umem_free(cbuf, bsize);
+	umem_free(dbuf, bsize);
+
+	return (errors);
+}
+
+int
+main(int argc, char **argv)
+{
+	char *algs, *name, *data;
+	int c, errors = 0;
+
+	while ((c = getopt(argc, argv, "b:c:d:n:h")) != -1) {
+		switch (c) {
+		case 'b':
+			cb_bsize = cb_parse_size(optarg);
+			break;
+		case 'c':
+			cb_algs = optarg;
+			break;
+		case 'd':
+			cb_data_type = optarg;
+			break;
+		case 'n':
+			cb_iters = atoi(optarg);
+			if (cb_iters <= 0)
+				usage(1);
+			break;
+		case 'h':
+			usage(0);
+			break;
+		default:
+			usage(1);
+		}
+	}
+
+	(void) setvbuf(stdout, NULL, _IOLBF, 0);
+
+	kernel_init(FREAD);
+
+	data = umem_alloc(cb_bsize, UMEM_NOFAIL);
+	cb_fill(data, cb_bsize);
+
+	(void) printf("%-12s %-8s %8s %14s %14s\n", "algorithm", "abd",
+	    "ratio", "compress MB/s", "decomp MB/s");
+
+	algs = strdup(cb_algs);
+	for (name = strtok(algs, ","); name != NULL; name = strtok(NULL, ","))
+		errors += cb_run(cb_lookup(name), data);
+	free(algs);
+
+	umem_free(data, cb_bsize);
+	kernel_fini();
+
+	return (errors != 0);
+}
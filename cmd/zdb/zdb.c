@@ -2139,30 +2139,62 @@ bpobj_count_refd(bpobj_t *bpo)
 	}
 }
 
+static int
+dsl_deadlist_entry_count_refd(void *arg, dsl_deadlist_entry_t *dle)
+{
+	spa_t *spa = arg;
+
+	if (dle->dle_bpobj.bpo_object != spa->spa_dsl_pool->dp_empty_bpobj)
+		bpobj_count_refd(&dle->dle_bpobj);
+	return (0);
+}
+
+static int
+dsl_deadlist_entry_dump(void *arg, dsl_deadlist_entry_t *dle)
+{
+	if (dump_opt['d'] >= 5) {
+		char buf[128];
+		(void) snprintf(buf, sizeof (buf),
+		    "mintxg %llu -> obj %llu",
+		    (longlong_t)dle->dle_mintxg,
+		    (longlong_t)dle->dle_bpobj.bpo_object);
+
+		dump_full_bpobj(&dle->dle_bpobj, buf, 0);
+	} else {
+		(void) printf("mintxg %llu -> obj %llu\n",
+		    (longlong_t)dle->dle_mintxg,
+		    (longlong_t)dle->dle_bpobj.bpo_object);
+	}
+	return (0);
+}
+
+static void
+livelist_count_refd(objset_t *mos, uint64_t obj)
+{
+	dsl_deadlist_t ll;
+
+	dsl_deadlist_open(&ll, mos, obj);
+	mos_obj_refd(ll.dl_object);
+	dsl_deadlist_iterate(&ll, dsl_deadlist_entry_count_refd,
+	    dmu_objset_spa(mos));
+	dsl_deadlist_close(&ll);
+}
+
 static void
 dump_deadlist(dsl_deadlist_t *dl)
 {
-	dsl_deadlist_entry_t *dle;
-	uint64_t unused;
 	char bytes[32];
 	char comp[32];
 	char uncomp[32];
-	uint64_t empty_bpobj =
-	    dmu_objset_spa(dl->dl_os)->spa_dsl_pool->dp_empty_bpobj;
-
-	/* force the tree to be loaded */
-	dsl_deadlist_space_range(dl, 0, UINT64_MAX, &unused, &unused, &unused);
+	spa_t *spa = dmu_objset_spa(dl->dl_os);
+	uint64_t empty_bpobj = spa->spa_dsl_pool->dp_empty_bpobj;
 
 	if (dl->dl_oldfmt) {
 		if (dl->dl_bpobj.bpo_object != empty_bpobj)
 			bpobj_count_refd(&dl->dl_bpobj);
 	} else {
 		mos_obj_refd(dl->dl_object);
-		for (dle = avl_first(&dl->dl_tree); dle;
-		    dle = AVL_NEXT(&dl->dl_tree, dle)) {
-			if (dle->dle_bpobj.bpo_object != empty_bpobj)
-				bpobj_count_refd(&dle->dle_bpobj);
-		}
+		dsl_deadlist_iterate(dl, dsl_deadlist_entry_count_refd, spa);
 	}
 
 	/* make sure nicenum has enough space */
@@ -2189,22 +2221,7 @@ dump_deadlist(dsl_deadlist_t *dl)
 
 	(void) printf("\n");
 
-	for (dle = avl_first(&dl->dl_tree); dle;
-	    dle = AVL_NEXT(&dl->dl_tree, dle)) {
-		if (dump_opt['d'] >= 5) {
-			char buf[128];
-			(void) snprintf(buf, sizeof (buf),
-			    "mintxg %llu -> obj %llu",
-			    (longlong_t)dle->dle_mintxg,
-			    (longlong_t)dle->dle_bpobj.bpo_object);
-
-			dump_full_bpobj(&dle->dle_bpobj, buf, 0);
-		} else {
-			(void) printf("mintxg %llu -> obj %llu\n",
-			    (longlong_t)dle->dle_mintxg,
-			    (longlong_t)dle->dle_bpobj.bpo_object);
-		}
-	}
+	dsl_deadlist_iterate(dl, dsl_deadlist_entry_dump, NULL);
 }
 
 static avl_tree_t idx_tree;
@@ -2708,6 +2725,9 @@ count_dir_mos_objects(dsl_dir_t *dd)
 	mos_obj_refd(dsl_dir_phys(dd)->dd_deleg_zapobj);
 	mos_obj_refd(dsl_dir_phys(dd)->dd_props_zapobj);
 	mos_obj_refd(dsl_dir_phys(dd)->dd_clones);
+	if (dsl_deadlist_is_open(&dd->dd_livelist))
+		livelist_count_refd(dd->dd_pool->dp_meta_objset,
+		    dd->dd_livelist.dl_object);
 
 	/*
 	 * The dd_crypto_obj can be referenced by multiple dsl_dir's.
@@ -3609,6 +3629,7 @@ dump_label(const char *dev)
 
 static uint64_t dataset_feature_count[SPA_FEATURES];
 static uint64_t remap_deadlist_count = 0;
+static uint64_t livelist_count = 0;
 
 /*ARGSUSED*/
 static int
@@ -3634,6 +3655,10 @@ dump_one_dir(const char *dsname, void *arg)
 		remap_deadlist_count++;
 	}
 
+	if (!dsl_dataset_is_snapshot(dmu_objset_ds(os)) &&
+	    dsl_deadlist_is_open(&dmu_objset_ds(os)->ds_dir->dd_livelist))
+		livelist_count++;
+
 	dump_dir(os);
 	close_objset(os, FTAG);
 	fuid_table_destroy();
@@ -4790,6 +4815,44 @@ count_block_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 	return (0);
 }
 
+static int
+livelist_entry_count_blocks(void *arg, dsl_deadlist_entry_t *dle)
+{
+	bplist_t net;
+
+	bplist_create(&net);
+	VERIFY0(dsl_livelist_net(&dle->dle_bpobj,
+	    dle->dle_bpobj.bpo_phys->bpo_num_blkptrs, &net, NULL, NULL));
+	bplist_iterate(&net, count_block_cb, arg, NULL);
+	bplist_destroy(&net);
+	return (0);
+}
+
+/*
+ * Count the blocks of the destroyed clones which the livelist delete zthr
+ * has not freed yet.
+ */
+static void
+count_deleted_livelists(spa_t *spa, zdb_cb_t *zcb)
+{
+	objset_t *mos = spa->spa_meta_objset;
+	zap_cursor_t zc;
+	zap_attribute_t attr;
+
+	if (spa->spa_livelists_to_delete == 0)
+		return;
+
+	for (zap_cursor_init(&zc, mos, spa->spa_livelists_to_delete);
+	    zap_cursor_retrieve(&zc, &attr) == 0; zap_cursor_advance(&zc)) {
+		dsl_deadlist_t ll;
+
+		dsl_deadlist_open(&ll, mos, attr.za_first_integer);
+		dsl_deadlist_iterate(&ll, livelist_entry_count_blocks, zcb);
+		dsl_deadlist_close(&ll);
+	}
+	zap_cursor_fini(&zc);
+}
+
 static int
 dump_block_stats(spa_t *spa)
 {
@@ -4844,6 +4907,8 @@ dump_block_stats(spa_t *spa)
 		    &zcb, NULL));
 	}
 
+	count_deleted_livelists(spa, &zcb);
+
 	if (dump_opt['c'] > 1)
 		flags |= TRAVERSE_PREFETCH_DATA;
 
@@ -5214,6 +5279,35 @@ dump_simulated_ddt(spa_t *spa)
 	dump_dedup_ratio(&dds_total);
 }
 
+static int
+verify_livelist_feature_count(spa_t *spa)
+{
+	uint64_t feature_refcount = 0;
+	uint64_t deleted_count = 0;
+
+	if (!spa_feature_is_enabled(spa, SPA_FEATURE_LIVELIST))
+		return (0);
+
+	(void) feature_get_refcount(spa,
+	    &spa_feature_table[SPA_FEATURE_LIVELIST], &feature_refcount);
+	if (spa->spa_livelists_to_delete != 0) {
+		VERIFY0(zap_count(spa->spa_meta_objset,
+		    spa->spa_livelists_to_delete, &deleted_count));
+	}
+
+	if (feature_refcount != livelist_count + deleted_count) {
+		(void) printf("Number of livelists (%llu) and deleted "
+		    "livelists (%llu) does not match feature count (%llu)\n",
+		    (u_longlong_t)livelist_count,
+		    (u_longlong_t)deleted_count,
+		    (u_longlong_t)feature_refcount);
+		return (1);
+	}
+	(void) printf("Verified livelist feature refcount "
+	    "of %llu is correct\n", (u_longlong_t)feature_refcount);
+	return (0);
+}
+
 static int
 verify_device_removal_feature_counts(spa_t *spa)
 {
@@ -5856,6 +5950,17 @@ dump_mos_leaks(spa_t *spa)
 	mos_obj_refd(spa->spa_all_vdev_zaps);
 	mos_obj_refd(spa->spa_dsl_pool->dp_bptree_obj);
 	mos_obj_refd(spa->spa_dsl_pool->dp_tmp_userrefs_obj);
+	mos_obj_refd(spa->spa_livelists_to_delete);
+	if (spa->spa_livelists_to_delete != 0) {
+		zap_cursor_t zc;
+		zap_attribute_t attr;
+
+		for (zap_cursor_init(&zc, mos, spa->spa_livelists_to_delete);
+		    zap_cursor_retrieve(&zc, &attr) == 0;
+		    zap_cursor_advance(&zc))
+			livelist_count_refd(mos, attr.za_first_integer);
+		zap_cursor_fini(&zc);
+	}
 	mos_obj_refd(spa->spa_dsl_pool->dp_scan->scn_phys.scn_queue_obj);
 	bpobj_count_refd(&spa->spa_deferred_bpobj);
 	mos_obj_refd(dp->dp_empty_bpobj);
@@ -6123,6 +6228,9 @@ dump_zpool(spa_t *spa, char *blockmap_file_path)
 			}
 		}
 
+		if (rc == 0)
+			rc = verify_livelist_feature_count(spa);
+
 		if (rc == 0)
 			rc = verify_device_removal_feature_counts(spa);
 	}
@@ -387,7 +387,7 @@ get_usage(zpool_help_t idx)
 		return (gettext("\tinitialize [-c | -s] <pool> "
 		    "[<device> ...]\n"));
 	case HELP_SCRUB:
-		return (gettext("\tscrub [-s | -p] <pool> ...\n"));
+		return (gettext("\tscrub [-s | -p] [-e] <pool> ...\n"));
 	case HELP_RESILVER:
 		return (gettext("\tresilver <pool> ...\n"));
 	case HELP_TRIM:
@@ -6787,29 +6787,35 @@ scrub_callback(zpool_handle_t *zhp, void *data)
 }
 
 /*
- * zpool scrub [-s | -p] <pool> ...
+ * zpool scrub [-s | -p] [-e] <pool> ...
  *
  *	-s	Stop.  Stops any in-progress scrub.
  *	-p	Pause. Pause in-progress scrub.
+ *	-e	Error. Only scrub blocks in the persistent error log.
  */
 int
 zpool_do_scrub(int argc, char **argv)
 {
 	int c;
 	scrub_cbdata_t cb;
+	boolean_t is_stop = B_FALSE;
+	boolean_t is_error = B_FALSE;
 
 	cb.cb_type = POOL_SCAN_SCRUB;
 	cb.cb_scrub_cmd = POOL_SCRUB_NORMAL;
 
 	/* check options */
-	while ((c = getopt(argc, argv, "sp")) != -1) {
+	while ((c = getopt(argc, argv, "spe")) != -1) {
 		switch (c) {
 		case 's':
-			cb.cb_type = POOL_SCAN_NONE;
+			is_stop = B_TRUE;
 			break;
 		case 'p':
 			cb.cb_scrub_cmd = POOL_SCRUB_PAUSE;
 			break;
+		case 'e':
+			is_error = B_TRUE;
+			break;
 		case '?':
 			(void) fprintf(stderr, gettext("invalid option '%c'\n"),
 			    optopt);
@@ -6817,13 +6823,17 @@ zpool_do_scrub(int argc, char **argv)
 		}
 	}
 
-	if (cb.cb_type == POOL_SCAN_NONE &&
-	    cb.cb_scrub_cmd == POOL_SCRUB_PAUSE) {
+	if (is_stop && cb.cb_scrub_cmd == POOL_SCRUB_PAUSE) {
 		(void) fprintf(stderr, gettext("invalid option combination: "
 		    "-s and -p are mutually exclusive\n"));
 		usage(B_FALSE);
 	}
 
+	if (is_stop)
+		cb.cb_type = POOL_SCAN_NONE;
+	else if (is_error)
+		cb.cb_type = POOL_SCAN_ERRORSCRUB;
+
 	cb.cb_argc = argc;
 	cb.cb_argv = argv;
 	argc -= optind;
@@ -7026,7 +7036,8 @@ print_scan_status(pool_scan_stat_t *ps)
 	zfs_nicebytes(ps->pss_processed, processed_buf, sizeof (processed_buf));
 
 	assert(ps->pss_func == POOL_SCAN_SCRUB ||
-	    ps->pss_func == POOL_SCAN_RESILVER);
+	    ps->pss_func == POOL_SCAN_RESILVER ||
+	    ps->pss_func == POOL_SCAN_ERRORSCRUB);
 
 	/* Scan is finished or canceled. */
 	if (ps->pss_state == DSS_FINISHED) {
@@ -7050,12 +7061,22 @@ print_scan_status(pool_scan_stat_t *ps)
 			    (u_longlong_t)days_left, (u_longlong_t)hours_left,
 			    (u_longlong_t)mins_left, (u_longlong_t)secs_left,
 			    (u_longlong_t)ps->pss_errors, ctime(&end));
+		} else if (ps->pss_func == POOL_SCAN_ERRORSCRUB) {
+			(void) printf(gettext("error scrub repaired %s "
+			    "in %llu days %02llu:%02llu:%02llu "
+			    "with %llu errors on %s"), processed_buf,
+			    (u_longlong_t)days_left, (u_longlong_t)hours_left,
+			    (u_longlong_t)mins_left, (u_longlong_t)secs_left,
+			    (u_longlong_t)ps->pss_errors, ctime(&end));
 		}
 		return;
 	} else if (ps->pss_state == DSS_CANCELED) {
 		if (ps->pss_func == POOL_SCAN_SCRUB) {
 			(void) printf(gettext("scrub canceled on %s"),
 			    ctime(&end));
+		} else if (ps->pss_func == POOL_SCAN_ERRORSCRUB) {
+			(void) printf(gettext("error scrub canceled on %s"),
+			    ctime(&end));
 		} else if (ps->pss_func == POOL_SCAN_RESILVER) {
 			(void) printf(gettext("resilver canceled on %s"),
 			    ctime(&end));
@@ -7076,6 +7097,16 @@ print_scan_status(pool_scan_stat_t *ps)
 			(void) printf(gettext("\tscrub started on %s"),
 			    ctime(&start));
 		}
+	} else if (ps->pss_func == POOL_SCAN_ERRORSCRUB) {
+		if (pause == 0) {
+			(void) printf(gettext("error scrub in progress "
+			    "since %s"), ctime(&start));
+		} else {
+			(void) printf(gettext("error scrub paused since %s"),
+			    ctime(&pause));
+			(void) printf(gettext("\terror scrub started on %s"),
+			    ctime(&start));
+		}
 	} else if (ps->pss_func == POOL_SCAN_RESILVER) {
 		(void) printf(gettext("resilver in progress since %s"),
 		    ctime(&start));
@@ -7125,7 +7156,8 @@ print_scan_status(pool_scan_stat_t *ps)
 	if (ps->pss_func == POOL_SCAN_RESILVER) {
 		(void) printf(gettext("\t%s resilvered, %.2f%% done"),
 		    processed_buf, 100 * fraction_done);
-	} else if (ps->pss_func == POOL_SCAN_SCRUB) {
+	} else if (ps->pss_func == POOL_SCAN_SCRUB ||
+	    ps->pss_func == POOL_SCAN_ERRORSCRUB) {
 		(void) printf(gettext("\t%s repaired, %.2f%% done"),
 		    processed_buf, 100 * fraction_done);
 	}
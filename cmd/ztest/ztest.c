@@ -1909,6 +1909,7 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 	dmu_tx_t *tx;
 	dmu_buf_t *db;
 	arc_buf_t *abuf = NULL;
+	abd_t *dabd = NULL;
 	rl_t *rl;
 
 	if (byteswap)
@@ -1949,14 +1950,23 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 
 	dmu_tx_hold_write(tx, lr->lr_foid, offset, length);
 
-	if (ztest_random(8) == 0 && length == doi.doi_data_block_size &&
-	    P2PHASE(offset, length) == 0)
-		abuf = dmu_request_arcbuf(db, length);
+	if (length == doi.doi_data_block_size && P2PHASE(offset, length) == 0) {
+		switch (ztest_random(8)) {
+		case 0:
+			abuf = dmu_request_arcbuf(db, length);
+			break;
+		case 1:
+			dabd = abd_alloc_linear(length, B_FALSE);
+			break;
+		}
+	}
 
 	txg = ztest_tx_assign(tx, TXG_WAIT, FTAG);
 	if (txg == 0) {
 		if (abuf != NULL)
 			dmu_return_arcbuf(abuf);
+		if (dabd != NULL)
+			abd_free(dabd);
 		dmu_buf_rele(db, FTAG);
 		ztest_range_unlock(rl);
 		ztest_object_unlock(zd, lr->lr_foid);
@@ -1975,8 +1985,13 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 			    DMU_READ_PREFETCH : DMU_READ_NO_PREFETCH;
 			ztest_block_tag_t rbt;
 
-			VERIFY(dmu_read(os, lr->lr_foid, offset,
-			    sizeof (rbt), &rbt, prefetch) == 0);
+			if (ztest_random(4) == 0) {
+				VERIFY0(dmu_read_direct(os, lr->lr_foid,
+				    offset, sizeof (rbt), &rbt));
+			} else {
+				VERIFY(dmu_read(os, lr->lr_foid, offset,
+				    sizeof (rbt), &rbt, prefetch) == 0);
+			}
 			if (rbt.bt_magic == BT_MAGIC) {
 				ztest_bt_verify(&rbt, os, lr->lr_foid, 0,
 				    offset, gen, txg, crtxg);
@@ -2003,11 +2018,17 @@ ztest_replay_write(void *arg1, void *arg2, boolean_t byteswap)
 		    crtxg);
 	}
 
-	if (abuf == NULL) {
-		dmu_write(os, lr->lr_foid, offset, length, data, tx);
-	} else {
+	if (abuf != NULL) {
 		bcopy(data, abuf->b_data, length);
 		dmu_assign_arcbuf_by_dbuf(db, offset, abuf, tx);
+	} else if (dabd != NULL) {
+		/* A failed direct write leaves the block untouched. */
+		abd_copy_from_buf(dabd, data, length);
+		if (dmu_write_direct_by_dbuf(db, offset, dabd, tx) != 0)
+			dmu_write(os, lr->lr_foid, offset, length, data, tx);
+		abd_free(dabd);
+	} else {
+		dmu_write(os, lr->lr_foid, offset, length, data, tx);
 	}
 
 	(void) ztest_log_write(zd, tx, lr);
@@ -6204,6 +6225,16 @@ ztest_scrub(ztest_ds_t *zd, uint64_t id)
 	if (error == EBUSY)
 		error = 0;
 	ASSERT0(error);
+
+	/*
+	 * An error scrub only visits the blocks in the error log.  Its
+	 * result is not checked, since injected faults may log new errors
+	 * while it runs.
+	 */
+	if (spa_scan(spa, POOL_SCAN_ERRORSCRUB) == 0) {
+		while (dsl_scan_scrubbing(spa_get_dsl(spa)))
+			txg_wait_synced(spa_get_dsl(spa), 0);
+	}
 }
 
 /*
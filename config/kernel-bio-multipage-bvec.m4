@@ -0,0 +1,30 @@
+dnl #
+dnl # 5.1 API change
+dnl # Multi-page bvecs, a single bio_vec may describe a physically
+dnl # contiguous range spanning several pages.  bio_for_each_bvec() was
+dnl # added alongside them to walk the multi-page segments.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_BIO_MULTIPAGE_BVEC], [
+	ZFS_LINUX_TEST_SRC([bio_multipage_bvec], [
+		#include <linux/bio.h>
+	],[
+		struct bio *bio = NULL;
+		struct bio_vec bv;
+		struct bvec_iter iter;
+
+		bio_for_each_bvec(bv, bio, iter) {
+			(void) bv;
+		}
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_BIO_MULTIPAGE_BVEC], [
+	AC_MSG_CHECKING([whether bio supports multi-page bvecs])
+	ZFS_LINUX_TEST_RESULT([bio_multipage_bvec], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_BIO_MULTIPAGE_BVEC, 1,
+		    [bio supports multi-page bvecs])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
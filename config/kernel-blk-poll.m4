@@ -0,0 +1,40 @@
+dnl #
+dnl # 5.0 API change
+dnl # blk_poll() gained a 'spin' argument.  Together with REQ_HIPRI it lets
+dnl # the submitter of a bio reap its completion from the device's queue
+dnl # rather than waiting for an interrupt.  Older variants are not used.
+dnl #
+dnl # blk_poll() is exported GPL-only on most kernels, in which case the
+dnl # polled path falls back to spinning on interrupt completion.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_BLK_POLL], [
+	ZFS_LINUX_TEST_SRC([blk_poll], [
+		#include <linux/blkdev.h>
+	],[
+		struct request_queue *q = NULL;
+		struct bio *bio = NULL;
+		blk_qc_t cookie = BLK_QC_T_NONE;
+		int ret __attribute__ ((unused));
+
+		bio->bi_opf |= REQ_HIPRI;
+		ret = blk_poll(q, cookie, true);
+	], [], [$ZFS_META_LICENSE])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_BLK_POLL], [
+	AC_MSG_CHECKING([whether blk_poll() is available])
+	ZFS_LINUX_TEST_RESULT([blk_poll], [
+		AC_MSG_RESULT(yes)
+
+		AC_MSG_CHECKING([whether blk_poll() is GPL-only])
+		ZFS_LINUX_TEST_RESULT([blk_poll_license], [
+			AC_MSG_RESULT(no)
+			AC_DEFINE(HAVE_BLK_POLL, 1,
+			    [blk_poll() is available])
+		],[
+			AC_MSG_RESULT(yes)
+		])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
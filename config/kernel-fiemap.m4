@@ -0,0 +1,29 @@
+dnl #
+dnl # 5.8 API change
+dnl # fiemap_check_flags() was replaced by fiemap_prep() which also
+dnl # handles FIEMAP_FLAG_SYNC and clamps the requested length.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_FIEMAP_PREP], [
+	ZFS_LINUX_TEST_SRC([fiemap_prep], [
+		#include <linux/fs.h>
+		#include <linux/fiemap.h>
+	],[
+		struct inode *ip = NULL;
+		struct fiemap_extent_info *fei = NULL;
+		u64 len = 0;
+		int error __attribute__ ((unused));
+
+		error = fiemap_prep(ip, fei, 0, &len, FIEMAP_FLAG_SYNC);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_FIEMAP_PREP], [
+	AC_MSG_CHECKING([whether fiemap_prep() is available])
+	ZFS_LINUX_TEST_RESULT_SYMBOL([fiemap_prep],
+	    [fiemap_prep], [fs/ioctl.c], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_FIEMAP_PREP, 1, [fiemap_prep() is available])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
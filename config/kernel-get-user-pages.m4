@@ -0,0 +1,25 @@
+dnl #
+dnl # 5.2 API change
+dnl # The 'write' argument of get_user_pages_fast() was replaced by
+dnl # 'gup_flags', which takes FOLL_WRITE to request writable pages.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_GET_USER_PAGES_FAST], [
+	ZFS_LINUX_TEST_SRC([get_user_pages_fast_gup_flags], [
+		#include <linux/mm.h>
+	],[
+		int (*gup)(unsigned long, int, unsigned int,
+		    struct page **) __attribute__ ((unused)) =
+		    get_user_pages_fast;
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_GET_USER_PAGES_FAST], [
+	AC_MSG_CHECKING([whether get_user_pages_fast() takes gup_flags])
+	ZFS_LINUX_TEST_RESULT([get_user_pages_fast_gup_flags], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_GET_USER_PAGES_FAST_GUP_FLAGS, 1,
+		    [get_user_pages_fast() takes gup_flags])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
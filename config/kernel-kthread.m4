@@ -0,0 +1,27 @@
+dnl #
+dnl # 2.6.39 API change
+dnl # kthread_create_on_node() was added to allocate the task_struct and
+dnl # stack of a kernel thread on a given NUMA node.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_KTHREAD_CREATE_ON_NODE], [
+	ZFS_LINUX_TEST_SRC([kthread_create_on_node], [
+		#include <linux/kthread.h>
+
+		int test_fn(void *data) { return (0); }
+	],[
+		struct task_struct *tsk __attribute__ ((unused));
+
+		tsk = kthread_create_on_node(test_fn, NULL, 0, "%s", "test");
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_KTHREAD_CREATE_ON_NODE], [
+	AC_MSG_CHECKING([whether kthread_create_on_node() is available])
+	ZFS_LINUX_TEST_RESULT([kthread_create_on_node], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_KTHREAD_CREATE_ON_NODE, 1,
+		    [kthread_create_on_node() is available])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
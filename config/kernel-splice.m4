@@ -0,0 +1,121 @@
+dnl #
+dnl # 3.5 API change
+dnl # struct splice_pipe_desc gained nr_pages_max.
+dnl #
+dnl # 3.15 API change
+dnl # The pipe_buf_operations map() and unmap() callbacks were removed.
+dnl #
+dnl # fops->splice_read() hands ARC pages to the pipe with splice_to_pipe(),
+dnl # which requires both of the above.  splice_to_pipe() is exported
+dnl # GPL-only on most kernels, in which case the generic implementation
+dnl # is used.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_SPLICE_TO_PIPE], [
+	ZFS_LINUX_TEST_SRC([splice_to_pipe], [
+		#include <linux/fs.h>
+		#include <linux/pipe_fs_i.h>
+		#include <linux/splice.h>
+	],[
+		struct pipe_inode_info *pipe = NULL;
+		struct splice_pipe_desc spd __attribute__ ((unused)) = {
+			.nr_pages_max = PIPE_DEF_BUFFERS,
+		};
+		ssize_t ret __attribute__ ((unused));
+
+		ret = splice_to_pipe(pipe, &spd);
+	], [], [$ZFS_META_LICENSE])
+
+	ZFS_LINUX_TEST_SRC([pipe_buf_operations_map], [
+		#include <linux/pipe_fs_i.h>
+
+		static const struct pipe_buf_operations
+		    ops __attribute__ ((unused)) = {
+			.map		= generic_pipe_buf_map,
+		};
+	],[])
+])
+
+dnl #
+dnl # 5.8 API change
+dnl # The pipe_buf_operations steal() callback was replaced by try_steal(),
+dnl # which returns a bool, and generic_pipe_buf_confirm() was removed;
+dnl # a NULL confirm() callback is now treated as always succeeding.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_PIPE_BUF_OPERATIONS_STEAL], [
+	ZFS_LINUX_TEST_SRC([pipe_buf_operations_try_steal], [
+		#include <linux/pipe_fs_i.h>
+
+		bool test_try_steal(struct pipe_inode_info *pipe,
+		    struct pipe_buffer *buf) { return (false); }
+
+		static const struct pipe_buf_operations
+		    ops __attribute__ ((unused)) = {
+			.release	= generic_pipe_buf_release,
+			.try_steal	= test_try_steal,
+			.get		= generic_pipe_buf_get,
+		};
+	],[])
+
+	ZFS_LINUX_TEST_SRC([pipe_buf_operations_steal], [
+		#include <linux/pipe_fs_i.h>
+
+		int test_steal(struct pipe_inode_info *pipe,
+		    struct pipe_buffer *buf) { return (1); }
+
+		static const struct pipe_buf_operations
+		    ops __attribute__ ((unused)) = {
+			.confirm	= generic_pipe_buf_confirm,
+			.release	= generic_pipe_buf_release,
+			.steal		= test_steal,
+			.get		= generic_pipe_buf_get,
+		};
+	],[])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_SPLICE_TO_PIPE], [
+	AC_MSG_CHECKING([whether pipe_buf_operations->try_steal() exists])
+	ZFS_LINUX_TEST_RESULT([pipe_buf_operations_try_steal], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_PIPE_BUF_OPERATIONS_TRY_STEAL, 1,
+		    [pipe_buf_operations->try_steal() exists])
+		zfs_pipe_buf_operations=yes
+	],[
+		AC_MSG_RESULT(no)
+
+		AC_MSG_CHECKING([whether pipe_buf_operations->steal() exists])
+		ZFS_LINUX_TEST_RESULT([pipe_buf_operations_steal], [
+			AC_MSG_RESULT(yes)
+			zfs_pipe_buf_operations=yes
+		],[
+			AC_MSG_RESULT(no)
+			zfs_pipe_buf_operations=no
+		])
+	])
+
+	AC_MSG_CHECKING([whether splice_to_pipe() is usable])
+	ZFS_LINUX_TEST_RESULT_SYMBOL([splice_to_pipe],
+	    [splice_to_pipe], [fs/splice.c], [
+		ZFS_LINUX_TEST_RESULT([pipe_buf_operations_map], [
+			AC_MSG_RESULT(no)
+		],[
+			AS_IF([test "$zfs_pipe_buf_operations" = "yes"], [
+				AC_MSG_RESULT(yes)
+
+				AC_MSG_CHECKING(
+				    [whether splice_to_pipe() is GPL-only])
+				ZFS_LINUX_TEST_RESULT(
+				    [splice_to_pipe_license], [
+					AC_MSG_RESULT(no)
+					AC_DEFINE(HAVE_SPLICE_TO_PIPE, 1,
+					    [splice_to_pipe() is usable])
+				],[
+					AC_MSG_RESULT(yes)
+				])
+			],[
+				AC_MSG_RESULT(no)
+			])
+		])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
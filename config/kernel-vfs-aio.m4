@@ -0,0 +1,60 @@
+dnl #
+dnl # 4.1 API change
+dnl # struct kiocb gained ki_complete() and ki_flags, allowing in-kernel
+dnl # callers to issue asynchronous direct I/O through ->read_iter() and
+dnl # ->write_iter() using a bio_vec backed iov_iter.
+dnl #
+AC_DEFUN([ZFS_AC_KERNEL_SRC_VFS_AIO_BVEC], [
+	ZFS_LINUX_TEST_SRC([vfs_aio_bvec], [
+		#include <linux/fs.h>
+		#include <linux/uio.h>
+		#include <linux/bio.h>
+
+		void test_complete(struct kiocb *iocb, long ret, long ret2) { }
+	],[
+		struct kiocb iocb;
+		struct iov_iter iter;
+		struct bio_vec bv;
+		struct file *fp = NULL;
+
+		init_sync_kiocb(&iocb, fp);
+		iocb.ki_pos = 0;
+		iocb.ki_flags |= IOCB_DIRECT;
+		iocb.ki_complete = test_complete;
+		iov_iter_bvec(&iter, ITER_BVEC | READ, &bv, 1, 0);
+		(void) fp->f_op->read_iter(&iocb, &iter);
+	])
+
+	ZFS_LINUX_TEST_SRC([iov_iter_type], [
+		#include <linux/fs.h>
+		#include <linux/uio.h>
+	],[
+		struct iov_iter iter = { 0 };
+		__attribute__((unused)) enum iter_type i = iov_iter_type(&iter);
+	])
+])
+
+AC_DEFUN([ZFS_AC_KERNEL_VFS_AIO_BVEC], [
+	AC_MSG_CHECKING([whether kiocb->ki_complete() is available])
+	ZFS_LINUX_TEST_RESULT([vfs_aio_bvec], [
+		AC_MSG_RESULT(yes)
+		AC_DEFINE(HAVE_VFS_AIO_BVEC, 1,
+		    [kiocb->ki_complete() is available])
+
+		dnl #
+		dnl # 4.20 API change
+		dnl # iov_iter_bvec() takes the bare data direction, the
+		dnl # ITER_BVEC type is implied and may no longer be passed.
+		dnl #
+		AC_MSG_CHECKING([whether iov_iter_type() is available])
+		ZFS_LINUX_TEST_RESULT([iov_iter_type], [
+			AC_MSG_RESULT(yes)
+			AC_DEFINE(HAVE_IOV_ITER_TYPE, 1,
+			    [iov_iter_type() is available])
+		],[
+			AC_MSG_RESULT(no)
+		])
+	],[
+		AC_MSG_RESULT(no)
+	])
+])
@@ -28,6 +28,7 @@
 #include <linux/module.h>
 #include <linux/sched.h>
 #include <linux/cpumask.h>
+#include <linux/topology.h>
 #include <sys/debug.h>
 #include <sys/zone.h>
 #include <sys/signal.h>
@@ -79,6 +80,8 @@
 #define	max_ncpus			num_possible_cpus()
 #define	boot_ncpus			num_online_cpus()
 #define	CPU_SEQID			smp_processor_id()
+#define	max_nnodes			nr_node_ids
+#define	CPU_NODEID			numa_node_id()
 #define	is_system_labeled()		0
 
 #ifndef RLIM64_INFINITY
@@ -71,6 +71,10 @@ extern int z_compress_level(void *dest, size_t *destLen, const void *source,
     size_t sourceLen, int level);
 extern int z_uncompress(void *dest, size_t *destLen, const void *source,
     size_t sourceLen);
+extern int z_deflate_init(z_stream *stream, int level);
+extern int z_deflate_end(z_stream *stream);
+extern int z_inflate_init(z_stream *stream);
+extern int z_inflate_end(z_stream *stream);
 
 int spl_zlib_init(void);
 void spl_zlib_fini(void);
@@ -46,6 +46,7 @@ typedef enum abd_flags {
 	ABD_FLAG_MULTI_ZONE  = 1 << 3,	/* pages split over memory zones */
 	ABD_FLAG_MULTI_CHUNK = 1 << 4,	/* pages split over multiple chunks */
 	ABD_FLAG_LINEAR_PAGE = 1 << 5,	/* linear but allocd from page */
+	ABD_FLAG_PAGES	= 1 << 6,	/* scatter over caller's pages */
 } abd_flags_t;
 
 typedef struct abd {
@@ -97,6 +98,7 @@ abd_t *abd_get_offset(abd_t *, size_t);
 abd_t *abd_get_offset_size(abd_t *, size_t, size_t);
 abd_t *abd_get_from_buf(void *, size_t);
 void abd_put(abd_t *);
+int abd_node(abd_t *);
 
 /*
  * Conversion to and from a normal buffer
@@ -125,9 +127,17 @@ int abd_cmp_buf_off(abd_t *, const void *, size_t, size_t);
 void abd_zero_off(abd_t *, size_t, size_t);
 
 #if defined(_KERNEL)
+abd_t *abd_get_from_pages(struct page **, uint_t, size_t);
+
+typedef int abd_iter_page_func_t(struct page *page, size_t off, size_t len,
+    void *private);
+
 unsigned int abd_scatter_bio_map_off(struct bio *, abd_t *, unsigned int,
 		size_t);
 unsigned long abd_nr_pages_off(abd_t *, unsigned int, size_t);
+unsigned long abd_nr_bvecs_off(abd_t *, unsigned int, size_t);
+int abd_iterate_page_func(abd_t *, size_t, size_t, abd_iter_page_func_t *,
+    void *);
 #endif
 
 void abd_raidz_gen_iterate(abd_t **cabds, abd_t *dabd,
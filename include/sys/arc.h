@@ -146,6 +146,19 @@ typedef enum arc_flags
 	ARC_FLAG_COMPRESSED_ARC		= 1 << 20,
 	ARC_FLAG_SHARED_DATA		= 1 << 21,
 
+	/*
+	 * Public flag: only cache the buffer in the L2ARC once it has been
+	 * promoted to the MFU list (secondarycache=demand).  It uses a spare
+	 * bit above the private flags so their values are unchanged.
+	 */
+	ARC_FLAG_L2CACHE_MFU		= 1 << 22,
+
+	/*
+	 * Private flag: the L2ARC feed has already counted this buffer in
+	 * l2_write_not_reused.
+	 */
+	ARC_FLAG_L2_NOT_REUSED		= 1 << 23,
+
 	/*
 	 * The arc buffer's compression mode is stored in the top 7 bits of the
 	 * flags field, so these dummy flags are included so that MDB can
@@ -264,6 +277,10 @@ void arc_buf_info(arc_buf_t *buf, arc_buf_info_t *abi, int state_index);
 uint64_t arc_buf_size(arc_buf_t *buf);
 uint64_t arc_buf_lsize(arc_buf_t *buf);
 void arc_buf_access(arc_buf_t *buf);
+#if defined(_KERNEL)
+int arc_buf_iterate_pages(arc_buf_t *buf, uint64_t off, uint64_t size,
+    abd_iter_page_func_t *func, void *private);
+#endif
 void arc_release(arc_buf_t *buf, void *tag);
 int arc_released(arc_buf_t *buf);
 void arc_buf_sigsegv(int sig, siginfo_t *si, void *unused);
@@ -162,6 +162,15 @@ typedef struct dbuf_dirty_record {
 			boolean_t dr_nopwrite;
 			boolean_t dr_has_raw_params;
 
+			/*
+			 * Set when dr_overridden_by was written directly
+			 * from open context by dbuf_direct_write().  The
+			 * data is not kept in memory (the dbuf is left in
+			 * DB_NOFILL) and dmu_sync() can log the block
+			 * pointer as-is.
+			 */
+			boolean_t dr_direct;
+
 			/*
 			 * If dr_has_raw_params is set, the following crypt
 			 * params will be set on the BP that's written.
@@ -324,6 +333,8 @@ int dbuf_hold_impl(struct dnode *dn, uint8_t level, uint64_t blkid,
     boolean_t fail_sparse, boolean_t fail_uncached,
     void *tag, dmu_buf_impl_t **dbp);
 
+int dbuf_dnode_findbp(struct dnode *dn, uint64_t level, uint64_t blkid,
+    blkptr_t *bp, uint16_t *datablkszsec, uint8_t *indblkshift);
 void dbuf_prefetch(struct dnode *dn, int64_t level, uint64_t blkid,
     zio_priority_t prio, arc_flags_t aflags);
 
@@ -339,6 +350,8 @@ dmu_buf_impl_t *dbuf_find(struct objset *os, uint64_t object, uint8_t level,
     uint64_t blkid);
 
 int dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags);
+boolean_t dbuf_read_direct(dmu_buf_impl_t *db, zio_t *pio, abd_t *abd);
+int dbuf_direct_write(dmu_buf_impl_t *db, abd_t *data, dmu_tx_t *tx);
 void dmu_buf_will_not_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_will_fill(dmu_buf_t *db, dmu_tx_t *tx);
 void dmu_buf_fill_done(dmu_buf_t *db, dmu_tx_t *tx);
@@ -389,13 +402,24 @@ boolean_t dbuf_is_metadata(dmu_buf_impl_t *db);
 #define	DBUF_IS_L2CACHEABLE(_db)					\
 	((_db)->db_objset->os_secondary_cache == ZFS_CACHE_ALL ||	\
 	(dbuf_is_metadata(_db) &&					\
-	((_db)->db_objset->os_secondary_cache == ZFS_CACHE_METADATA)))
+	((_db)->db_objset->os_secondary_cache == ZFS_CACHE_METADATA ||	\
+	(_db)->db_objset->os_secondary_cache == ZFS_CACHE_DEMAND)))
+
+/*
+ * With secondarycache=demand, user data is only offered to the L2ARC
+ * when it is read on demand, and even then only once it has been reused
+ * (promoted to the MFU list); see ARC_FLAG_L2CACHE_MFU.
+ */
+#define	DBUF_IS_L2CACHE_DEMAND(_db)					\
+	((_db)->db_objset->os_secondary_cache == ZFS_CACHE_DEMAND &&	\
+	!dbuf_is_metadata(_db))
 
 #define	DNODE_LEVEL_IS_L2CACHEABLE(_dn, _level)				\
 	((_dn)->dn_objset->os_secondary_cache == ZFS_CACHE_ALL ||	\
 	(((_level) > 0 ||						\
 	DMU_OT_IS_METADATA((_dn)->dn_handle->dnh_dnode->dn_type)) &&	\
-	((_dn)->dn_objset->os_secondary_cache == ZFS_CACHE_METADATA)))
+	((_dn)->dn_objset->os_secondary_cache == ZFS_CACHE_METADATA ||	\
+	(_dn)->dn_objset->os_secondary_cache == ZFS_CACHE_DEMAND)))
 
 #ifdef ZFS_DEBUG
 
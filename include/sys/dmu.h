@@ -385,6 +385,7 @@ typedef struct dmu_buf {
 #define	DMU_POOL_CONDENSING_INDIRECT	"com.delphix:condensing_indirect"
 #define	DMU_POOL_ZPOOL_CHECKPOINT	"com.delphix:zpool_checkpoint"
 #define	DMU_POOL_LOG_SPACEMAP_ZAP	"com.delphix:log_spacemap_zap"
+#define	DMU_POOL_DELETED_CLONES		"com.delphix:deleted_clones"
 
 /*
  * Allocate an object from this objset.  The range of object numbers
@@ -856,13 +857,22 @@ void dmu_prealloc(objset_t *os, uint64_t object, uint64_t offset, uint64_t size,
 int dmu_read_uio(objset_t *os, uint64_t object, struct uio *uio, uint64_t size);
 int dmu_read_uio_dbuf(dmu_buf_t *zdb, struct uio *uio, uint64_t size);
 int dmu_read_uio_dnode(dnode_t *dn, struct uio *uio, uint64_t size);
+int dmu_read_pages_dbuf(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_iter_page_func_t *pagefunc, abd_iter_func_t *copyfunc, void *private);
 int dmu_write_uio(objset_t *os, uint64_t object, struct uio *uio, uint64_t size,
 	dmu_tx_t *tx);
 int dmu_write_uio_dbuf(dmu_buf_t *zdb, struct uio *uio, uint64_t size,
 	dmu_tx_t *tx);
 int dmu_write_uio_dnode(dnode_t *dn, struct uio *uio, uint64_t size,
 	dmu_tx_t *tx);
+int dmu_read_uio_direct(dmu_buf_t *zdb, struct uio *uio, uint64_t size);
 #endif
+int dmu_read_direct(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t size, void *buf);
+int dmu_write_direct_by_dnode(dnode_t *dn, uint64_t offset,
+    struct abd *data, dmu_tx_t *tx);
+int dmu_write_direct_by_dbuf(dmu_buf_t *handle, uint64_t offset,
+    struct abd *data, dmu_tx_t *tx);
 struct arc_buf *dmu_request_arcbuf(dmu_buf_t *handle, int size);
 void dmu_return_arcbuf(struct arc_buf *buf);
 int dmu_assign_arcbuf_by_dnode(dnode_t *dn, uint64_t offset,
@@ -892,6 +902,8 @@ extern int zfs_max_recordsize;
  */
 void dmu_prefetch(objset_t *os, uint64_t object, int64_t level, uint64_t offset,
 	uint64_t len, enum zio_priority pri);
+int dmu_prefetch_dnodes(objset_t *os, uint64_t *objs, int count,
+    zio_priority_t pri, int *nblksp);
 int dmu_prefetch_wait(objset_t *os, uint64_t object, uint64_t offset,
     uint64_t size, uint32_t flags);
 
@@ -122,6 +122,7 @@ struct objset {
 	enum zio_checksum os_dedup_checksum;
 	boolean_t os_dedup_verify;
 	zfs_logbias_op_t os_logbias;
+	zfs_direct_t os_direct;
 	zfs_cache_type_t os_primary_cache;
 	zfs_cache_type_t os_secondary_cache;
 	zfs_sync_type_t os_sync;
@@ -143,6 +144,12 @@ struct objset {
 	 */
 	int os_zpl_special_smallblock;
 
+	/*
+	 * Whether each of the last 64 blocks written compressed, used by
+	 * the compression early abort heuristic.  Updated without locking.
+	 */
+	uint64_t os_compress_history;
+
 	/*
 	 * Pointer is constant; the blkptr it points to is protected by
 	 * os_dsl_dataset->ds_bp_rwlock
@@ -201,8 +208,7 @@ struct objset {
 #define	DMU_PROJECTUSED_DNODE(os) ((os)->os_projectused_dnode.dnh_dnode)
 
 #define	DMU_OS_IS_L2CACHEABLE(os)				\
-	((os)->os_secondary_cache == ZFS_CACHE_ALL ||		\
-	(os)->os_secondary_cache == ZFS_CACHE_METADATA)
+	((os)->os_secondary_cache != ZFS_CACHE_NONE)
 
 /* called from zpl */
 int dmu_objset_hold(const char *name, void *tag, objset_t **osp);
@@ -61,6 +61,9 @@ typedef struct dsl_destroy_head_arg {
 int dsl_destroy_head_check(void *, dmu_tx_t *);
 void dsl_destroy_head_sync(void *, dmu_tx_t *);
 
+void dsl_destroy_init(void);
+void dsl_destroy_fini(void);
+
 #ifdef	__cplusplus
 }
 #endif
@@ -34,6 +34,8 @@
 #include <sys/refcount.h>
 #include <sys/zfs_context.h>
 #include <sys/dsl_crypt.h>
+#include <sys/dsl_deadlist.h>
+#include <sys/bplist.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -50,6 +52,7 @@ struct dsl_dataset;
 #define	DD_FIELD_SNAPSHOT_COUNT		"com.joyent:snapshot_count"
 #define	DD_FIELD_CRYPTO_KEY_OBJ		"com.datto:crypto_key_obj"
 #define	DD_FIELD_LAST_REMAP_TXG		"com.delphix:last_remap_txg"
+#define	DD_FIELD_LIVELIST		"com.delphix:livelist"
 
 typedef enum dd_used {
 	DD_USED_HEAD,
@@ -115,6 +118,18 @@ struct dsl_dir {
 	/* amount of space we expect to write; == amount of dirty data */
 	int64_t dd_space_towrite[TXG_SIZE];
 
+	/*
+	 * Blocks allocated and freed by a clone since it was created, see
+	 * dsl_deadlist.c.  Only modified in syncing context; the blocks
+	 * born and killed while the clone's dataset is synced are collected
+	 * in the pending lists and moved to the livelist by
+	 * dsl_dataset_sync_done().
+	 */
+	dsl_deadlist_t dd_livelist;
+	bplist_t dd_pending_allocs;
+	bplist_t dd_pending_frees;
+	boolean_t dd_livelist_remapped;	/* protected by dd_lock */
+
 	/* protected by dd_lock; keep at end of struct for better locality */
 	char dd_myname[ZFS_MAX_DATASET_NAME_LEN];
 };
@@ -185,6 +200,9 @@ void dsl_dir_set_reservation_sync_impl(dsl_dir_t *dd, uint64_t value,
     dmu_tx_t *tx);
 void dsl_dir_zapify(dsl_dir_t *dd, dmu_tx_t *tx);
 boolean_t dsl_dir_is_zapified(dsl_dir_t *dd);
+void dsl_dir_create_livelist(dsl_dir_t *dd, uint64_t mintxg, dmu_tx_t *tx);
+void dsl_dir_remove_livelist(dsl_dir_t *dd, dmu_tx_t *tx);
+uint64_t dsl_dir_detach_livelist(dsl_dir_t *dd, dmu_tx_t *tx);
 
 /* internal reserved dir name */
 #define	MOS_DIR_NAME "$MOS"
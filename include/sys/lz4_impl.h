@@ -0,0 +1,65 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _SYS_LZ4_IMPL_H
+#define	_SYS_LZ4_IMPL_H
+
+#include <sys/types.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * Decode an lz4 block of isize bytes into a buffer of osize bytes.  Returns
+ * the number of bytes decoded, or a negative value if the block is
+ * malformed.  Never reads or writes outside of the two buffers.
+ */
+typedef int lz4_decompress_func_t(const char *src, char *dst, int isize,
+    int osize);
+typedef boolean_t lz4_decompress_will_work_f(void);
+
+typedef struct lz4_decompress_ops {
+	lz4_decompress_func_t		*decompress;
+	lz4_decompress_will_work_f	*is_supported;
+	boolean_t			uses_fpu;
+	const char			*name;
+} lz4_decompress_ops_t;
+
+extern const lz4_decompress_ops_t lz4_decompress_scalar_ops;
+extern const lz4_decompress_ops_t lz4_decompress_generic_ops;
+#if defined(__x86_64) && defined(HAVE_SSE2)
+extern const lz4_decompress_ops_t lz4_decompress_sse2_ops;
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+extern const lz4_decompress_ops_t lz4_decompress_avx2_ops;
+#endif
+
+extern void lz4_decompress_impl_init(void);
+extern void lz4_decompress_impl_fini(void);
+extern int lz4_decompress_impl_set(const char *name);
+extern const lz4_decompress_ops_t *lz4_decompress_impl_get(size_t osize);
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif /* _SYS_LZ4_IMPL_H */
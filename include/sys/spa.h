@@ -519,6 +519,13 @@ _NOTE(CONSTCOND) } while (0)
 	BF64_SET((bp)->blk_fill, 32, 32, iv2);	\
 }
 
+/*
+ * The blkptrs stored in a bpobj have no fill count, so livelists use its
+ * low bit to tell the entries of freed blocks from those of allocated ones.
+ */
+#define	BP_GET_FREE(bp)			BF64_GET((bp)->blk_fill, 0, 1)
+#define	BP_SET_FREE(bp, x)		BF64_SET((bp)->blk_fill, 0, 1, x)
+
 #define	BP_IS_METADATA(bp)	\
 	(BP_GET_LEVEL(bp) > 0 || DMU_OT_IS_METADATA(BP_GET_TYPE(bp)))
 
@@ -741,6 +748,10 @@ extern void spa_async_unrequest(spa_t *spa, int flag);
 extern void spa_async_suspend(spa_t *spa);
 extern void spa_async_resume(spa_t *spa);
 extern int spa_async_tasks(spa_t *spa);
+extern boolean_t spa_livelist_delete_check(spa_t *spa);
+extern void spa_livelist_condense_queue(spa_t *spa, uint64_t dir,
+    uint64_t livelist, uint64_t mintxg, uint64_t bpobj);
+extern void spa_livelist_condense_cancel(spa_t *spa, uint64_t dir);
 extern spa_t *spa_inject_addref(char *pool);
 extern void spa_inject_delref(spa_t *spa);
 extern void spa_scan_stat_init(spa_t *spa);
@@ -1138,6 +1149,8 @@ extern void spa_errlog_rotate(spa_t *spa);
 extern void spa_errlog_drain(spa_t *spa);
 extern void spa_errlog_sync(spa_t *spa, uint64_t txg);
 extern void spa_get_errlists(spa_t *spa, avl_tree_t *last, avl_tree_t *scrub);
+extern void spa_get_errlog_entries(spa_t *spa, avl_tree_t *tree);
+extern int spa_error_entry_compare(const void *a, const void *b);
 
 /* vdev cache */
 extern void vdev_cache_stat_init(void);
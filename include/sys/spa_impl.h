@@ -125,6 +125,22 @@ typedef struct spa_condensing_indirect_phys {
 	uint64_t	scip_next_mapping_object;
 } spa_condensing_indirect_phys_t;
 
+/*
+ * A full sublist of a clone's livelist, waiting to have the entries of
+ * the blocks which were both allocated and freed removed from it (see
+ * dsl_deadlist.c).  Only one sublist is condensed at a time; slc_dir is
+ * zero when there is none.  Sublists filled meanwhile wait their turn on
+ * spa_livelist_condense_pending.
+ */
+typedef struct spa_livelist_condense {
+	uint64_t	slc_dir;	/* dsl_dir owning the livelist */
+	uint64_t	slc_livelist;	/* the livelist's object */
+	uint64_t	slc_mintxg;	/* key of the sublist */
+	uint64_t	slc_bpobj;	/* the sublist's bpobj */
+	boolean_t	slc_cancelled;	/* livelist went away meanwhile */
+	list_node_t	slc_node;	/* on spa_livelist_condense_pending */
+} spa_livelist_condense_t;
+
 struct spa_aux_vdev {
 	uint64_t	sav_object;		/* MOS object for device list */
 	nvlist_t	*sav_config;		/* cached device config */
@@ -175,11 +191,55 @@ typedef enum spa_proc_state {
 	SPA_PROC_GONE		/* spa_thread() is exiting, spa_proc = &p0 */
 } spa_proc_state_t;
 
+/*
+ * When stqs_nodes is non-zero the taskqs are split evenly between that many
+ * NUMA nodes, stqs_count / stqs_nodes consecutive taskqs per node.
+ */
 typedef struct spa_taskqs {
 	uint_t stqs_count;
+	uint_t stqs_nodes;
 	taskq_t **stqs_taskq;
 } spa_taskqs_t;
 
+typedef struct spa_compress_queue_stats {
+	kstat_named_t scqs_depth;
+	kstat_named_t scqs_max_depth;
+	kstat_named_t scqs_zios;
+	kstat_named_t scqs_batches;
+	kstat_named_t scqs_threads;
+} spa_compress_queue_stats_t;
+
+struct spa_compress_queue;
+
+typedef struct spa_compress_entry {
+	zio_t		*sce_zio;
+	list_node_t	sce_node;
+} spa_compress_entry_t;
+
+typedef struct spa_compress_worker {
+	taskq_ent_t	scw_tqent;
+	struct spa_compress_queue *scw_queue;
+	list_node_t	scw_node;
+} spa_compress_worker_t;
+
+/*
+ * Write zios waiting for compression, one queue per NUMA node.  Each
+ * queue has one preallocated task per taskq thread; idle tasks are kept
+ * on scq_idle and dispatched as zios arrive to drain the queue.  A task
+ * removes up to zio_compress_batch entries each time it takes scq_lock,
+ * then runs their zios one after another.
+ */
+typedef struct spa_compress_queue {
+	kmutex_t	scq_lock;
+	list_t		scq_list;
+	list_t		scq_idle;
+	uint_t		scq_threads;
+	spa_compress_worker_t *scq_workers;
+	taskq_t		*scq_taskq;
+	kstat_t		*scq_ksp;
+	spa_compress_queue_stats_t scq_stats;
+} spa_compress_queue_t;
+
 typedef enum spa_all_vdev_zap_action {
 	AVZ_ACTION_NONE = 0,
 	AVZ_ACTION_DESTROY,	/* Destroy all per-vdev ZAPs and the AVZ. */
@@ -218,6 +278,8 @@ struct spa {
 	spa_config_source_t spa_config_source;	/* where config comes from? */
 	uint64_t	spa_import_flags;	/* import specific flags */
 	spa_taskqs_t	spa_zio_taskq[ZIO_TYPES][ZIO_TASKQ_TYPES];
+	spa_compress_queue_t *spa_compress_queue; /* per-node write compress */
+	uint_t		spa_compress_nqueues;
 	dsl_pool_t	*spa_dsl_pool;
 	boolean_t	spa_is_initializing;	/* true while opening pool */
 	boolean_t	spa_is_exporting;	/* true while exporting pool */
@@ -312,6 +374,13 @@ struct spa {
 	spa_checkpoint_info_t spa_checkpoint_info; /* checkpoint accounting */
 	zthr_t		*spa_checkpoint_discard_zthr;
 
+	uint64_t	spa_livelists_to_delete; /* zap of deleted clones */
+	zthr_t		*spa_livelist_delete_zthr;
+	zthr_t		*spa_livelist_condense_zthr;
+	kmutex_t	spa_livelist_lock;	/* protects spa_livelist_condense* */
+	spa_livelist_condense_t spa_livelist_condense;
+	list_t		spa_livelist_condense_pending;
+
 	space_map_t	*spa_syncing_log_sm;	/* current log space map */
 	avl_tree_t	spa_sm_logs_by_txg;
 	kmutex_t	spa_flushed_ms_lock;	/* for metaslabs_by_flushed */
@@ -423,8 +492,9 @@ struct spa {
 
 extern char *spa_config_path;
 
-extern void spa_taskq_dispatch_ent(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
-    task_func_t *func, void *arg, uint_t flags, taskq_ent_t *ent);
+extern boolean_t spa_taskq_dispatch_ent(spa_t *spa, zio_type_t t,
+    zio_taskq_type_t q, task_func_t *func, void *arg, uint_t flags,
+    taskq_ent_t *ent, int node);
 extern void spa_taskq_dispatch_sync(spa_t *, zio_type_t t, zio_taskq_type_t q,
     task_func_t *func, void *arg, uint_t flags);
 extern void spa_load_spares(spa_t *spa);
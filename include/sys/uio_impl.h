@@ -45,5 +45,11 @@ extern int uiomove(void *, size_t, enum uio_rw, uio_t *);
 extern int uio_prefaultpages(ssize_t, uio_t *);
 extern int uiocopy(void *, size_t, enum uio_rw, uio_t *, size_t *);
 extern void uioskip(uio_t *, size_t);
+#ifdef _KERNEL
+struct page;
+extern int uio_get_user_pages(uio_t *, size_t, enum uio_rw, struct page **,
+    uint_t *);
+extern void uio_put_user_pages(struct page **, uint_t, enum uio_rw);
+#endif
 
 #endif	/* _SYS_UIO_IMPL_H */
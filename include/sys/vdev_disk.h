@@ -50,5 +50,8 @@ typedef struct vdev_disk {
 	krwlock_t		vd_lock;
 } vdev_disk_t;
 
+extern void vdev_disk_init(void);
+extern void vdev_disk_fini(void);
+
 #endif /* _KERNEL */
 #endif /* _SYS_VDEV_DISK_H */
@@ -35,6 +35,10 @@ extern "C" {
 
 typedef struct vdev_file {
 	vnode_t		*vf_vnode;
+#ifdef _KERNEL
+	struct file	*vf_dio_file;	/* O_DIRECT handle for async I/O */
+	uint_t		vf_dio_align;	/* required O_DIRECT alignment */
+#endif
 } vdev_file_t;
 
 extern void vdev_file_init(void);
@@ -487,6 +487,8 @@ extern taskq_t	*taskq_create(const char *, int, pri_t, int, int, uint_t);
 	    (taskq_create(a, b, c, d, e, f))
 #define	taskq_create_sysdc(a, b, d, e, p, dc, f) \
 	    (taskq_create(a, b, maxclsyspri, d, e, f))
+#define	taskq_create_node(a, b, c, d, e, n, f) \
+	    (taskq_create(a, b, c, d, e, f))
 extern taskqid_t taskq_dispatch(taskq_t *, task_func_t, void *, uint_t);
 extern taskqid_t taskq_dispatch_delay(taskq_t *, task_func_t, void *, uint_t,
     clock_t);
@@ -611,6 +613,8 @@ extern int vn_openat(char *path, int x1, int oflags, int mode, vnode_t **vpp,
     int x2, int x3, vnode_t *vp, int fd);
 extern int vn_rdwr(int uio, vnode_t *vp, void *addr, ssize_t len,
     offset_t offset, int x1, int x2, rlim64_t x3, void *x4, ssize_t *residp);
+extern int vn_rdwrv(int uio, vnode_t *vp, struct iovec *iov, int iovcnt,
+    offset_t offset, ssize_t *residp);
 extern void vn_close(vnode_t *vp);
 
 #define	vn_remove(path, x1, x2)		remove(path)
@@ -657,6 +661,12 @@ extern void delay(clock_t ticks);
 
 #define	CPU_SEQID	((uintptr_t)pthread_self() & (max_ncpus - 1))
 
+#define	max_nnodes	1
+#define	CPU_NODEID	0
+#define	N_CPU		0
+#define	for_each_node_state(n, s)	for ((n) = 0; (n) < max_nnodes; (n)++)
+#define	NUMA_NO_NODE	(-1)
+
 #define	kcred		NULL
 #define	CRED()		NULL
 
@@ -0,0 +1,90 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef	_SYS_ZFS_READDIRPLUS_H
+#define	_SYS_ZFS_READDIRPLUS_H
+
+#include <sys/types.h>
+#include <linux/ioctl.h>
+
+#ifdef	__cplusplus
+extern "C" {
+#endif
+
+/*
+ * ZFS_IOC_READDIRPLUS returns a directory's entries together with the
+ * attributes stat(2) would report for each of them, which saves callers
+ * such as backup scanners a separate lookup and getattr per entry.
+ *
+ * The caller opens the directory and passes a zfs_readdirplus_t with
+ * zrp_cookie set to zero for the first call.  As many zfs_direntplus_t
+ * records as fit are packed into the zrp_buflen byte buffer at zrp_buf,
+ * each zde_reclen bytes long, and zrp_cookie is updated to resume after
+ * the last one returned.  ZRP_EOF is set once the end of the directory
+ * has been reached.  The "." and ".." entries are not returned.  Like a
+ * lookup of each entry, this requires search permission on the directory,
+ * and owners are reported as the uid and gid stat(2) would return.
+ */
+typedef struct zfs_readdirplus {
+	uint64_t	zrp_cookie;	/* in/out: position in directory */
+	uint64_t	zrp_buf;	/* in: address of record buffer */
+	uint32_t	zrp_buflen;	/* in: size of record buffer */
+	uint32_t	zrp_count;	/* out: number of records returned */
+	uint32_t	zrp_flags;	/* out: ZRP_* flags */
+	uint32_t	zrp_pad;
+} zfs_readdirplus_t;
+
+#define	ZRP_EOF		0x1	/* no entries remain */
+
+typedef struct zfs_direntplus {
+	uint64_t	zde_ino;
+	uint64_t	zde_cookie;	/* position after this entry */
+	uint64_t	zde_gen;
+	uint64_t	zde_mode;
+	uint64_t	zde_nlink;
+	uint64_t	zde_uid;
+	uint64_t	zde_gid;
+	uint64_t	zde_size;
+	uint64_t	zde_blocks;	/* 512 byte blocks allocated */
+	uint64_t	zde_atime[2];
+	uint64_t	zde_mtime[2];
+	uint64_t	zde_ctime[2];
+	uint64_t	zde_crtime[2];
+	uint32_t	zde_blksize;
+	uint32_t	zde_rdev_major;
+	uint32_t	zde_rdev_minor;
+	uint16_t	zde_reclen;	/* total size of this record */
+	uint16_t	zde_namelen;	/* excluding the terminating NUL */
+	uint8_t		zde_type;	/* DT_* directory entry type */
+	uint8_t		zde_pad[7];
+	char		zde_name[];	/* NUL terminated */
+} zfs_direntplus_t;
+
+#define	ZFS_DIRENTPLUS_RECLEN(namelen)	\
+	P2ROUNDUP(offsetof(zfs_direntplus_t, zde_name) + (namelen) + 1, 8)
+
+#define	ZFS_IOC_READDIRPLUS	_IOWR('Z', 1, zfs_readdirplus_t)
+
+#ifdef	__cplusplus
+}
+#endif
+
+#endif	/* _SYS_ZFS_READDIRPLUS_H */
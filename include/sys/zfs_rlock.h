@@ -33,6 +33,7 @@
 extern "C" {
 #endif
 
+#include <sys/list.h>
 #include <sys/avl.h>
 
 typedef enum {
@@ -45,11 +46,25 @@ struct locked_range;
 
 typedef void (rangelock_cb_t)(struct locked_range *, void *);
 
+/*
+ * Per-CPU list of readers which were granted a lock without entering
+ * the tree.  The lists are shared by all rangelocks; each bucket is
+ * allocated on its own cache line.
+ */
+typedef struct rangelock_readers {
+	kmutex_t rr_lock;
+	kcondvar_t rr_cv;	/* cv for writers waiting on a reader */
+	list_t rr_list;		/* locked_range_t granted by the fast path */
+	uint_t rr_waiters;	/* writers waiting on rr_cv */
+} rangelock_readers_t;
+
 typedef struct rangelock {
 	avl_tree_t rl_tree; /* contains locked_range_t */
 	kmutex_t rl_lock;
 	rangelock_cb_t *rl_cb;
 	void *rl_arg;
+	boolean_t rl_fast;	/* readers may use the fast path */
+	uint_t rl_writers;	/* writers holding or waiting for a lock */
 } rangelock_t;
 
 typedef struct locked_range {
@@ -64,10 +79,17 @@ typedef struct locked_range {
 	uint8_t lr_proxy;	/* acting for original range */
 	uint8_t lr_write_wanted; /* writer wants to lock this range */
 	uint8_t lr_read_wanted;	/* reader wants to lock this range */
+	uint8_t lr_fast;	/* granted by the reader fast path */
+	uint_t lr_bucket;	/* reader list of a fast path reader */
+	list_node_t lr_fast_node; /* rr_list link for a fast path reader */
 } locked_range_t;
 
+void zfs_rangelock_readers_init(void);
+void zfs_rangelock_readers_fini(void);
+
 void zfs_rangelock_init(rangelock_t *, rangelock_cb_t *, void *);
 void zfs_rangelock_fini(rangelock_t *);
+void zfs_rangelock_reset(rangelock_t *);
 
 locked_range_t *zfs_rangelock_enter(rangelock_t *,
     uint64_t, uint64_t, rangelock_type_t);
@@ -31,6 +31,7 @@
 #include <sys/cred.h>
 #include <sys/fcntl.h>
 #include <sys/pathname.h>
+#include <sys/abd.h>
 #include <sys/zpl.h>
 
 #ifdef	__cplusplus
@@ -40,7 +41,12 @@ extern "C" {
 extern int zfs_open(struct inode *ip, int mode, int flag, cred_t *cr);
 extern int zfs_close(struct inode *ip, int flag, cred_t *cr);
 extern int zfs_holey(struct inode *ip, int cmd, loff_t *off);
+extern int zfs_fiemap(struct inode *ip, struct fiemap_extent_info *fei,
+    uint64_t start, uint64_t len);
 extern int zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr);
+extern int zfs_read_pages(struct inode *ip, offset_t off, size_t len,
+    abd_iter_page_func_t *pagefunc, abd_iter_func_t *copyfunc, void *private,
+    int ioflag, cred_t *cr);
 extern int zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr);
 extern int zfs_access(struct inode *ip, int mode, int flag, cred_t *cr);
 extern int zfs_lookup(struct inode *dip, char *nm, struct inode **ipp,
@@ -55,6 +61,10 @@ extern int zfs_mkdir(struct inode *dip, char *dirname, vattr_t *vap,
 extern int zfs_rmdir(struct inode *dip, char *name, struct inode *cwd,
     cred_t *cr, int flags);
 extern int zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr);
+extern void zfs_readdir_prefetch_init(void);
+extern void zfs_readdir_prefetch_fini(void);
+extern int zfs_readdirplus(struct inode *ip, uio_t *uio, uint64_t *cookiep,
+    uint32_t *countp, boolean_t *eofp, cred_t *cr);
 extern int zfs_fsync(struct inode *ip, int syncflag, cred_t *cr);
 extern int zfs_getattr(struct inode *ip, vattr_t *vap, int flag, cred_t *cr);
 extern int zfs_getattr_fast(struct inode *ip, struct kstat *sp);
@@ -42,6 +42,7 @@
 #include <sys/zfs_acl.h>
 #include <sys/zil.h>
 #include <sys/zfs_project.h>
+#include <sys/zfs_readdirplus.h>
 
 #ifdef	__cplusplus
 extern "C" {
@@ -344,6 +345,7 @@ extern void	zfs_create_fs(objset_t *os, cred_t *cr, nvlist_t *,
 extern void	zfs_tstamp_update_setup(znode_t *, uint_t, uint64_t [2],
     uint64_t [2]);
 extern void	zfs_grow_blocksize(znode_t *, uint64_t, dmu_tx_t *);
+extern uint64_t	zfs_append_blocksize(znode_t *, uint64_t, uint64_t);
 extern int	zfs_freesp(znode_t *, uint64_t, uint64_t, int, boolean_t);
 extern void	zfs_znode_init(void);
 extern void	zfs_znode_fini(void);
@@ -404,6 +406,10 @@ extern int zfsfstype;
 #endif /* _KERNEL */
 
 extern int zfs_obj_to_path(objset_t *osp, uint64_t obj, char *buf, int len);
+#ifdef _KERNEL
+extern int zfs_obj_to_direntplus(zfsvfs_t *zfsvfs, uint64_t obj,
+    zfs_direntplus_t *zde);
+#endif /* _KERNEL */
 
 #ifdef	__cplusplus
 }
@@ -280,6 +280,8 @@ typedef void zio_done_func_t(zio_t *zio);
 
 extern int zio_exclude_metadata;
 extern int zio_dva_throttle_enabled;
+extern int zio_taskq_numa;
+extern uint_t zio_nnodes;
 extern const char *zio_type_name[ZIO_TYPES];
 
 /*
@@ -350,6 +352,7 @@ typedef struct zio_prop {
 	uint8_t			zp_iv[ZIO_DATA_IV_LEN];
 	uint8_t			zp_mac[ZIO_DATA_MAC_LEN];
 	uint32_t		zp_zpl_smallblk;
+	uint64_t		*zp_compress_history;
 } zio_prop_t;
 
 typedef struct zio_cksum_report zio_cksum_report_t;
@@ -516,6 +519,7 @@ struct zio {
 	kmutex_t	io_lock;
 	kcondvar_t	io_cv;
 	int		io_allocator;
+	int		io_node;	/* NUMA node holding the data */
 
 	/* FMA state */
 	zio_cksum_report_t *io_cksum_report;
@@ -586,6 +590,11 @@ extern int zio_wait(zio_t *zio);
 extern void zio_nowait(zio_t *zio);
 extern void zio_execute(zio_t *zio);
 extern void zio_interrupt(zio_t *zio);
+extern void zio_interrupt_inline(zio_t *zio);
+extern void zio_execute_inline(zio_t *zio);
+extern boolean_t zio_execute_stack_check(zio_t *zio);
+extern int zio_node_to_index(int node);
+extern int zio_index_to_node(uint_t index);
 extern void zio_delay_init(zio_t *zio);
 extern void zio_delay_interrupt(zio_t *zio);
 extern void zio_deadman(zio_t *zio, char *tag);
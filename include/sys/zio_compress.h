@@ -62,10 +62,13 @@ typedef int zio_decompress_func_t(void *src, void *dst,
     size_t s_len, size_t d_len, int);
 
 /*
- * Common signature for all zio decompress functions using an ABD as input.
- * This is helpful if you have both compressed ARC and scatter ABDs enabled,
- * but is not a requirement for all compression algorithms.
+ * Common signatures for all zio compress and decompress functions using an
+ * ABD as input.  These avoid linearizing scatter ABDs, which is helpful if
+ * you have scatter ABDs enabled, but are not a requirement for all
+ * compression algorithms.
  */
+typedef size_t zio_compress_abd_func_t(abd_t *src, void *dst,
+    size_t s_len, size_t d_len, int);
 typedef int zio_decompress_abd_func_t(abd_t *src, void *dst,
     size_t s_len, size_t d_len, int);
 /*
@@ -76,16 +79,45 @@ typedef const struct zio_compress_info {
 	int				ci_level;
 	zio_compress_func_t		*ci_compress;
 	zio_decompress_func_t		*ci_decompress;
+	zio_compress_abd_func_t		*ci_compress_abd;
+	zio_decompress_abd_func_t	*ci_decompress_abd;
 } zio_compress_info_t;
 
 extern zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS];
 
+/*
+ * Compression accelerators.  zca_use() is asked whether the accelerator
+ * will handle a block of the given algorithm and (uncompressed) size.  If
+ * so, the compress and decompress callbacks are passed linear buffers and
+ * return zero on success, or nonzero to have the block handled by the
+ * software implementation instead.  A successful zca_compress() sets
+ * *c_len, which may exceed d_len for data which did not compress.
+ */
+typedef struct zio_compress_accel {
+	const char	*zca_name;
+	boolean_t	(*zca_use)(enum zio_compress c, size_t len);
+	int		(*zca_compress)(enum zio_compress c, void *src,
+	    void *dst, size_t s_len, size_t d_len, size_t *c_len);
+	int		(*zca_decompress)(enum zio_compress c, void *src,
+	    void *dst, size_t s_len, size_t d_len);
+	list_node_t	zca_node;
+} zio_compress_accel_t;
+
+extern void zio_compress_accel_register(zio_compress_accel_t *zca);
+extern void zio_compress_accel_unregister(zio_compress_accel_t *zca);
+
 /*
  * lz4 compression init & free
  */
 extern void lz4_init(void);
 extern void lz4_fini(void);
 
+/*
+ * Compression statistics init & free
+ */
+extern void zio_compress_init(void);
+extern void zio_compress_fini(void);
+
 /*
  * Compression routines.
  */
@@ -97,6 +129,10 @@ extern size_t gzip_compress(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
 extern int gzip_decompress(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
+extern size_t gzip_compress_abd(abd_t *src, void *dst, size_t s_len,
+    size_t d_len, int level);
+extern int gzip_decompress_abd(abd_t *src, void *dst, size_t s_len,
+    size_t d_len, int level);
 extern size_t zle_compress(void *src, void *dst, size_t s_len, size_t d_len,
     int level);
 extern int zle_decompress(void *src, void *dst, size_t s_len, size_t d_len,
@@ -111,6 +147,8 @@ extern int lz4_decompress_zfs(void *src, void *dst, size_t s_len, size_t d_len,
  */
 extern size_t zio_compress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len);
+extern size_t zio_compress_data_adaptive(enum zio_compress c, abd_t *src,
+    void *dst, size_t s_len, uint64_t *history, uint64_t blkid);
 extern int zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len, size_t d_len);
 extern int zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
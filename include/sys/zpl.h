@@ -31,6 +31,7 @@
 #include <linux/dcache_compat.h>
 #include <linux/exportfs.h>
 #include <linux/falloc.h>
+#include <linux/fiemap.h>
 #include <linux/parser.h>
 #include <linux/task_io_accounting_ops.h>
 #include <linux/vfs_compat.h>
@@ -59,6 +60,10 @@ extern long zpl_fallocate_common(struct inode *ip, int mode,
     loff_t offset, loff_t len);
 #endif /* defined(HAVE_FILE_FALLOCATE) || defined(HAVE_INODE_FALLOCATE) */
 
+extern void zpl_readahead_init(void);
+extern void zpl_readahead_fini(void);
+extern void zpl_splice_init(void);
+extern void zpl_splice_fini(void);
 extern const struct address_space_operations zpl_address_space_operations;
 extern const struct file_operations zpl_file_operations;
 extern const struct file_operations zpl_dir_file_operations;
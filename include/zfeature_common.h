@@ -68,6 +68,8 @@ typedef enum spa_feature {
 	SPA_FEATURE_RESILVER_DEFER,
 	SPA_FEATURE_BOOKMARK_V2,
 	SPA_FEATURE_LOG_SPACEMAP,
+	SPA_FEATURE_LIVELIST,
+	SPA_FEATURE_ERROR_SCRUB,
 	SPA_FEATURES
 } spa_feature_t;
 
@@ -31,6 +31,7 @@
 #include <string.h>
 #include <zlib.h>
 #include <libgen.h>
+#include <limits.h>
 #include <sys/signal.h>
 #include <sys/spa.h>
 #include <sys/stat.h>
@@ -676,6 +677,119 @@ vn_rdwr(int uio, vnode_t *vp, void *addr, ssize_t len, offset_t offset,
 	return (0);
 }
 
+/*
+ * Transfer the vector with preadv(2)/pwritev(2) in batches of at most
+ * IOV_MAX entries.  Returns the number of bytes transferred, or -1.
+ */
+static ssize_t
+vn_iov_xfer(int uio, int fd, const struct iovec *iov, int iovcnt,
+    offset_t offset)
+{
+	ssize_t rc, done = 0;
+
+	while (iovcnt > 0) {
+		int cnt = MIN(iovcnt, IOV_MAX);
+		size_t len = 0;
+
+		for (int i = 0; i < cnt; i++)
+			len += iov[i].iov_len;
+
+		if (uio == UIO_READ)
+			rc = preadv64(fd, iov, cnt, offset + done);
+		else
+			rc = pwritev64(fd, iov, cnt, offset + done);
+
+		if (rc == -1)
+			return (-1);
+
+		done += rc;
+		if ((size_t)rc != len)
+			break;
+
+		iov += cnt;
+		iovcnt -= cnt;
+	}
+
+	return (done);
+}
+
+/*
+ * Vectored variant of vn_rdwr() used to transfer the chunks of a scatter
+ * ABD without first copying them to a linear buffer.
+ */
+int
+vn_rdwrv(int uio, vnode_t *vp, struct iovec *iov, int iovcnt,
+    offset_t offset, ssize_t *residp)
+{
+	ssize_t rc, done = 0, len = 0;
+	int i;
+
+	for (i = 0; i < iovcnt; i++)
+		len += iov[i].iov_len;
+
+	if (uio == UIO_READ) {
+		rc = vn_iov_xfer(UIO_READ, vp->v_fd, iov, iovcnt, offset);
+		if (vp->v_dump_fd != -1 && rc == len) {
+			ssize_t status;
+			status = vn_iov_xfer(UIO_WRITE, vp->v_dump_fd, iov,
+			    iovcnt, offset);
+			ASSERT(status != -1);
+		}
+	} else {
+		/*
+		 * As in vn_rdwr(), split writes at a random sector into two
+		 * system calls.  The iovec spanning the split is divided in
+		 * a private copy of the vector.
+		 */
+		struct iovec *siov;
+		int sectors = len >> SPA_MINBLOCKSHIFT;
+		ssize_t split = (sectors > 0 ? rand() % sectors : 0) <<
+		    SPA_MINBLOCKSHIFT;
+		size_t skip = split;
+
+		for (i = 0; i < iovcnt - 1 && skip >= iov[i].iov_len; i++)
+			skip -= iov[i].iov_len;
+
+		siov = umem_alloc((iovcnt + 1) * sizeof (struct iovec),
+		    UMEM_NOFAIL);
+		bcopy(iov, siov, iovcnt * sizeof (struct iovec));
+		bcopy(&iov[i], &siov[i + 1],
+		    (iovcnt - i) * sizeof (struct iovec));
+		siov[i].iov_len = skip;
+		siov[i + 1].iov_base = (char *)iov[i].iov_base + skip;
+		siov[i + 1].iov_len = iov[i].iov_len - skip;
+
+		rc = vn_iov_xfer(UIO_WRITE, vp->v_fd, siov, i + 1, offset);
+		if (rc != -1) {
+			done = rc;
+			rc = vn_iov_xfer(UIO_WRITE, vp->v_fd, &siov[i + 1],
+			    iovcnt - i, offset + split);
+		}
+
+		umem_free(siov, (iovcnt + 1) * sizeof (struct iovec));
+	}
+
+#ifdef __linux__
+	if (rc == -1 && errno == EINVAL) {
+		/*
+		 * As in vn_rdwr(), this most likely means an O_DIRECT
+		 * alignment issue, so we abort() to catch the offender.
+		 */
+		abort();
+	}
+#endif
+	if (rc == -1)
+		return (errno);
+
+	done += rc;
+
+	if (residp)
+		*residp = len - done;
+	else if (done != len)
+		return (EIO);
+	return (0);
+}
+
 void
 vn_close(vnode_t *vp)
 {
@@ -986,14 +986,41 @@ taskq_thread_create(taskq_t *tq)
 	tqt->tqt_tq = tq;
 	tqt->tqt_id = TASKQID_INVALID;
 
-	tqt->tqt_thread = spl_kthread_create(taskq_thread, tqt,
-	    "%s", tq->tq_name);
+	if (tq->tq_node != NUMA_NO_NODE) {
+		tqt->tqt_thread = spl_kthread_create_on_node(taskq_thread, tqt,
+		    tq->tq_node, "%s", tq->tq_name);
+	} else {
+		tqt->tqt_thread = spl_kthread_create(taskq_thread, tqt,
+		    "%s", tq->tq_name);
+	}
 	if (tqt->tqt_thread == NULL) {
 		kmem_free(tqt, sizeof (taskq_thread_t));
 		return (NULL);
 	}
 
-	if (spl_taskq_thread_bind) {
+	if (tq->tq_node != NUMA_NO_NODE) {
+		/*
+		 * Node taskq threads may run on any online cpu of their
+		 * node, or are spread round-robin over those cpus when
+		 * spl_taskq_thread_bind is set.  A node without online
+		 * cpus leaves its threads unbound.
+		 */
+		const struct cpumask *mask = cpumask_of_node(tq->tq_node);
+		int cpu;
+
+		if (spl_taskq_thread_bind) {
+			cpu = cpumask_next_and(tq->tq_lastcpu, mask,
+			    cpu_online_mask);
+			if (cpu >= nr_cpu_ids)
+				cpu = cpumask_first_and(mask, cpu_online_mask);
+			if (cpu < nr_cpu_ids) {
+				tq->tq_lastcpu = cpu;
+				kthread_bind(tqt->tqt_thread, cpu);
+			}
+		} else if (cpumask_intersects(mask, cpu_online_mask)) {
+			set_cpus_allowed_ptr(tqt->tqt_thread, mask);
+		}
+	} else if (spl_taskq_thread_bind) {
 		last_used_cpu = (last_used_cpu + 1) % num_online_cpus();
 		kthread_bind(tqt->tqt_thread, last_used_cpu);
 	}
@@ -1006,9 +1033,9 @@ taskq_thread_create(taskq_t *tq)
 	return (tqt);
 }
 
-taskq_t *
-taskq_create(const char *name, int nthreads, pri_t pri,
-    int minalloc, int maxalloc, uint_t flags)
+static taskq_t *
+__taskq_create(const char *name, int nthreads, pri_t pri,
+    int minalloc, int maxalloc, int node, uint_t flags)
 {
 	taskq_t *tq;
 	taskq_thread_t *tqt;
@@ -1026,7 +1053,12 @@ taskq_create(const char *name, int nthreads, pri_t pri,
 		ASSERT(nthreads >= 0);
 		nthreads = MIN(nthreads, 100);
 		nthreads = MAX(nthreads, 0);
-		nthreads = MAX((num_online_cpus() * nthreads) / 100, 1);
+		if (node != NUMA_NO_NODE) {
+			nthreads = MAX((cpumask_weight(cpumask_of_node(node)) *
+			    nthreads) / 100, 1);
+		} else {
+			nthreads = MAX((num_online_cpus() * nthreads) / 100, 1);
+		}
 	}
 
 	tq = kmem_alloc(sizeof (*tq), KM_PUSHPAGE);
@@ -1055,6 +1087,8 @@ taskq_create(const char *name, int nthreads, pri_t pri,
 	init_waitqueue_head(&tq->tq_work_waitq);
 	init_waitqueue_head(&tq->tq_wait_waitq);
 	tq->tq_lock_class = TQ_LOCK_GENERAL;
+	tq->tq_node = node;
+	tq->tq_lastcpu = -1;
 	INIT_LIST_HEAD(&tq->tq_taskqs);
 
 	if (flags & TASKQ_PREPOPULATE) {
@@ -1099,8 +1133,32 @@ taskq_create(const char *name, int nthreads, pri_t pri,
 
 	return (tq);
 }
+
+taskq_t *
+taskq_create(const char *name, int nthreads, pri_t pri,
+    int minalloc, int maxalloc, uint_t flags)
+{
+	return (__taskq_create(name, nthreads, pri, minalloc, maxalloc,
+	    NUMA_NO_NODE, flags));
+}
 EXPORT_SYMBOL(taskq_create);
 
+/*
+ * Create a taskq whose threads are allocated on, and bound to the cpus of,
+ * the given NUMA node.  When TASKQ_THREADS_CPU_PCT is set the thread count
+ * is a percentage of the node's cpus rather than of all online cpus.
+ */
+taskq_t *
+taskq_create_node(const char *name, int nthreads, pri_t pri,
+    int minalloc, int maxalloc, int node, uint_t flags)
+{
+	ASSERT(node == NUMA_NO_NODE || (node >= 0 && node < nr_node_ids));
+
+	return (__taskq_create(name, nthreads, pri, minalloc, maxalloc,
+	    node, flags));
+}
+EXPORT_SYMBOL(taskq_create_node);
+
 void
 taskq_destroy(taskq_t *tq)
 {
@@ -128,23 +128,18 @@ __thread_create(caddr_t stk, size_t  stksize, thread_func_t func,
 }
 EXPORT_SYMBOL(__thread_create);
 
-/*
- * spl_kthread_create - Wrapper providing pre-3.13 semantics for
- * kthread_create() in which it is not killable and less likely
- * to return -ENOMEM.
- */
-struct task_struct *
-spl_kthread_create(int (*func)(void *), void *data, const char namefmt[], ...)
+static struct task_struct *
+__spl_kthread_create(int (*func)(void *), void *data, int node,
+    const char *name)
 {
 	struct task_struct *tsk;
-	va_list args;
-	char name[TASK_COMM_LEN];
 
-	va_start(args, namefmt);
-	vsnprintf(name, sizeof (name), namefmt, args);
-	va_end(args);
 	do {
+#ifdef HAVE_KTHREAD_CREATE_ON_NODE
+		tsk = kthread_create_on_node(func, data, node, "%s", name);
+#else
 		tsk = kthread_create(func, data, "%s", name);
+#endif
 		if (IS_ERR(tsk)) {
 			if (signal_pending(current)) {
 				clear_thread_flag(TIF_SIGPENDING);
@@ -158,8 +153,46 @@ spl_kthread_create(int (*func)(void *), void *data, const char namefmt[], ...)
 		}
 	} while (1);
 }
+
+/*
+ * spl_kthread_create - Wrapper providing pre-3.13 semantics for
+ * kthread_create() in which it is not killable and less likely
+ * to return -ENOMEM.
+ */
+struct task_struct *
+spl_kthread_create(int (*func)(void *), void *data, const char namefmt[], ...)
+{
+	char name[TASK_COMM_LEN];
+	va_list args;
+
+	va_start(args, namefmt);
+	vsnprintf(name, sizeof (name), namefmt, args);
+	va_end(args);
+
+	return (__spl_kthread_create(func, data, NUMA_NO_NODE, name));
+}
 EXPORT_SYMBOL(spl_kthread_create);
 
+/*
+ * spl_kthread_create_on_node - As spl_kthread_create() but the thread's
+ * task_struct and stack are allocated on the given NUMA node.  Kernels
+ * without kthread_create_on_node() fall back to an unplaced thread.
+ */
+struct task_struct *
+spl_kthread_create_on_node(int (*func)(void *), void *data, int node,
+    const char namefmt[], ...)
+{
+	char name[TASK_COMM_LEN];
+	va_list args;
+
+	va_start(args, namefmt);
+	vsnprintf(name, sizeof (name), namefmt, args);
+	va_end(args);
+
+	return (__spl_kthread_create(func, data, node, name));
+}
+EXPORT_SYMBOL(spl_kthread_create_on_node);
+
 /*
  * spl_kthread_signal - Wrapper for sending signals to a thread.
  */
@@ -191,6 +191,74 @@ z_uncompress(void *dest, size_t *destLen, const void *source, size_t sourceLen)
 }
 EXPORT_SYMBOL(z_uncompress);
 
+/*
+ * Prepares the stream for incremental compression with zlib_deflate(),
+ * using the same parameters as z_compress_level().  The caller provides
+ * next_in/avail_in and next_out/avail_out as the data becomes available
+ * and must release the stream with z_deflate_end().
+ */
+int
+z_deflate_init(z_stream *stream, int level)
+{
+	int err;
+
+	stream->workspace = zlib_workspace_alloc(KM_SLEEP);
+	if (!stream->workspace)
+		return (Z_MEM_ERROR);
+
+	err = zlib_deflateInit(stream, level);
+	if (err != Z_OK)
+		zlib_workspace_free(stream->workspace);
+
+	return (err);
+}
+EXPORT_SYMBOL(z_deflate_init);
+
+int
+z_deflate_end(z_stream *stream)
+{
+	int err;
+
+	err = zlib_deflateEnd(stream);
+	zlib_workspace_free(stream->workspace);
+
+	return (err);
+}
+EXPORT_SYMBOL(z_deflate_end);
+
+/*
+ * Prepares the stream for incremental decompression with zlib_inflate().
+ * The stream must be released with z_inflate_end().
+ */
+int
+z_inflate_init(z_stream *stream)
+{
+	int err;
+
+	stream->workspace = zlib_workspace_alloc(KM_SLEEP);
+	if (!stream->workspace)
+		return (Z_MEM_ERROR);
+
+	err = zlib_inflateInit(stream);
+	if (err != Z_OK)
+		zlib_workspace_free(stream->workspace);
+
+	return (err);
+}
+EXPORT_SYMBOL(z_inflate_init);
+
+int
+z_inflate_end(z_stream *stream)
+{
+	int err;
+
+	err = zlib_inflateEnd(stream);
+	zlib_workspace_free(stream->workspace);
+
+	return (err);
+}
+EXPORT_SYMBOL(z_inflate_end);
+
 int
 spl_zlib_init(void)
 {
@@ -53,6 +53,7 @@
 #include <sys/strings.h>
 #include <linux/kmap_compat.h>
 #include <linux/uaccess.h>
+#include <linux/mm.h>
 
 /*
  * Move "n" bytes at byte address "p"; "rw" indicates the direction
@@ -275,4 +276,65 @@ uioskip(uio_t *uiop, size_t n)
 	uiop->uio_resid -= n;
 }
 EXPORT_SYMBOL(uioskip);
+
+/*
+ * Pin the user pages backing the next n bytes of *uio, without advancing
+ * it, so that data can be moved to or from them in place.  Only a page
+ * aligned range of user memory within the current iovec is supported;
+ * ENOTSUP is returned otherwise and the caller should use uiomove()
+ * instead.  "rw" has the same meaning as for uiomove(), so the pages are
+ * written to for UIO_READ.  The caller provides room for n / PAGESIZE
+ * pages and releases them with uio_put_user_pages().
+ */
+int
+uio_get_user_pages(uio_t *uio, size_t n, enum uio_rw rw,
+    struct page **pages, uint_t *npages)
+{
+	const struct iovec *iov = uio->uio_iov;
+	unsigned long addr;
+	int nr, got;
+
+	if (uio->uio_segflg != UIO_USERSPACE || uio->uio_iovcnt == 0 ||
+	    iov->iov_len - uio->uio_skip < n)
+		return (ENOTSUP);
+
+	addr = (unsigned long)iov->iov_base + uio->uio_skip;
+	if (!IS_P2ALIGNED(addr, PAGESIZE) || !IS_P2ALIGNED(n, PAGESIZE) ||
+	    n == 0)
+		return (ENOTSUP);
+
+	nr = n >> PAGE_SHIFT;
+#ifdef HAVE_GET_USER_PAGES_FAST_GUP_FLAGS
+	got = get_user_pages_fast(addr, nr,
+	    rw == UIO_READ ? FOLL_WRITE : 0, pages);
+#else
+	got = get_user_pages_fast(addr, nr, rw == UIO_READ, pages);
+#endif
+	if (got != nr) {
+		if (got > 0)
+			uio_put_user_pages(pages, got, UIO_WRITE);
+		return (EFAULT);
+	}
+
+	*npages = nr;
+	return (0);
+}
+EXPORT_SYMBOL(uio_get_user_pages);
+
+/*
+ * Release pages pinned by uio_get_user_pages(), marking them dirty if
+ * they were read into.
+ */
+void
+uio_put_user_pages(struct page **pages, uint_t npages, enum uio_rw rw)
+{
+	uint_t i;
+
+	for (i = 0; i < npages; i++) {
+		if (rw == UIO_READ)
+			set_page_dirty_lock(pages[i]);
+		put_page(pages[i]);
+	}
+}
+EXPORT_SYMBOL(uio_put_user_pages);
 #endif /* _KERNEL */
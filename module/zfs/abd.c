@@ -140,6 +140,7 @@ typedef struct abd_stats {
 	kstat_named_t abdstat_scatter_page_multi_zone;
 	kstat_named_t abdstat_scatter_page_alloc_retry;
 	kstat_named_t abdstat_scatter_sg_table_retry;
+	kstat_named_t abdstat_scatter_page_numa_remote;
 } abd_stats_t;
 
 static abd_stats_t abd_stats = {
@@ -194,6 +195,11 @@ static abd_stats_t abd_stats = {
 	 *  allocate the sg table for an ABD.
 	 */
 	{ "scatter_sg_table_retry",		KSTAT_DATA_UINT64 },
+	/*
+	 * The number of pages allocated to scatter ABDs from a node other
+	 * than the allocating cpu's node while zio_taskq_numa is enabled.
+	 */
+	{ "scatter_page_numa_remote",		KSTAT_DATA_UINT64 },
 };
 
 #define	ABDSTAT(stat)		(abd_stats.stat.value.ui64)
@@ -257,6 +263,10 @@ abd_chunkcnt_for_bytes(size_t size)
  * progressively decreased until it can be satisfied without performing
  * reclaim or compaction.  When necessary this function will degenerate to
  * allocating individual pages and allowing reclaim to satisfy allocations.
+ *
+ * When zio_taskq_numa is set compound pages are only taken from the
+ * allocating cpu's node; a smaller local page is preferred over a larger
+ * remote one.  Individual pages may still fall back to any node.
  */
 static void
 abd_alloc_pages(abd_t *abd, size_t size)
@@ -272,10 +282,20 @@ abd_alloc_pages(abd_t *abd, size_t size)
 	int chunks = 0, zones = 0;
 	size_t remaining_size;
 	int nid = NUMA_NO_NODE;
+	int home = NUMA_NO_NODE;
 	int alloc_pages = 0;
+	int remote_pages = 0;
 
 	INIT_LIST_HEAD(&pages);
 
+	if (zio_taskq_numa) {
+		home = numa_node_id();
+		if (node_state(home, N_HIGH_MEMORY))
+			gfp_comp |= __GFP_THISNODE;
+		else
+			home = NUMA_NO_NODE;
+	}
+
 	while (alloc_pages < nr_pages) {
 		unsigned chunk_pages;
 		int order;
@@ -283,7 +303,8 @@ abd_alloc_pages(abd_t *abd, size_t size)
 		order = MIN(highbit64(nr_pages - alloc_pages) - 1, max_order);
 		chunk_pages = (1U << order);
 
-		page = alloc_pages_node(nid, order ? gfp_comp : gfp, order);
+		page = alloc_pages_node(home != NUMA_NO_NODE ? home : nid,
+		    order ? gfp_comp : gfp, order);
 		if (page == NULL) {
 			if (order == 0) {
 				ABDSTAT_BUMP(abdstat_scatter_page_alloc_retry);
@@ -299,6 +320,9 @@ abd_alloc_pages(abd_t *abd, size_t size)
 		if ((nid != NUMA_NO_NODE) && (page_to_nid(page) != nid))
 			zones++;
 
+		if ((home != NUMA_NO_NODE) && (page_to_nid(page) != home))
+			remote_pages += chunk_pages;
+
 		nid = page_to_nid(page);
 		ABDSTAT_BUMP(abdstat_scatter_orders[order]);
 		chunks++;
@@ -307,6 +331,9 @@ abd_alloc_pages(abd_t *abd, size_t size)
 
 	ASSERT3S(alloc_pages, ==, nr_pages);
 
+	if (remote_pages > 0)
+		ABDSTAT_INCR(abdstat_scatter_page_numa_remote, remote_pages);
+
 	while (sg_alloc_table(&table, chunks, gfp)) {
 		ABDSTAT_BUMP(abdstat_scatter_sg_table_retry);
 		schedule_timeout_interruptible(1);
@@ -508,8 +535,13 @@ abd_alloc_pages(abd_t *abd, size_t size)
 	    sizeof (struct scatterlist), KM_SLEEP);
 	sg_init_table(ABD_SCATTER(abd).abd_sgl, nr_pages);
 
+	/*
+	 * Page align the chunks so they may be passed directly to preadv(2)
+	 * and pwritev(2) for devices opened with O_DIRECT.
+	 */
 	abd_for_each_sg(abd, sg, nr_pages, i) {
-		struct page *p = umem_alloc_aligned(PAGESIZE, 64, KM_SLEEP);
+		struct page *p = umem_alloc_aligned(PAGESIZE, PAGESIZE,
+		    KM_SLEEP);
 		sg_set_page(sg, p, PAGESIZE, 0);
 	}
 	ABD_SCATTER(abd).abd_nents = nr_pages;
@@ -577,7 +609,7 @@ abd_verify(abd_t *abd)
 	ASSERT3U(abd->abd_size, <=, SPA_MAXBLOCKSIZE);
 	ASSERT3U(abd->abd_flags, ==, abd->abd_flags & (ABD_FLAG_LINEAR |
 	    ABD_FLAG_OWNER | ABD_FLAG_META | ABD_FLAG_MULTI_ZONE |
-	    ABD_FLAG_MULTI_CHUNK | ABD_FLAG_LINEAR_PAGE));
+	    ABD_FLAG_MULTI_CHUNK | ABD_FLAG_LINEAR_PAGE | ABD_FLAG_PAGES));
 	IMPLY(abd->abd_parent != NULL, !(abd->abd_flags & ABD_FLAG_OWNER));
 	IMPLY(abd->abd_flags & ABD_FLAG_META, abd->abd_flags & ABD_FLAG_OWNER);
 	if (abd_is_linear(abd)) {
@@ -876,9 +908,53 @@ abd_get_from_buf(void *buf, size_t size)
 	return (abd);
 }
 
+#ifdef _KERNEL
 /*
- * Free an ABD allocated from abd_get_offset() or abd_get_from_buf(). Will not
- * free the underlying scatterlist or buffer.
+ * Allocate a scatter ABD structure for size bytes of an array of whole
+ * pages, such as pinned user pages.  The pages are not referenced or
+ * released by the ABD; free it with abd_put() before releasing them.
+ */
+abd_t *
+abd_get_from_pages(struct page **pages, uint_t npages, size_t size)
+{
+	abd_t *abd = abd_alloc_struct();
+	struct scatterlist *sg;
+	struct sg_table table;
+	uint_t i;
+
+	VERIFY3U(size, <=, SPA_MAXBLOCKSIZE);
+	ASSERT3U(size, <=, (size_t)npages << PAGE_SHIFT);
+	ASSERT3U(size, >, (size_t)(npages - 1) << PAGE_SHIFT);
+
+	while (sg_alloc_table(&table, npages, __GFP_NOWARN | GFP_NOIO)) {
+		ABDSTAT_BUMP(abdstat_scatter_sg_table_retry);
+		schedule_timeout_interruptible(1);
+	}
+
+	for_each_sg(table.sgl, sg, npages, i) {
+		sg_set_page(sg, pages[i], MIN(size - ((size_t)i << PAGE_SHIFT),
+		    PAGESIZE), 0);
+	}
+
+	/*
+	 * We don't own the pages, and they are never metadata, so only
+	 * ABD_FLAG_PAGES is set; it tells abd_put() to free the table.
+	 */
+	abd->abd_flags = ABD_FLAG_PAGES;
+	abd->abd_size = size;
+	abd->abd_parent = NULL;
+	zfs_refcount_create(&abd->abd_children);
+	ABD_SCATTER(abd).abd_offset = 0;
+	ABD_SCATTER(abd).abd_nents = npages;
+	ABD_SCATTER(abd).abd_sgl = table.sgl;
+
+	return (abd);
+}
+#endif
+
+/*
+ * Free an ABD allocated from abd_get_offset(), abd_get_from_buf() or
+ * abd_get_from_pages(). Will not free the underlying buffer or pages.
  */
 void
 abd_put(abd_t *abd)
@@ -891,10 +967,42 @@ abd_put(abd_t *abd)
 		    abd->abd_size, abd);
 	}
 
+#ifdef _KERNEL
+	if (abd->abd_flags & ABD_FLAG_PAGES) {
+		struct sg_table table;
+
+		table.sgl = ABD_SCATTER(abd).abd_sgl;
+		table.nents = table.orig_nents = ABD_SCATTER(abd).abd_nents;
+		sg_free_table(&table);
+	}
+#endif
+
 	zfs_refcount_destroy(&abd->abd_children);
 	abd_free_struct(abd);
 }
 
+/*
+ * Return the NUMA node holding the start of an ABD's data, or NUMA_NO_NODE
+ * when it cannot be determined.  Used to keep pipeline work near the data.
+ */
+int
+abd_node(abd_t *abd)
+{
+#ifdef _KERNEL
+	void *buf;
+
+	if (!abd_is_linear(abd))
+		return (page_to_nid(sg_page(ABD_SCATTER(abd).abd_sgl)));
+
+	buf = ABD_BUF(abd);
+	if (is_vmalloc_addr(buf))
+		return (page_to_nid(vmalloc_to_page(buf)));
+	if (virt_addr_valid(buf))
+		return (page_to_nid(virt_to_page(buf)));
+#endif
+	return (NUMA_NO_NODE);
+}
+
 /*
  * Get the raw buffer associated with a linear ABD.
  */
@@ -1552,10 +1660,47 @@ abd_nr_pages_off(abd_t *abd, unsigned int size, size_t off)
 	    (pos >> PAGE_SHIFT);
 }
 
+/*
+ * The number of bio_vecs needed to map [off, off + size) of an ABD.  When
+ * the kernel supports multi-page bvecs each physically contiguous chunk of
+ * an ABD needs only one, otherwise one is needed per page.
+ */
+unsigned long
+abd_nr_bvecs_off(abd_t *abd, unsigned int size, size_t off)
+{
+#ifdef HAVE_BIO_MULTIPAGE_BVEC
+	if (abd_is_linear(abd)) {
+		if (!is_vmalloc_addr(abd_to_buf(abd)))
+			return (1);
+	} else {
+		struct abd_iter aiter;
+		unsigned long nr = 0;
+
+		abd_iter_init(&aiter, abd, 0);
+		abd_iter_advance(&aiter, off);
+
+		while (size > 0) {
+			size_t len = MIN(size,
+			    aiter.iter_sg->length - aiter.iter_offset);
+
+			nr++;
+			size -= len;
+			abd_iter_advance(&aiter, len);
+		}
+
+		return (nr);
+	}
+#endif
+	return (abd_nr_pages_off(abd, size, off));
+}
+
 /*
  * bio_map for scatter ABD.
  * @off is the offset in @abd
  * Remaining IO size is returned
+ *
+ * With multi-page bvecs each scatter chunk is added whole, so a bio holds
+ * up to bi_max_vecs chunks rather than bi_max_vecs pages.
  */
 unsigned int
 abd_scatter_bio_map_off(struct bio *bio, abd_t *abd,
@@ -1581,7 +1726,11 @@ abd_scatter_bio_map_off(struct bio *bio, abd_t *abd,
 		sg = aiter.iter_sg;
 		sgoff = aiter.iter_offset;
 		pgoff = sgoff & (PAGESIZE - 1);
+#ifdef HAVE_BIO_MULTIPAGE_BVEC
+		len = MIN(io_size, sg->length - sgoff);
+#else
 		len = MIN(io_size, PAGESIZE - pgoff);
+#endif
 		ASSERT(len > 0);
 
 		pg = nth_page(sg_page(sg), sgoff >> PAGE_SHIFT);
@@ -1595,6 +1744,65 @@ abd_scatter_bio_map_off(struct bio *bio, abd_t *abd,
 	return (io_size);
 }
 
+/*
+ * Call func for each page, or part of a page, backing [off, off + size)
+ * of an ABD, so that the caller can take references to the pages instead
+ * of copying the data out.  Each call covers at most one page.  Linear
+ * ABDs which were not allocated from pages cannot be referenced this
+ * way and return ENOTSUP.
+ */
+int
+abd_iterate_page_func(abd_t *abd, size_t off, size_t size,
+    abd_iter_page_func_t *func, void *private)
+{
+	struct abd_iter aiter;
+	int ret = 0;
+
+	ASSERT3U(off + size, <=, abd->abd_size);
+
+	if (abd_is_linear(abd)) {
+		struct page *base;
+
+		if (!abd_is_linear_page(abd))
+			return (SET_ERROR(ENOTSUP));
+
+		base = sg_page(abd->abd_u.abd_linear.abd_sgl);
+		while (size > 0 && ret == 0) {
+			size_t pgoff = off & (PAGESIZE - 1);
+			size_t len = MIN(size, PAGESIZE - pgoff);
+
+			ret = func(nth_page(base, off >> PAGE_SHIFT), pgoff,
+			    len, private);
+			off += len;
+			size -= len;
+		}
+
+		return (ret);
+	}
+
+	abd_iter_init(&aiter, abd, 0);
+	abd_iter_advance(&aiter, off);
+
+	while (size > 0 && ret == 0) {
+		struct page *pg;
+		size_t len, sgoff, pgoff;
+
+		sgoff = aiter.iter_offset;
+		pgoff = sgoff & (PAGESIZE - 1);
+		len = MIN(size, PAGESIZE - pgoff);
+		len = MIN(len, aiter.iter_sg->length - sgoff);
+		ASSERT(len > 0);
+
+		pg = nth_page(sg_page(aiter.iter_sg), sgoff >> PAGE_SHIFT);
+		ret = func(pg, pgoff, len, private);
+
+		size -= len;
+		abd_iter_advance(&aiter, len);
+	}
+
+	return (ret);
+}
+
 /* Tunable Parameters */
 module_param(zfs_abd_scatter_enabled, int, 0644);
 MODULE_PARM_DESC(zfs_abd_scatter_enabled,
@@ -258,6 +258,8 @@
  * ARC is disabled, then the L2ARC's block must be transformed to look
  * like the physical block in the main data pool before comparing the
  * checksum and determining its validity.
+ * Fully encrypted blocks skip the checksum comparison, since decrypting them
+ * checks them against the MAC in the bp, which covers the same bytes.
  *
  * The L1ARC has a slightly different system for storing encrypted data.
  * Raw (encrypted + possibly compressed) data has a few subtle differences from
@@ -699,9 +701,11 @@ typedef struct arc_stats {
 	kstat_named_t arcstat_l2_evict_lock_retry;
 	kstat_named_t arcstat_l2_evict_reading;
 	kstat_named_t arcstat_l2_evict_l1cached;
+	kstat_named_t arcstat_l2_write_not_reused;
 	kstat_named_t arcstat_l2_free_on_write;
 	kstat_named_t arcstat_l2_abort_lowmem;
 	kstat_named_t arcstat_l2_cksum_bad;
+	kstat_named_t arcstat_l2_mac_verified;
 	kstat_named_t arcstat_l2_io_error;
 	kstat_named_t arcstat_l2_lsize;
 	kstat_named_t arcstat_l2_psize;
@@ -802,9 +806,11 @@ static arc_stats_t arc_stats = {
 	{ "l2_evict_lock_retry",	KSTAT_DATA_UINT64 },
 	{ "l2_evict_reading",		KSTAT_DATA_UINT64 },
 	{ "l2_evict_l1cached",		KSTAT_DATA_UINT64 },
+	{ "l2_write_not_reused",	KSTAT_DATA_UINT64 },
 	{ "l2_free_on_write",		KSTAT_DATA_UINT64 },
 	{ "l2_abort_lowmem",		KSTAT_DATA_UINT64 },
 	{ "l2_cksum_bad",		KSTAT_DATA_UINT64 },
+	{ "l2_mac_verified",		KSTAT_DATA_UINT64 },
 	{ "l2_io_error",		KSTAT_DATA_UINT64 },
 	{ "l2_size",			KSTAT_DATA_UINT64 },
 	{ "l2_asize",			KSTAT_DATA_UINT64 },
@@ -946,6 +952,8 @@ static taskq_t *arc_prune_taskq;
 	((hdr)->b_flags & ARC_FLAG_COMPRESSED_ARC)
 
 #define	HDR_L2CACHE(hdr)	((hdr)->b_flags & ARC_FLAG_L2CACHE)
+#define	HDR_L2CACHE_MFU(hdr)	((hdr)->b_flags & ARC_FLAG_L2CACHE_MFU)
+#define	HDR_L2_NOT_REUSED(hdr)	((hdr)->b_flags & ARC_FLAG_L2_NOT_REUSED)
 #define	HDR_L2_READING(hdr)	\
 	(((hdr)->b_flags & ARC_FLAG_IO_IN_PROGRESS) &&	\
 	((hdr)->b_flags & ARC_FLAG_HAS_L2HDR))
@@ -1729,7 +1737,6 @@ arc_buf_type(arc_buf_hdr_t *hdr)
 	} else {
 		type = ARC_BUFC_DATA;
 	}
-	VERIFY3U(hdr->b_type, ==, type);
 	return (type);
 }
 
@@ -1811,6 +1818,24 @@ arc_hdr_clear_flags(arc_buf_hdr_t *hdr, arc_flags_t flags)
 	hdr->b_flags &= ~flags;
 }
 
+/*
+ * Mark a header as L2ARC eligible on behalf of a reader.  A reader that
+ * only wants the block cached once it has been reused (ARC_FLAG_L2CACHE_MFU)
+ * never overrides one that wants it cached unconditionally.
+ */
+static inline void
+arc_hdr_set_l2cache(arc_buf_hdr_t *hdr, arc_flags_t flags)
+{
+	ASSERT(flags & ARC_FLAG_L2CACHE);
+
+	if (!(flags & ARC_FLAG_L2CACHE_MFU)) {
+		arc_hdr_clear_flags(hdr, ARC_FLAG_L2CACHE_MFU);
+		arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
+	} else if (!HDR_L2CACHE(hdr)) {
+		arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE | ARC_FLAG_L2CACHE_MFU);
+	}
+}
+
 /*
  * Setting the compression bits in the arc_buf_hdr_t's b_flags is
  * done in a special way since we have to clear and set bits
@@ -2506,10 +2531,11 @@ arc_buf_info(arc_buf_t *ab, arc_buf_info_t *abi, int state_index)
 		abi->abi_holds = zfs_refcount_count(&l1hdr->b_refcnt);
 	}
 
-	if (l2hdr) {
+	if (l1hdr)
+		abi->abi_l2arc_hits = l1hdr->b_l2_hits;
+
+	if (l2hdr)
 		abi->abi_l2arc_dattr = l2hdr->b_daddr;
-		abi->abi_l2arc_hits = l2hdr->b_hits;
-	}
 
 	abi->abi_state_type = state ? state->arcs_state : ARC_STATE_ANON;
 	abi->abi_state_contents = arc_buf_type(hdr);
@@ -2868,8 +2894,6 @@ arc_buf_alloc_impl(arc_buf_hdr_t *hdr, spa_t *spa, const zbookmark_phys_t *zb,
 
 	ASSERT(HDR_HAS_L1HDR(hdr));
 	ASSERT3U(HDR_GET_LSIZE(hdr), >, 0);
-	VERIFY(hdr->b_type == ARC_BUFC_DATA ||
-	    hdr->b_type == ARC_BUFC_METADATA);
 	ASSERT3P(ret, !=, NULL);
 	ASSERT3P(*ret, ==, NULL);
 	IMPLY(encrypted, compressed);
@@ -3394,7 +3418,6 @@ arc_hdr_alloc(uint64_t spa, int32_t psize, int32_t lsize,
 	HDR_SET_PSIZE(hdr, psize);
 	HDR_SET_LSIZE(hdr, lsize);
 	hdr->b_spa = spa;
-	hdr->b_type = type;
 	hdr->b_flags = 0;
 	arc_hdr_set_flags(hdr, arc_bufc_to_flags(type) | ARC_FLAG_HAS_L1HDR);
 	arc_hdr_set_compress(hdr, compression_type);
@@ -3577,7 +3600,6 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	 */
 	nhdr->b_dva = hdr->b_dva;
 	nhdr->b_birth = hdr->b_birth;
-	nhdr->b_type = hdr->b_type;
 	nhdr->b_flags = hdr->b_flags;
 	nhdr->b_psize = hdr->b_psize;
 	nhdr->b_lsize = hdr->b_lsize;
@@ -3621,7 +3643,6 @@ arc_hdr_realloc_crypt(arc_buf_hdr_t *hdr, boolean_t need_crypt)
 	/* unset all members of the original hdr */
 	bzero(&hdr->b_dva, sizeof (dva_t));
 	hdr->b_birth = 0;
-	hdr->b_type = ARC_BUFC_INVALID;
 	hdr->b_flags = 0;
 	hdr->b_psize = 0;
 	hdr->b_lsize = 0;
@@ -5610,7 +5631,7 @@ arc_get_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag)
 		mutex_exit(&arc_adjust_lock);
 	}
 
-	VERIFY3U(hdr->b_type, ==, type);
+	VERIFY3U(arc_buf_type(hdr), ==, type);
 	if (type == ARC_BUFC_METADATA) {
 		arc_space_consume(size, ARC_SPACE_META);
 	} else {
@@ -5692,7 +5713,7 @@ arc_free_data_impl(arc_buf_hdr_t *hdr, uint64_t size, void *tag)
 	}
 	(void) zfs_refcount_remove_many(&state->arcs_size, size, tag);
 
-	VERIFY3U(hdr->b_type, ==, type);
+	VERIFY3U(arc_buf_type(hdr), ==, type);
 	if (type == ARC_BUFC_METADATA) {
 		arc_space_return(size, ARC_SPACE_META);
 	} else {
@@ -5890,6 +5911,56 @@ arc_buf_access(arc_buf_t *buf)
 	    demand, prefetch, !HDR_ISTYPE_METADATA(hdr), data, metadata, hits);
 }
 
+#if defined(_KERNEL)
+/*
+ * Call func for the pages holding [off, off + size) of a buffer's data in
+ * the header's own copy, b_pabd, so that the caller can reference the ARC
+ * pages rather than copy them.  This is only possible when b_pabd holds
+ * the data uncompressed and decrypted in page-backed memory and is not
+ * shared with a buffer; otherwise ENOTSUP is returned and the caller must
+ * copy from buf->b_data.
+ *
+ * A header's b_pabd is never modified in place, and the pages are freed by
+ * dropping a page reference, so pages the caller takes a reference on keep
+ * their contents even after the header is evicted.  func is called with
+ * the hash lock held and must not block.
+ */
+int
+arc_buf_iterate_pages(arc_buf_t *buf, uint64_t off, uint64_t size,
+    abd_iter_page_func_t *func, void *private)
+{
+	int err = SET_ERROR(ENOTSUP);
+
+	if (ARC_BUF_COMPRESSED(buf) || ARC_BUF_ENCRYPTED(buf))
+		return (err);
+
+	mutex_enter(&buf->b_evict_lock);
+	arc_buf_hdr_t *hdr = buf->b_hdr;
+
+	if (hdr->b_l1hdr.b_state == arc_anon || HDR_EMPTY(hdr)) {
+		mutex_exit(&buf->b_evict_lock);
+		return (err);
+	}
+
+	kmutex_t *hash_lock = HDR_LOCK(hdr);
+	mutex_enter(hash_lock);
+
+	if (hdr->b_l1hdr.b_state != arc_anon && !HDR_EMPTY(hdr) &&
+	    !HDR_IO_IN_PROGRESS(hdr) && !HDR_SHARED_DATA(hdr) &&
+	    !HDR_NOAUTH(hdr) && hdr->b_l1hdr.b_pabd != NULL &&
+	    arc_hdr_get_compress(hdr) == ZIO_COMPRESS_OFF &&
+	    off + size <= HDR_GET_LSIZE(hdr)) {
+		err = abd_iterate_page_func(hdr->b_l1hdr.b_pabd, off, size,
+		    func, private);
+	}
+
+	mutex_exit(hash_lock);
+	mutex_exit(&buf->b_evict_lock);
+
+	return (err);
+}
+#endif
+
 /* a generic arc_read_done_func_t which you can use */
 /* ARGSUSED */
 void
@@ -6390,7 +6461,7 @@ top:
 		if (*arc_flags & ARC_FLAG_PRESCIENT_PREFETCH)
 			arc_hdr_set_flags(hdr, ARC_FLAG_PRESCIENT_PREFETCH);
 		if (*arc_flags & ARC_FLAG_L2CACHE)
-			arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
+			arc_hdr_set_l2cache(hdr, *arc_flags);
 		mutex_exit(hash_lock);
 		ARCSTAT_BUMP(arcstat_hits);
 		ARCSTAT_CONDSTAT(!HDR_PREFETCH(hdr),
@@ -6521,7 +6592,7 @@ top:
 		if (*arc_flags & ARC_FLAG_PRESCIENT_PREFETCH)
 			arc_hdr_set_flags(hdr, ARC_FLAG_PRESCIENT_PREFETCH);
 		if (*arc_flags & ARC_FLAG_L2CACHE)
-			arc_hdr_set_flags(hdr, ARC_FLAG_L2CACHE);
+			arc_hdr_set_l2cache(hdr, *arc_flags);
 		if (BP_IS_AUTHENTICATED(bp))
 			arc_hdr_set_flags(hdr, ARC_FLAG_NOAUTH);
 		if (BP_GET_LEVEL(bp) > 0)
@@ -6605,7 +6676,7 @@ top:
 
 				DTRACE_PROBE1(l2arc__hit, arc_buf_hdr_t *, hdr);
 				ARCSTAT_BUMP(arcstat_l2_hits);
-				atomic_inc_32(&hdr->b_l2hdr.b_hits);
+				atomic_inc_32(&hdr->b_l1hdr.b_l2_hits);
 
 				cb = kmem_zalloc(sizeof (l2arc_read_callback_t),
 				    KM_SLEEP);
@@ -6890,7 +6961,6 @@ arc_release(arc_buf_t *buf, void *tag)
 		boolean_t protected = HDR_PROTECTED(hdr);
 		enum zio_compress compress = arc_hdr_get_compress(hdr);
 		arc_buf_contents_t type = arc_buf_type(hdr);
-		VERIFY3U(hdr->b_type, ==, type);
 
 		ASSERT(hdr->b_l1hdr.b_buf != buf || buf->b_next != NULL);
 		(void) remove_reference(hdr, hash_lock, tag);
@@ -6985,7 +7055,7 @@ arc_release(arc_buf_t *buf, void *tag)
 		ASSERT3P(nhdr->b_l1hdr.b_buf, ==, NULL);
 		ASSERT0(nhdr->b_l1hdr.b_bufcnt);
 		ASSERT0(zfs_refcount_count(&nhdr->b_l1hdr.b_refcnt));
-		VERIFY3U(nhdr->b_type, ==, type);
+		VERIFY3U(arc_buf_type(nhdr), ==, type);
 		ASSERT(!HDR_SHARED_DATA(nhdr));
 
 		nhdr->b_l1hdr.b_buf = buf;
@@ -8193,14 +8263,36 @@ l2arc_write_eligible(uint64_t spa_guid, arc_buf_hdr_t *hdr)
 	 * 2. is already cached on the L2ARC.
 	 * 3. has an I/O in progress (it may be an incomplete read).
 	 * 4. is flagged not eligible (zfs property).
+	 * 5. is only eligible once reused (secondarycache=demand) and
+	 *    has not been promoted to the MFU yet.  This keeps blocks
+	 *    which were streamed or prefetched and read only once from
+	 *    using up L2ARC write bandwidth.
 	 */
 	if (hdr->b_spa != spa_guid || HDR_HAS_L2HDR(hdr) ||
 	    HDR_IO_IN_PROGRESS(hdr) || !HDR_L2CACHE(hdr))
 		return (B_FALSE);
 
+	if (HDR_L2CACHE_MFU(hdr) && hdr->b_l1hdr.b_state != arc_mfu)
+		return (B_FALSE);
+
 	return (B_TRUE);
 }
 
+/*
+ * Count a buffer which the feed thread found held back until it is reused.
+ * The feed scans the same buffers over and over, so each is counted once.
+ */
+static void
+l2arc_write_count_not_reused(uint64_t spa_guid, arc_buf_hdr_t *hdr)
+{
+	if (hdr->b_spa == spa_guid && HDR_L2CACHE_MFU(hdr) &&
+	    !HDR_HAS_L2HDR(hdr) && !HDR_L2_NOT_REUSED(hdr) &&
+	    hdr->b_l1hdr.b_state != arc_mfu) {
+		arc_hdr_set_flags(hdr, ARC_FLAG_L2_NOT_REUSED);
+		ARCSTAT_BUMP(arcstat_l2_write_not_reused);
+	}
+}
+
 static uint64_t
 l2arc_write_size(void)
 {
@@ -8453,6 +8545,19 @@ top:
 	kmem_free(cb, sizeof (l2arc_write_callback_t));
 }
 
+/*
+ * Fully encrypted blocks are authenticated by the MAC in their block pointer,
+ * which covers every byte of ciphertext their checksum does. An L2ARC hit on
+ * one is verified by decrypting it, rather than by checksumming the
+ * ciphertext first. Dnode blocks are only partly encrypted and still have
+ * their checksum verified.
+ */
+static boolean_t
+l2arc_mac_verifies(const blkptr_t *bp)
+{
+	return (BP_IS_ENCRYPTED(bp) && BP_GET_TYPE(bp) != DMU_OT_DNODE);
+}
+
 static int
 l2arc_untransform(zio_t *zio, l2arc_read_callback_t *cb)
 {
@@ -8478,34 +8583,58 @@ l2arc_untransform(zio_t *zio, l2arc_read_callback_t *cb)
 	 * we must check the bp here and not the hdr, since the
 	 * hdr does not have its encryption parameters updated
 	 * until arc_read_done().
+	 *
+	 * A block which was read into a temporary buffer (because its
+	 * allocated size is larger than the hdr's) is still there when it is
+	 * verified by its MAC, and is decrypted straight into b_pabd.
 	 */
 	if (BP_IS_ENCRYPTED(bp)) {
-		abd_t *eabd = arc_get_data_abd(hdr, arc_hdr_size(hdr), hdr);
+		abd_t *cabd = cb->l2rcb_abd;
+		abd_t *eabd = hdr->b_l1hdr.b_pabd;
+
+		if (cabd == NULL) {
+			cabd = hdr->b_l1hdr.b_pabd;
+			eabd = arc_get_data_abd(hdr, arc_hdr_size(hdr), hdr);
+		}
 
 		zio_crypt_decode_params_bp(bp, salt, iv);
 		zio_crypt_decode_mac_bp(bp, mac);
 
 		ret = spa_do_crypt_abd(B_FALSE, spa, &cb->l2rcb_zb,
 		    BP_GET_TYPE(bp), BP_GET_DEDUP(bp), BP_SHOULD_BYTESWAP(bp),
-		    salt, iv, mac, HDR_GET_PSIZE(hdr), eabd,
-		    hdr->b_l1hdr.b_pabd, &no_crypt);
+		    salt, iv, mac, HDR_GET_PSIZE(hdr), eabd, cabd, &no_crypt);
 		if (ret != 0) {
-			arc_free_data_abd(hdr, eabd, arc_hdr_size(hdr), hdr);
+			if (eabd != hdr->b_l1hdr.b_pabd) {
+				arc_free_data_abd(hdr, eabd,
+				    arc_hdr_size(hdr), hdr);
+			}
 			goto error;
 		}
 
 		/*
 		 * If we actually performed decryption, replace b_pabd
 		 * with the decrypted data. Otherwise we can just throw
-		 * our decryption buffer away.
+		 * our decryption buffer away, but nothing was checked
+		 * against a MAC so the checksum must still be verified.
 		 */
-		if (!no_crypt) {
+		if (no_crypt) {
+			if (eabd != hdr->b_l1hdr.b_pabd) {
+				arc_free_data_abd(hdr, eabd,
+				    arc_hdr_size(hdr), hdr);
+			} else {
+				abd_copy(hdr->b_l1hdr.b_pabd, cabd,
+				    HDR_GET_PSIZE(hdr));
+			}
+			if (l2arc_mac_verifies(bp) &&
+			    !arc_cksum_is_equal(hdr, zio)) {
+				ret = SET_ERROR(ECKSUM);
+				goto error;
+			}
+		} else if (eabd != hdr->b_l1hdr.b_pabd) {
 			arc_free_data_abd(hdr, hdr->b_l1hdr.b_pabd,
 			    arc_hdr_size(hdr), hdr);
 			hdr->b_l1hdr.b_pabd = eabd;
 			zio->io_abd = eabd;
-		} else {
-			arc_free_data_abd(hdr, eabd, arc_hdr_size(hdr), hdr);
 		}
 	}
 
@@ -8557,6 +8686,8 @@ l2arc_read_done(zio_t *zio)
 	boolean_t valid_cksum;
 	boolean_t using_rdata = (BP_IS_ENCRYPTED(&cb->l2rcb_bp) &&
 	    (cb->l2rcb_flags & ZIO_FLAG_RAW_ENCRYPT));
+	boolean_t mac_verify = (!using_rdata && zio->io_error == 0 &&
+	    l2arc_mac_verifies(&cb->l2rcb_bp));
 
 	ASSERT3P(zio->io_vd, !=, NULL);
 	ASSERT(zio->io_flags & ZIO_FLAG_DONT_PROPAGATE);
@@ -8581,7 +8712,7 @@ l2arc_read_done(zio_t *zio)
 			if (using_rdata) {
 				abd_copy(hdr->b_crypt_hdr.b_rabd,
 				    cb->l2rcb_abd, arc_hdr_size(hdr));
-			} else {
+			} else if (!mac_verify) {
 				abd_copy(hdr->b_l1hdr.b_pabd,
 				    cb->l2rcb_abd, arc_hdr_size(hdr));
 			}
@@ -8590,7 +8721,8 @@ l2arc_read_done(zio_t *zio)
 		/*
 		 * The following must be done regardless of whether
 		 * there was an error:
-		 * - free the temporary buffer
+		 * - free the temporary buffer, unless the block is
+		 *   decrypted from it by l2arc_untransform()
 		 * - point zio to the real ARC buffer
 		 * - set zio size accordingly
 		 * These are required because zio is either re-used for
@@ -8598,7 +8730,10 @@ l2arc_read_done(zio_t *zio)
 		 * or the zio is passed to arc_read_done() and it
 		 * needs real data.
 		 */
-		abd_free(cb->l2rcb_abd);
+		if (!mac_verify) {
+			abd_free(cb->l2rcb_abd);
+			cb->l2rcb_abd = NULL;
+		}
 		zio->io_size = zio->io_orig_size = arc_hdr_size(hdr);
 
 		if (using_rdata) {
@@ -8621,15 +8756,30 @@ l2arc_read_done(zio_t *zio)
 	zio->io_bp_copy = cb->l2rcb_bp;	/* XXX fix in L2ARC 2.0	*/
 	zio->io_bp = &zio->io_bp_copy;	/* XXX fix in L2ARC 2.0	*/
 
-	valid_cksum = arc_cksum_is_equal(hdr, zio);
+	/*
+	 * Blocks verified by their MAC are checked when they are decrypted
+	 * by l2arc_untransform(), a failure there is counted as a bad
+	 * checksum.
+	 */
+	if (mac_verify)
+		valid_cksum = B_TRUE;
+	else
+		valid_cksum = arc_cksum_is_equal(hdr, zio);
 
 	/*
 	 * b_rabd will always match the data as it exists on disk if it is
 	 * being used. Therefore if we are reading into b_rabd we do not
 	 * attempt to untransform the data.
 	 */
-	if (valid_cksum && !using_rdata)
+	if (valid_cksum && !using_rdata) {
 		tfm_error = l2arc_untransform(zio, cb);
+		if (mac_verify && tfm_error == 0)
+			ARCSTAT_BUMP(arcstat_l2_mac_verified);
+	}
+	if (cb->l2rcb_abd != NULL) {
+		abd_free(cb->l2rcb_abd);
+		cb->l2rcb_abd = NULL;
+	}
 
 	if (valid_cksum && tfm_error == 0 && zio->io_error == 0 &&
 	    !HDR_L2_EVICTED(hdr)) {
@@ -9035,6 +9185,7 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 			}
 
 			if (!l2arc_write_eligible(guid, hdr)) {
+				l2arc_write_count_not_reused(guid, hdr);
 				mutex_exit(hash_lock);
 				continue;
 			}
@@ -9131,7 +9282,6 @@ l2arc_write_buffers(spa_t *spa, l2arc_dev_t *dev, uint64_t target_sz)
 			}
 
 			hdr->b_l2hdr.b_dev = dev;
-			hdr->b_l2hdr.b_hits = 0;
 
 			hdr->b_l2hdr.b_daddr = dev->l2ad_hand;
 			arc_hdr_set_flags(hdr, ARC_FLAG_HAS_L2HDR);
@@ -501,6 +501,56 @@ bpobj_iterate_nofree(bpobj_t *bpo, bpobj_itor_t func, void *arg, dmu_tx_t *tx)
 	return (bpobj_iterate_impl(bpo, func, arg, tx, B_FALSE));
 }
 
+/*
+ * Iterate, in order and without removing them, the entries at indices
+ * [start, end) of a bpobj which has no subobjs, such as a livelist
+ * sublist.  If func returns nonzero, iteration will stop.
+ */
+int
+bpobj_iterate_range(bpobj_t *bpo, uint64_t start, uint64_t end,
+    bpobj_itor_t func, void *arg, dmu_tx_t *tx)
+{
+	dmu_buf_t *dbuf = NULL;
+	int err = 0;
+
+	ASSERT(!bpo->bpo_havesubobj || bpo->bpo_phys->bpo_num_subobjs == 0);
+	ASSERT3U(start, <=, end);
+
+	if (start < end) {
+		dmu_prefetch(bpo->bpo_os, bpo->bpo_object, 0,
+		    start * sizeof (blkptr_t), (end - start) * sizeof (blkptr_t),
+		    ZIO_PRIORITY_ASYNC_READ);
+	}
+
+	for (uint64_t i = start; i < end; i++) {
+		uint64_t offset = i * sizeof (blkptr_t);
+		uint64_t blkoff = P2PHASE(i, bpo->bpo_epb);
+
+		if (dbuf == NULL ||
+		    offset >= dbuf->db_offset + dbuf->db_size) {
+			if (dbuf != NULL)
+				dmu_buf_rele(dbuf, FTAG);
+			err = dmu_buf_hold(bpo->bpo_os, bpo->bpo_object, offset,
+			    FTAG, &dbuf, 0);
+			if (err != 0) {
+				dbuf = NULL;
+				break;
+			}
+		}
+
+		ASSERT3U(offset, >=, dbuf->db_offset);
+		ASSERT3U(offset, <, dbuf->db_offset + dbuf->db_size);
+
+		blkptr_t *bparray = dbuf->db_data;
+		err = func(arg, &bparray[blkoff], tx);
+		if (err != 0)
+			break;
+	}
+	if (dbuf != NULL)
+		dmu_buf_rele(dbuf, FTAG);
+	return (err);
+}
+
 /*
  * Logically add subobj's contents to the parent bpobj.
  *
@@ -724,7 +774,8 @@ bpobj_enqueue_subobj(bpobj_t *bpo, uint64_t subobj, dmu_tx_t *tx)
 }
 
 void
-bpobj_enqueue(bpobj_t *bpo, const blkptr_t *bp, dmu_tx_t *tx)
+bpobj_enqueue(bpobj_t *bpo, const blkptr_t *bp, boolean_t bp_freed,
+    dmu_tx_t *tx)
 {
 	blkptr_t stored_bp = *bp;
 	uint64_t offset;
@@ -755,8 +806,12 @@ bpobj_enqueue(bpobj_t *bpo, const blkptr_t *bp, dmu_tx_t *tx)
 		bzero(&stored_bp.blk_cksum, sizeof (stored_bp.blk_cksum));
 	}
 
-	/* We never need the fill count. */
+	/*
+	 * We never need the fill count; livelists keep the FREE flag in it
+	 * (see BP_SET_FREE()).
+	 */
 	stored_bp.blk_fill = 0;
+	BP_SET_FREE(&stored_bp, bp_freed);
 
 	mutex_enter(&bpo->bpo_lock);
 
@@ -1409,6 +1409,8 @@ dbuf_read_impl(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags,
 
 	if (DBUF_IS_L2CACHEABLE(db))
 		aflags |= ARC_FLAG_L2CACHE;
+	else if (DBUF_IS_L2CACHE_DEMAND(db))
+		aflags |= ARC_FLAG_L2CACHE | ARC_FLAG_L2CACHE_MFU;
 
 	dbuf_add_ref(db, NULL);
 
@@ -1508,6 +1510,88 @@ dbuf_fix_old_data(dmu_buf_impl_t *db, uint64_t txg)
 	}
 }
 
+/*
+ * Blocks written with dbuf_direct_write() or dmu_buf_write_embedded() are
+ * left in the DB_NOFILL state; their contents are only described by the
+ * block pointer in the dirty record.  Bring such a dbuf back into a state
+ * the regular read and write paths understand.  Once the dirty records
+ * have synced the on-disk copy is current and the dbuf can simply be read
+ * again.  Otherwise read the overriding block pointer back in, unless the
+ * caller is about to overwrite the whole block, in which case this cannot
+ * fail.
+ *
+ * As in dbuf_read_impl(), db_mtx is not held across the allocation and
+ * the read.  If the newest dirty record no longer points at the block we
+ * read once we get it back, the buffer is discarded and we start over.
+ */
+static int
+dbuf_read_nofill(dmu_buf_impl_t *db, boolean_t overwrite)
+{
+	dbuf_dirty_record_t *dr;
+	spa_t *spa = db->db_objset->os_spa;
+	arc_buf_t *buf;
+	blkptr_t bp;
+	int err = 0;
+
+	ASSERT0(db->db_level);
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+
+	mutex_enter(&db->db_mtx);
+	while (db->db_state == DB_NOFILL) {
+		dr = db->db_last_dirty;
+		if (dr == NULL) {
+			ASSERT3P(db->db_buf, ==, NULL);
+			db->db_state = DB_UNCACHED;
+			break;
+		}
+
+		bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+
+		buf = arc_alloc_buf(spa, db, DBUF_GET_BUFC_TYPE(db),
+		    db->db.db_size);
+		if (overwrite) {
+			/* contents are about to be replaced */
+		} else if (BP_IS_HOLE(&bp)) {
+			bzero(buf->b_data, db->db.db_size);
+		} else {
+			zbookmark_phys_t zb;
+			abd_t *abd;
+
+			SET_BOOKMARK(&zb, dmu_objset_id(db->db_objset),
+			    db->db.db_object, db->db_level, db->db_blkid);
+			abd = abd_get_from_buf(buf->b_data, db->db.db_size);
+			err = zio_wait(zio_read(NULL, spa, &bp, abd,
+			    db->db.db_size, NULL, NULL, ZIO_PRIORITY_SYNC_READ,
+			    ZIO_FLAG_CANFAIL, &zb));
+			abd_put(abd);
+		}
+
+		mutex_enter(&db->db_mtx);
+		if (err != 0) {
+			arc_buf_destroy(buf, db);
+			break;
+		}
+		if (db->db_state == DB_NOFILL && db->db_last_dirty == dr &&
+		    BP_EQUAL(&bp, &dr->dt.dl.dr_overridden_by)) {
+			/*
+			 * Only the newest dirty record gets the data; older
+			 * ones are still overridden and do not need it to
+			 * sync.
+			 */
+			dbuf_set_data(db, buf);
+			dr->dt.dl.dr_data = buf;
+			db->db_state = DB_CACHED;
+			cv_broadcast(&db->db_changed);
+			break;
+		}
+		arc_buf_destroy(buf, db);
+	}
+	mutex_exit(&db->db_mtx);
+
+	return (err);
+}
+
 int
 dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 {
@@ -1521,8 +1605,11 @@ dbuf_read(dmu_buf_impl_t *db, zio_t *zio, uint32_t flags)
 	 */
 	ASSERT(!zfs_refcount_is_zero(&db->db_holds));
 
-	if (db->db_state == DB_NOFILL)
-		return (SET_ERROR(EIO));
+	if (db->db_state == DB_NOFILL) {
+		err = dbuf_read_nofill(db, B_FALSE);
+		if (err != 0)
+			return (err);
+	}
 
 	DB_DNODE_ENTER(db);
 	dn = DB_DNODE(db);
@@ -1693,6 +1780,7 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	dr->dt.dl.dr_override_state = DR_NOT_OVERRIDDEN;
 	dr->dt.dl.dr_nopwrite = B_FALSE;
 	dr->dt.dl.dr_has_raw_params = B_FALSE;
+	dr->dt.dl.dr_direct = B_FALSE;
 
 	/*
 	 * Release the already-written buffer, so we leave it in
@@ -1700,9 +1788,10 @@ dbuf_unoverride(dbuf_dirty_record_t *dr)
 	 * modifying the buffer, so they will immediately do
 	 * another (redundant) arc_release().  Therefore, leave
 	 * the buf thawed to save the effort of freezing &
-	 * immediately re-thawing it.
+	 * immediately re-thawing it.  DB_NOFILL buffers have no data.
 	 */
-	arc_release(dr->dt.dl.dr_data, db);
+	if (dr->dt.dl.dr_data != NULL)
+		arc_release(dr->dt.dl.dr_data, db);
 }
 
 /*
@@ -2271,9 +2360,13 @@ dbuf_undirty(dmu_buf_impl_t *db, dmu_tx_t *tx)
 	}
 	DB_DNODE_EXIT(db);
 
-	if (db->db_state != DB_NOFILL) {
-		dbuf_unoverride(dr);
+	/*
+	 * An overridden NOFILL record owns a block that was already
+	 * written from open context; dbuf_unoverride() frees it.
+	 */
+	dbuf_unoverride(dr);
 
+	if (db->db_state != DB_NOFILL) {
 		ASSERT(db->db_buf != NULL);
 		ASSERT(dr->dt.dl.dr_data != NULL);
 		if (dr->dt.dl.dr_data != db->db_buf)
@@ -2359,21 +2452,9 @@ dmu_buf_is_dirty(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	return (B_FALSE);
 }
 
-void
-dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
-{
-	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
-
-	db->db_state = DB_NOFILL;
-
-	dmu_buf_will_fill(db_fake, tx);
-}
-
-void
-dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+static void
+dmu_buf_will_fill_impl(dmu_buf_impl_t *db, dmu_tx_t *tx)
 {
-	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
-
 	if (db == NULL) {
 		cmn_err(CE_WARN, "dmu_buf_will_fill() NULL dbuf! db=%p", db);
 	} else if (db->db_buf == NULL) {
@@ -2392,6 +2473,32 @@ dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
 	(void) dbuf_dirty(db, tx);
 }
 
+void
+dmu_buf_will_not_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+
+	db->db_state = DB_NOFILL;
+
+	dmu_buf_will_fill_impl(db, tx);
+}
+
+void
+dmu_buf_will_fill(dmu_buf_t *db_fake, dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)db_fake;
+
+	/*
+	 * A block previously written with dbuf_direct_write() has no
+	 * buffer to fill; give it one before it is dirtied again.  Nothing
+	 * is read when the block is being overwritten, so this can't fail.
+	 */
+	if (db->db_state == DB_NOFILL)
+		VERIFY0(dbuf_read_nofill(db, B_TRUE));
+
+	dmu_buf_will_fill_impl(db, tx);
+}
+
 /*
  * This function is effectively the same as dmu_buf_will_dirty(), but
  * indicates the caller expects raw encrypted data in the db, and provides
@@ -2490,6 +2597,169 @@ dmu_buf_write_embedded(dmu_buf_t *dbuf, void *data,
 	dl->dr_overridden_by.blk_birth = db->db_last_dirty->dr_txg;
 }
 
+/*
+ * Read the current contents of a level-0 dbuf straight from disk into
+ * abd, without going through the ARC.  The read is issued as a child of
+ * pio; the caller must wait on pio before using the data.  B_FALSE is
+ * returned, and nothing is read, when the dbuf is already cached or dirty
+ * in memory, in which case the caller should use dbuf_read() so that it
+ * sees the in-memory copy.
+ *
+ * As with dmu_sync(), the caller must hold a range lock that keeps the
+ * block from being modified while the read is in flight.
+ */
+boolean_t
+dbuf_read_direct(dmu_buf_impl_t *db, zio_t *pio, abd_t *abd)
+{
+	spa_t *spa = db->db_objset->os_spa;
+	zbookmark_phys_t zb;
+	blkptr_t bp;
+
+	ASSERT0(db->db_level);
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT3U(abd->abd_size, ==, db->db.db_size);
+
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_NOFILL && db->db_last_dirty != NULL) {
+		bp = db->db_last_dirty->dt.dl.dr_overridden_by;
+	} else if ((db->db_state == DB_UNCACHED ||
+	    db->db_state == DB_NOFILL) && db->db_last_dirty == NULL) {
+		if (db->db_blkptr != NULL)
+			bp = *db->db_blkptr;
+		else
+			BP_ZERO(&bp);
+	} else {
+		mutex_exit(&db->db_mtx);
+		return (B_FALSE);
+	}
+	mutex_exit(&db->db_mtx);
+
+	if (BP_IS_HOLE(&bp)) {
+		abd_zero(abd, db->db.db_size);
+		return (B_TRUE);
+	}
+
+	SET_BOOKMARK(&zb, dmu_objset_id(db->db_objset),
+	    db->db.db_object, db->db_level, db->db_blkid);
+	zio_nowait(zio_read(pio, spa, &bp, abd, db->db.db_size, NULL, NULL,
+	    ZIO_PRIORITY_SYNC_READ, ZIO_FLAG_CANFAIL, &zb));
+
+	return (B_TRUE);
+}
+
+static void
+dbuf_direct_write_ready(zio_t *zio)
+{
+	dmu_buf_impl_t *db = zio->io_private;
+	blkptr_t *bp = zio->io_bp;
+
+	if (zio->io_error == 0) {
+		if (BP_IS_HOLE(bp)) {
+			/*
+			 * A block of zeros may compress to a hole, but the
+			 * block size still needs to be known for replay.
+			 */
+			BP_SET_LSIZE(bp, db->db.db_size);
+		} else if (!BP_IS_EMBEDDED(bp)) {
+			ASSERT(BP_GET_LEVEL(bp) == 0);
+			BP_SET_FILL(bp, 1);
+		}
+	}
+}
+
+/*
+ * Write a full level-0 block from open context, bypassing the ARC, and
+ * dirty the dbuf with the resulting block pointer as its override.  The
+ * data goes through the regular write pipeline, so checksums,
+ * compression and encryption are applied as usual, but it is never
+ * cached: the dbuf is left in DB_NOFILL and the block pointer is simply
+ * installed by dbuf_write() when the txg syncs.
+ *
+ * EAGAIN is returned without dirtying anything if the dbuf is cached in
+ * memory, since the in-memory copy would then have to be updated too; the
+ * caller should fall back to a buffered write.  As with dmu_sync(), the
+ * caller must hold a range lock covering the block.
+ */
+int
+dbuf_direct_write(dmu_buf_impl_t *db, abd_t *data, dmu_tx_t *tx)
+{
+	objset_t *os = db->db_objset;
+	spa_t *spa = os->os_spa;
+	uint64_t txg = dmu_tx_get_txg(tx);
+	dbuf_dirty_record_t *dr;
+	zbookmark_phys_t zb;
+	zio_prop_t zp;
+	blkptr_t bp;
+	int err;
+
+	ASSERT0(db->db_level);
+	ASSERT(db->db_blkid != DMU_BONUS_BLKID);
+	ASSERT(db->db_blkid != DMU_SPILL_BLKID);
+	ASSERT(!dmu_tx_is_syncing(tx));
+
+	mutex_enter(&db->db_mtx);
+	if (db->db_state != DB_UNCACHED && db->db_state != DB_NOFILL) {
+		mutex_exit(&db->db_mtx);
+		return (SET_ERROR(EAGAIN));
+	}
+	mutex_exit(&db->db_mtx);
+
+	DB_DNODE_ENTER(db);
+	dmu_write_policy(os, DB_DNODE(db), 0, WP_DMU_SYNC, &zp);
+	DB_DNODE_EXIT(db);
+
+	/*
+	 * The block pointer we would nopwrite against may change before
+	 * this txg syncs, so don't bother (see dmu_sync_late_arrival()).
+	 */
+	zp.zp_nopwrite = B_FALSE;
+
+	SET_BOOKMARK(&zb, dmu_objset_id(os), db->db.db_object,
+	    db->db_level, db->db_blkid);
+	BP_ZERO(&bp);
+	err = zio_wait(zio_write(NULL, spa, txg, &bp, data,
+	    db->db.db_size, db->db.db_size, &zp, dbuf_direct_write_ready,
+	    NULL, NULL, NULL, db, ZIO_PRIORITY_SYNC_WRITE,
+	    ZIO_FLAG_CANFAIL, &zb));
+	if (err != 0)
+		return (err);
+
+	/*
+	 * Old style holes are filled with all zeros, whereas new-style
+	 * holes maintain their lsize, type, level, and birth time (see
+	 * dmu_sync_done()).
+	 */
+	if (BP_IS_HOLE(&bp) && bp.blk_birth == 0)
+		BP_ZERO(&bp);
+
+	mutex_enter(&db->db_mtx);
+	if (db->db_state != DB_UNCACHED && db->db_state != DB_NOFILL) {
+		/* Lost a race with a reader; discard what we wrote. */
+		mutex_exit(&db->db_mtx);
+		if (!BP_IS_HOLE(&bp))
+			zio_free(spa, txg, &bp);
+		return (SET_ERROR(EAGAIN));
+	}
+	db->db_state = DB_NOFILL;
+	mutex_exit(&db->db_mtx);
+
+	dbuf_noread(db);
+	(void) dbuf_dirty(db, tx);
+
+	mutex_enter(&db->db_mtx);
+	dr = db->db_last_dirty;
+	ASSERT3U(dr->dr_txg, ==, txg);
+	ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
+	dr->dt.dl.dr_overridden_by = bp;
+	dr->dt.dl.dr_override_state = DR_OVERRIDDEN;
+	dr->dt.dl.dr_copies = zp.zp_copies;
+	dr->dt.dl.dr_nopwrite = B_FALSE;
+	dr->dt.dl.dr_direct = B_TRUE;
+	mutex_exit(&db->db_mtx);
+
+	return (0);
+}
+
 /*
  * Directly assign a provided arc buf to a given dbuf if it's not referenced
  * by anybody except our caller. Otherwise copy arcbuf's contents to dbuf.
@@ -2857,6 +3127,36 @@ dbuf_create(dnode_t *dn, uint8_t level, uint64_t blkid,
 	return (db);
 }
 
+/*
+ * Look up the block pointer for the given level/blkid of a dnode without
+ * instantiating a dbuf for the block itself.  The caller must hold
+ * dn_struct_rwlock.  The optional datablkszsec and indblkshift are filled
+ * in from the dnode so callers can size a read of the block.
+ */
+int
+dbuf_dnode_findbp(dnode_t *dn, uint64_t level, uint64_t blkid,
+    blkptr_t *bp, uint16_t *datablkszsec, uint8_t *indblkshift)
+{
+	dmu_buf_impl_t *dbp = NULL;
+	blkptr_t *bp2;
+	int err;
+
+	ASSERT(RW_LOCK_HELD(&dn->dn_struct_rwlock));
+
+	err = dbuf_findbp(dn, level, blkid, B_FALSE, &dbp, &bp2);
+	if (err == 0) {
+		*bp = *bp2;
+		if (dbp != NULL)
+			dbuf_rele(dbp, NULL);
+		if (datablkszsec != NULL)
+			*datablkszsec = dn->dn_phys->dn_datablkszsec;
+		if (indblkshift != NULL)
+			*indblkshift = dn->dn_phys->dn_indblkshift;
+	}
+
+	return (err);
+}
+
 typedef struct dbuf_prefetch_arg {
 	spa_t *dpa_spa;	/* The spa to issue the prefetch in. */
 	zbookmark_phys_t dpa_zb; /* The target block to prefetch. */
@@ -4250,7 +4550,11 @@ cleanup:
 	if (db->db_level == 0) {
 		ASSERT(db->db_blkid != DMU_BONUS_BLKID);
 		ASSERT(dr->dt.dl.dr_override_state == DR_NOT_OVERRIDDEN);
-		if (db->db_state != DB_NOFILL) {
+		/*
+		 * A record written by dbuf_direct_write() has no data of its
+		 * own even if the dbuf has since been read back in.
+		 */
+		if (db->db_state != DB_NOFILL && dr->dt.dl.dr_data != NULL) {
 			if (dr->dt.dl.dr_data != db->db_buf)
 				arc_buf_destroy(dr->dt.dl.dr_data, db);
 		}
@@ -4337,7 +4641,8 @@ dbuf_write_override_done(zio_t *zio)
 	if (!BP_EQUAL(zio->io_bp, obp)) {
 		if (!BP_IS_HOLE(obp))
 			dsl_free(spa_get_dsl(zio->io_spa), zio->io_txg, obp);
-		arc_release(dr->dt.dl.dr_data, db);
+		if (dr->dt.dl.dr_data != NULL)
+			arc_release(dr->dt.dl.dr_data, db);
 	}
 	mutex_exit(&db->db_mtx);
 
@@ -54,6 +54,9 @@
 #ifdef _KERNEL
 #include <sys/vmsystm.h>
 #include <sys/zfs_znode.h>
+#include <linux/sort.h>
+#define	qsort(base, num, size, cmp) \
+    sort(base, num, size, cmp, NULL)
 #endif
 
 /*
@@ -70,7 +73,9 @@ int zfs_nopwrite_enabled = 1;
 unsigned long zfs_per_txg_dirty_frees_percent = 5;
 
 /*
- * Enable/disable forcing txg sync when dirty in dmu_offset_next.
+ * Enable/disable forcing txg sync when dirty in dmu_offset_next.  This is
+ * no longer required for correct results since dirty state is taken into
+ * account, but is retained to allow the old behavior to be restored.
  */
 int zfs_dmu_offset_next_sync = 0;
 
@@ -644,6 +649,67 @@ dmu_buf_rele_array(dmu_buf_t **dbp_fake, int numbufs, void *tag)
 	kmem_free(dbp, sizeof (dmu_buf_t *) * numbufs);
 }
 
+static int
+dmu_prefetch_dnodes_compare(const void *x1, const void *x2)
+{
+	const uint64_t *obj1 = x1;
+	const uint64_t *obj2 = x2;
+
+	return (TREE_CMP(*obj1, *obj2));
+}
+
+/*
+ * Issue prefetch i/os for the dnode blocks holding the given objects, for
+ * callers such as readdir which are about to look at many dnodes at once.
+ * The objects array is sorted in place so that only one prefetch is issued
+ * per dnode block, regardless of how many of the objects it holds.
+ *
+ * Returns the number of distinct dnode blocks which were already cached and
+ * needed no i/o.  If nblksp is not NULL it is set to the number of distinct
+ * dnode blocks which were considered.
+ */
+int
+dmu_prefetch_dnodes(objset_t *os, uint64_t *objs, int count,
+    zio_priority_t pri, int *nblksp)
+{
+	dnode_t *dn = DMU_META_DNODE(os);
+	uint64_t lastblk = UINT64_MAX;
+	int nblks = 0, cached = 0;
+
+	qsort(objs, count, sizeof (uint64_t), dmu_prefetch_dnodes_compare);
+
+	rw_enter(&dn->dn_struct_rwlock, RW_READER);
+	for (int i = 0; i < count; i++) {
+		dmu_buf_impl_t *db;
+		uint64_t blkid;
+
+		if (objs[i] == 0 || objs[i] >= DN_MAX_OBJECT)
+			continue;
+
+		blkid = dbuf_whichblock(dn, 0, objs[i] * sizeof (dnode_phys_t));
+		if (blkid == lastblk)
+			continue;
+
+		lastblk = blkid;
+		nblks++;
+
+		db = dbuf_find(os, DMU_META_DNODE_OBJECT, 0, blkid);
+		if (db != NULL) {
+			mutex_exit(&db->db_mtx);
+			cached++;
+			continue;
+		}
+
+		dbuf_prefetch(dn, 0, blkid, pri, 0);
+	}
+	rw_exit(&dn->dn_struct_rwlock);
+
+	if (nblksp != NULL)
+		*nblksp = nblks;
+
+	return (cached);
+}
+
 /*
  * Issue prefetch i/os for the given blocks.  If level is greater than 0, the
  * indirect blocks prefetched will be those that point to the blocks containing
@@ -944,6 +1010,173 @@ dmu_free_long_range_impl(objset_t *os, dnode_t *dn, uint64_t offset,
 	return (0);
 }
 
+/*
+ * Freeing a very large object one chunk at a time is bounded by the time
+ * needed to locate each chunk's L1 indirect blocks, which are read
+ * synchronously by get_next_chunk().  When the whole of a large object is
+ * being freed, the range is instead divided into stripes aligned to the
+ * span of an L1 indirect block and handed out to several threads on the
+ * dmu_free_long taskq.  Each stripe is freed with
+ * dmu_free_long_range_impl(), so the per-txg dirty frees throttle and the
+ * unmount check still apply.  Progress is reported by the dmu_free_long
+ * kstat.
+ */
+typedef struct dmu_free_long_stats {
+	kstat_named_t dfls_objects;
+	kstat_named_t dfls_objects_active;
+	kstat_named_t dfls_stripes;
+	kstat_named_t dfls_bytes_pending;
+	kstat_named_t dfls_bytes_freed;
+} dmu_free_long_stats_t;
+
+static dmu_free_long_stats_t dmu_free_long_stats = {
+	{ "objects",		KSTAT_DATA_UINT64 },
+	{ "objects_active",	KSTAT_DATA_UINT64 },
+	{ "stripes",		KSTAT_DATA_UINT64 },
+	{ "bytes_pending",	KSTAT_DATA_UINT64 },
+	{ "bytes_freed",	KSTAT_DATA_UINT64 },
+};
+
+#define	DFLS_INCR(stat, val) \
+	atomic_add_64(&dmu_free_long_stats.stat.value.ui64, (val))
+#define	DFLS_BUMP(stat)		DFLS_INCR(stat, 1)
+
+static kstat_t *dmu_free_long_ksp;
+static taskq_t *dmu_free_long_taskq;
+
+/*
+ * Objects at least this large are freed by multiple threads when they are
+ * removed entirely.  A value of zero disables parallel freeing.
+ */
+unsigned long zfs_free_long_parallel_min = 1ULL << 30;
+
+/*
+ * Maximum number of threads which free a single object.
+ */
+int zfs_free_long_parallel_threads = 8;
+
+typedef struct dmu_free_long_parallel {
+	objset_t	*dflp_os;
+	dnode_t		*dflp_dn;
+	uint64_t	dflp_stripe;	/* bytes per stripe */
+	uint64_t	dflp_next;	/* end of the next stripe to free */
+	int		dflp_workers;	/* workers still running */
+	int		dflp_error;	/* first error encountered */
+	kmutex_t	dflp_lock;
+	kcondvar_t	dflp_cv;
+} dmu_free_long_parallel_t;
+
+static void
+dmu_free_long_parallel_task(void *arg)
+{
+	dmu_free_long_parallel_t *dflp = arg;
+	uint64_t begin, end;
+	int err;
+
+	mutex_enter(&dflp->dflp_lock);
+	while (dflp->dflp_next != 0 && dflp->dflp_error == 0) {
+		/*
+		 * Stripes are handed out from the end of the object
+		 * towards the start, as dmu_free_long_range_impl() does
+		 * with its chunks.
+		 */
+		end = dflp->dflp_next;
+		begin = ((end - 1) / dflp->dflp_stripe) * dflp->dflp_stripe;
+		dflp->dflp_next = begin;
+		mutex_exit(&dflp->dflp_lock);
+
+		err = dmu_free_long_range_impl(dflp->dflp_os, dflp->dflp_dn,
+		    begin, end - begin);
+		DFLS_BUMP(dfls_stripes);
+		DFLS_INCR(dfls_bytes_pending, -(int64_t)(end - begin));
+		if (err == 0)
+			DFLS_INCR(dfls_bytes_freed, end - begin);
+
+		mutex_enter(&dflp->dflp_lock);
+		if (err != 0 && dflp->dflp_error == 0)
+			dflp->dflp_error = err;
+	}
+	if (--dflp->dflp_workers == 0)
+		cv_broadcast(&dflp->dflp_cv);
+	mutex_exit(&dflp->dflp_lock);
+}
+
+/*
+ * Free the entire contents of an object using up to
+ * zfs_free_long_parallel_threads threads, including the caller's.
+ * Returns -1 if the object is too small to benefit, in which case the
+ * caller should free it serially.
+ */
+static int
+dmu_free_long_range_parallel(objset_t *os, dnode_t *dn)
+{
+	dmu_free_long_parallel_t dflp;
+	uint64_t object_size, iblkrange, nstripes;
+	int threads = zfs_free_long_parallel_threads;
+	int err;
+
+	object_size = (dn->dn_maxblkid + 1) * dn->dn_datablksz;
+	if (zfs_free_long_parallel_min == 0 || threads < 2 ||
+	    object_size < zfs_free_long_parallel_min ||
+	    dmu_free_long_taskq == NULL)
+		return (-1);
+
+	/*
+	 * Aim for a few stripes per thread so that sparse regions of the
+	 * object do not leave some threads idle while others are busy.
+	 * The stripe is a multiple of the range covered by one indirect
+	 * block, but not necessarily a power of two.
+	 */
+	iblkrange = (uint64_t)dn->dn_datablksz *
+	    EPB(dn->dn_indblkshift, SPA_BLKPTRSHIFT);
+	dflp.dflp_stripe = howmany(howmany(object_size, threads * 4),
+	    iblkrange) * iblkrange;
+	nstripes = howmany(object_size, dflp.dflp_stripe);
+	if (nstripes < 2)
+		return (-1);
+	threads = MIN(threads, nstripes);
+
+	dflp.dflp_os = os;
+	dflp.dflp_dn = dn;
+	dflp.dflp_next = object_size;
+	dflp.dflp_workers = threads;
+	dflp.dflp_error = 0;
+	mutex_init(&dflp.dflp_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&dflp.dflp_cv, NULL, CV_DEFAULT, NULL);
+
+	DFLS_BUMP(dfls_objects);
+	DFLS_BUMP(dfls_objects_active);
+	DFLS_INCR(dfls_bytes_pending, object_size);
+
+	for (int i = 1; i < threads; i++) {
+		if (taskq_dispatch(dmu_free_long_taskq,
+		    dmu_free_long_parallel_task, &dflp, TQ_SLEEP) ==
+		    TASKQID_INVALID) {
+			mutex_enter(&dflp.dflp_lock);
+			dflp.dflp_workers--;
+			mutex_exit(&dflp.dflp_lock);
+		}
+	}
+
+	/* The caller always takes part, so progress is guaranteed. */
+	dmu_free_long_parallel_task(&dflp);
+
+	mutex_enter(&dflp.dflp_lock);
+	while (dflp.dflp_workers != 0)
+		cv_wait(&dflp.dflp_cv, &dflp.dflp_lock);
+	err = dflp.dflp_error;
+	mutex_exit(&dflp.dflp_lock);
+
+	/* Stripes left unclaimed after an error are no longer pending. */
+	DFLS_INCR(dfls_bytes_pending, -(int64_t)dflp.dflp_next);
+	DFLS_INCR(dfls_objects_active, -1);
+
+	cv_destroy(&dflp.dflp_cv);
+	mutex_destroy(&dflp.dflp_lock);
+
+	return (err);
+}
+
 int
 dmu_free_long_range(objset_t *os, uint64_t object,
     uint64_t offset, uint64_t length)
@@ -954,7 +1187,11 @@ dmu_free_long_range(objset_t *os, uint64_t object,
 	err = dnode_hold(os, object, FTAG, &dn);
 	if (err != 0)
 		return (err);
-	err = dmu_free_long_range_impl(os, dn, offset, length);
+	err = -1;
+	if (offset == 0 && length == DMU_OBJECT_END)
+		err = dmu_free_long_range_parallel(os, dn);
+	if (err == -1)
+		err = dmu_free_long_range_impl(os, dn, offset, length);
 
 	/*
 	 * It is important to zero out the maxblkid when freeing the entire
@@ -1589,6 +1826,77 @@ dmu_read_uio_dbuf(dmu_buf_t *zdb, uio_t *uio, uint64_t size)
 	return (err);
 }
 
+/*
+ * Hand 'size' bytes of the object starting at 'offset' to the caller
+ * without copying them where possible.  For each block whose data the ARC
+ * holds uncompressed in page-backed memory, pagefunc is called for the
+ * pages themselves; see arc_buf_iterate_pages().  The remaining blocks,
+ * including dirty ones, are passed to copyfunc as a pointer to the dbuf's
+ * data, which is only valid for the duration of the call.
+ *
+ * A non-zero return from either function stops the read and is returned.
+ */
+static int
+dmu_read_pages_dnode(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_iter_page_func_t *pagefunc, abd_iter_func_t *copyfunc, void *private)
+{
+	dmu_buf_t **dbp;
+	int numbufs, i, err;
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size,
+	    TRUE, FTAG, &numbufs, &dbp, 0);
+	if (err)
+		return (err);
+
+	for (i = 0; i < numbufs; i++) {
+		dmu_buf_impl_t *db = (dmu_buf_impl_t *)dbp[i];
+		uint64_t bufoff, tocpy;
+
+		ASSERT(size > 0);
+
+		bufoff = offset - db->db.db_offset;
+		tocpy = MIN(db->db.db_size - bufoff, size);
+
+		err = SET_ERROR(ENOTSUP);
+		if (db->db_buf != NULL) {
+			err = arc_buf_iterate_pages(db->db_buf, bufoff, tocpy,
+			    pagefunc, private);
+		}
+		if (err == ENOTSUP) {
+			err = copyfunc((char *)db->db.db_data + bufoff, tocpy,
+			    private);
+		}
+		if (err)
+			break;
+
+		offset += tocpy;
+		size -= tocpy;
+	}
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+int
+dmu_read_pages_dbuf(dmu_buf_t *zdb, uint64_t offset, uint64_t size,
+    abd_iter_page_func_t *pagefunc, abd_iter_func_t *copyfunc, void *private)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	dnode_t *dn;
+	int err;
+
+	if (size == 0)
+		return (0);
+
+	DB_DNODE_ENTER(db);
+	dn = DB_DNODE(db);
+	err = dmu_read_pages_dnode(dn, offset, size, pagefunc, copyfunc,
+	    private);
+	DB_DNODE_EXIT(db);
+
+	return (err);
+}
+
 /*
  * Read 'size' bytes into the uio buffer.
  * From the specified object
@@ -1925,6 +2233,227 @@ dmu_assign_arcbuf_by_dbuf(dmu_buf_t *handle, uint64_t offset, arc_buf_t *buf,
 	return (err);
 }
 
+/*
+ * Direct I/O support.  These routines move whole blocks between the
+ * caller's buffer and disk without caching them in the ARC, for consumers
+ * which do their own caching.  Blocks which are already cached or dirty
+ * in memory are accessed through their dbuf instead, so that direct and
+ * buffered access to the same object stay coherent.  The caller must hold
+ * a range lock covering the I/O, as for dmu_sync().
+ *
+ * Reads of whole blocks land directly in the caller's abd; only a block
+ * partially covered by the request is staged in a buffer of its own.
+ */
+static int
+dmu_read_direct_impl(dnode_t *dn, uint64_t offset, uint64_t size,
+    abd_t *abd)
+{
+	dmu_buf_t **dbp;
+	abd_t **abds;
+	zio_t *rio;
+	uint64_t pos;
+	int numbufs, i, err;
+
+	err = dmu_buf_hold_array_by_dnode(dn, offset, size, FALSE, FTAG,
+	    &numbufs, &dbp, DMU_READ_NO_PREFETCH);
+	if (err)
+		return (err);
+
+	/*
+	 * Issue all of the uncached reads in parallel.
+	 */
+	abds = kmem_zalloc(numbufs * sizeof (abd_t *), KM_SLEEP);
+	rio = zio_root(dn->dn_objset->os_spa, NULL, NULL, ZIO_FLAG_CANFAIL);
+	for (i = 0, pos = 0; i < numbufs; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t bufoff = offset + pos - db->db_offset;
+		uint64_t len = MIN(db->db_size - bufoff, size - pos);
+		boolean_t whole = (bufoff == 0 && len == db->db_size);
+		abd_t *dabd;
+
+		if (whole)
+			dabd = abd_get_offset_size(abd, pos, len);
+		else
+			dabd = abd_alloc_linear(db->db_size, B_FALSE);
+
+		if (dbuf_read_direct((dmu_buf_impl_t *)db, rio, dabd))
+			abds[i] = dabd;
+		else if (whole)
+			abd_put(dabd);
+		else
+			abd_free(dabd);
+
+		pos += len;
+	}
+	err = zio_wait(rio);
+
+	/*
+	 * Fill in the blocks which were cached, and the partial ones.
+	 */
+	for (i = 0, pos = 0; i < numbufs; i++) {
+		dmu_buf_t *db = dbp[i];
+		uint64_t bufoff = offset + pos - db->db_offset;
+		uint64_t len = MIN(db->db_size - bufoff, size - pos);
+		boolean_t whole = (bufoff == 0 && len == db->db_size);
+
+		if (err == 0 && abds[i] == NULL) {
+			err = dbuf_read((dmu_buf_impl_t *)db, NULL,
+			    DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+			if (err == 0) {
+				abd_copy_from_buf_off(abd,
+				    (char *)db->db_data + bufoff, pos, len);
+			}
+		} else if (err == 0 && !whole) {
+			abd_copy_off(abd, abds[i], pos, bufoff, len);
+		}
+
+		if (abds[i] != NULL && whole)
+			abd_put(abds[i]);
+		else if (abds[i] != NULL)
+			abd_free(abds[i]);
+
+		pos += len;
+	}
+
+	kmem_free(abds, numbufs * sizeof (abd_t *));
+	dmu_buf_rele_array(dbp, numbufs, FTAG);
+
+	return (err);
+}
+
+int
+dmu_read_direct(objset_t *os, uint64_t object, uint64_t offset,
+    uint64_t size, void *buf)
+{
+	dnode_t *dn;
+	int err;
+
+	err = dnode_hold(os, object, FTAG, &dn);
+	if (err)
+		return (err);
+
+	while (size > 0 && err == 0) {
+		uint64_t len = MIN(size, SPA_MAXBLOCKSIZE);
+		abd_t *abd = abd_get_from_buf(buf, len);
+
+		err = dmu_read_direct_impl(dn, offset, len, abd);
+		abd_put(abd);
+
+		buf = (char *)buf + len;
+		offset += len;
+		size -= len;
+	}
+
+	dnode_rele(dn, FTAG);
+
+	return (err);
+}
+
+#ifdef _KERNEL
+/*
+ * Read 'size' bytes into the uio buffer, bypassing the ARC.
+ * From object zdb->db_object.
+ * Starting at offset uio->uio_loffset.
+ *
+ * When the user buffer is page aligned its pages are pinned and read into
+ * directly.  Otherwise the data is read into a kernel buffer and copied.
+ */
+int
+dmu_read_uio_direct(dmu_buf_t *zdb, uio_t *uio, uint64_t size)
+{
+	dmu_buf_impl_t *db = (dmu_buf_impl_t *)zdb;
+	size_t pages_size = (size >> PAGE_SHIFT) * sizeof (struct page *);
+	struct page **pages = NULL;
+	uint_t npages;
+	abd_t *abd;
+	int err;
+
+	if (size == 0)
+		return (0);
+
+	ASSERT3U(size, <=, SPA_MAXBLOCKSIZE);
+
+	if (pages_size > 0)
+		pages = vmem_alloc(pages_size, KM_SLEEP);
+
+	DB_DNODE_ENTER(db);
+	if (pages != NULL &&
+	    uio_get_user_pages(uio, size, UIO_READ, pages, &npages) == 0) {
+		abd = abd_get_from_pages(pages, npages, size);
+		err = dmu_read_direct_impl(DB_DNODE(db), uio->uio_loffset,
+		    size, abd);
+		abd_put(abd);
+		uio_put_user_pages(pages, npages, UIO_READ);
+		if (err == 0)
+			uioskip(uio, size);
+	} else {
+		abd = abd_alloc_linear(size, B_FALSE);
+		err = dmu_read_direct_impl(DB_DNODE(db), uio->uio_loffset,
+		    size, abd);
+		if (err == 0)
+			err = uiomove(abd_to_buf(abd), size, UIO_READ, uio);
+		abd_free(abd);
+	}
+	DB_DNODE_EXIT(db);
+
+	if (pages != NULL)
+		vmem_free(pages, pages_size);
+
+	return (err);
+}
+#endif
+
+/*
+ * Write one full, block-aligned buffer at 'offset', bypassing the ARC.
+ * If the block is cached in memory the data is copied into its dbuf
+ * instead, exactly as dmu_write() would.
+ */
+int
+dmu_write_direct_by_dnode(dnode_t *dn, uint64_t offset, abd_t *data,
+    dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *db;
+	uint64_t blkid;
+	int err;
+
+	rw_enter(&dn->dn_struct_rwlock, RW_READER);
+	blkid = dbuf_whichblock(dn, 0, offset);
+	db = dbuf_hold(dn, blkid, FTAG);
+	rw_exit(&dn->dn_struct_rwlock);
+	if (db == NULL)
+		return (SET_ERROR(EIO));
+
+	if (offset != db->db.db_offset || data->abd_size != db->db.db_size) {
+		dbuf_rele(db, FTAG);
+		return (SET_ERROR(EINVAL));
+	}
+
+	err = dbuf_direct_write(db, data, tx);
+	if (err == EAGAIN) {
+		dmu_buf_will_fill(&db->db, tx);
+		abd_copy_to_buf(db->db.db_data, data, db->db.db_size);
+		dmu_buf_fill_done(&db->db, tx);
+		err = 0;
+	}
+	dbuf_rele(db, FTAG);
+
+	return (err);
+}
+
+int
+dmu_write_direct_by_dbuf(dmu_buf_t *handle, uint64_t offset, abd_t *data,
+    dmu_tx_t *tx)
+{
+	dmu_buf_impl_t *dbuf = (dmu_buf_impl_t *)handle;
+	int err;
+
+	DB_DNODE_ENTER(dbuf);
+	err = dmu_write_direct_by_dnode(DB_DNODE(dbuf), offset, data, tx);
+	DB_DNODE_EXIT(dbuf);
+
+	return (err);
+}
+
 typedef struct {
 	dbuf_dirty_record_t	*dsa_dr;
 	dmu_sync_cb_t		*dsa_done;
@@ -2148,10 +2677,38 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	zbookmark_phys_t zb;
 	zio_prop_t zp;
 	dnode_t *dn;
+	int err;
 
 	ASSERT(pio != NULL);
 	ASSERT(txg != 0);
 
+	/*
+	 * The caller may hold the dbuf without having read it.  A block
+	 * written by dbuf_direct_write() in this txg is already on disk and
+	 * is logged by its block pointer, so it need not be read back in.
+	 * Anything else is written from its in-memory copy.
+	 */
+	mutex_enter(&db->db_mtx);
+	if (db->db_state == DB_NOFILL &&
+	    txg > spa_last_synced_txg(os->os_spa)) {
+		dr = db->db_last_dirty;
+		while (dr && dr->dr_txg != txg)
+			dr = dr->dr_next;
+		if (dr != NULL && dr->dt.dl.dr_direct &&
+		    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
+			*zgd->zgd_bp = dr->dt.dl.dr_overridden_by;
+			mutex_exit(&db->db_mtx);
+			zil_lwb_add_block(zgd->zgd_lwb, zgd->zgd_bp);
+			done(zgd, 0);
+			return (0);
+		}
+	}
+	mutex_exit(&db->db_mtx);
+
+	err = dbuf_read(db, NULL, DB_RF_CANFAIL | DB_RF_NOPREFETCH);
+	if (err != 0)
+		return (err);
+
 	SET_BOOKMARK(&zb, ds->ds_object,
 	    db->db.db_object, db->db_level, db->db_blkid);
 
@@ -2250,6 +2807,20 @@ dmu_sync(zio_t *pio, uint64_t txg, dmu_sync_cb_t *done, zgd_t *zgd)
 	DB_DNODE_EXIT(db);
 
 	ASSERT(dr->dr_txg == txg);
+	if (dr->dt.dl.dr_override_state == DR_OVERRIDDEN &&
+	    dr->dt.dl.dr_direct) {
+		/*
+		 * This block was written by dbuf_direct_write() and is
+		 * already on disk.  No log record refers to it yet, so
+		 * hand its block pointer back rather than EALREADY.
+		 */
+		*zgd->zgd_bp = dr->dt.dl.dr_overridden_by;
+		mutex_exit(&db->db_mtx);
+		zil_lwb_add_block(zgd->zgd_lwb, zgd->zgd_bp);
+		done(zgd, 0);
+		return (0);
+	}
+
 	if (dr->dt.dl.dr_override_state == DR_IN_DMU_SYNC ||
 	    dr->dt.dl.dr_override_state == DR_OVERRIDDEN) {
 		/*
@@ -2507,56 +3078,55 @@ dmu_write_policy(objset_t *os, dnode_t *dn, int level, int wp, zio_prop_t *zp)
 	zp->zp_zpl_smallblk = DMU_OT_IS_FILE(zp->zp_type) ?
 	    os->os_zpl_special_smallblock : 0;
 
+	/*
+	 * Only file data learns from its dataset's history.  Blocks of a
+	 * deduplicated dataset must compress identically however they were
+	 * written, including those written by dmu_sync() which are not
+	 * deduplicated until they are rewritten.
+	 */
+	zp->zp_compress_history = (!ismd && !(wp & WP_NOFILL) &&
+	    os->os_dedup_checksum == ZIO_CHECKSUM_OFF) ?
+	    &os->os_compress_history : NULL;
+
 	ASSERT3U(zp->zp_compress, !=, ZIO_COMPRESS_INHERIT);
 }
 
 /*
- * This function is only called from zfs_holey_common() for zpl_llseek()
- * in order to determine the location of holes.  In order to accurately
- * report holes all dirty data must be synced to disk.  This causes extremely
- * poor performance when seeking for holes in a dirty file.  As a compromise,
- * only provide hole data when the dnode is clean.  When a dnode is dirty
- * report the dnode as having no holes which is always a safe thing to do.
+ * This function is called from zfs_holey_common() for zpl_llseek() and
+ * zfs_fiemap() in order to determine the location of holes and data.
+ * Dirty data and pending frees which have not yet been synced to disk are
+ * accounted for by dnode_next_data(), so there is no need to wait for the
+ * txg to sync first.
  */
 int
 dmu_offset_next(objset_t *os, uint64_t object, boolean_t hole, uint64_t *off)
 {
 	dnode_t *dn;
 	int i, err;
-	boolean_t clean = B_TRUE;
 
 	err = dnode_hold(os, object, FTAG, &dn);
 	if (err)
 		return (err);
 
-	/*
-	 * Check if dnode is dirty
-	 */
-	for (i = 0; i < TXG_SIZE; i++) {
-		if (multilist_link_active(&dn->dn_dirty_link[i])) {
-			clean = B_FALSE;
-			break;
-		}
-	}
-
 	/*
 	 * If compatibility option is on, sync any current changes before
 	 * we go trundling through the block pointers.
 	 */
-	if (!clean && zfs_dmu_offset_next_sync) {
-		clean = B_TRUE;
-		dnode_rele(dn, FTAG);
-		txg_wait_synced(dmu_objset_pool(os), 0);
-		err = dnode_hold(os, object, FTAG, &dn);
-		if (err)
-			return (err);
+	if (zfs_dmu_offset_next_sync) {
+		for (i = 0; i < TXG_SIZE; i++) {
+			if (multilist_link_active(&dn->dn_dirty_link[i]))
+				break;
+		}
+		if (i < TXG_SIZE) {
+			dnode_rele(dn, FTAG);
+			txg_wait_synced(dmu_objset_pool(os), 0);
+			err = dnode_hold(os, object, FTAG, &dn);
+			if (err)
+				return (err);
+		}
 	}
 
-	if (clean)
-		err = dnode_next_offset(dn,
-		    (hole ? DNODE_FIND_HOLE : 0), off, 1, 1, 0);
-	else
-		err = SET_ERROR(EBUSY);
+	err = dnode_next_data(dn, hole, off);
 
 	dnode_rele(dn, FTAG);
 
@@ -2709,6 +3279,37 @@ byteswap_uint8_array(void *vbuf, size_t size)
 {
 }
 
+static void
+dmu_free_long_init(void)
+{
+	dmu_free_long_taskq = taskq_create("dmu_free_long", max_ncpus,
+	    defclsyspri, max_ncpus, INT_MAX,
+	    TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
+
+	dmu_free_long_ksp = kstat_create("zfs", 0, "dmu_free_long", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (dmu_free_long_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (dmu_free_long_ksp != NULL) {
+		dmu_free_long_ksp->ks_data = &dmu_free_long_stats;
+		kstat_install(dmu_free_long_ksp);
+	}
+}
+
+static void
+dmu_free_long_fini(void)
+{
+	if (dmu_free_long_ksp != NULL) {
+		kstat_delete(dmu_free_long_ksp);
+		dmu_free_long_ksp = NULL;
+	}
+
+	if (dmu_free_long_taskq != NULL) {
+		taskq_destroy(dmu_free_long_taskq);
+		dmu_free_long_taskq = NULL;
+	}
+}
+
 void
 dmu_init(void)
 {
@@ -2720,6 +3321,7 @@ dmu_init(void)
 	dnode_init();
 	zfetch_init();
 	dmu_tx_init();
+	dmu_free_long_init();
 	l2arc_init();
 	arc_init();
 	dbuf_init();
@@ -2730,6 +3332,7 @@ dmu_fini(void)
 {
 	arc_fini(); /* arc depends on l2arc, so arc must go first */
 	l2arc_fini();
+	dmu_free_long_fini();
 	dmu_tx_fini();
 	zfetch_fini();
 	dbuf_fini();
@@ -2747,6 +3350,7 @@ EXPORT_SYMBOL(dmu_bonus_hold_by_dnode);
 EXPORT_SYMBOL(dmu_buf_hold_array_by_bonus);
 EXPORT_SYMBOL(dmu_buf_rele_array);
 EXPORT_SYMBOL(dmu_prefetch);
+EXPORT_SYMBOL(dmu_prefetch_dnodes);
 EXPORT_SYMBOL(dmu_free_range);
 EXPORT_SYMBOL(dmu_free_long_range);
 EXPORT_SYMBOL(dmu_free_long_object);
@@ -2771,6 +3375,10 @@ EXPORT_SYMBOL(dmu_request_arcbuf);
 EXPORT_SYMBOL(dmu_return_arcbuf);
 EXPORT_SYMBOL(dmu_assign_arcbuf_by_dnode);
 EXPORT_SYMBOL(dmu_assign_arcbuf_by_dbuf);
+EXPORT_SYMBOL(dmu_read_direct);
+EXPORT_SYMBOL(dmu_read_uio_direct);
+EXPORT_SYMBOL(dmu_write_direct_by_dnode);
+EXPORT_SYMBOL(dmu_write_direct_by_dbuf);
 EXPORT_SYMBOL(dmu_buf_hold);
 EXPORT_SYMBOL(dmu_ot);
 
@@ -2782,6 +3390,14 @@ module_param(zfs_per_txg_dirty_frees_percent, ulong, 0644);
 MODULE_PARM_DESC(zfs_per_txg_dirty_frees_percent,
 	"percentage of dirtied blocks from frees in one TXG");
 
+module_param(zfs_free_long_parallel_min, ulong, 0644);
+MODULE_PARM_DESC(zfs_free_long_parallel_min,
+	"Free objects at least this large using multiple threads");
+
+module_param(zfs_free_long_parallel_threads, int, 0644);
+MODULE_PARM_DESC(zfs_free_long_parallel_threads,
+	"Max threads used to free a single large object");
+
 module_param(zfs_dmu_offset_next_sync, int, 0644);
 MODULE_PARM_DESC(zfs_dmu_offset_next_sync,
 	"Enable forcing txg sync to find holes");
@@ -2545,6 +2545,195 @@ out:
 	return (error);
 }
 
+/*
+ * Find the first run of consecutive level 0 blocks in [blkid, maxblkid)
+ * which are dirty in any txg that has not yet synced.  Returns B_TRUE and
+ * the run as [*startp, *endp) if one exists; the run itself may extend
+ * past maxblkid.  The search starts at blkid's position in dn_dbufs and
+ * stops at maxblkid, so cached clean blocks past the point of interest
+ * are never visited.
+ */
+static boolean_t
+dnode_next_dirty_run(dnode_t *dn, uint64_t blkid, uint64_t maxblkid,
+    uint64_t *startp, uint64_t *endp)
+{
+	dmu_buf_impl_t *db, *db_search;
+	avl_index_t where;
+	boolean_t found = B_FALSE;
+
+	db_search = kmem_alloc(sizeof (dmu_buf_impl_t), KM_SLEEP);
+	db_search->db_level = 0;
+	db_search->db_blkid = blkid;
+	db_search->db_state = DB_SEARCH;
+
+	mutex_enter(&dn->dn_dbufs_mtx);
+	db = avl_find(&dn->dn_dbufs, db_search, &where);
+	ASSERT3P(db, ==, NULL);
+	db = avl_nearest(&dn->dn_dbufs, where, AVL_AFTER);
+
+	/*
+	 * dn_dbufs_mtx keeps the dbufs from being destroyed; an unlocked
+	 * look at db_last_dirty is sufficient since a dbuf only becomes
+	 * clean after its block pointer has been filled in its parent.
+	 */
+	for (; db != NULL; db = AVL_NEXT(&dn->dn_dbufs, db)) {
+		if (db->db_level != 0 || db->db_blkid == DMU_SPILL_BLKID)
+			break;
+		if (!found && db->db_blkid >= maxblkid)
+			break;
+		if (db->db_state == DB_EVICTING || db->db_last_dirty == NULL) {
+			if (found)
+				break;
+			continue;
+		}
+		if (!found) {
+			*startp = db->db_blkid;
+			found = B_TRUE;
+		} else if (db->db_blkid != *endp) {
+			break;
+		}
+		*endp = db->db_blkid + 1;
+	}
+	mutex_exit(&dn->dn_dbufs_mtx);
+
+	kmem_free(db_search, sizeof (dmu_buf_impl_t));
+
+	return (found);
+}
+
+/*
+ * Find the first range of level 0 blocks at or after blkid which is being
+ * freed in a txg that has not yet synced.  Returns B_TRUE and the range as
+ * [*startp, *endp) if one exists.
+ */
+static boolean_t
+dnode_next_freed_range(dnode_t *dn, uint64_t blkid, uint64_t *startp,
+    uint64_t *endp)
+{
+	boolean_t found = B_FALSE;
+
+	mutex_enter(&dn->dn_mtx);
+	for (int i = 0; i < TXG_SIZE; i++) {
+		uint64_t start, size;
+
+		if (dn->dn_free_ranges[i] == NULL ||
+		    !range_tree_find_in(dn->dn_free_ranges[i], blkid,
+		    UINT64_MAX - blkid, &start, &size))
+			continue;
+		if (!found || start < *startp) {
+			*startp = start;
+			*endp = start + size;
+			found = B_TRUE;
+		}
+	}
+	mutex_exit(&dn->dn_mtx);
+
+	return (found);
+}
+
+/*
+ * Find the next data (or hole, if "hole" is set) in a file at or after
+ * *offset, including changes which have not yet been synced to disk.
+ * The block tree describes the state as of the last synced txg; it is
+ * overlaid with the dnode's dirty level 0 dbufs, which are always data,
+ * and its pending free ranges, which are holes unless redirtied.  This
+ * allows SEEK_DATA/SEEK_HOLE on a file which is being written without
+ * waiting for a txg to sync.  Returns ESRCH if there is no more data.
+ */
+int
+dnode_next_data(dnode_t *dn, boolean_t hole, uint64_t *offset)
+{
+	uint64_t off = *offset;
+	uint64_t dstart, dend, fstart, fend;
+	int shift, error = 0;
+
+	rw_enter(&dn->dn_struct_rwlock, RW_READER);
+
+	/*
+	 * An object with a single block, or one being freed entirely,
+	 * does not need the dirty state overlay.
+	 */
+	shift = dn->dn_datablkshift;
+	if (shift == 0 || dn->dn_free_txg != 0) {
+		if (dn->dn_free_txg != 0)
+			error = hole ? 0 : SET_ERROR(ESRCH);
+		else if (off < dn->dn_datablksz)
+			*offset = hole ? dn->dn_datablksz : off;
+		else
+			error = hole ? 0 : SET_ERROR(ESRCH);
+		goto out;
+	}
+
+	for (;;) {
+		uint64_t disk = off;
+		uint64_t blkid = off >> shift;
+
+		if (dn->dn_phys->dn_nlevels == 0) {
+			/* Nothing has been synced yet, it is all hole. */
+			error = hole ? 0 : SET_ERROR(ESRCH);
+		} else {
+			error = dnode_next_offset(dn, DNODE_FIND_HAVELOCK |
+			    (hole ? DNODE_FIND_HOLE : 0), &disk, 1, 1, 0);
+		}
+		if (error != 0 && error != ESRCH)
+			break;
+		if (error == ESRCH)
+			disk = UINT64_MAX;
+		error = 0;
+
+		if (!hole) {
+			uint64_t dirty = UINT64_MAX;
+
+			/* Dirty blocks past the next synced data are moot. */
+			if (dnode_next_dirty_run(dn, blkid,
+			    (disk >> shift) + 1, &dstart, &dend))
+				dirty = MAX(off, dstart << shift);
+			if (dirty <= disk) {
+				if (dirty == UINT64_MAX)
+					error = SET_ERROR(ESRCH);
+				else
+					*offset = dirty;
+				break;
+			}
+
+			/* Skip synced data which is about to be freed. */
+			if (dnode_next_freed_range(dn, disk >> shift,
+			    &fstart, &fend) && fstart == disk >> shift) {
+				if (dirty < (fend << shift)) {
+					*offset = dirty;
+					break;
+				}
+				off = fend << shift;
+				continue;
+			}
+			*offset = disk;
+			break;
+		} else {
+			uint64_t hb;
+
+			/* Blocks being freed are holes which appear sooner. */
+			if (dnode_next_freed_range(dn, blkid, &fstart, &fend) &&
+			    (fstart << shift) < disk)
+				disk = MAX(off, fstart << shift);
+
+			/* A hole which has been written since is data. */
+			hb = disk >> shift;
+			if (dnode_next_dirty_run(dn, hb, hb + 1,
+			    &dstart, &dend)) {
+				ASSERT3U(dstart, ==, hb);
+				off = dend << shift;
+				continue;
+			}
+			*offset = disk;
+			break;
+		}
+	}
+out:
+	rw_exit(&dn->dn_struct_rwlock);
+
+	return (error);
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dnode_hold);
 EXPORT_SYMBOL(dnode_rele);
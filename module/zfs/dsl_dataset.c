@@ -77,6 +77,21 @@
  */
 int zfs_max_recordsize = 1 * 1024 * 1024;
 
+/*
+ * A new sublist is started in a clone's livelist once the last one holds
+ * this many entries (see dsl_deadlist.c), which bounds the memory needed
+ * to condense or destroy a sublist.
+ */
+unsigned long zfs_livelist_max_entries = 500000;
+
+/*
+ * Once no more than this percentage of the space referenced by a clone is
+ * shared with its origin, its livelist is removed: destroying the clone
+ * by traversing it is then about as fast, and the livelist would only keep
+ * growing.
+ */
+int zfs_livelist_min_percent_shared = 75;
+
 #define	SWITCH64(x, y) \
 	{ \
 		uint64_t __tmp = (x); \
@@ -146,6 +161,10 @@ dsl_dataset_block_born(dsl_dataset_t *ds, const blkptr_t *bp, dmu_tx_t *tx)
 	}
 
 	ASSERT3U(bp->blk_birth, >, dsl_dataset_phys(ds)->ds_prev_snap_txg);
+	if (dsl_deadlist_is_open(&ds->ds_dir->dd_livelist) &&
+	    !BP_IS_EMBEDDED(bp))
+		bplist_append(&ds->ds_dir->dd_pending_allocs, bp);
+
 	dmu_buf_will_dirty(ds->ds_dbuf, tx);
 	mutex_enter(&ds->ds_lock);
 	delta = parent_delta(ds, used);
@@ -192,6 +211,16 @@ dsl_dataset_block_remapped(dsl_dataset_t *ds, uint64_t vdev, uint64_t offset,
 
 	if (birth > dsl_dataset_phys(ds)->ds_prev_snap_txg) {
 		spa_vdev_indirect_mark_obsolete(spa, vdev, offset, size, tx);
+
+		/*
+		 * The clone's livelist still records the block at its
+		 * old location; have dsl_dataset_sync_done() remove it.
+		 */
+		if (dsl_deadlist_is_open(&ds->ds_dir->dd_livelist)) {
+			mutex_enter(&ds->ds_dir->dd_lock);
+			ds->ds_dir->dd_livelist_remapped = B_TRUE;
+			mutex_exit(&ds->ds_dir->dd_lock);
+		}
 	} else {
 		blkptr_t fakebp;
 		dva_t *dva = &fakebp.blk_dva[0];
@@ -210,7 +239,8 @@ dsl_dataset_block_remapped(dsl_dataset_t *ds, uint64_t vdev, uint64_t offset,
 		DVA_SET_OFFSET(dva, offset);
 		DVA_SET_ASIZE(dva, size);
 
-		dsl_deadlist_insert(&ds->ds_remap_deadlist, &fakebp, tx);
+		dsl_deadlist_insert(&ds->ds_remap_deadlist, &fakebp, B_FALSE,
+		    tx);
 	}
 }
 
@@ -246,6 +276,9 @@ dsl_dataset_block_kill(dsl_dataset_t *ds, const blkptr_t *bp, dmu_tx_t *tx,
 
 		dprintf_bp(bp, "freeing ds=%llu", ds->ds_object);
 		dsl_free(tx->tx_pool, tx->tx_txg, bp);
+		if (dsl_deadlist_is_open(&ds->ds_dir->dd_livelist) &&
+		    !BP_IS_EMBEDDED(bp))
+			bplist_append(&ds->ds_dir->dd_pending_frees, bp);
 
 		mutex_enter(&ds->ds_lock);
 		ASSERT(dsl_dataset_phys(ds)->ds_unique_bytes >= used ||
@@ -269,7 +302,7 @@ dsl_dataset_block_kill(dsl_dataset_t *ds, const blkptr_t *bp, dmu_tx_t *tx,
 			 */
 			bplist_append(&ds->ds_pending_deadlist, bp);
 		} else {
-			dsl_deadlist_insert(&ds->ds_deadlist, bp, tx);
+			dsl_deadlist_insert(&ds->ds_deadlist, bp, B_FALSE, tx);
 		}
 		ASSERT3U(ds->ds_prev->ds_object, ==,
 		    dsl_dataset_phys(ds)->ds_prev_snap_obj);
@@ -1270,6 +1303,16 @@ dsl_dataset_create_sync_dd(dsl_dir_t *dd, dsl_dataset_t *origin,
 			    dsl_dir_phys(origin->ds_dir)->dd_clones,
 			    dsobj, tx));
 		}
+
+		/*
+		 * Track the blocks the clone allocates and frees, so that it
+		 * can be destroyed without being traversed.
+		 */
+		if (dsl_dir_is_clone(dd) &&
+		    spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_LIVELIST)) {
+			dsl_dir_create_livelist(dd,
+			    dsphys->ds_prev_snap_txg, tx);
+		}
 	}
 
 	/* handle encryption */
@@ -1727,6 +1770,12 @@ dsl_dataset_snapshot_sync_impl(dsl_dataset_t *ds, const char *snapname,
 
 	dsl_fs_ss_count_adjust(ds->ds_dir, 1, DD_FIELD_SNAPSHOT_COUNT, tx);
 
+	/*
+	 * Blocks the clone frees from now on may still be referenced by the
+	 * new snapshot, so its livelist can no longer be used to destroy it.
+	 */
+	dsl_dir_remove_livelist(ds->ds_dir, tx);
+
 	/*
 	 * The origin's ds_creation_txg has to be < TXG_INITIAL
 	 */
@@ -2119,18 +2168,98 @@ static int
 deadlist_enqueue_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
 	dsl_deadlist_t *dl = arg;
-	dsl_deadlist_insert(dl, bp, tx);
+	dsl_deadlist_insert(dl, bp, B_FALSE, tx);
+	return (0);
+}
+
+static int
+livelist_enqueue_alloc_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_deadlist_t *ll = arg;
+	dsl_deadlist_insert(ll, bp, B_FALSE, tx);
+	return (0);
+}
+
+static int
+livelist_enqueue_free_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_deadlist_t *ll = arg;
+	dsl_deadlist_insert(ll, bp, B_TRUE, tx);
 	return (0);
 }
 
+/*
+ * Move the blocks born and killed in this txg to the clone's livelist.
+ */
+static void
+dsl_livelist_flush_pending(dsl_dataset_t *ds, dmu_tx_t *tx)
+{
+	dsl_dir_t *dd = ds->ds_dir;
+	dsl_deadlist_t *ll = &dd->dd_livelist;
+	dsl_deadlist_entry_t *last = dsl_deadlist_last(ll);
+
+	/*
+	 * Start a new sublist once the last one is full, and have the full
+	 * one condensed.  The new sublist holds the blocks born from this
+	 * txg on, so it never receives the FREE entries of the blocks
+	 * already recorded.
+	 */
+	if (last != NULL && last->dle_mintxg < tx->tx_txg - 1 &&
+	    last->dle_bpobj.bpo_phys->bpo_num_blkptrs >=
+	    zfs_livelist_max_entries) {
+		spa_livelist_condense_queue(dd->dd_pool->dp_spa,
+		    dd->dd_object, ll->dl_object, last->dle_mintxg,
+		    last->dle_bpobj.bpo_object);
+		dsl_deadlist_add_key(ll, tx->tx_txg - 1, tx);
+	}
+
+	bplist_iterate(&dd->dd_pending_allocs,
+	    livelist_enqueue_alloc_cb, ll, tx);
+	bplist_iterate(&dd->dd_pending_frees,
+	    livelist_enqueue_free_cb, ll, tx);
+}
+
+/*
+ * Whether the clone's livelist should be removed, because little of the
+ * space the clone references is still shared with its origin.
+ */
+static boolean_t
+dsl_livelist_should_disable(dsl_dataset_t *ds)
+{
+	uint64_t used, referenced;
+
+	used = dsl_dir_get_usedds(ds->ds_dir);
+	referenced = dsl_get_referenced(ds);
+	if (referenced == 0)
+		return (B_FALSE);
+	if (used >= referenced)
+		return (B_TRUE);
+
+	return ((100 * (referenced - used)) / referenced <=
+	    zfs_livelist_min_percent_shared);
+}
+
 void
 dsl_dataset_sync_done(dsl_dataset_t *ds, dmu_tx_t *tx)
 {
 	objset_t *os = ds->ds_objset;
+	dsl_dir_t *dd = ds->ds_dir;
 
 	bplist_iterate(&ds->ds_pending_deadlist,
 	    deadlist_enqueue_cb, &ds->ds_deadlist, tx);
 
+	if (dsl_deadlist_is_open(&dd->dd_livelist)) {
+		boolean_t remapped;
+
+		dsl_livelist_flush_pending(ds, tx);
+
+		mutex_enter(&dd->dd_lock);
+		remapped = dd->dd_livelist_remapped;
+		mutex_exit(&dd->dd_lock);
+		if (remapped || dsl_livelist_should_disable(ds))
+			dsl_dir_remove_livelist(dd, tx);
+	}
+
 	if (os->os_synced_dnodes != NULL) {
 		multilist_destroy(os->os_synced_dnodes);
 		os->os_synced_dnodes = NULL;
@@ -3369,6 +3498,9 @@ dsl_dataset_promote_sync(void *arg, dmu_tx_t *tx)
 
 	dsl_dataset_promote_crypt_sync(hds->ds_dir, odd, tx);
 
+	/* the promoted clone's blocks are now shared with its snapshots */
+	dsl_dir_remove_livelist(dd, tx);
+
 	/* change origin's next snap */
 	dmu_buf_will_dirty(origin_ds->ds_dbuf, tx);
 	oldnext_obj = dsl_dataset_phys(origin_ds)->ds_next_snap_obj;
@@ -3824,6 +3956,13 @@ dsl_dataset_clone_swap_sync_impl(dsl_dataset_t *clone,
 	    DMU_MAX_ACCESS * spa_asize_inflation);
 	ASSERT3P(clone->ds_prev, ==, origin_head->ds_prev);
 
+	/*
+	 * Neither livelist describes the blocks of its dataset once the
+	 * contents have been swapped.
+	 */
+	dsl_dir_remove_livelist(clone->ds_dir, tx);
+	dsl_dir_remove_livelist(origin_head->ds_dir, tx);
+
 	/*
 	 * Swap per-dataset feature flags.
 	 */
@@ -4588,6 +4727,15 @@ module_param(zfs_max_recordsize, int, 0444);
 MODULE_PARM_DESC(zfs_max_recordsize, "Max allowed record size");
 #endif
 
+module_param(zfs_livelist_max_entries, ulong, 0644);
+MODULE_PARM_DESC(zfs_livelist_max_entries,
+	"Max entries in a sublist of a clone's livelist");
+
+module_param(zfs_livelist_min_percent_shared, int, 0644);
+MODULE_PARM_DESC(zfs_livelist_min_percent_shared,
+	"Remove a clone's livelist once this percentage or less of its "
+	"space is shared with its origin");
+
 EXPORT_SYMBOL(dsl_dataset_hold);
 EXPORT_SYMBOL(dsl_dataset_hold_flags);
 EXPORT_SYMBOL(dsl_dataset_hold_obj);
@@ -30,6 +30,7 @@
 #include <sys/zap.h>
 #include <sys/zfs_context.h>
 #include <sys/dsl_pool.h>
+#include <sys/btree.h>
 
 /*
  * Deadlist concurrency:
@@ -46,11 +47,22 @@
  * Therefore, we only need to provide locking between dsl_deadlist_insert() and
  * the accessors, protecting:
  *     dl_phys->dl_used,comp,uncomp
- *     and protecting the dl_tree from being loaded.
+ *     and protecting the dl_tree and dl_cache from being loaded.
  * The locking is provided by dl_lock.  Note that locking on the bpobj_t
  * provides its own locking, and dl_oldfmt is immutable.
  */
 
+/*
+ * Deadlist entries are loaded lazily.  Opening a deadlist only holds its
+ * header, which suffices for dsl_deadlist_space().  Space queries over a
+ * range of entries load dl_cache, which records the space of each nonempty
+ * entry without keeping its bpobj open.  Anything which modifies the
+ * deadlist or needs the entries' bpobjs loads dl_tree, which holds every
+ * entry open; once it is loaded the cache is discarded, since it would
+ * not be kept up to date.  A dataset's deadlists live in its dsl_dataset_t,
+ * so whatever is loaded is shared by all holders of the dataset.
+ */
+
 static int
 dsl_deadlist_compare(const void *arg1, const void *arg2)
 {
@@ -60,9 +72,33 @@ dsl_deadlist_compare(const void *arg1, const void *arg2)
 	return (TREE_CMP(dle1->dle_mintxg, dle2->dle_mintxg));
 }
 
+static int
+dsl_deadlist_cache_compare(const void *arg1, const void *arg2)
+{
+	const dsl_deadlist_cache_entry_t *dlce1 = arg1;
+	const dsl_deadlist_cache_entry_t *dlce2 = arg2;
+
+	return (TREE_CMP(dlce1->dlce_mintxg, dlce2->dlce_mintxg));
+}
+
+static void
+dsl_deadlist_discard_cache(dsl_deadlist_t *dl)
+{
+	zfs_btree_index_t *cookie = NULL;
+
+	if (!dl->dl_havecache)
+		return;
+
+	while (zfs_btree_destroy_nodes(&dl->dl_cache, &cookie) != NULL)
+		continue;
+	zfs_btree_destroy(&dl->dl_cache);
+	dl->dl_havecache = B_FALSE;
+}
+
 static void
 dsl_deadlist_load_tree(dsl_deadlist_t *dl)
 {
+	dsl_deadlist_entry_t *dle;
 	zap_cursor_t zc;
 	zap_attribute_t za;
 
@@ -72,22 +108,105 @@ dsl_deadlist_load_tree(dsl_deadlist_t *dl)
 	if (dl->dl_havetree)
 		return;
 
+	dsl_deadlist_discard_cache(dl);
+
 	avl_create(&dl->dl_tree, dsl_deadlist_compare,
 	    sizeof (dsl_deadlist_entry_t),
 	    offsetof(dsl_deadlist_entry_t, dle_node));
 	for (zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
 	    zap_cursor_retrieve(&zc, &za) == 0;
 	    zap_cursor_advance(&zc)) {
-		dsl_deadlist_entry_t *dle = kmem_alloc(sizeof (*dle), KM_SLEEP);
+		dle = kmem_alloc(sizeof (*dle), KM_SLEEP);
 		dle->dle_mintxg = zfs_strtonum(za.za_name, NULL);
-		VERIFY3U(0, ==, bpobj_open(&dle->dle_bpobj, dl->dl_os,
-		    za.za_first_integer));
+		dle->dle_bpobj.bpo_object = za.za_first_integer;
 		avl_add(&dl->dl_tree, dle);
+
+		/* read the bpobjs' headers in parallel */
+		dmu_prefetch(dl->dl_os, za.za_first_integer, 0, 0, 0,
+		    ZIO_PRIORITY_SYNC_READ);
 	}
 	zap_cursor_fini(&zc);
+
+	for (dle = avl_first(&dl->dl_tree); dle != NULL;
+	    dle = AVL_NEXT(&dl->dl_tree, dle)) {
+		VERIFY0(bpobj_open(&dle->dle_bpobj, dl->dl_os,
+		    dle->dle_bpobj.bpo_object));
+	}
 	dl->dl_havetree = B_TRUE;
 }
 
+/*
+ * Load the space of each nonempty entry, for dsl_deadlist_space_range().
+ */
+static void
+dsl_deadlist_load_cache(dsl_deadlist_t *dl)
+{
+	uint64_t empty_bpobj = dmu_objset_pool(dl->dl_os)->dp_empty_bpobj;
+	dsl_deadlist_cache_entry_t *dlce;
+	zfs_btree_index_t where;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+
+	ASSERT(MUTEX_HELD(&dl->dl_lock));
+
+	ASSERT(!dl->dl_oldfmt);
+	ASSERT(!dl->dl_havetree);
+	if (dl->dl_havecache)
+		return;
+
+	zfs_btree_create(&dl->dl_cache, dsl_deadlist_cache_compare,
+	    sizeof (dsl_deadlist_cache_entry_t));
+	for (zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		dsl_deadlist_cache_entry_t dlce_toadd = { 0 };
+
+		if (za.za_first_integer == empty_bpobj)
+			continue;
+
+		dlce_toadd.dlce_mintxg = zfs_strtonum(za.za_name, NULL);
+		dlce_toadd.dlce_bpobj = za.za_first_integer;
+		zfs_btree_add(&dl->dl_cache, &dlce_toadd);
+
+		dmu_prefetch(dl->dl_os, za.za_first_integer, 0, 0, 0,
+		    ZIO_PRIORITY_SYNC_READ);
+	}
+	zap_cursor_fini(&zc);
+
+	for (dlce = zfs_btree_first(&dl->dl_cache, &where); dlce != NULL;
+	    dlce = zfs_btree_next(&dl->dl_cache, &where, &where)) {
+		bpobj_t bpo;
+
+		VERIFY0(bpobj_open(&bpo, dl->dl_os, dlce->dlce_bpobj));
+		VERIFY0(bpobj_space(&bpo, &dlce->dlce_used,
+		    &dlce->dlce_comp, &dlce->dlce_uncomp));
+		bpobj_close(&bpo);
+	}
+	dl->dl_havecache = B_TRUE;
+}
+
+/*
+ * Call func on each entry of the deadlist, in mintxg order, until it
+ * returns nonzero.  The deadlist must not be modified meanwhile.
+ */
+void
+dsl_deadlist_iterate(dsl_deadlist_t *dl, deadlist_iter_t func, void *arg)
+{
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(dsl_deadlist_is_open(dl));
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	for (dle = avl_first(&dl->dl_tree); dle != NULL;
+	    dle = AVL_NEXT(&dl->dl_tree, dle)) {
+		if (func(arg, dle) != 0)
+			break;
+	}
+	mutex_exit(&dl->dl_lock);
+}
+
 void
 dsl_deadlist_open(dsl_deadlist_t *dl, objset_t *os, uint64_t object)
 {
@@ -111,6 +230,7 @@ dsl_deadlist_open(dsl_deadlist_t *dl, objset_t *os, uint64_t object)
 	dl->dl_oldfmt = B_FALSE;
 	dl->dl_phys = dl->dl_dbuf->db_data;
 	dl->dl_havetree = B_FALSE;
+	dl->dl_havecache = B_FALSE;
 }
 
 boolean_t
@@ -143,7 +263,9 @@ dsl_deadlist_close(dsl_deadlist_t *dl)
 			kmem_free(dle, sizeof (*dle));
 		}
 		avl_destroy(&dl->dl_tree);
+		dl->dl_havetree = B_FALSE;
 	}
+	dsl_deadlist_discard_cache(dl);
 	dmu_buf_rele(dl->dl_dbuf, dl);
 	dl->dl_dbuf = NULL;
 	dl->dl_phys = NULL;
@@ -188,7 +310,7 @@ dsl_deadlist_free(objset_t *os, uint64_t dlobj, dmu_tx_t *tx)
 
 static void
 dle_enqueue(dsl_deadlist_t *dl, dsl_deadlist_entry_t *dle,
-    const blkptr_t *bp, dmu_tx_t *tx)
+    const blkptr_t *bp, boolean_t bp_freed, dmu_tx_t *tx)
 {
 	ASSERT(MUTEX_HELD(&dl->dl_lock));
 	if (dle->dle_bpobj.bpo_object ==
@@ -200,7 +322,7 @@ dle_enqueue(dsl_deadlist_t *dl, dsl_deadlist_entry_t *dle,
 		VERIFY3U(0, ==, zap_update_int_key(dl->dl_os, dl->dl_object,
 		    dle->dle_mintxg, obj, tx));
 	}
-	bpobj_enqueue(&dle->dle_bpobj, bp, tx);
+	bpobj_enqueue(&dle->dle_bpobj, bp, bp_freed, tx);
 }
 
 static void
@@ -221,14 +343,15 @@ dle_enqueue_subobj(dsl_deadlist_t *dl, dsl_deadlist_entry_t *dle,
 }
 
 void
-dsl_deadlist_insert(dsl_deadlist_t *dl, const blkptr_t *bp, dmu_tx_t *tx)
+dsl_deadlist_insert(dsl_deadlist_t *dl, const blkptr_t *bp, boolean_t bp_freed,
+    dmu_tx_t *tx)
 {
 	dsl_deadlist_entry_t dle_tofind;
 	dsl_deadlist_entry_t *dle;
 	avl_index_t where;
 
 	if (dl->dl_oldfmt) {
-		bpobj_enqueue(&dl->dl_bpobj, bp, tx);
+		bpobj_enqueue(&dl->dl_bpobj, bp, bp_freed, tx);
 		return;
 	}
 
@@ -255,7 +378,7 @@ dsl_deadlist_insert(dsl_deadlist_t *dl, const blkptr_t *bp, dmu_tx_t *tx)
 	}
 
 	ASSERT3P(dle, !=, NULL);
-	dle_enqueue(dl, dle, bp, tx);
+	dle_enqueue(dl, dle, bp, bp_freed, tx);
 	mutex_exit(&dl->dl_lock);
 }
 
@@ -272,15 +395,19 @@ dsl_deadlist_add_key(dsl_deadlist_t *dl, uint64_t mintxg, dmu_tx_t *tx)
 	if (dl->dl_oldfmt)
 		return;
 
-	dle = kmem_alloc(sizeof (*dle), KM_SLEEP);
-	dle->dle_mintxg = mintxg;
-
 	mutex_enter(&dl->dl_lock);
-	dsl_deadlist_load_tree(dl);
-
 	obj = bpobj_alloc_empty(dl->dl_os, SPA_OLD_MAXBLOCKSIZE, tx);
-	VERIFY3U(0, ==, bpobj_open(&dle->dle_bpobj, dl->dl_os, obj));
-	avl_add(&dl->dl_tree, dle);
+
+	/*
+	 * The new entry is empty, so there is no need to load the tree (or
+	 * to update the cache) just to add it; a later load will find it.
+	 */
+	if (dl->dl_havetree) {
+		dle = kmem_alloc(sizeof (*dle), KM_SLEEP);
+		dle->dle_mintxg = mintxg;
+		VERIFY3U(0, ==, bpobj_open(&dle->dle_bpobj, dl->dl_os, obj));
+		avl_add(&dl->dl_tree, dle);
+	}
 
 	VERIFY3U(0, ==, zap_add_int_key(dl->dl_os, dl->dl_object,
 	    mintxg, obj, tx));
@@ -347,7 +474,8 @@ uint64_t
 dsl_deadlist_clone(dsl_deadlist_t *dl, uint64_t maxtxg,
     uint64_t mrs_obj, dmu_tx_t *tx)
 {
-	dsl_deadlist_entry_t *dle;
+	zap_cursor_t zc;
+	zap_attribute_t za;
 	uint64_t newobj;
 
 	newobj = dsl_deadlist_alloc(dl->dl_os, tx);
@@ -357,20 +485,22 @@ dsl_deadlist_clone(dsl_deadlist_t *dl, uint64_t maxtxg,
 		return (newobj);
 	}
 
+	/* only the keys are needed, so read them without loading the tree */
 	mutex_enter(&dl->dl_lock);
-	dsl_deadlist_load_tree(dl);
-
-	for (dle = avl_first(&dl->dl_tree); dle;
-	    dle = AVL_NEXT(&dl->dl_tree, dle)) {
+	for (zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		uint64_t mintxg = zfs_strtonum(za.za_name, NULL);
 		uint64_t obj;
 
-		if (dle->dle_mintxg >= maxtxg)
-			break;
+		if (mintxg >= maxtxg)
+			continue;
 
 		obj = bpobj_alloc_empty(dl->dl_os, SPA_OLD_MAXBLOCKSIZE, tx);
 		VERIFY3U(0, ==, zap_add_int_key(dl->dl_os, newobj,
-		    dle->dle_mintxg, obj, tx));
+		    mintxg, obj, tx));
 	}
+	zap_cursor_fini(&zc);
 	mutex_exit(&dl->dl_lock);
 	return (newobj);
 }
@@ -399,6 +529,30 @@ dsl_deadlist_space(dsl_deadlist_t *dl,
  * mintxg and maxtxg must both be keys in the deadlist (unless maxtxg is
  * larger than any bp in the deadlist (eg. UINT64_MAX)).
  */
+static void
+dsl_deadlist_space_range_cache(dsl_deadlist_t *dl, uint64_t mintxg,
+    uint64_t maxtxg, uint64_t *usedp, uint64_t *compp, uint64_t *uncompp)
+{
+	dsl_deadlist_cache_entry_t dlce_tofind;
+	dsl_deadlist_cache_entry_t *dlce;
+	zfs_btree_index_t where;
+
+	dsl_deadlist_load_cache(dl);
+
+	/* empty entries are not cached, so mintxg may not be found */
+	dlce_tofind.dlce_mintxg = mintxg;
+	dlce = zfs_btree_find(&dl->dl_cache, &dlce_tofind, &where);
+	if (dlce == NULL)
+		dlce = zfs_btree_next(&dl->dl_cache, &where, &where);
+
+	for (; dlce != NULL && dlce->dlce_mintxg < maxtxg;
+	    dlce = zfs_btree_next(&dl->dl_cache, &where, &where)) {
+		*usedp += dlce->dlce_used;
+		*compp += dlce->dlce_comp;
+		*uncompp += dlce->dlce_uncomp;
+	}
+}
+
 void
 dsl_deadlist_space_range(dsl_deadlist_t *dl, uint64_t mintxg, uint64_t maxtxg,
     uint64_t *usedp, uint64_t *compp, uint64_t *uncompp)
@@ -416,7 +570,13 @@ dsl_deadlist_space_range(dsl_deadlist_t *dl, uint64_t mintxg, uint64_t maxtxg,
 	*usedp = *compp = *uncompp = 0;
 
 	mutex_enter(&dl->dl_lock);
-	dsl_deadlist_load_tree(dl);
+	if (!dl->dl_havetree) {
+		dsl_deadlist_space_range_cache(dl, mintxg, maxtxg,
+		    usedp, compp, uncompp);
+		mutex_exit(&dl->dl_lock);
+		return;
+	}
+
 	dle_tofind.dle_mintxg = mintxg;
 	dle = avl_find(&dl->dl_tree, &dle_tofind, &where);
 	/*
@@ -474,7 +634,7 @@ static int
 dsl_deadlist_insert_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
 	dsl_deadlist_t *dl = arg;
-	dsl_deadlist_insert(dl, bp, tx);
+	dsl_deadlist_insert(dl, bp, B_FALSE, tx);
 	return (0);
 }
 
@@ -566,3 +726,335 @@ dsl_deadlist_move_bpobj(dsl_deadlist_t *dl, bpobj_t *bpo, uint64_t mintxg,
 	}
 	mutex_exit(&dl->dl_lock);
 }
+
+/*
+ * Issue reads for the metadata that merging this deadlist into another, or
+ * moving its entries to a bpobj, will need: the header of each entry's
+ * bpobj, and the dnode of that bpobj's subobj array.  This is called from
+ * open context before a sync task which will destroy snapshots, so that
+ * the sync task finds these blocks cached instead of reading them one at
+ * a time.  Entries are handled DSL_DEADLIST_PREFETCH_BATCH at a time, so
+ * that a deadlist with very many entries doesn't need a large allocation.
+ */
+#define	DSL_DEADLIST_PREFETCH_BATCH	256
+
+static void
+dsl_deadlist_prefetch_batch(dsl_deadlist_t *dl, uint64_t *objs, int n)
+{
+	(void) dmu_prefetch_dnodes(dl->dl_os, objs, n,
+	    ZIO_PRIORITY_ASYNC_READ, NULL);
+
+	for (int i = 0; i < n; i++) {
+		bpobj_t bpo;
+
+		if (bpobj_open(&bpo, dl->dl_os, objs[i]) != 0)
+			continue;
+		if (bpo.bpo_havesubobj && bpo.bpo_phys->bpo_subobjs != 0) {
+			dmu_prefetch(dl->dl_os, bpo.bpo_phys->bpo_subobjs,
+			    0, 0, 0, ZIO_PRIORITY_ASYNC_READ);
+		}
+		bpobj_close(&bpo);
+	}
+}
+
+void
+dsl_deadlist_prefetch(dsl_deadlist_t *dl)
+{
+	uint64_t empty_bpobj = dmu_objset_pool(dl->dl_os)->dp_empty_bpobj;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	uint64_t *objs;
+	boolean_t done = B_FALSE;
+
+	if (dl->dl_oldfmt)
+		return;
+
+	objs = kmem_alloc(DSL_DEADLIST_PREFETCH_BATCH * sizeof (uint64_t),
+	    KM_SLEEP);
+	zap_cursor_init(&zc, dl->dl_os, dl->dl_object);
+	while (!done) {
+		int n = 0;
+
+		/*
+		 * A loaded tree holds every bpobj open, so they are cached.
+		 * The lock is dropped between batches; entries added or
+		 * removed meanwhile may be missed, which only costs a read.
+		 */
+		mutex_enter(&dl->dl_lock);
+		if (dl->dl_havetree) {
+			mutex_exit(&dl->dl_lock);
+			break;
+		}
+		while (n < DSL_DEADLIST_PREFETCH_BATCH) {
+			if (zap_cursor_retrieve(&zc, &za) != 0) {
+				done = B_TRUE;
+				break;
+			}
+			if (za.za_first_integer != empty_bpobj)
+				objs[n++] = za.za_first_integer;
+			zap_cursor_advance(&zc);
+		}
+		mutex_exit(&dl->dl_lock);
+
+		if (n > 0)
+			dsl_deadlist_prefetch_batch(dl, objs, n);
+	}
+	zap_cursor_fini(&zc);
+	kmem_free(objs, DSL_DEADLIST_PREFETCH_BATCH * sizeof (uint64_t));
+}
+
+/*
+ * Return the first or the last sublist of dl, or NULL if it has none.
+ */
+dsl_deadlist_entry_t *
+dsl_deadlist_first(dsl_deadlist_t *dl)
+{
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	dle = avl_first(&dl->dl_tree);
+	mutex_exit(&dl->dl_lock);
+	return (dle);
+}
+
+dsl_deadlist_entry_t *
+dsl_deadlist_last(dsl_deadlist_t *dl)
+{
+	dsl_deadlist_entry_t *dle;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+	dle = avl_last(&dl->dl_tree);
+	mutex_exit(&dl->dl_lock);
+	return (dle);
+}
+
+/*
+ * Remove the sublist with the given mintxg and free its bpobj.  Unlike
+ * dsl_deadlist_remove_key(), its entries are not moved to the previous
+ * sublist.
+ */
+void
+dsl_deadlist_remove_entry(dsl_deadlist_t *dl, uint64_t mintxg, dmu_tx_t *tx)
+{
+	dsl_deadlist_entry_t dle_tofind;
+	dsl_deadlist_entry_t *dle;
+	uint64_t obj, used, comp, uncomp;
+
+	ASSERT(!dl->dl_oldfmt);
+
+	mutex_enter(&dl->dl_lock);
+	dsl_deadlist_load_tree(dl);
+
+	dle_tofind.dle_mintxg = mintxg;
+	dle = avl_find(&dl->dl_tree, &dle_tofind, NULL);
+	ASSERT3P(dle, !=, NULL);
+
+	VERIFY0(bpobj_space(&dle->dle_bpobj, &used, &comp, &uncomp));
+	dmu_buf_will_dirty(dl->dl_dbuf, tx);
+	ASSERT3U(dl->dl_phys->dl_used, >=, used);
+	ASSERT3U(dl->dl_phys->dl_comp, >=, comp);
+	ASSERT3U(dl->dl_phys->dl_uncomp, >=, uncomp);
+	dl->dl_phys->dl_used -= used;
+	dl->dl_phys->dl_comp -= comp;
+	dl->dl_phys->dl_uncomp -= uncomp;
+
+	obj = dle->dle_bpobj.bpo_object;
+	avl_remove(&dl->dl_tree, dle);
+	bpobj_close(&dle->dle_bpobj);
+	kmem_free(dle, sizeof (*dle));
+
+	if (obj == dmu_objset_pool(dl->dl_os)->dp_empty_bpobj)
+		bpobj_decr_empty(dl->dl_os, tx);
+	else
+		bpobj_free(dl->dl_os, obj, tx);
+	VERIFY0(zap_remove_int(dl->dl_os, dl->dl_object, mintxg, tx));
+	mutex_exit(&dl->dl_lock);
+}
+
+/*
+ * Livelists
+ *
+ * A clone's livelist is a deadlist recording the blocks the clone has
+ * allocated (ALLOC entries) and freed (FREE entries, marked with
+ * BP_SET_FREE()) since it was created, so that it can be destroyed by
+ * freeing the blocks with more ALLOC than FREE entries instead of by
+ * traversing it.  Both kinds of entries are inserted by the block's birth
+ * txg, and a sublist is only added with a mintxg below the births recorded
+ * from then on (see dsl_dataset_sync_done()), so the FREE entries of a
+ * block always land in the sublist holding its ALLOC entries.  Each
+ * sublist can therefore be condensed or resolved on its own.
+ *
+ * Blocks are identified by the vdev and offset of their first DVA and their
+ * birth txg; a deduplicated block may have several ALLOC entries.
+ */
+
+typedef struct livelist_entry {
+	blkptr_t	le_bp;
+	uint64_t	le_allocs;
+	uint64_t	le_frees;
+} livelist_entry_t;
+
+typedef struct livelist_net_arg {
+	zfs_btree_t	lna_tree;
+	zthr_t		*lna_zthr;
+	boolean_t	*lna_cancelled;
+} livelist_net_arg_t;
+
+static int
+livelist_compare(const void *arg1, const void *arg2)
+{
+	const blkptr_t *bp1 = &((const livelist_entry_t *)arg1)->le_bp;
+	const blkptr_t *bp2 = &((const livelist_entry_t *)arg2)->le_bp;
+	int cmp;
+
+	cmp = TREE_CMP(DVA_GET_VDEV(&bp1->blk_dva[0]),
+	    DVA_GET_VDEV(&bp2->blk_dva[0]));
+	if (cmp != 0)
+		return (cmp);
+
+	cmp = TREE_CMP(DVA_GET_OFFSET(&bp1->blk_dva[0]),
+	    DVA_GET_OFFSET(&bp2->blk_dva[0]));
+	if (cmp != 0)
+		return (cmp);
+
+	return (TREE_CMP(bp1->blk_birth, bp2->blk_birth));
+}
+
+/* ARGSUSED */
+static int
+livelist_net_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	livelist_net_arg_t *lna = arg;
+	livelist_entry_t le_tofind;
+	livelist_entry_t *le;
+	zfs_btree_index_t where;
+
+	if ((lna->lna_zthr != NULL && zthr_iscancelled(lna->lna_zthr)) ||
+	    (lna->lna_cancelled != NULL && *lna->lna_cancelled))
+		return (SET_ERROR(EINTR));
+
+	le_tofind.le_bp = *bp;
+	le = zfs_btree_find(&lna->lna_tree, &le_tofind, &where);
+	if (le == NULL) {
+		le_tofind.le_allocs = !BP_GET_FREE(bp);
+		le_tofind.le_frees = BP_GET_FREE(bp);
+		zfs_btree_add_idx(&lna->lna_tree, &le_tofind, &where);
+	} else if (BP_GET_FREE(bp)) {
+		le->le_frees++;
+	} else {
+		le->le_allocs++;
+	}
+	return (0);
+}
+
+/*
+ * Resolve the first count entries of the livelist sublist bpo: the ALLOC
+ * and FREE entries of each block cancel each other out, and the entries
+ * left over are appended to net.  If t is cancelled or *cancelled becomes
+ * set meanwhile, EINTR is returned and nothing is appended.
+ */
+int
+dsl_livelist_net(bpobj_t *bpo, uint64_t count, bplist_t *net, zthr_t *t,
+    boolean_t *cancelled)
+{
+	livelist_net_arg_t lna;
+	livelist_entry_t *le;
+	zfs_btree_index_t *cookie = NULL;
+	int err;
+
+	zfs_btree_create(&lna.lna_tree, livelist_compare,
+	    sizeof (livelist_entry_t));
+	lna.lna_zthr = t;
+	lna.lna_cancelled = cancelled;
+
+	err = bpobj_iterate_range(bpo, 0, count, livelist_net_cb, &lna, NULL);
+
+	while ((le = zfs_btree_destroy_nodes(&lna.lna_tree, &cookie)) !=
+	    NULL) {
+		if (err == 0) {
+			boolean_t freed = (le->le_frees > le->le_allocs);
+			uint64_t n = freed ? le->le_frees - le->le_allocs :
+			    le->le_allocs - le->le_frees;
+
+			BP_SET_FREE(&le->le_bp, freed);
+			for (; n > 0; n--)
+				bplist_append(net, &le->le_bp);
+		}
+	}
+	zfs_btree_destroy(&lna.lna_tree);
+
+	return (err);
+}
+
+static int
+livelist_enqueue_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	bpobj_t *bpo = arg;
+
+	bpobj_enqueue(bpo, bp, BP_GET_FREE(bp), tx);
+	return (0);
+}
+
+/*
+ * Condense the livelist sublist with the given mintxg, whose first count
+ * entries were resolved into kept by dsl_livelist_net(): it is replaced by
+ * a new bpobj holding the kept entries followed by the entries appended to
+ * the sublist since.  Returns B_FALSE, changing nothing, if the sublist is
+ * gone or no longer stored in bpobj obj.
+ */
+boolean_t
+dsl_livelist_condense_entry(dsl_deadlist_t *ll, uint64_t mintxg, uint64_t obj,
+    uint64_t count, bplist_t *kept, dmu_tx_t *tx)
+{
+	dsl_deadlist_entry_t dle_tofind;
+	dsl_deadlist_entry_t *dle;
+	objset_t *os = ll->dl_os;
+	uint64_t used, comp, uncomp;
+	uint64_t newused, newcomp, newuncomp;
+	uint64_t newobj;
+	bpobj_t newbpo;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(!ll->dl_oldfmt);
+
+	mutex_enter(&ll->dl_lock);
+	dsl_deadlist_load_tree(ll);
+
+	dle_tofind.dle_mintxg = mintxg;
+	dle = avl_find(&ll->dl_tree, &dle_tofind, NULL);
+	if (dle == NULL || dle->dle_bpobj.bpo_object != obj ||
+	    dle->dle_bpobj.bpo_phys->bpo_num_blkptrs < count) {
+		mutex_exit(&ll->dl_lock);
+		return (B_FALSE);
+	}
+
+	newobj = bpobj_alloc(os, SPA_OLD_MAXBLOCKSIZE, tx);
+	VERIFY0(bpobj_open(&newbpo, os, newobj));
+	bplist_iterate(kept, livelist_enqueue_cb, &newbpo, tx);
+	VERIFY0(bpobj_iterate_range(&dle->dle_bpobj, count,
+	    dle->dle_bpobj.bpo_phys->bpo_num_blkptrs,
+	    livelist_enqueue_cb, &newbpo, tx));
+
+	VERIFY0(bpobj_space(&dle->dle_bpobj, &used, &comp, &uncomp));
+	VERIFY0(bpobj_space(&newbpo, &newused, &newcomp, &newuncomp));
+	bpobj_close(&newbpo);
+
+	dmu_buf_will_dirty(ll->dl_dbuf, tx);
+	ll->dl_phys->dl_used -= used - newused;
+	ll->dl_phys->dl_comp -= comp - newcomp;
+	ll->dl_phys->dl_uncomp -= uncomp - newuncomp;
+
+	bpobj_close(&dle->dle_bpobj);
+	bpobj_free(os, obj, tx);
+	VERIFY0(bpobj_open(&dle->dle_bpobj, os, newobj));
+	VERIFY0(zap_update_int_key(os, ll->dl_object, mintxg, newobj, tx));
+	mutex_exit(&ll->dl_lock);
+
+	return (B_TRUE);
+}
@@ -44,6 +44,50 @@
 #include <sys/dmu_impl.h>
 #include <sys/zvol.h>
 #include <sys/zcp.h>
+#include <sys/spa_impl.h>
+
+/*
+ * Snapshot destroy statistics, exported as the "destroy_snaps" kstat.
+ * A list of snapshots is destroyed by a single sync task, during which
+ * destroyed advances as each snapshot's deadlist has been merged and its
+ * objects freed.  Comparing snapshots, prefetched and destroyed shows the
+ * progress of a large destroy.
+ */
+typedef struct dsl_destroy_stats {
+	/* Calls to dsl_destroy_snapshots_nvl() */
+	kstat_named_t dds_requests;
+	/* Snapshots named in those calls */
+	kstat_named_t dds_snapshots;
+	/* Snapshots whose deadlists were prefetched */
+	kstat_named_t dds_prefetched;
+	/* Snapshots whose destroy completed in syncing context */
+	kstat_named_t dds_destroyed;
+} dsl_destroy_stats_t;
+
+static dsl_destroy_stats_t dsl_destroy_stats = {
+	{ "requests",			KSTAT_DATA_UINT64 },
+	{ "snapshots",			KSTAT_DATA_UINT64 },
+	{ "prefetched",			KSTAT_DATA_UINT64 },
+	{ "destroyed",			KSTAT_DATA_UINT64 },
+};
+
+#define	DDSTAT_INCR(stat, val) \
+	atomic_add_64(&dsl_destroy_stats.stat.value.ui64, (val))
+#define	DDSTAT_BUMP(stat)	DDSTAT_INCR(stat, 1)
+
+static kstat_t *dsl_destroy_ksp;
+
+/*
+ * Deadlist prefetch tasks of all destroy requests, one per filesystem.
+ */
+static taskq_t *dsl_destroy_prefetch_taskq;
+
+/*
+ * Before the sync task which destroys a list of snapshots runs, prefetch
+ * the deadlists it will merge, one task per filesystem.  Setting
+ * zfs_destroy_snaps_prefetch to 0 disables this.
+ */
+int zfs_destroy_snaps_prefetch = 1;
 
 int
 dsl_destroy_snapshot_check_impl(dsl_dataset_t *ds, boolean_t defer)
@@ -127,7 +171,7 @@ process_old_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 	ASSERT(!BP_IS_HOLE(bp));
 
 	if (bp->blk_birth <= dsl_dataset_phys(poa->ds)->ds_prev_snap_txg) {
-		dsl_deadlist_insert(&poa->ds->ds_deadlist, bp, tx);
+		dsl_deadlist_insert(&poa->ds->ds_deadlist, bp, B_FALSE, tx);
 		if (poa->ds_prev && !poa->after_branch_point &&
 		    bp->blk_birth >
 		    dsl_dataset_phys(poa->ds_prev)->ds_prev_snap_txg) {
@@ -520,6 +564,8 @@ dsl_destroy_snapshot_sync_impl(dsl_dataset_t *ds, boolean_t defer, dmu_tx_t *tx)
 	dsl_dir_rele(ds->ds_dir, ds);
 	ds->ds_dir = NULL;
 	dmu_object_free_zapified(mos, obj, tx);
+
+	DDSTAT_BUMP(dds_destroyed);
 }
 
 void
@@ -541,6 +587,167 @@ dsl_destroy_snapshot_sync(void *arg, dmu_tx_t *tx)
 	dsl_dataset_rele(ds, FTAG);
 }
 
+typedef struct dsl_destroy_prefetch {
+	kmutex_t	ddp_lock;
+	kcondvar_t	ddp_cv;
+	int		ddp_pending;	/* dispatched tasks still running */
+} dsl_destroy_prefetch_t;
+
+typedef struct dsl_destroy_prefetch_arg {
+	const char	**ddpa_snaps;	/* snapshots of one filesystem */
+	int		ddpa_count;
+	dsl_destroy_prefetch_t *ddpa_ddp;
+} dsl_destroy_prefetch_arg_t;
+
+static boolean_t
+dsl_destroy_snap_fsname(const char *snapname, char *fsname)
+{
+	const char *at = strchr(snapname, '@');
+
+	if (at == NULL || at - snapname >= ZFS_MAX_DATASET_NAME_LEN)
+		return (B_FALSE);
+	(void) strlcpy(fsname, snapname, at - snapname + 1);
+	return (B_TRUE);
+}
+
+/*
+ * Destroying a snapshot merges its deadlist into the next snapshot's (or
+ * the head's), and moves part of the next snapshot's deadlist to the
+ * snapshot's successor.  Read the metadata of both deadlists now, in
+ * parallel with the other filesystems, so that the sync task does not
+ * read it one block at a time.  Snapshots which cannot be held are left
+ * for the sync task to report.  The pool is held for one snapshot at a
+ * time, so that sync tasks are not held off for the whole prefetch.
+ */
+static void
+dsl_destroy_prefetch_fs(dsl_destroy_prefetch_arg_t *ddpa)
+{
+	for (int i = 0; i < ddpa->ddpa_count; i++) {
+		dsl_pool_t *dp;
+		dsl_dataset_t *ds, *ds_next;
+		uint64_t next_obj;
+
+		if (dsl_pool_hold(ddpa->ddpa_snaps[i], FTAG, &dp) != 0)
+			continue;
+		if (dsl_dataset_hold(dp, ddpa->ddpa_snaps[i], FTAG, &ds) != 0) {
+			dsl_pool_rele(dp, FTAG);
+			continue;
+		}
+		if (!ds->ds_is_snapshot) {
+			dsl_dataset_rele(ds, FTAG);
+			dsl_pool_rele(dp, FTAG);
+			continue;
+		}
+
+		dsl_deadlist_prefetch(&ds->ds_deadlist);
+		next_obj = dsl_dataset_phys(ds)->ds_next_snap_obj;
+		if (next_obj != 0 &&
+		    dsl_dataset_hold_obj(dp, next_obj, FTAG, &ds_next) == 0) {
+			dsl_deadlist_prefetch(&ds_next->ds_deadlist);
+			dsl_dataset_rele(ds_next, FTAG);
+		}
+		dsl_dataset_rele(ds, FTAG);
+		dsl_pool_rele(dp, FTAG);
+		DDSTAT_BUMP(dds_prefetched);
+	}
+}
+
+static void
+dsl_destroy_prefetch_task(void *arg)
+{
+	dsl_destroy_prefetch_arg_t *ddpa = arg;
+	dsl_destroy_prefetch_t *ddp = ddpa->ddpa_ddp;
+
+	dsl_destroy_prefetch_fs(ddpa);
+
+	mutex_enter(&ddp->ddp_lock);
+	if (--ddp->ddp_pending == 0)
+		cv_broadcast(&ddp->ddp_cv);
+	mutex_exit(&ddp->ddp_lock);
+}
+
+static void
+dsl_destroy_snapshots_prefetch(nvlist_t *snaps)
+{
+	char fsname[ZFS_MAX_DATASET_NAME_LEN];
+	dsl_destroy_prefetch_arg_t *ddpa;
+	nvlist_t *counts = fnvlist_alloc();
+	nvlist_t *groups = fnvlist_alloc();
+	dsl_destroy_prefetch_t ddp;
+	const char **names;
+	uint64_t count;
+	int nsnaps = 0, ngroups, i;
+
+	/* count the snapshots of each filesystem */
+	for (nvpair_t *pair = nvlist_next_nvpair(snaps, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(snaps, pair)) {
+		if (!dsl_destroy_snap_fsname(nvpair_name(pair), fsname))
+			continue;
+		if (nvlist_lookup_uint64(counts, fsname, &count) != 0)
+			count = 0;
+		fnvlist_add_uint64(counts, fsname, count + 1);
+		nsnaps++;
+	}
+
+	ngroups = fnvlist_num_pairs(counts);
+	if (ngroups == 0) {
+		fnvlist_free(groups);
+		fnvlist_free(counts);
+		return;
+	}
+
+	/* give each filesystem a slice of names[] */
+	names = vmem_alloc(nsnaps * sizeof (char *), KM_SLEEP);
+	ddpa = kmem_zalloc(ngroups * sizeof (*ddpa), KM_SLEEP);
+	i = 0;
+	nsnaps = 0;
+	for (nvpair_t *pair = nvlist_next_nvpair(counts, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(counts, pair)) {
+		ddpa[i].ddpa_snaps = names + nsnaps;
+		nsnaps += fnvpair_value_uint64(pair);
+		fnvlist_add_uint64(groups, nvpair_name(pair), i);
+		i++;
+	}
+	for (nvpair_t *pair = nvlist_next_nvpair(snaps, NULL);
+	    pair != NULL; pair = nvlist_next_nvpair(snaps, pair)) {
+		dsl_destroy_prefetch_arg_t *g;
+
+		if (!dsl_destroy_snap_fsname(nvpair_name(pair), fsname))
+			continue;
+		g = &ddpa[fnvlist_lookup_uint64(groups, fsname)];
+		g->ddpa_snaps[g->ddpa_count++] = nvpair_name(pair);
+	}
+	fnvlist_free(groups);
+	fnvlist_free(counts);
+
+	if (ngroups == 1 || dsl_destroy_prefetch_taskq == NULL) {
+		for (i = 0; i < ngroups; i++)
+			dsl_destroy_prefetch_fs(&ddpa[i]);
+		goto out;
+	}
+
+	mutex_init(&ddp.ddp_lock, NULL, MUTEX_DEFAULT, NULL);
+	cv_init(&ddp.ddp_cv, NULL, CV_DEFAULT, NULL);
+	ddp.ddp_pending = ngroups;
+	for (i = 0; i < ngroups; i++) {
+		ddpa[i].ddpa_ddp = &ddp;
+		if (taskq_dispatch(dsl_destroy_prefetch_taskq,
+		    dsl_destroy_prefetch_task, &ddpa[i], TQ_SLEEP) ==
+		    TASKQID_INVALID)
+			dsl_destroy_prefetch_task(&ddpa[i]);
+	}
+
+	mutex_enter(&ddp.ddp_lock);
+	while (ddp.ddp_pending != 0)
+		cv_wait(&ddp.ddp_cv, &ddp.ddp_lock);
+	mutex_exit(&ddp.ddp_lock);
+	cv_destroy(&ddp.ddp_cv);
+	mutex_destroy(&ddp.ddp_lock);
+out:
+	kmem_free(ddpa, ngroups * sizeof (*ddpa));
+	vmem_free(names, nsnaps * sizeof (char *));
+}
+
 /*
  * The semantics of this function are described in the comment above
  * lzc_destroy_snaps().  To summarize:
@@ -561,6 +768,11 @@ dsl_destroy_snapshots_nvl(nvlist_t *snaps, boolean_t defer,
 	if (nvlist_next_nvpair(snaps, NULL) == NULL)
 		return (0);
 
+	DDSTAT_BUMP(dds_requests);
+	DDSTAT_INCR(dds_snapshots, fnvlist_num_pairs(snaps));
+	if (zfs_destroy_snaps_prefetch)
+		dsl_destroy_snapshots_prefetch(snaps);
+
 	/*
 	 * lzc_destroy_snaps() is documented to take an nvlist whose
 	 * values "don't matter".  We need to convert that nvlist to
@@ -825,6 +1037,47 @@ dsl_dir_destroy_sync(uint64_t ddobj, dmu_tx_t *tx)
 	dmu_object_free_zapified(mos, ddobj, tx);
 }
 
+/*
+ * Destroy a clone which has a livelist: the livelist is handed to the
+ * livelist delete zthr (see spa.c), which frees the blocks only the clone
+ * references without traversing it.
+ */
+static void
+dsl_async_clone_destroy(dsl_dataset_t *ds, dmu_tx_t *tx)
+{
+	dsl_dir_t *dd = ds->ds_dir;
+	dsl_pool_t *dp = dd->dd_pool;
+	spa_t *spa = dp->dp_spa;
+	objset_t *mos = dp->dp_meta_objset;
+	uint64_t used, comp, uncomp;
+	uint64_t obj;
+
+	obj = dsl_dir_detach_livelist(dd, tx);
+
+	if (spa->spa_livelists_to_delete == 0) {
+		spa->spa_livelists_to_delete = zap_create(mos,
+		    DMU_OTN_ZAP_METADATA, DMU_OT_NONE, 0, tx);
+		VERIFY0(zap_add(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DELETED_CLONES, sizeof (uint64_t), 1,
+		    &spa->spa_livelists_to_delete, tx));
+	}
+	VERIFY0(zap_add_int(mos, spa->spa_livelists_to_delete, obj, tx));
+
+	used = dsl_dir_phys(dd)->dd_used_bytes;
+	comp = dsl_dir_phys(dd)->dd_compressed_bytes;
+	uncomp = dsl_dir_phys(dd)->dd_uncompressed_bytes;
+
+	ASSERT(!DS_UNIQUE_IS_ACCURATE(ds) ||
+	    dsl_dataset_phys(ds)->ds_unique_bytes == used);
+
+	dsl_dir_diduse_space(dd, DD_USED_HEAD, -used, -comp, -uncomp, tx);
+	dsl_dir_diduse_space(dp->dp_free_dir, DD_USED_HEAD,
+	    used, comp, uncomp, tx);
+
+	if (spa->spa_livelist_delete_zthr != NULL)
+		zthr_wakeup(spa->spa_livelist_delete_zthr);
+}
+
 void
 dsl_destroy_head_sync_impl(dsl_dataset_t *ds, dmu_tx_t *tx)
 {
@@ -901,7 +1154,11 @@ dsl_destroy_head_sync_impl(dsl_dataset_t *ds, dmu_tx_t *tx)
 	VERIFY0(dmu_objset_from_ds(ds, &os));
 
 	if (!spa_feature_is_enabled(dp->dp_spa, SPA_FEATURE_ASYNC_DESTROY)) {
+		dsl_dir_remove_livelist(ds->ds_dir, tx);
 		old_synchronous_dataset_destroy(ds, tx);
+	} else if (dsl_deadlist_is_open(&ds->ds_dir->dd_livelist)) {
+		zil_destroy_sync(dmu_objset_zil(os), tx);
+		dsl_async_clone_destroy(ds, tx);
 	} else {
 		/*
 		 * Move the bptree into the pool's list of trees to
@@ -1110,6 +1367,37 @@ dsl_destroy_inconsistent(const char *dsname, void *arg)
 	return (0);
 }
 
+void
+dsl_destroy_init(void)
+{
+	dsl_destroy_prefetch_taskq = taskq_create("z_destroy_prefetch",
+	    max_ncpus, defclsyspri, max_ncpus, INT_MAX,
+	    TASKQ_PREPOPULATE | TASKQ_DYNAMIC);
+
+	dsl_destroy_ksp = kstat_create("zfs", 0, "destroy_snaps", "misc",
+	    KSTAT_TYPE_NAMED,
+	    sizeof (dsl_destroy_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	if (dsl_destroy_ksp != NULL) {
+		dsl_destroy_ksp->ks_data = &dsl_destroy_stats;
+		kstat_install(dsl_destroy_ksp);
+	}
+}
+
+void
+dsl_destroy_fini(void)
+{
+	if (dsl_destroy_ksp != NULL) {
+		kstat_delete(dsl_destroy_ksp);
+		dsl_destroy_ksp = NULL;
+	}
+
+	if (dsl_destroy_prefetch_taskq != NULL) {
+		taskq_destroy(dsl_destroy_prefetch_taskq);
+		dsl_destroy_prefetch_taskq = NULL;
+	}
+}
 
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dsl_destroy_head);
@@ -1119,4 +1407,10 @@ EXPORT_SYMBOL(dsl_destroy_snapshot_sync_impl);
 EXPORT_SYMBOL(dsl_destroy_inconsistent);
 EXPORT_SYMBOL(dsl_dataset_user_release_tmp);
 EXPORT_SYMBOL(dsl_destroy_head_check_impl);
+
+/* BEGIN CSTYLED */
+module_param(zfs_destroy_snaps_prefetch, int, 0644);
+MODULE_PARM_DESC(zfs_destroy_snaps_prefetch,
+	"Prefetch deadlists before destroying snapshots");
+/* END CSTYLED */
 #endif
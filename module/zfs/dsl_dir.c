@@ -135,6 +135,31 @@ typedef struct ddulrt_arg {
 	uint64_t	ddlrta_txg;
 } ddulrt_arg_t;
 
+static void
+dsl_dir_livelist_open(dsl_dir_t *dd, uint64_t obj)
+{
+	objset_t *mos = dd->dd_pool->dp_meta_objset;
+
+	ASSERT(spa_feature_is_active(dd->dd_pool->dp_spa,
+	    SPA_FEATURE_LIVELIST));
+	dsl_deadlist_open(&dd->dd_livelist, mos, obj);
+	bplist_create(&dd->dd_pending_allocs);
+	bplist_create(&dd->dd_pending_frees);
+}
+
+static void
+dsl_dir_livelist_close(dsl_dir_t *dd)
+{
+	if (!dsl_deadlist_is_open(&dd->dd_livelist))
+		return;
+
+	dsl_deadlist_close(&dd->dd_livelist);
+	bplist_clear(&dd->dd_pending_allocs);
+	bplist_clear(&dd->dd_pending_frees);
+	bplist_destroy(&dd->dd_pending_allocs);
+	bplist_destroy(&dd->dd_pending_frees);
+}
+
 static void
 dsl_dir_evict_async(void *dbu)
 {
@@ -155,6 +180,7 @@ dsl_dir_evict_async(void *dbu)
 
 	spa_async_close(dd->dd_pool->dp_spa, dd);
 
+	dsl_dir_livelist_close(dd);
 	dsl_prop_fini(dd);
 	mutex_destroy(&dd->dd_lock);
 	kmem_free(dd, sizeof (dsl_dir_t));
@@ -202,6 +228,17 @@ dsl_dir_hold_obj(dsl_pool_t *dp, uint64_t ddobj,
 			}
 		}
 
+		if (dsl_dir_is_zapified(dd)) {
+			uint64_t obj;
+
+			err = zap_lookup(dp->dp_meta_objset, ddobj,
+			    DD_FIELD_LIVELIST, sizeof (uint64_t), 1, &obj);
+			if (err == 0)
+				dsl_dir_livelist_open(dd, obj);
+			else if (err != ENOENT)
+				goto errout;
+		}
+
 		mutex_init(&dd->dd_lock, NULL, MUTEX_DEFAULT, NULL);
 		dsl_prop_init(dd);
 
@@ -263,6 +300,7 @@ dsl_dir_hold_obj(dsl_pool_t *dp, uint64_t ddobj,
 		if (winner != NULL) {
 			if (dd->dd_parent)
 				dsl_dir_rele(dd->dd_parent, dd);
+			dsl_dir_livelist_close(dd);
 			dsl_prop_fini(dd);
 			mutex_destroy(&dd->dd_lock);
 			kmem_free(dd, sizeof (dsl_dir_t));
@@ -291,6 +329,7 @@ dsl_dir_hold_obj(dsl_pool_t *dp, uint64_t ddobj,
 errout:
 	if (dd->dd_parent)
 		dsl_dir_rele(dd->dd_parent, dd);
+	dsl_dir_livelist_close(dd);
 	dsl_prop_fini(dd);
 	mutex_destroy(&dd->dd_lock);
 	kmem_free(dd, sizeof (dsl_dir_t));
@@ -2224,6 +2263,71 @@ dsl_dir_is_zapified(dsl_dir_t *dd)
 	return (doi.doi_type == DMU_OTN_ZAP_METADATA);
 }
 
+/*
+ * Give a newly created clone a livelist, whose first sublist holds the
+ * blocks born after mintxg, the txg of its origin.
+ */
+void
+dsl_dir_create_livelist(dsl_dir_t *dd, uint64_t mintxg, dmu_tx_t *tx)
+{
+	objset_t *mos = dd->dd_pool->dp_meta_objset;
+	uint64_t obj;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(!dsl_deadlist_is_open(&dd->dd_livelist));
+
+	obj = dsl_deadlist_alloc(mos, tx);
+	dsl_dir_zapify(dd, tx);
+	VERIFY0(zap_add(mos, dd->dd_object, DD_FIELD_LIVELIST,
+	    sizeof (uint64_t), 1, &obj, tx));
+	spa_feature_incr(dd->dd_pool->dp_spa, SPA_FEATURE_LIVELIST, tx);
+
+	dsl_dir_livelist_open(dd, obj);
+	dsl_deadlist_add_key(&dd->dd_livelist, mintxg, tx);
+}
+
+/*
+ * Stop tracking the clone's blocks in a livelist, and return the livelist's
+ * object, which the caller is now responsible for.
+ */
+uint64_t
+dsl_dir_detach_livelist(dsl_dir_t *dd, dmu_tx_t *tx)
+{
+	objset_t *mos = dd->dd_pool->dp_meta_objset;
+	uint64_t obj = dd->dd_livelist.dl_object;
+
+	ASSERT(dmu_tx_is_syncing(tx));
+	ASSERT(dsl_deadlist_is_open(&dd->dd_livelist));
+
+	spa_livelist_condense_cancel(dd->dd_pool->dp_spa, dd->dd_object);
+	dsl_dir_livelist_close(dd);
+	mutex_enter(&dd->dd_lock);
+	dd->dd_livelist_remapped = B_FALSE;
+	mutex_exit(&dd->dd_lock);
+	VERIFY0(zap_remove(mos, dd->dd_object, DD_FIELD_LIVELIST, tx));
+
+	return (obj);
+}
+
+/*
+ * Free the clone's livelist, if it has one.  Called when the livelist can
+ * no longer describe the blocks which only the clone references, e.g. once
+ * it has been snapshotted; the clone will be destroyed by traversing it.
+ */
+void
+dsl_dir_remove_livelist(dsl_dir_t *dd, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = dd->dd_pool;
+	uint64_t obj;
+
+	if (!dsl_deadlist_is_open(&dd->dd_livelist))
+		return;
+
+	obj = dsl_dir_detach_livelist(dd, tx);
+	dsl_deadlist_free(dp->dp_meta_objset, obj, tx);
+	spa_feature_decr(dp->dp_spa, SPA_FEATURE_LIVELIST, tx);
+}
+
 #if defined(_KERNEL)
 EXPORT_SYMBOL(dsl_dir_set_quota);
 EXPORT_SYMBOL(dsl_dir_set_reservation);
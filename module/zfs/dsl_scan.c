@@ -36,6 +36,7 @@
 #include <sys/dmu_tx.h>
 #include <sys/dmu_objset.h>
 #include <sys/arc.h>
+#include <sys/dbuf.h>
 #include <sys/zap.h>
 #include <sys/zio.h>
 #include <sys/zfs_context.h>
@@ -126,6 +127,7 @@ static void scan_ds_queue_insert(dsl_scan_t *scn, uint64_t dsobj, uint64_t txg);
 static void scan_ds_queue_remove(dsl_scan_t *scn, uint64_t dsobj);
 static void scan_ds_queue_sync(dsl_scan_t *scn, dmu_tx_t *tx);
 static uint64_t dsl_scan_count_leaves(vdev_t *vd);
+static void dsl_scan_errorscrub_visit(dsl_scan_t *scn, dmu_tx_t *tx);
 
 extern int zfs_vdev_async_write_active_min_dirty_percent;
 
@@ -195,7 +197,11 @@ int zfs_resilver_disable_defer = 0; /* set to disable resilver deferring */
 
 #define	DSL_SCAN_IS_SCRUB_RESILVER(scn) \
 	((scn)->scn_phys.scn_func == POOL_SCAN_SCRUB || \
-	(scn)->scn_phys.scn_func == POOL_SCAN_RESILVER)
+	(scn)->scn_phys.scn_func == POOL_SCAN_RESILVER || \
+	(scn)->scn_phys.scn_func == POOL_SCAN_ERRORSCRUB)
+
+#define	DSL_SCAN_IS_ERRORSCRUB(scn) \
+	((scn)->scn_phys.scn_func == POOL_SCAN_ERRORSCRUB)
 
 /*
  * Enable/disable the processing of the free_bpobj object.
@@ -207,6 +213,7 @@ static scan_cb_t *scan_funcs[POOL_SCAN_FUNCS] = {
 	NULL,
 	dsl_scan_scrub_cb,	/* POOL_SCAN_SCRUB */
 	dsl_scan_scrub_cb,	/* POOL_SCAN_RESILVER */
+	dsl_scan_scrub_cb,	/* POOL_SCAN_ERRORSCRUB */
 };
 
 /* In core node for the scn->scn_queue. Represents a dataset to be scanned */
@@ -606,7 +613,8 @@ dsl_scan_scrubbing(const dsl_pool_t *dp)
 	dsl_scan_phys_t *scn_phys = &dp->dp_scan->scn_phys;
 
 	return (scn_phys->scn_state == DSS_SCANNING &&
-	    scn_phys->scn_func == POOL_SCAN_SCRUB);
+	    (scn_phys->scn_func == POOL_SCAN_SCRUB ||
+	    scn_phys->scn_func == POOL_SCAN_ERRORSCRUB));
 }
 
 boolean_t
@@ -688,10 +696,16 @@ static int
 dsl_scan_setup_check(void *arg, dmu_tx_t *tx)
 {
 	dsl_scan_t *scn = dmu_tx_pool(tx)->dp_scan;
+	pool_scan_func_t *funcp = arg;
 
 	if (dsl_scan_is_running(scn))
 		return (SET_ERROR(EBUSY));
 
+	if (*funcp == POOL_SCAN_ERRORSCRUB &&
+	    !spa_feature_is_enabled(dmu_tx_pool(tx)->dp_spa,
+	    SPA_FEATURE_ERROR_SCRUB))
+		return (SET_ERROR(ENOTSUP));
+
 	return (0);
 }
 
@@ -722,7 +736,23 @@ dsl_scan_setup_sync(void *arg, dmu_tx_t *tx)
 	scn->scn_checkpointing = B_FALSE;
 	spa_scan_stat_init(spa);
 
-	if (DSL_SCAN_IS_SCRUB_RESILVER(scn)) {
+	if (DSL_SCAN_IS_ERRORSCRUB(scn)) {
+		/*
+		 * An error scrub only visits the blocks named in the
+		 * persistent error log, so there is no DDT phase and the
+		 * amount of work is discovered as the log is walked.
+		 */
+		scn->scn_phys.scn_ddt_class_max = 0;
+		scn->scn_phys.scn_ddt_bookmark.ddb_class = DDT_CLASSES;
+		scn->scn_phys.scn_to_examine = 0;
+
+		/* older software must not find this scn_func on disk */
+		if (!spa_feature_is_active(spa, SPA_FEATURE_ERROR_SCRUB))
+			spa_feature_incr(spa, SPA_FEATURE_ERROR_SCRUB, tx);
+
+		spa_event_notify(spa, NULL, NULL, ESC_ZFS_SCRUB_START);
+		spa->spa_scrub_started = B_TRUE;
+	} else if (DSL_SCAN_IS_SCRUB_RESILVER(scn)) {
 		scn->scn_phys.scn_ddt_class_max = zfs_scrub_ddt_class_max;
 
 		/* rewrite all disk labels */
@@ -800,7 +830,8 @@ dsl_scan(dsl_pool_t *dp, pool_scan_func_t func)
 		return (0);
 	}
 
-	if (func == POOL_SCAN_SCRUB && dsl_scan_is_paused_scrub(scn)) {
+	if ((func == POOL_SCAN_SCRUB || func == POOL_SCAN_ERRORSCRUB) &&
+	    dsl_scan_is_paused_scrub(scn) && scn->scn_phys.scn_func == func) {
 		/* got scrub start cmd, resume paused scrub */
 		int err = dsl_scrub_set_pause_resume(scn->scn_dp,
 		    POOL_SCRUB_NORMAL);
@@ -896,8 +927,11 @@ dsl_scan_done(dsl_scan_t *scn, boolean_t complete, dmu_tx_t *tx)
 		 * data that have been freed but are part of a checkpoint,
 		 * we don't mark the scrub as done in the DTLs as faults
 		 * may still exist in those vdevs.
+		 *
+		 * An error scrub only reads the blocks in the error log,
+		 * so it can never vouch for the contents of the DTLs.
 		 */
-		if (complete &&
+		if (complete && !DSL_SCAN_IS_ERRORSCRUB(scn) &&
 		    !spa_feature_is_active(spa, SPA_FEATURE_POOL_CHECKPOINT)) {
 			vdev_dtl_reassess(spa->spa_root_vdev, tx->tx_txg,
 			    scn->scn_phys.scn_max_txg, B_TRUE);
@@ -909,7 +943,17 @@ dsl_scan_done(dsl_scan_t *scn, boolean_t complete, dmu_tx_t *tx)
 			vdev_dtl_reassess(spa->spa_root_vdev, tx->tx_txg,
 			    0, B_TRUE);
 		}
-		spa_errlog_rotate(spa);
+
+		/*
+		 * A cancelled error scrub has not visited every entry of
+		 * the error log, so keep the log as it is rather than
+		 * replacing it with the errors found so far.
+		 */
+		if (complete || !DSL_SCAN_IS_ERRORSCRUB(scn))
+			spa_errlog_rotate(spa);
+		if (DSL_SCAN_IS_ERRORSCRUB(scn) &&
+		    spa_feature_is_active(spa, SPA_FEATURE_ERROR_SCRUB))
+			spa_feature_decr(spa, SPA_FEATURE_ERROR_SCRUB, tx);
 
 		/*
 		 * We may have finished replacing a device.
@@ -2034,7 +2078,7 @@ dsl_scan_ds_destroyed(dsl_dataset_t *ds, dmu_tx_t *tx)
 	dsl_scan_t *scn = dp->dp_scan;
 	uint64_t mintxg;
 
-	if (!dsl_scan_is_running(scn))
+	if (!dsl_scan_is_running(scn) || DSL_SCAN_IS_ERRORSCRUB(scn))
 		return;
 
 	ds_destroyed_scn_phys(ds, &scn->scn_phys);
@@ -2106,7 +2150,7 @@ dsl_scan_ds_snapshotted(dsl_dataset_t *ds, dmu_tx_t *tx)
 	dsl_scan_t *scn = dp->dp_scan;
 	uint64_t mintxg;
 
-	if (!dsl_scan_is_running(scn))
+	if (!dsl_scan_is_running(scn) || DSL_SCAN_IS_ERRORSCRUB(scn))
 		return;
 
 	ASSERT(dsl_dataset_phys(ds)->ds_prev_snap_obj != 0);
@@ -2168,7 +2212,7 @@ dsl_scan_ds_clone_swapped(dsl_dataset_t *ds1, dsl_dataset_t *ds2, dmu_tx_t *tx)
 	uint64_t mintxg1, mintxg2;
 	boolean_t ds1_queued, ds2_queued;
 
-	if (!dsl_scan_is_running(scn))
+	if (!dsl_scan_is_running(scn) || DSL_SCAN_IS_ERRORSCRUB(scn))
 		return;
 
 	ds_clone_swapped_bookmark(ds1, ds2, &scn->scn_phys.scn_bookmark);
@@ -2693,6 +2737,127 @@ dsl_scan_visit(dsl_scan_t *scn, dmu_tx_t *tx)
 	ASSERT0(scn->scn_suspending);
 }
 
+/*
+ * Resolve a bookmark from the persistent error log to the block pointer
+ * that currently describes it.  Returns ENOENT if the dataset, object or
+ * block no longer exists, in which case the error is simply dropped.
+ */
+static int
+dsl_scan_errorscrub_findbp(dsl_scan_t *scn, const zbookmark_phys_t *zb,
+    blkptr_t *bp)
+{
+	dsl_pool_t *dp = scn->scn_dp;
+	dsl_dataset_t *ds = NULL;
+	objset_t *os;
+	dnode_t *dn;
+	int err;
+
+	if (zb->zb_objset == DMU_META_OBJSET) {
+		os = dp->dp_meta_objset;
+	} else {
+		err = dsl_dataset_hold_obj(dp, zb->zb_objset, FTAG, &ds);
+		if (err != 0)
+			return (err);
+		err = dmu_objset_from_ds(ds, &os);
+		if (err != 0) {
+			dsl_dataset_rele(ds, FTAG);
+			return (err);
+		}
+	}
+
+	if (zb->zb_object == ZB_ROOT_OBJECT && zb->zb_level == ZB_ROOT_LEVEL) {
+		/* the objset block itself */
+		*bp = *os->os_rootbp;
+		err = BP_IS_HOLE(bp) ? SET_ERROR(ENOENT) : 0;
+	} else if (zb->zb_level < 0) {
+		/* intent log blocks cannot be looked up by bookmark */
+		err = SET_ERROR(ENOTSUP);
+	} else {
+		err = dnode_hold(os, zb->zb_object, FTAG, &dn);
+		if (err == 0) {
+			rw_enter(&dn->dn_struct_rwlock, RW_READER);
+			err = dbuf_dnode_findbp(dn, zb->zb_level,
+			    zb->zb_blkid, bp, NULL, NULL);
+			rw_exit(&dn->dn_struct_rwlock);
+			dnode_rele(dn, FTAG);
+
+			if (err == 0 && BP_IS_HOLE(bp))
+				err = SET_ERROR(ENOENT);
+		}
+	}
+
+	if (ds != NULL)
+		dsl_dataset_rele(ds, FTAG);
+
+	return (err);
+}
+
+/*
+ * Walk the persistent error log and scrub just the blocks it names.
+ * Entries are visited in bookmark order so that scn_bookmark can be used
+ * to resume a suspended or paused error scrub.  Any block that is still
+ * damaged will be logged again by the scrub zio, so when the scan
+ * completes and the error log is rotated only the errors which could not
+ * be repaired remain.
+ */
+static void
+dsl_scan_errorscrub_visit(dsl_scan_t *scn, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = scn->scn_dp;
+	spa_t *spa = dp->dp_spa;
+	zbookmark_phys_t resume = scn->scn_phys.scn_bookmark;
+	spa_error_entry_t *se, search;
+	avl_tree_t errors;
+	avl_index_t where;
+	void *cookie = NULL;
+
+	bzero(&scn->scn_phys.scn_bookmark, sizeof (zbookmark_phys_t));
+	spa_get_errlog_entries(spa, &errors);
+
+	search.se_bookmark = resume;
+	if (ZB_IS_ZERO(&resume))
+		se = avl_first(&errors);
+	else if ((se = avl_find(&errors, &search, &where)) == NULL)
+		se = avl_nearest(&errors, where, AVL_AFTER);
+
+	for (; se != NULL; se = AVL_NEXT(&errors, se)) {
+		zbookmark_phys_t *zb = &se->se_bookmark;
+		blkptr_t bp;
+		int err;
+
+		if (dsl_scan_check_suspend(scn, NULL)) {
+			scn->scn_phys.scn_bookmark = *zb;
+			break;
+		}
+
+		err = dsl_scan_errorscrub_findbp(scn, zb, &bp);
+		if (err == ENOENT || err == ENXIO) {
+			/* the damaged block has since been freed */
+			continue;
+		} else if (err != 0) {
+			/*
+			 * We could not get at the block, either because a
+			 * parent is itself damaged or because this kind of
+			 * block can't be resolved from a bookmark.  Keep
+			 * the entry so the error is not silently forgotten.
+			 */
+			spa_log_error(spa, zb);
+			continue;
+		}
+
+		if (BP_IS_EMBEDDED(&bp))
+			continue;
+
+		scn->scn_visited_this_txg++;
+		scn->scn_phys.scn_to_examine += BP_GET_ASIZE(&bp);
+		scan_funcs[scn->scn_phys.scn_func](dp, &bp, zb);
+	}
+
+	while ((se = avl_destroy_nodes(&errors, &cookie)) != NULL)
+		kmem_free(se, sizeof (spa_error_entry_t));
+	avl_destroy(&errors);
+}
+
 static uint64_t
 dsl_scan_count_leaves(vdev_t *vd)
 {
@@ -3367,8 +3532,12 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 	}
 	if (err != 0)
 		return (err);
+	/*
+	 * The blocks of destroyed clones with livelists are accounted to
+	 * dp_free_dir until the livelist delete zthr has freed them.
+	 */
 	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying &&
-	    zfs_free_leak_on_eio &&
+	    !spa_livelist_delete_check(spa) && zfs_free_leak_on_eio &&
 	    (dsl_dir_phys(dp->dp_free_dir)->dd_used_bytes != 0 ||
 	    dsl_dir_phys(dp->dp_free_dir)->dd_compressed_bytes != 0 ||
 	    dsl_dir_phys(dp->dp_free_dir)->dd_uncompressed_bytes != 0)) {
@@ -3395,7 +3564,8 @@ dsl_process_async_destroys(dsl_pool_t *dp, dmu_tx_t *tx)
 		    -dsl_dir_phys(dp->dp_free_dir)->dd_uncompressed_bytes, tx);
 	}
 
-	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying) {
+	if (dp->dp_free_dir != NULL && !scn->scn_async_destroying &&
+	    !spa_livelist_delete_check(spa)) {
 		/* finished; verify that space accounting went to zero */
 		ASSERT0(dsl_dir_phys(dp->dp_free_dir)->dd_used_bytes);
 		ASSERT0(dsl_dir_phys(dp->dp_free_dir)->dd_compressed_bytes);
@@ -3632,7 +3802,10 @@ dsl_scan_sync(dsl_pool_t *dp, dmu_tx_t *tx)
 		ASSERT(prefetch_tqid != TASKQID_INVALID);
 
 		dsl_pool_config_enter(dp, FTAG);
-		dsl_scan_visit(scn, tx);
+		if (DSL_SCAN_IS_ERRORSCRUB(scn))
+			dsl_scan_errorscrub_visit(scn, tx);
+		else
+			dsl_scan_visit(scn, tx);
 		dsl_pool_config_exit(dp, FTAG);
 
 		mutex_enter(&dp->dp_spa->spa_scrub_lock);
@@ -3893,7 +4066,8 @@ dsl_scan_scrub_cb(dsl_pool_t *dp,
 	ASSERT(!BP_IS_EMBEDDED(bp));
 
 	ASSERT(DSL_SCAN_IS_SCRUB_RESILVER(scn));
-	if (scn->scn_phys.scn_func == POOL_SCAN_SCRUB) {
+	if (scn->scn_phys.scn_func == POOL_SCAN_SCRUB ||
+	    scn->scn_phys.scn_func == POOL_SCAN_ERRORSCRUB) {
 		zio_flags |= ZIO_FLAG_SCRUB;
 		needs_io = B_TRUE;
 	} else {
@@ -29,7 +29,7 @@
 #include <sys/debug.h>
 #include <sys/types.h>
 #include <sys/strings.h>
-#include "qat.h"
+#include <sys/abd.h>
 
 #ifdef _KERNEL
 
@@ -37,6 +37,12 @@
 typedef size_t zlen_t;
 #define	compress_func	z_compress_level
 #define	uncompress_func	z_uncompress
+#define	deflate_init_func	z_deflate_init
+#define	deflate_func		zlib_deflate
+#define	deflate_end_func	z_deflate_end
+#define	inflate_init_func	z_inflate_init
+#define	inflate_func		zlib_inflate
+#define	inflate_end_func	z_inflate_end
 
 #else /* _KERNEL */
 
@@ -44,33 +50,22 @@ typedef size_t zlen_t;
 typedef uLongf zlen_t;
 #define	compress_func	compress2
 #define	uncompress_func	uncompress
+#define	deflate_init_func	deflateInit
+#define	deflate_func		deflate
+#define	deflate_end_func	deflateEnd
+#define	inflate_init_func	inflateInit
+#define	inflate_func		inflate
+#define	inflate_end_func	inflateEnd
 
 #endif
 
 size_t
 gzip_compress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n)
 {
-	int ret;
 	zlen_t dstlen = d_len;
 
 	ASSERT(d_len <= s_len);
 
-	/* check if hardware accelerator can be used */
-	if (qat_dc_use_accel(s_len)) {
-		ret = qat_compress(QAT_COMPRESS, s_start, s_len, d_start,
-		    d_len, &dstlen);
-		if (ret == CPA_STATUS_SUCCESS) {
-			return ((size_t)dstlen);
-		} else if (ret == CPA_STATUS_INCOMPRESSIBLE) {
-			if (d_len != s_len)
-				return (s_len);
-
-			bcopy(s_start, d_start, s_len);
-			return (s_len);
-		}
-		/* if hardware compression fails, do it again with software */
-	}
-
 	if (compress_func(d_start, &dstlen, s_start, s_len, n) != Z_OK) {
 		if (d_len != s_len)
 			return (s_len);
@@ -90,16 +85,100 @@ gzip_decompress(void *s_start, void *d_start, size_t s_len, size_t d_len, int n)
 
 	ASSERT(d_len >= s_len);
 
-	/* check if hardware accelerator can be used */
-	if (qat_dc_use_accel(d_len)) {
-		if (qat_compress(QAT_DECOMPRESS, s_start, s_len,
-		    d_start, d_len, &dstlen) == CPA_STATUS_SUCCESS)
-			return (0);
-		/* if hardware de-compress fail, do it again with software */
-	}
-
 	if (uncompress_func(d_start, &dstlen, s_start, s_len) != Z_OK)
 		return (-1);
 
 	return (0);
 }
+
+/*
+ * The ABD variants stream the chunks of a scatter ABD through zlib rather
+ * than copying them to a linear buffer first.  zlib's output does not
+ * depend on how its input is divided, so the compressed data is identical
+ * to that produced by gzip_compress() for the same contents.
+ */
+static int
+gzip_compress_abd_cb(void *buf, size_t len, void *private)
+{
+	z_stream *stream = private;
+
+	stream->next_in = buf;
+	stream->avail_in = len;
+
+	/* All input is consumed unless the output buffer is full */
+	if (deflate_func(stream, Z_NO_FLUSH) != Z_OK || stream->avail_in != 0)
+		return (1);
+
+	return (0);
+}
+
+size_t
+gzip_compress_abd(abd_t *src, void *d_start, size_t s_len, size_t d_len,
+    int n)
+{
+	z_stream stream;
+	size_t c_len = s_len;
+
+	ASSERT(d_len <= s_len);
+
+	bzero(&stream, sizeof (stream));
+	if (deflate_init_func(&stream, n) == Z_OK) {
+		stream.next_out = d_start;
+		stream.avail_out = d_len;
+
+		if (abd_iterate_func(src, 0, s_len, gzip_compress_abd_cb,
+		    &stream) == 0 &&
+		    deflate_func(&stream, Z_FINISH) == Z_STREAM_END)
+			c_len = stream.total_out;
+
+		(void) deflate_end_func(&stream);
+	}
+
+	if (c_len == s_len && d_len == s_len)
+		abd_copy_to_buf(d_start, src, s_len);
+
+	return (c_len);
+}
+
+static int
+gzip_decompress_abd_cb(void *buf, size_t len, void *private)
+{
+	z_stream *stream = private;
+	int err;
+
+	stream->next_in = buf;
+	stream->avail_in = len;
+
+	/*
+	 * Returns Z_STREAM_END to stop the iteration once the end of the
+	 * stream is reached, any trailing padding is ignored.
+	 */
+	err = inflate_func(stream, Z_NO_FLUSH);
+	if (err == Z_OK && stream->avail_in != 0)
+		err = Z_BUF_ERROR;
+
+	return (err);
+}
+
+/*ARGSUSED*/
+int
+gzip_decompress_abd(abd_t *src, void *d_start, size_t s_len, size_t d_len,
+    int n)
+{
+	z_stream stream;
+	int err;
+
+	ASSERT(d_len >= s_len);
+
+	bzero(&stream, sizeof (stream));
+	if (inflate_init_func(&stream) != Z_OK)
+		return (-1);
+
+	stream.next_out = d_start;
+	stream.avail_out = d_len;
+
+	err = abd_iterate_func(src, 0, s_len, gzip_decompress_abd_cb, &stream);
+	(void) inflate_end_func(&stream);
+
+	return (err == Z_STREAM_END ? 0 : -1);
+}
@@ -33,6 +33,7 @@
  */
 
 #include <sys/zfs_context.h>
+#include <sys/lz4_impl.h>
 
 static int real_LZ4_compress(const char *source, char *dest, int isize,
     int osize);
@@ -89,8 +90,8 @@ lz4_decompress_zfs(void *s_start, void *d_start, size_t s_len,
 	 * Returns 0 on success (decompression function returned non-negative)
 	 * and non-zero on failure (decompression function returned negative).
 	 */
-	return (LZ4_uncompress_unknownOutputSize(&src[sizeof (bufsiz)],
-	    d_start, bufsiz, d_len) < 0);
+	return (lz4_decompress_impl_get(d_len)->decompress(
+	    &src[sizeof (bufsiz)], d_start, bufsiz, d_len) < 0);
 }
 
 /*
@@ -1013,16 +1014,31 @@ LZ4_uncompress_unknownOutputSize(const char *source, char *dest, int isize,
 	return (-1);
 }
 
+static boolean_t
+lz4_decompress_scalar_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const lz4_decompress_ops_t lz4_decompress_scalar_ops = {
+	.decompress = LZ4_uncompress_unknownOutputSize,
+	.is_supported = lz4_decompress_scalar_will_work,
+	.uses_fpu = B_FALSE,
+	.name = "scalar"
+};
+
 void
 lz4_init(void)
 {
 	lz4_cache = kmem_cache_create("lz4_cache",
 	    sizeof (struct refTables), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	lz4_decompress_impl_init();
 }
 
 void
 lz4_fini(void)
 {
+	lz4_decompress_impl_fini();
 	if (lz4_cache) {
 		kmem_cache_destroy(lz4_cache);
 		lz4_cache = NULL;
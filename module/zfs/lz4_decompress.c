@@ -0,0 +1,470 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Selection of the lz4 decompression implementation.
+ *
+ * Every implementation decodes blocks exactly like the original "scalar"
+ * decoder in lz4.c.  The others copy literal runs and long matches in
+ * wider steps: "generic" 16 bytes at a time in plain C, "sse2" and "avx2"
+ * with 16 and 32 byte vector moves.  As with fletcher 4, the fastest
+ * supported implementation is chosen by a micro benchmark when the module
+ * is loaded, and its results are reported in
+ * /proc/spl/kstat/zfs/lz4_decompress_bench.
+ */
+
+#include <sys/zfs_context.h>
+#include <sys/spa.h>
+#include <sys/zio_compress.h>
+#include <sys/lz4_impl.h>
+#include <linux/simd.h>
+
+#define	LZ4_DEC_NAME		generic
+#define	LZ4_DEC_WIDTH		16
+#define	LZ4_DEC_COPY(d, s)	(void) memcpy((d), (s), LZ4_DEC_WIDTH)
+#define	LZ4_DEC_BEGIN()		((void) 0)
+#define	LZ4_DEC_END()		((void) 0)
+
+#include "lz4_decompress_impl.h"
+
+static boolean_t
+lz4_decompress_generic_will_work(void)
+{
+	return (B_TRUE);
+}
+
+const lz4_decompress_ops_t lz4_decompress_generic_ops = {
+	.decompress = lz4_decompress_generic,
+	.is_supported = lz4_decompress_generic_will_work,
+	.uses_fpu = B_FALSE,
+	.name = "generic"
+};
+
+static const lz4_decompress_ops_t *const lz4_decompress_impls[] = {
+	&lz4_decompress_scalar_ops,
+	&lz4_decompress_generic_ops,
+#if defined(__x86_64) && defined(HAVE_SSE2)
+	&lz4_decompress_sse2_ops,
+#endif
+#if defined(__x86_64) && defined(HAVE_AVX2)
+	&lz4_decompress_avx2_ops,
+#endif
+};
+
+/*
+ * Blocks larger than this are decompressed by the fastest implementation
+ * which doesn't use the FPU, so preemption isn't disabled for too long.
+ */
+#define	LZ4_DECOMPRESS_FPU_MAX	SPA_OLD_MAXBLOCKSIZE
+
+/* Hold all supported implementations */
+static uint32_t lz4_decompress_supp_impls_cnt = 0;
+static const lz4_decompress_ops_t *
+    lz4_decompress_supp_impls[ARRAY_SIZE(lz4_decompress_impls)];
+
+/* Fastest implementations overall, and without the FPU */
+static const lz4_decompress_ops_t *lz4_decompress_fastest_impl =
+    &lz4_decompress_scalar_ops;
+static const lz4_decompress_ops_t *lz4_decompress_fastest_nofpu_impl =
+    &lz4_decompress_scalar_ops;
+
+/* Select lz4 decompression implementation */
+#define	IMPL_FASTEST	(UINT32_MAX)
+#define	IMPL_CYCLE	(UINT32_MAX - 1)
+#define	IMPL_SCALAR	(0)
+
+static uint32_t lz4_decompress_impl_chosen = IMPL_FASTEST;
+
+#define	IMPL_READ(i)	(*(volatile uint32_t *) &(i))
+
+static struct lz4_decompress_impl_selector {
+	const char	*lis_name;
+	uint32_t	lis_sel;
+} lz4_decompress_impl_selectors[] = {
+	{ "cycle",	IMPL_CYCLE },
+	{ "fastest",	IMPL_FASTEST },
+	{ "scalar",	IMPL_SCALAR }
+};
+
+#if defined(_KERNEL)
+static kstat_t *lz4_decompress_kstat;
+
+/* Bandwidth of each supported implementation in B/s */
+static uint64_t
+    lz4_decompress_stat_data[ARRAY_SIZE(lz4_decompress_impls) + 1];
+#endif
+
+/* Indicate that benchmark has been completed */
+static boolean_t lz4_decompress_initialized = B_FALSE;
+
+int
+lz4_decompress_impl_set(const char *val)
+{
+	int err = -EINVAL;
+	uint32_t impl = IMPL_READ(lz4_decompress_impl_chosen);
+	size_t i, val_len;
+
+	val_len = strlen(val);
+	while ((val_len > 0) && !!isspace(val[val_len-1])) /* trim '\n' */
+		val_len--;
+
+	/* check mandatory implementations */
+	for (i = 0; i < ARRAY_SIZE(lz4_decompress_impl_selectors); i++) {
+		const char *name = lz4_decompress_impl_selectors[i].lis_name;
+
+		if (val_len == strlen(name) &&
+		    strncmp(val, name, val_len) == 0) {
+			impl = lz4_decompress_impl_selectors[i].lis_sel;
+			err = 0;
+			break;
+		}
+	}
+
+	if (err != 0 && lz4_decompress_initialized) {
+		/* check all supported implementations */
+		for (i = 0; i < lz4_decompress_supp_impls_cnt; i++) {
+			const char *name = lz4_decompress_supp_impls[i]->name;
+
+			if (val_len == strlen(name) &&
+			    strncmp(val, name, val_len) == 0) {
+				impl = i;
+				err = 0;
+				break;
+			}
+		}
+	}
+
+	if (err == 0) {
+		atomic_swap_32(&lz4_decompress_impl_chosen, impl);
+		membar_producer();
+	}
+
+	return (err);
+}
+
+/*
+ * Returns the implementation to decompress a block of osize bytes with.
+ * When the FPU can't be used in the current context, or the block is
+ * large, fall back to the fastest implementation which doesn't need it.
+ */
+const lz4_decompress_ops_t *
+lz4_decompress_impl_get(size_t osize)
+{
+	const lz4_decompress_ops_t *ops = NULL;
+	uint32_t impl = IMPL_READ(lz4_decompress_impl_chosen);
+
+	switch (impl) {
+	case IMPL_FASTEST:
+		ops = lz4_decompress_fastest_impl;
+		break;
+	case IMPL_CYCLE:
+		/* Cycle through supported implementations */
+		ASSERT(lz4_decompress_initialized);
+		ASSERT3U(lz4_decompress_supp_impls_cnt, >, 0);
+		static uint32_t cycle_count = 0;
+		uint32_t idx = (++cycle_count) % lz4_decompress_supp_impls_cnt;
+		ops = lz4_decompress_supp_impls[idx];
+		break;
+	default:
+		ASSERT3U(lz4_decompress_supp_impls_cnt, >, 0);
+		ASSERT3U(impl, <, lz4_decompress_supp_impls_cnt);
+		ops = lz4_decompress_supp_impls[impl];
+		break;
+	}
+
+	ASSERT3P(ops, !=, NULL);
+
+	if (ops->uses_fpu &&
+	    (!kfpu_allowed() || osize > LZ4_DECOMPRESS_FPU_MAX))
+		ops = lz4_decompress_fastest_nofpu_impl;
+
+	return (ops);
+}
+
+/*
+ * Fill a buffer with data which compresses roughly as well as typical file
+ * data: a mix of short words, numbers, and incompressible runs.
+ */
+static void
+lz4_decompress_bench_fill(char *buf, size_t size)
+{
+	static const char *const words[] = {
+		"the ", "pool ", "dataset ", "snapshot ", "block ", "record ",
+		"checksum ", "compress ", "zfs ", "data ", "of ", "and ",
+		"0000", "\n\t", "GET /index.html ", "200 OK\r\n"
+	};
+	uint64_t x = 0x9e3779b97f4a7c15ULL;
+	size_t off = 0;
+
+	while (off < size) {
+		size_t len;
+
+		x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+		if ((x >> 60) < 3) {
+			/* a short run of random bytes */
+			len = MIN(size - off, 1 + ((x >> 32) & 7));
+			for (size_t i = 0; i < len; i++)
+				buf[off + i] = (char)(x >> (i * 5));
+		} else {
+			const char *w = words[(x >> 40) % ARRAY_SIZE(words)];
+
+			len = MIN(size - off, strlen(w));
+			(void) memcpy(buf + off, w, len);
+		}
+		off += len;
+	}
+}
+
+#if defined(_KERNEL)
+static int
+lz4_decompress_kstat_headers(char *buf, size_t size)
+{
+	ssize_t off = 0;
+
+	off += snprintf(buf + off, size, "%-17s", "implementation");
+	(void) snprintf(buf + off, size - off, "%-15s\n", "decompress");
+
+	return (0);
+}
+
+static int
+lz4_decompress_kstat_data(char *buf, size_t size, void *data)
+{
+	uint64_t *fastest_stat =
+	    &lz4_decompress_stat_data[lz4_decompress_supp_impls_cnt];
+	uint64_t *curr_stat = (uint64_t *)data;
+	ssize_t off = 0;
+
+	if (curr_stat == fastest_stat) {
+		off += snprintf(buf + off, size - off, "%-17s", "fastest");
+		(void) snprintf(buf + off, size - off, "%-15s\n",
+		    lz4_decompress_fastest_impl->name);
+	} else {
+		ptrdiff_t id = curr_stat - lz4_decompress_stat_data;
+
+		off += snprintf(buf + off, size - off, "%-17s",
+		    lz4_decompress_supp_impls[id]->name);
+		(void) snprintf(buf + off, size - off, "%-15llu\n",
+		    (u_longlong_t)*curr_stat);
+	}
+
+	return (0);
+}
+
+static void *
+lz4_decompress_kstat_addr(kstat_t *ksp, loff_t n)
+{
+	if (n <= lz4_decompress_supp_impls_cnt)
+		ksp->ks_private = (void *) (lz4_decompress_stat_data + n);
+	else
+		ksp->ks_private = NULL;
+
+	return (ksp->ks_private);
+}
+
+#define	LZ4_DECOMPRESS_BENCH_NS	(MSEC2NSEC(10))		/* 10ms */
+
+/*
+ * Measure the decompression bandwidth of each supported implementation
+ * on the same block, in B/s.
+ */
+static void
+lz4_decompress_benchmark_impl(const char *src, int isize, char *dst,
+    int osize)
+{
+	uint64_t run_bw, run_time_ns, best_run = 0, best_nofpu = 0;
+	hrtime_t start;
+	uint32_t i, l;
+
+	for (i = 0; i < lz4_decompress_supp_impls_cnt; i++) {
+		const lz4_decompress_ops_t *ops = lz4_decompress_supp_impls[i];
+		uint64_t run_count = 0;
+
+		kpreempt_disable();
+		start = gethrtime();
+		do {
+			for (l = 0; l < 8; l++, run_count++)
+				(void) ops->decompress(src, dst, isize, osize);
+
+			run_time_ns = gethrtime() - start;
+		} while (run_time_ns < LZ4_DECOMPRESS_BENCH_NS);
+		kpreempt_enable();
+
+		run_bw = osize * run_count * NANOSEC;
+		run_bw /= run_time_ns;	/* B/s */
+		lz4_decompress_stat_data[i] = run_bw;
+
+		if (run_bw > best_run) {
+			best_run = run_bw;
+			lz4_decompress_fastest_impl = ops;
+		}
+		if (!ops->uses_fpu && run_bw > best_nofpu) {
+			best_nofpu = run_bw;
+			lz4_decompress_fastest_nofpu_impl = ops;
+		}
+	}
+}
+#endif /* _KERNEL */
+
+/*
+ * Find the supported implementations, check that each one decodes a test
+ * block correctly, and benchmark them.
+ */
+static void
+lz4_decompress_benchmark(void)
+{
+	const size_t size = SPA_OLD_MAXBLOCKSIZE;
+	char *src = vmem_alloc(size, KM_SLEEP);
+	char *cbuf = vmem_alloc(size, KM_SLEEP);
+	char *dst = vmem_alloc(size, KM_SLEEP);
+	size_t clen;
+	uint32_t bufsiz;
+	int i, c;
+
+	lz4_decompress_bench_fill(src, size);
+	clen = lz4_compress_zfs(src, cbuf, size, size, 0);
+	VERIFY3U(clen, <, size);
+	bufsiz = BE_IN32(cbuf);
+
+	for (i = 0, c = 0; i < ARRAY_SIZE(lz4_decompress_impls); i++) {
+		const lz4_decompress_ops_t *ops = lz4_decompress_impls[i];
+
+		if (ops->is_supported == NULL || !ops->is_supported())
+			continue;
+
+		bzero(dst, size);
+		if (ops->decompress(cbuf + sizeof (bufsiz), dst, bufsiz,
+		    size) != (int)size || bcmp(src, dst, size) != 0) {
+			cmn_err(CE_WARN, "lz4 decompression implementation "
+			    "'%s' failed its self test", ops->name);
+			continue;
+		}
+
+		lz4_decompress_supp_impls[c++] = ops;
+	}
+	membar_producer();	/* complete lz4_decompress_supp_impls[] init */
+	lz4_decompress_supp_impls_cnt = c;
+
+#if defined(_KERNEL)
+	lz4_decompress_benchmark_impl(cbuf + sizeof (bufsiz), bufsiz,
+	    dst, size);
+#else
+	/*
+	 * Skip the benchmark in user space to avoid impacting libzpool
+	 * consumers.  The last implementations are assumed to be the
+	 * fastest and used by default.
+	 */
+	for (i = 0; i < c; i++) {
+		lz4_decompress_fastest_impl = lz4_decompress_supp_impls[i];
+		if (!lz4_decompress_supp_impls[i]->uses_fpu) {
+			lz4_decompress_fastest_nofpu_impl =
+			    lz4_decompress_supp_impls[i];
+		}
+	}
+#endif /* _KERNEL */
+	membar_producer();
+
+	vmem_free(dst, size);
+	vmem_free(cbuf, size);
+	vmem_free(src, size);
+}
+
+void
+lz4_decompress_impl_init(void)
+{
+	/* Determine the fastest available implementation. */
+	lz4_decompress_benchmark();
+
+#if defined(_KERNEL)
+	/* Install kstats for all implementations */
+	lz4_decompress_kstat = kstat_create("zfs", 0, "lz4_decompress_bench",
+	    "misc", KSTAT_TYPE_RAW, 0, KSTAT_FLAG_VIRTUAL);
+	if (lz4_decompress_kstat != NULL) {
+		lz4_decompress_kstat->ks_data = NULL;
+		lz4_decompress_kstat->ks_ndata = UINT32_MAX;
+		kstat_set_raw_ops(lz4_decompress_kstat,
+		    lz4_decompress_kstat_headers,
+		    lz4_decompress_kstat_data,
+		    lz4_decompress_kstat_addr);
+		kstat_install(lz4_decompress_kstat);
+	}
+#endif
+
+	/* Finish initialization */
+	lz4_decompress_initialized = B_TRUE;
+}
+
+void
+lz4_decompress_impl_fini(void)
+{
+#if defined(_KERNEL)
+	if (lz4_decompress_kstat != NULL) {
+		kstat_delete(lz4_decompress_kstat);
+		lz4_decompress_kstat = NULL;
+	}
+#endif
+
+	lz4_decompress_initialized = B_FALSE;
+	lz4_decompress_supp_impls_cnt = 0;
+	lz4_decompress_fastest_impl = &lz4_decompress_scalar_ops;
+	lz4_decompress_fastest_nofpu_impl = &lz4_decompress_scalar_ops;
+}
+
+#if defined(_KERNEL)
+#include <linux/mod_compat.h>
+
+static int
+lz4_decompress_param_get(char *buffer, zfs_kernel_param_t *unused)
+{
+	const uint32_t impl = IMPL_READ(lz4_decompress_impl_chosen);
+	char *fmt;
+	int i, cnt = 0;
+
+	/* list fastest */
+	fmt = (impl == IMPL_FASTEST) ? "[%s] " : "%s ";
+	cnt += sprintf(buffer + cnt, fmt, "fastest");
+
+	/* list all supported implementations */
+	for (i = 0; i < lz4_decompress_supp_impls_cnt; i++) {
+		fmt = (i == impl) ? "[%s] " : "%s ";
+		cnt += sprintf(buffer + cnt, fmt,
+		    lz4_decompress_supp_impls[i]->name);
+	}
+
+	return (cnt);
+}
+
+static int
+lz4_decompress_param_set(const char *val, zfs_kernel_param_t *unused)
+{
+	return (lz4_decompress_impl_set(val));
+}
+
+/*
+ * Choose an lz4 decompression implementation in ZFS.
+ * Users can choose "cycle" to exercise all implementations, but this is
+ * for testing purpose therefore it can only be set in user space.
+ */
+module_param_call(zfs_lz4_decompress_impl,
+    lz4_decompress_param_set, lz4_decompress_param_get, NULL, 0644);
+MODULE_PARM_DESC(zfs_lz4_decompress_impl,
+	"Select lz4 decompression implementation.");
+#endif
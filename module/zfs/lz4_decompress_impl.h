@@ -0,0 +1,244 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#ifndef _LZ4_DECOMPRESS_IMPL_H
+#define	_LZ4_DECOMPRESS_IMPL_H
+
+/*
+ * Template for the lz4 block decoders.  Before including this file define:
+ *
+ *	LZ4_DEC_NAME		suffix of the generated lz4_decompress_<name>()
+ *	LZ4_DEC_WIDTH		bytes moved by one wide copy, at least 16
+ *	LZ4_DEC_COPY(d, s)	copy LZ4_DEC_WIDTH bytes between buffers which
+ *				are at least LZ4_DEC_WIDTH bytes apart
+ *	LZ4_DEC_BEGIN()		enter the context LZ4_DEC_COPY() runs in
+ *	LZ4_DEC_END()		and leave it again
+ *
+ * The generated decoder walks the block exactly like the original
+ * LZ4_uncompress_unknownOutputSize() in lz4.c, accepts and rejects the
+ * same blocks, and produces the same output for well formed blocks (a
+ * corrupt match may copy from bytes not yet written, whose contents are
+ * left by earlier wild copies).  It differs only in how bytes
+ * are moved: literal runs and matches which are far enough from the end of
+ * both buffers are copied LZ4_DEC_WIDTH bytes at a time rather than 8.
+ * Like the original 8 byte steps these are "wild" copies, which may
+ * write past the end of the run into bytes the next sequence overwrites.
+ * Most sequences have short literal runs and matches; away from the ends
+ * of the buffers those are copied with a fixed number of moves without
+ * checking their lengths first.
+ */
+
+#define	LZ4_DEC_COPYLENGTH	8
+#define	LZ4_DEC_MINMATCH	4
+#define	LZ4_DEC_ML_BITS		4
+#define	LZ4_DEC_ML_MASK		((1U << LZ4_DEC_ML_BITS) - 1)
+#define	LZ4_DEC_RUN_MASK	((1U << (8 - LZ4_DEC_ML_BITS)) - 1)
+
+/*
+ * Space needed after a short sequence's token for it to be decoded without
+ * bounds checks: up to 14 literals plus an 18 byte match must fit, and
+ * still end COPYLENGTH bytes before the end of the output.
+ */
+#define	LZ4_DEC_SHORT_IN	(LZ4_DEC_WIDTH + LZ4_DEC_COPYLENGTH)
+#define	LZ4_DEC_SHORT_OUT	40
+
+#ifndef unlikely
+#define	unlikely(expr)		__builtin_expect((expr) != 0, 0)
+#endif
+
+#define	LZ4_DEC_FN_(name)	lz4_decompress_ ## name
+#define	LZ4_DEC_FN(name)	LZ4_DEC_FN_(name)
+
+static const int lz4_dec32table[] = {0, 3, 2, 3, 0, 0, 0, 0};
+static const int lz4_dec64table[] = {0, 0, 0, -1, 0, 1, 2, 3};
+
+/* Copy 8 bytes at a time from s to d until d reaches e. */
+#define	LZ4_DEC_WILDCOPY8(s, d, e)	do {				\
+	(void) memcpy((d), (s), 8);					\
+	(d) += 8;							\
+	(s) += 8;							\
+} while ((d) < (e))
+
+/* Copy LZ4_DEC_WIDTH bytes at a time from s to d until d reaches e. */
+#define	LZ4_DEC_WILDCOPY(s, d, e)	do {				\
+	LZ4_DEC_COPY((d), (s));						\
+	(d) += LZ4_DEC_WIDTH;						\
+	(s) += LZ4_DEC_WIDTH;						\
+} while ((d) < (e))
+
+#endif /* _LZ4_DECOMPRESS_IMPL_H */
+
+static int
+LZ4_DEC_FN(LZ4_DEC_NAME)(const char *source, char *dest, int isize,
+    int maxOutputSize)
+{
+	const uint8_t *ip = (const uint8_t *)source;
+	const uint8_t *const iend = ip + isize;
+	const uint8_t *ref;
+	uint8_t *op = (uint8_t *)dest;
+	uint8_t *const oend = op + maxOutputSize;
+	uint8_t *cpy;
+	int ret = -1;
+
+	LZ4_DEC_BEGIN();
+
+	while (ip < iend) {
+		unsigned token;
+		size_t length;
+
+		token = *ip++;
+		length = token >> LZ4_DEC_ML_BITS;
+
+		/* short literal run, then a short match at least 8 back */
+		if (length != LZ4_DEC_RUN_MASK &&
+		    iend - ip >= LZ4_DEC_SHORT_IN &&
+		    oend - op >= LZ4_DEC_SHORT_OUT) {
+			LZ4_DEC_COPY(op, ip);
+			op += length;
+			ip += length;
+
+			ref = op - (ip[0] | (ip[1] << 8));
+			ip += 2;
+			if (ref < (uint8_t *)dest)
+				goto out;
+
+			length = token & LZ4_DEC_ML_MASK;
+			if (length != LZ4_DEC_ML_MASK && op - ref >= 8) {
+				(void) memcpy(op, ref, 8);
+				(void) memcpy(op + 8, ref + 8, 8);
+				(void) memcpy(op + 16, ref + 16, 2);
+				op += length + LZ4_DEC_MINMATCH;
+				continue;
+			}
+			goto match;
+		}
+
+		/* get runlength */
+		if (length == LZ4_DEC_RUN_MASK) {
+			int s = 255;
+			while ((ip < iend) && (s == 255)) {
+				s = *ip++;
+				if (unlikely(length > (size_t)(length + s)))
+					goto out;
+				length += s;
+			}
+		}
+
+		/* copy literals */
+		cpy = op + length;
+		if (cpy < op)
+			goto out;
+		if ((cpy > oend - LZ4_DEC_COPYLENGTH) ||
+		    (ip + length > iend - LZ4_DEC_COPYLENGTH)) {
+			/* Only the final literals may end this close */
+			if (cpy > oend || ip + length != iend)
+				goto out;
+			(void) memcpy(op, ip, length);
+			op += length;
+			break;
+		}
+		if (cpy <= oend - LZ4_DEC_WIDTH &&
+		    ip + length <= iend - LZ4_DEC_WIDTH)
+			LZ4_DEC_WILDCOPY(ip, op, cpy);
+		else
+			LZ4_DEC_WILDCOPY8(ip, op, cpy);
+		ip -= (op - cpy);
+		op = cpy;
+
+		/* get offset */
+		ref = cpy - (ip[0] | (ip[1] << 8));
+		ip += 2;
+		if (ref < (uint8_t *)dest)
+			goto out;
+
+		/* get matchlength */
+		length = token & LZ4_DEC_ML_MASK;
+match:
+		if (length == LZ4_DEC_ML_MASK) {
+			while (ip < iend) {
+				int s = *ip++;
+				if (unlikely(length > (size_t)(length + s)))
+					goto out;
+				length += s;
+				if (s == 255)
+					continue;
+				break;
+			}
+		}
+
+		/*
+		 * Copy the first 8 bytes of the match.  A source closer than
+		 * that is spread so the rest can be copied from at least 8
+		 * bytes back.
+		 */
+		if (unlikely(op - ref < 8)) {
+			int dec64 = lz4_dec64table[op - ref];
+
+			op[0] = ref[0];
+			op[1] = ref[1];
+			op[2] = ref[2];
+			op[3] = ref[3];
+			op += 4;
+			ref += 4;
+			ref -= lz4_dec32table[op - ref];
+			(void) memcpy(op, ref, 4);
+			op += 4;
+			ref -= dec64;
+		} else {
+			(void) memcpy(op, ref, 8);
+			op += 8;
+			ref += 8;
+		}
+
+		/* copy the rest of the match */
+		cpy = op + length - (8 - LZ4_DEC_MINMATCH);
+		if (cpy > oend - LZ4_DEC_COPYLENGTH) {
+			if (cpy > oend)
+				goto out;
+			if ((ref + LZ4_DEC_COPYLENGTH) > oend)
+				goto out;
+			if (op < oend - LZ4_DEC_COPYLENGTH)
+				LZ4_DEC_WILDCOPY8(ref, op,
+				    oend - LZ4_DEC_COPYLENGTH);
+			while (op < cpy)
+				*op++ = *ref++;
+			op = cpy;
+			/* The last 5 bytes are always literals */
+			if (op == oend)
+				goto out;
+			continue;
+		}
+		if (op < cpy) {
+			if (op - ref >= LZ4_DEC_WIDTH &&
+			    cpy <= oend - LZ4_DEC_WIDTH)
+				LZ4_DEC_WILDCOPY(ref, op, cpy);
+			else
+				LZ4_DEC_WILDCOPY8(ref, op, cpy);
+		}
+		op = cpy;
+	}
+
+	ret = (int)(((char *)op) - dest);
+out:
+	LZ4_DEC_END();
+
+	return (ret);
+}
@@ -0,0 +1,59 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#include <sys/isa_defs.h>
+
+#if defined(__x86_64) && defined(HAVE_SSE2)
+
+#include <sys/zfs_context.h>
+#include <sys/lz4_impl.h>
+#include <linux/simd_x86.h>
+
+/*
+ * lz4 decoder copying literal runs and matches with SSE2 16 byte moves.
+ */
+#define	LZ4_DEC_NAME		sse2
+#define	LZ4_DEC_WIDTH		16
+#define	LZ4_DEC_COPY(d, s)						\
+	__asm__ __volatile__(						\
+	    "movdqu %1, %%xmm0\n\t"					\
+	    "movdqu %%xmm0, %0"						\
+	    : "=m" (*(uint8_t (*)[LZ4_DEC_WIDTH])(d))			\
+	    : "m" (*(const uint8_t (*)[LZ4_DEC_WIDTH])(s)))
+#define	LZ4_DEC_BEGIN()		kfpu_begin()
+#define	LZ4_DEC_END()		kfpu_end()
+
+#include "lz4_decompress_impl.h"
+
+static boolean_t
+lz4_decompress_sse2_will_work(void)
+{
+	return (kfpu_allowed() && zfs_sse2_available());
+}
+
+const lz4_decompress_ops_t lz4_decompress_sse2_ops = {
+	.decompress = lz4_decompress_sse2,
+	.is_supported = lz4_decompress_sse2_will_work,
+	.uses_fpu = B_TRUE,
+	.name = "sse2"
+};
+
+#endif /* defined(__x86_64) && defined(HAVE_SSE2) */
@@ -28,6 +28,7 @@
 #include <sys/zfs_context.h>
 #include <sys/byteorder.h>
 #include <sys/zio.h>
+#include <sys/zio_compress.h>
 #include "qat.h"
 
 /*
@@ -61,6 +62,54 @@ qat_dc_use_accel(size_t s_len)
 	    s_len <= QAT_MAX_BUF_SIZE);
 }
 
+/*
+ * QAT is registered as an accelerator for the gzip algorithms, which it
+ * implements at a single level of its own.
+ */
+static boolean_t
+qat_dc_accel_use(enum zio_compress c, size_t len)
+{
+	return (c >= ZIO_COMPRESS_GZIP_1 && c <= ZIO_COMPRESS_GZIP_9 &&
+	    qat_dc_use_accel(len));
+}
+
+/*ARGSUSED*/
+static int
+qat_dc_accel_compress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len, size_t *c_len)
+{
+	int ret;
+
+	ret = qat_compress(QAT_COMPRESS, src, s_len, dst, d_len, c_len);
+	if (ret == CPA_STATUS_INCOMPRESSIBLE) {
+		*c_len = s_len;
+		return (0);
+	}
+
+	return (ret == CPA_STATUS_SUCCESS ? 0 : SET_ERROR(EIO));
+}
+
+/*ARGSUSED*/
+static int
+qat_dc_accel_decompress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len)
+{
+	size_t c_len;
+
+	if (qat_compress(QAT_DECOMPRESS, src, s_len, dst, d_len,
+	    &c_len) != CPA_STATUS_SUCCESS)
+		return (SET_ERROR(EIO));
+
+	return (0);
+}
+
+static zio_compress_accel_t qat_dc_accel = {
+	.zca_name = "qat",
+	.zca_use = qat_dc_accel_use,
+	.zca_compress = qat_dc_accel_compress,
+	.zca_decompress = qat_dc_accel_decompress,
+};
+
 static void
 qat_dc_callback(void *p_callback, CpaStatus status)
 {
@@ -74,6 +123,9 @@ qat_dc_clean(void)
 	Cpa16U buff_num = 0;
 	Cpa16U num_inter_buff_lists = 0;
 
+	if (qat_dc_init_done)
+		zio_compress_accel_unregister(&qat_dc_accel);
+
 	for (Cpa16U i = 0; i < num_inst; i++) {
 		cpaDcStopInstance(dc_inst_handles[i]);
 		QAT_PHYS_CONTIG_FREE(session_handles[i]);
@@ -213,6 +265,7 @@ qat_dc_init(void)
 	}
 
 	qat_dc_init_done = B_TRUE;
+	zio_compress_accel_register(&qat_dc_accel);
 	return (0);
 fail:
 	qat_dc_clean();
@@ -160,9 +160,12 @@ static void spa_sync_props(void *arg, dmu_tx_t *tx);
 static boolean_t spa_has_active_shared_spare(spa_t *spa);
 static int spa_load_impl(spa_t *spa, spa_import_type_t type, char **ereport);
 static void spa_vdev_resilver_done(spa_t *spa);
+static void spa_livelist_condense_clear(spa_t *spa);
 
 uint_t		zio_taskq_batch_pct = 75;	/* 1 thread per cpu in pset */
+uint_t		zio_compress_taskq_pct = 75;	/* write compress threads */
 boolean_t	zio_taskq_sysdc = B_TRUE;	/* use SDC scheduling class */
+int		zio_taskq_numa = 1;		/* per-node zio taskqs */
 uint_t		zio_taskq_basedc = 80;		/* base duty cycle */
 
 boolean_t	spa_create_process = B_TRUE;	/* no process ==> no sysdc */
@@ -963,7 +966,7 @@ spa_change_guid(spa_t *spa)
  * ==========================================================================
  */
 
-static int
+int
 spa_error_entry_compare(const void *a, const void *b)
 {
 	const spa_error_entry_t *sa = (const spa_error_entry_t *)a;
@@ -1005,17 +1008,32 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 	uint_t count = ztip->zti_count;
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
 	uint_t flags = 0;
+	uint_t nodes = 0;
 	boolean_t batch = B_FALSE;
 
 	if (mode == ZTI_MODE_NULL) {
 		tqs->stqs_count = 0;
+		tqs->stqs_nodes = 0;
 		tqs->stqs_taskq = NULL;
 		return;
 	}
 
 	ASSERT3U(count, >, 0);
 
+	/*
+	 * The CPU intensive batch taskqs and those already split for
+	 * parallelism are instead split between NUMA nodes.  Each node gets
+	 * its share of the taskqs, bound to its cpus, so that checksum and
+	 * compression run next to the buffers they touch.
+	 */
+	if (zio_taskq_numa && zio_nnodes > 1 &&
+	    (mode == ZTI_MODE_BATCH || count > 1)) {
+		nodes = zio_nnodes;
+		count = MAX(count / nodes, 1) * nodes;
+	}
+
 	tqs->stqs_count = count;
+	tqs->stqs_nodes = nodes;
 	tqs->stqs_taskq = kmem_alloc(count * sizeof (taskq_t *), KM_SLEEP);
 
 	switch (mode) {
@@ -1045,7 +1063,7 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 		(void) snprintf(name, sizeof (name), "%s_%s",
 		    zio_type_name[t], zio_taskq_types[q]);
 
-		if (zio_taskq_sysdc && spa->spa_proc != &p0) {
+		if (nodes == 0 && zio_taskq_sysdc && spa->spa_proc != &p0) {
 			if (batch)
 				flags |= TASKQ_DC_BATCH;
 
@@ -1063,8 +1081,14 @@ spa_taskqs_init(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 			if (t == ZIO_TYPE_WRITE && q == ZIO_TASKQ_ISSUE)
 				pri++;
 
-			tq = taskq_create_proc(name, value, pri, 50,
-			    INT_MAX, spa->spa_proc, flags);
+			if (nodes != 0) {
+				tq = taskq_create_node(name, value, pri, 50,
+				    INT_MAX, zio_index_to_node(i / (count /
+				    nodes)), flags);
+			} else {
+				tq = taskq_create_proc(name, value, pri, 50,
+				    INT_MAX, spa->spa_proc, flags);
+			}
 		}
 
 		tqs->stqs_taskq[i] = tq;
@@ -1088,19 +1112,24 @@ spa_taskqs_fini(spa_t *spa, zio_type_t t, zio_taskq_type_t q)
 
 	kmem_free(tqs->stqs_taskq, tqs->stqs_count * sizeof (taskq_t *));
 	tqs->stqs_taskq = NULL;
+	tqs->stqs_nodes = 0;
 }
 
 /*
  * Dispatch a task to the appropriate taskq for the ZFS I/O type and priority.
  * Note that a type may have multiple discrete taskqs to avoid lock contention
  * on the taskq itself. In that case we choose which taskq at random by using
- * the low bits of gethrtime().
+ * the low bits of gethrtime().  When the taskqs are split between NUMA nodes
+ * the choice is limited to those of the given node, if any.  Returns B_TRUE
+ * when the task was dispatched to a taskq local to that node.
  */
-void
+boolean_t
 spa_taskq_dispatch_ent(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
-    task_func_t *func, void *arg, uint_t flags, taskq_ent_t *ent)
+    task_func_t *func, void *arg, uint_t flags, taskq_ent_t *ent, int node)
 {
 	spa_taskqs_t *tqs = &spa->spa_zio_taskq[t][q];
+	boolean_t local = B_FALSE;
+	int index = zio_node_to_index(node);
 	taskq_t *tq;
 
 	ASSERT3P(tqs->stqs_taskq, !=, NULL);
@@ -1108,11 +1137,20 @@ spa_taskq_dispatch_ent(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 
 	if (tqs->stqs_count == 1) {
 		tq = tqs->stqs_taskq[0];
+	} else if (tqs->stqs_nodes != 0 && index >= 0 &&
+	    index < tqs->stqs_nodes) {
+		uint_t per_node = tqs->stqs_count / tqs->stqs_nodes;
+
+		tq = tqs->stqs_taskq[index * per_node +
+		    ((uint64_t)gethrtime()) % per_node];
+		local = B_TRUE;
 	} else {
 		tq = tqs->stqs_taskq[((uint64_t)gethrtime()) % tqs->stqs_count];
 	}
 
 	taskq_dispatch_ent(tq, func, arg, flags, ent);
+
+	return (local);
 }
 
 /*
@@ -1140,6 +1178,111 @@ spa_taskq_dispatch_sync(spa_t *spa, zio_type_t t, zio_taskq_type_t q,
 		taskq_wait_id(tq, id);
 }
 
+static const spa_compress_queue_stats_t spa_compress_queue_stats_template = {
+	{ "depth",			KSTAT_DATA_UINT64 },
+	{ "max_depth",			KSTAT_DATA_UINT64 },
+	{ "zios",			KSTAT_DATA_UINT64 },
+	{ "batches",			KSTAT_DATA_UINT64 },
+	{ "threads",			KSTAT_DATA_UINT64 },
+};
+
+/*
+ * Create a write compression queue and taskq for each NUMA node, sharing
+ * zio_compress_taskq_pct of the CPUs between them.  Writes are queued on
+ * the node holding their data; see zio_compress_dispatch().  With
+ * zio_taskq_numa set each queue's threads are bound to its node.
+ */
+static void
+spa_compress_queues_init(spa_t *spa)
+{
+	uint_t nqueues = MAX(zio_nnodes, 1);
+	uint_t threads = MAX(boot_ncpus * MIN(zio_compress_taskq_pct, 100) /
+	    100 / nqueues, 1);
+	char *name = kmem_asprintf("zfs/%s", spa_name(spa));
+
+	spa->spa_compress_nqueues = nqueues;
+	spa->spa_compress_queue = kmem_zalloc(nqueues *
+	    sizeof (spa_compress_queue_t), KM_SLEEP);
+
+	for (uint_t i = 0; i < nqueues; i++) {
+		spa_compress_queue_t *scq = &spa->spa_compress_queue[i];
+		char ksname[KSTAT_STRLEN];
+		kstat_t *ksp;
+
+		mutex_init(&scq->scq_lock, NULL, MUTEX_DEFAULT, NULL);
+		list_create(&scq->scq_list, sizeof (spa_compress_entry_t),
+		    offsetof(spa_compress_entry_t, sce_node));
+		list_create(&scq->scq_idle, sizeof (spa_compress_worker_t),
+		    offsetof(spa_compress_worker_t, scw_node));
+		scq->scq_threads = threads;
+		scq->scq_workers = kmem_zalloc(threads *
+		    sizeof (spa_compress_worker_t), KM_SLEEP);
+		for (uint_t w = 0; w < threads; w++) {
+			spa_compress_worker_t *scw = &scq->scq_workers[w];
+
+			taskq_init_ent(&scw->scw_tqent);
+			scw->scw_queue = scq;
+			list_insert_tail(&scq->scq_idle, scw);
+		}
+		scq->scq_stats = spa_compress_queue_stats_template;
+		scq->scq_stats.scqs_threads.value.ui64 = threads;
+
+		if (zio_taskq_sysdc && spa->spa_proc != &p0) {
+			scq->scq_taskq = taskq_create_sysdc("z_wr_cmp", threads,
+			    50, INT_MAX, spa->spa_proc, zio_taskq_basedc,
+			    TASKQ_DC_BATCH);
+		} else if (zio_taskq_numa && nqueues > 1) {
+			/* Like the write issue taskq, run below maxclsyspri */
+			scq->scq_taskq = taskq_create_node("z_wr_cmp", threads,
+			    maxclsyspri + 1, 50, INT_MAX, zio_index_to_node(i),
+			    0);
+		} else {
+			scq->scq_taskq = taskq_create_proc("z_wr_cmp", threads,
+			    maxclsyspri + 1, 50, INT_MAX, spa->spa_proc, 0);
+		}
+
+		(void) snprintf(ksname, sizeof (ksname), "compress_queue_%d",
+		    zio_index_to_node(i));
+		ksp = kstat_create(name, 0, ksname, "misc", KSTAT_TYPE_NAMED,
+		    sizeof (spa_compress_queue_stats_t) /
+		    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+		if (ksp != NULL) {
+			ksp->ks_lock = &scq->scq_lock;
+			ksp->ks_data = &scq->scq_stats;
+			kstat_install(ksp);
+		}
+		scq->scq_ksp = ksp;
+	}
+
+	strfree(name);
+}
+
+static void
+spa_compress_queues_fini(spa_t *spa)
+{
+	for (uint_t i = 0; i < spa->spa_compress_nqueues; i++) {
+		spa_compress_queue_t *scq = &spa->spa_compress_queue[i];
+
+		taskq_destroy(scq->scq_taskq);
+		if (scq->scq_ksp != NULL)
+			kstat_delete(scq->scq_ksp);
+
+		ASSERT(list_is_empty(&scq->scq_list));
+		while (list_remove_head(&scq->scq_idle) != NULL)
+			continue;
+		list_destroy(&scq->scq_idle);
+		list_destroy(&scq->scq_list);
+		kmem_free(scq->scq_workers, scq->scq_threads *
+		    sizeof (spa_compress_worker_t));
+		mutex_destroy(&scq->scq_lock);
+	}
+
+	kmem_free(spa->spa_compress_queue, spa->spa_compress_nqueues *
+	    sizeof (spa_compress_queue_t));
+	spa->spa_compress_queue = NULL;
+	spa->spa_compress_nqueues = 0;
+}
+
 static void
 spa_create_zio_taskqs(spa_t *spa)
 {
@@ -1148,6 +1291,8 @@ spa_create_zio_taskqs(spa_t *spa)
 			spa_taskqs_init(spa, t, q);
 		}
 	}
+
+	spa_compress_queues_init(spa);
 }
 
 /*
@@ -1380,6 +1525,8 @@ spa_deactivate(spa_t *spa)
 		}
 	}
 
+	spa_compress_queues_fini(spa);
+
 	for (size_t i = 0; i < TXG_SIZE; i++) {
 		ASSERT3P(spa->spa_txg_zio[i], !=, NULL);
 		error = zio_wait(spa->spa_txg_zio[i]);
@@ -1671,6 +1818,18 @@ spa_unload(spa_t *spa, uint64_t txg_how)
 		spa->spa_checkpoint_discard_zthr = NULL;
 	}
 
+	if (spa->spa_livelist_delete_zthr != NULL) {
+		zthr_destroy(spa->spa_livelist_delete_zthr);
+		spa->spa_livelist_delete_zthr = NULL;
+	}
+
+	if (spa->spa_livelist_condense_zthr != NULL) {
+		zthr_destroy(spa->spa_livelist_condense_zthr);
+		spa->spa_livelist_condense_zthr = NULL;
+	}
+	spa_livelist_condense_clear(spa);
+	spa->spa_livelists_to_delete = 0;
+
 	spa_condense_fini(spa);
 
 	bpobj_close(&spa->spa_deferred_bpobj);
@@ -2448,6 +2607,325 @@ spa_vdev_err(vdev_t *vdev, vdev_aux_t aux, int err)
 	return (SET_ERROR(err));
 }
 
+/*
+ * The livelists of destroyed clones are listed in the DMU_POOL_DELETED_CLONES
+ * zap (see dsl_destroy_head_sync_impl()).  The livelist delete zthr frees
+ * their blocks one sublist per sync task, so that a clone's destruction is
+ * spread over as many txgs as its livelist has sublists.
+ */
+typedef struct livelist_delete_arg {
+	spa_t		*lda_spa;
+	uint64_t	lda_ll_obj;
+	uint64_t	lda_mintxg;
+	bplist_t	*lda_net;
+} livelist_delete_arg_t;
+
+static int
+livelist_free_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
+{
+	dsl_pool_t *dp = arg;
+
+	/*
+	 * A sublist's FREE entries always cancel out ALLOC entries of the
+	 * same sublist, so none should be left over.
+	 */
+	ASSERT(!BP_GET_FREE(bp));
+	if (BP_GET_FREE(bp))
+		return (0);
+
+	dsl_dir_diduse_space(dp->dp_free_dir, DD_USED_HEAD,
+	    -bp_get_dsize_sync(dp->dp_spa, bp),
+	    -BP_GET_PSIZE(bp), -BP_GET_UCSIZE(bp), tx);
+	dsl_free(dp, tx->tx_txg, bp);
+	return (0);
+}
+
+static void
+livelist_delete_sublist_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_delete_arg_t *lda = arg;
+	spa_t *spa = lda->lda_spa;
+	dsl_deadlist_t ll;
+
+	bplist_iterate(lda->lda_net, livelist_free_cb, spa_get_dsl(spa), tx);
+
+	dsl_deadlist_open(&ll, spa_meta_objset(spa), lda->lda_ll_obj);
+	dsl_deadlist_remove_entry(&ll, lda->lda_mintxg, tx);
+	dsl_deadlist_close(&ll);
+}
+
+static void
+livelist_delete_free_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_delete_arg_t *lda = arg;
+	spa_t *spa = lda->lda_spa;
+	objset_t *mos = spa_meta_objset(spa);
+	uint64_t count;
+
+	dsl_deadlist_free(mos, lda->lda_ll_obj, tx);
+	spa_feature_decr(spa, SPA_FEATURE_LIVELIST, tx);
+	VERIFY0(zap_remove_int(mos, spa->spa_livelists_to_delete,
+	    lda->lda_ll_obj, tx));
+
+	VERIFY0(zap_count(mos, spa->spa_livelists_to_delete, &count));
+	if (count == 0) {
+		VERIFY0(zap_destroy(mos, spa->spa_livelists_to_delete, tx));
+		VERIFY0(zap_remove(mos, DMU_POOL_DIRECTORY_OBJECT,
+		    DMU_POOL_DELETED_CLONES, tx));
+		spa->spa_livelists_to_delete = 0;
+	}
+}
+
+/*
+ * Whether the blocks of deleted clones are still being freed.  Until they
+ * are, the pool's $FREE dir accounts for them.
+ */
+boolean_t
+spa_livelist_delete_check(spa_t *spa)
+{
+	return (spa->spa_livelists_to_delete != 0);
+}
+
+/* ARGSUSED */
+static boolean_t
+spa_livelist_delete_cb_check(void *arg, zthr_t *z)
+{
+	return (spa_livelist_delete_check(arg));
+}
+
+static void
+spa_livelist_delete_cb(void *arg, zthr_t *z)
+{
+	spa_t *spa = arg;
+	objset_t *mos = spa_meta_objset(spa);
+	livelist_delete_arg_t lda = { .lda_spa = spa };
+	dsl_deadlist_entry_t *first;
+	dsl_deadlist_t ll;
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	bplist_t net;
+	int err;
+
+	zap_cursor_init(&zc, mos, spa->spa_livelists_to_delete);
+	err = zap_cursor_retrieve(&zc, &za);
+	zap_cursor_fini(&zc);
+	if (err != 0)
+		return;
+	lda.lda_ll_obj = za.za_first_integer;
+
+	dsl_deadlist_open(&ll, mos, lda.lda_ll_obj);
+	first = dsl_deadlist_first(&ll);
+	if (first == NULL) {
+		dsl_deadlist_close(&ll);
+		VERIFY0(dsl_sync_task(spa_name(spa), NULL,
+		    livelist_delete_free_sync, &lda, 0,
+		    ZFS_SPACE_CHECK_NONE));
+		return;
+	}
+
+	bplist_create(&net);
+	lda.lda_mintxg = first->dle_mintxg;
+	lda.lda_net = &net;
+	err = dsl_livelist_net(&first->dle_bpobj,
+	    first->dle_bpobj.bpo_phys->bpo_num_blkptrs, &net, z, NULL);
+	dsl_deadlist_close(&ll);
+
+	if (err == 0) {
+		VERIFY0(dsl_sync_task(spa_name(spa), NULL,
+		    livelist_delete_sublist_sync, &lda, 0,
+		    ZFS_SPACE_CHECK_NONE));
+	}
+	bplist_clear(&net);
+	bplist_destroy(&net);
+}
+
+/*
+ * A full sublist of a clone's livelist is condensed by the livelist condense
+ * zthr: the entries of the blocks the clone has already freed are dropped,
+ * so that the livelist does not grow with every overwrite.
+ */
+void
+spa_livelist_condense_queue(spa_t *spa, uint64_t dir, uint64_t livelist,
+    uint64_t mintxg, uint64_t bpobj)
+{
+	spa_livelist_condense_t *slc = &spa->spa_livelist_condense;
+
+	mutex_enter(&spa->spa_livelist_lock);
+	if (slc->slc_dir != 0) {
+		/* another sublist is being condensed; this one waits */
+		slc = kmem_zalloc(sizeof (spa_livelist_condense_t), KM_SLEEP);
+		list_insert_tail(&spa->spa_livelist_condense_pending, slc);
+	}
+	slc->slc_dir = dir;
+	slc->slc_livelist = livelist;
+	slc->slc_mintxg = mintxg;
+	slc->slc_bpobj = bpobj;
+	slc->slc_cancelled = B_FALSE;
+	mutex_exit(&spa->spa_livelist_lock);
+
+	if (spa->spa_livelist_condense_zthr != NULL)
+		zthr_wakeup(spa->spa_livelist_condense_zthr);
+}
+
+/*
+ * Called before the livelist of dsl_dir dir is removed or deleted.
+ */
+void
+spa_livelist_condense_cancel(spa_t *spa, uint64_t dir)
+{
+	list_t *pending = &spa->spa_livelist_condense_pending;
+	spa_livelist_condense_t *slc, *next;
+
+	mutex_enter(&spa->spa_livelist_lock);
+	if (spa->spa_livelist_condense.slc_dir == dir)
+		spa->spa_livelist_condense.slc_cancelled = B_TRUE;
+	for (slc = list_head(pending); slc != NULL; slc = next) {
+		next = list_next(pending, slc);
+		if (slc->slc_dir == dir) {
+			list_remove(pending, slc);
+			kmem_free(slc, sizeof (spa_livelist_condense_t));
+		}
+	}
+	mutex_exit(&spa->spa_livelist_lock);
+}
+
+/*
+ * The sublist being condensed is done with; start on the next one waiting.
+ */
+static void
+spa_livelist_condense_next(spa_t *spa)
+{
+	spa_livelist_condense_t *slc = &spa->spa_livelist_condense;
+	spa_livelist_condense_t *next;
+
+	ASSERT(MUTEX_HELD(&spa->spa_livelist_lock));
+
+	next = list_remove_head(&spa->spa_livelist_condense_pending);
+	if (next != NULL) {
+		slc->slc_dir = next->slc_dir;
+		slc->slc_livelist = next->slc_livelist;
+		slc->slc_mintxg = next->slc_mintxg;
+		slc->slc_bpobj = next->slc_bpobj;
+		slc->slc_cancelled = B_FALSE;
+		kmem_free(next, sizeof (spa_livelist_condense_t));
+	} else {
+		bzero(slc, sizeof (spa_livelist_condense_t));
+	}
+}
+
+/*
+ * Forget the sublists queued for condensing when the pool is unloaded.  A
+ * sublist left uncondensed still holds valid entries, only more of them.
+ */
+static void
+spa_livelist_condense_clear(spa_t *spa)
+{
+	mutex_enter(&spa->spa_livelist_lock);
+	while (spa->spa_livelist_condense.slc_dir != 0)
+		spa_livelist_condense_next(spa);
+	mutex_exit(&spa->spa_livelist_lock);
+}
+
+typedef struct livelist_condense_arg {
+	spa_livelist_condense_t	lca_slc;
+	uint64_t		lca_count;
+	bplist_t		*lca_kept;
+} livelist_condense_arg_t;
+
+static void
+livelist_condense_sync(void *arg, dmu_tx_t *tx)
+{
+	livelist_condense_arg_t *lca = arg;
+	spa_livelist_condense_t *slc = &lca->lca_slc;
+	dsl_pool_t *dp = dmu_tx_pool(tx);
+	spa_t *spa = dp->dp_spa;
+	boolean_t cancelled;
+	dsl_dir_t *dd;
+
+	mutex_enter(&spa->spa_livelist_lock);
+	cancelled = spa->spa_livelist_condense.slc_cancelled;
+	mutex_exit(&spa->spa_livelist_lock);
+	if (cancelled)
+		return;
+
+	if (dsl_dir_hold_obj(dp, slc->slc_dir, NULL, FTAG, &dd) != 0)
+		return;
+	if (dsl_deadlist_is_open(&dd->dd_livelist) &&
+	    dd->dd_livelist.dl_object == slc->slc_livelist) {
+		(void) dsl_livelist_condense_entry(&dd->dd_livelist,
+		    slc->slc_mintxg, slc->slc_bpobj, lca->lca_count,
+		    lca->lca_kept, tx);
+	}
+	dsl_dir_rele(dd, FTAG);
+}
+
+/* ARGSUSED */
+static boolean_t
+spa_livelist_condense_cb_check(void *arg, zthr_t *z)
+{
+	spa_t *spa = arg;
+	boolean_t queued;
+
+	mutex_enter(&spa->spa_livelist_lock);
+	queued = (spa->spa_livelist_condense.slc_dir != 0);
+	mutex_exit(&spa->spa_livelist_lock);
+
+	return (queued);
+}
+
+static void
+spa_livelist_condense_cb(void *arg, zthr_t *z)
+{
+	spa_t *spa = arg;
+	dsl_pool_t *dp = spa_get_dsl(spa);
+	livelist_condense_arg_t lca;
+	bplist_t kept;
+	bpobj_t bpo;
+	int err;
+
+	mutex_enter(&spa->spa_livelist_lock);
+	lca.lca_slc = spa->spa_livelist_condense;
+	mutex_exit(&spa->spa_livelist_lock);
+
+	/*
+	 * The livelist is only freed in syncing context, so it cannot go
+	 * away while we check that it is still wanted and open its sublist.
+	 */
+	dsl_pool_config_enter(dp, FTAG);
+	mutex_enter(&spa->spa_livelist_lock);
+	err = spa->spa_livelist_condense.slc_cancelled ? SET_ERROR(EINTR) : 0;
+	mutex_exit(&spa->spa_livelist_lock);
+	if (err == 0) {
+		err = bpobj_open(&bpo, spa_meta_objset(spa),
+		    lca.lca_slc.slc_bpobj);
+	}
+	dsl_pool_config_exit(dp, FTAG);
+
+	if (err == 0) {
+		bplist_create(&kept);
+		lca.lca_count = bpo.bpo_phys->bpo_num_blkptrs;
+		lca.lca_kept = &kept;
+		err = dsl_livelist_net(&bpo, lca.lca_count, &kept, z,
+		    &spa->spa_livelist_condense.slc_cancelled);
+		bpobj_close(&bpo);
+
+		if (err == 0) {
+			err = dsl_sync_task(spa_name(spa), NULL,
+			    livelist_condense_sync, &lca, 0,
+			    ZFS_SPACE_CHECK_EXTRA_RESERVED);
+		}
+		bplist_clear(&kept);
+		bplist_destroy(&kept);
+	}
+
+	/* retry once resumed if we were interrupted by a suspend */
+	if (!zthr_iscancelled(z)) {
+		mutex_enter(&spa->spa_livelist_lock);
+		spa_livelist_condense_next(spa);
+		mutex_exit(&spa->spa_livelist_lock);
+	}
+}
+
 static void
 spa_spawn_aux_threads(spa_t *spa)
 {
@@ -2461,6 +2939,16 @@ spa_spawn_aux_threads(spa_t *spa)
 	spa->spa_checkpoint_discard_zthr =
 	    zthr_create(spa_checkpoint_discard_thread_check,
 	    spa_checkpoint_discard_thread, spa);
+
+	ASSERT3P(spa->spa_livelist_delete_zthr, ==, NULL);
+	spa->spa_livelist_delete_zthr =
+	    zthr_create(spa_livelist_delete_cb_check,
+	    spa_livelist_delete_cb, spa);
+
+	ASSERT3P(spa->spa_livelist_condense_zthr, ==, NULL);
+	spa->spa_livelist_condense_zthr =
+	    zthr_create(spa_livelist_condense_cb_check,
+	    spa_livelist_condense_cb, spa);
 }
 
 /*
@@ -3688,6 +4176,15 @@ spa_ld_get_props(spa_t *spa)
 		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
 	}
 
+	/*
+	 * Load the zap of livelists of destroyed clones whose blocks are
+	 * still to be freed.  It is only present while there are some.
+	 */
+	error = spa_dir_prop(spa, DMU_POOL_DELETED_CLONES,
+	    &spa->spa_livelists_to_delete, B_FALSE);
+	if (error != 0 && error != ENOENT)
+		return (spa_vdev_err(rvd, VDEV_AUX_CORRUPT_DATA, EIO));
+
 	/*
 	 * Load the bit that tells us to use the new accounting function
 	 * (raid-z deflation).  If we have an older pool, this will not
@@ -7811,6 +8308,14 @@ spa_async_suspend(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_cancel(discard_thread);
+
+	zthr_t *ll_delete_thread = spa->spa_livelist_delete_zthr;
+	if (ll_delete_thread != NULL)
+		zthr_cancel(ll_delete_thread);
+
+	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
+	if (ll_condense_thread != NULL)
+		zthr_cancel(ll_condense_thread);
 }
 
 void
@@ -7829,6 +8334,14 @@ spa_async_resume(spa_t *spa)
 	zthr_t *discard_thread = spa->spa_checkpoint_discard_zthr;
 	if (discard_thread != NULL)
 		zthr_resume(discard_thread);
+
+	zthr_t *ll_delete_thread = spa->spa_livelist_delete_zthr;
+	if (ll_delete_thread != NULL)
+		zthr_resume(ll_delete_thread);
+
+	zthr_t *ll_condense_thread = spa->spa_livelist_condense_zthr;
+	if (ll_condense_thread != NULL)
+		zthr_resume(ll_condense_thread);
 }
 
 static boolean_t
@@ -7889,7 +8402,7 @@ static int
 bpobj_enqueue_cb(void *arg, const blkptr_t *bp, dmu_tx_t *tx)
 {
 	bpobj_t *bpo = arg;
-	bpobj_enqueue(bpo, bp, tx);
+	bpobj_enqueue(bpo, bp, B_FALSE, tx);
 	return (0);
 }
 
@@ -9150,6 +9663,14 @@ module_param(zio_taskq_batch_pct, uint, 0444);
 MODULE_PARM_DESC(zio_taskq_batch_pct,
 	"Percentage of CPUs to run an IO worker thread");
 
+module_param(zio_taskq_numa, int, 0644);
+MODULE_PARM_DESC(zio_taskq_numa,
+	"Bind zio taskqs and ABD page allocations to NUMA nodes");
+
+module_param(zio_compress_taskq_pct, uint, 0444);
+MODULE_PARM_DESC(zio_compress_taskq_pct,
+	"Percentage of CPUs to run write compression threads");
+
 /* BEGIN CSTYLED */
 module_param(zfs_max_missing_tvds, ulong, 0644);
 MODULE_PARM_DESC(zfs_max_missing_tvds,
@@ -69,7 +69,6 @@ bookmark_to_name(zbookmark_phys_t *zb, char *buf, size_t len)
 /*
  * Convert a string to a bookmark
  */
-#ifdef _KERNEL
 static void
 name_to_bookmark(char *buf, zbookmark_phys_t *zb)
 {
@@ -82,7 +81,6 @@ name_to_bookmark(char *buf, zbookmark_phys_t *zb)
 	zb->zb_blkid = zfs_strtonum(buf + 1, &buf);
 	ASSERT(*buf == '\0');
 }
-#endif
 
 /*
  * Log an uncorrectable error to the persistent error log.  We add it to the
@@ -257,6 +255,69 @@ spa_get_errlog(spa_t *spa, void *uaddr, size_t *count)
 	return (ret);
 }
 
+static void
+errlog_add_entry(avl_tree_t *tree, const zbookmark_phys_t *zb)
+{
+	spa_error_entry_t search, *se;
+	avl_index_t where;
+
+	search.se_bookmark = *zb;
+	if (avl_find(tree, &search, &where) != NULL)
+		return;
+
+	se = kmem_zalloc(sizeof (spa_error_entry_t), KM_SLEEP);
+	se->se_bookmark = *zb;
+	avl_insert(tree, se, where);
+}
+
+static void
+errlog_add_log(spa_t *spa, uint64_t obj, avl_tree_t *tree)
+{
+	zap_cursor_t zc;
+	zap_attribute_t za;
+	zbookmark_phys_t zb;
+
+	if (obj == 0)
+		return;
+
+	for (zap_cursor_init(&zc, spa->spa_meta_objset, obj);
+	    zap_cursor_retrieve(&zc, &za) == 0;
+	    zap_cursor_advance(&zc)) {
+		name_to_bookmark(za.za_name, &zb);
+		errlog_add_entry(tree, &zb);
+	}
+	zap_cursor_fini(&zc);
+}
+
+/*
+ * Build a private, sorted and de-duplicated copy of every error currently
+ * known to the pool: both on-disk logs plus the pending in-core lists.  The
+ * tree is created here; the caller frees the spa_error_entry_t nodes and
+ * destroys the tree.  Used by the error scrub to find the blocks to read.
+ */
+void
+spa_get_errlog_entries(spa_t *spa, avl_tree_t *tree)
+{
+	spa_error_entry_t *se;
+
+	avl_create(tree, spa_error_entry_compare, sizeof (spa_error_entry_t),
+	    offsetof(spa_error_entry_t, se_avl));
+
+	mutex_enter(&spa->spa_errlog_lock);
+	errlog_add_log(spa, spa->spa_errlog_scrub, tree);
+	errlog_add_log(spa, spa->spa_errlog_last, tree);
+	mutex_exit(&spa->spa_errlog_lock);
+
+	mutex_enter(&spa->spa_errlist_lock);
+	for (se = avl_first(&spa->spa_errlist_scrub); se != NULL;
+	    se = AVL_NEXT(&spa->spa_errlist_scrub, se))
+		errlog_add_entry(tree, &se->se_bookmark);
+	for (se = avl_first(&spa->spa_errlist_last); se != NULL;
+	    se = AVL_NEXT(&spa->spa_errlist_last, se))
+		errlog_add_entry(tree, &se->se_bookmark);
+	mutex_exit(&spa->spa_errlist_lock);
+}
+
 /*
  * Called when a scrub completes.  This simply set a bit which tells which AVL
  * tree to add new errors.  spa_errlog_sync() is responsible for actually
@@ -417,4 +478,5 @@ EXPORT_SYMBOL(spa_errlog_rotate);
 EXPORT_SYMBOL(spa_errlog_drain);
 EXPORT_SYMBOL(spa_errlog_sync);
 EXPORT_SYMBOL(spa_get_errlists);
+EXPORT_SYMBOL(spa_get_errlog_entries);
 #endif
@@ -41,6 +41,7 @@
 #include <sys/vdev_initialize.h>
 #include <sys/vdev_trim.h>
 #include <sys/vdev_file.h>
+#include <sys/vdev_disk.h>
 #include <sys/vdev_raidz.h>
 #include <sys/metaslab.h>
 #include <sys/uberblock_impl.h>
@@ -49,6 +50,7 @@
 #include <sys/unique.h>
 #include <sys/dsl_pool.h>
 #include <sys/dsl_dir.h>
+#include <sys/dsl_destroy.h>
 #include <sys/dsl_prop.h>
 #include <sys/fm/util.h>
 #include <sys/dsl_scan.h>
@@ -60,6 +62,7 @@
 #include "zfs_prop.h"
 #include <sys/btree.h>
 #include <sys/zfeature.h>
+#include <sys/zfs_rlock.h>
 #include "qat.h"
 
 /*
@@ -670,6 +673,7 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	mutex_init(&spa->spa_vdev_top_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_feat_stats_lock, NULL, MUTEX_DEFAULT, NULL);
 	mutex_init(&spa->spa_flushed_ms_lock, NULL, MUTEX_DEFAULT, NULL);
+	mutex_init(&spa->spa_livelist_lock, NULL, MUTEX_DEFAULT, NULL);
 
 	cv_init(&spa->spa_async_cv, NULL, CV_DEFAULT, NULL);
 	cv_init(&spa->spa_evicting_os_cv, NULL, CV_DEFAULT, NULL);
@@ -722,6 +726,9 @@ spa_add(const char *name, nvlist_t *config, const char *altroot)
 	    sizeof (spa_log_sm_t), offsetof(spa_log_sm_t, sls_node));
 	list_create(&spa->spa_log_summary, sizeof (log_summary_entry_t),
 	    offsetof(log_summary_entry_t, lse_node));
+	list_create(&spa->spa_livelist_condense_pending,
+	    sizeof (spa_livelist_condense_t),
+	    offsetof(spa_livelist_condense_t, slc_node));
 
 	/*
 	 * Every pool starts with the default cachefile
@@ -815,6 +822,7 @@ spa_remove(spa_t *spa)
 	avl_destroy(&spa->spa_metaslabs_by_flushed);
 	avl_destroy(&spa->spa_sm_logs_by_txg);
 	list_destroy(&spa->spa_log_summary);
+	list_destroy(&spa->spa_livelist_condense_pending);
 	list_destroy(&spa->spa_config_list);
 	list_destroy(&spa->spa_leaf_list);
 
@@ -840,6 +848,7 @@ spa_remove(spa_t *spa)
 	cv_destroy(&spa->spa_suspend_cv);
 
 	mutex_destroy(&spa->spa_flushed_ms_lock);
+	mutex_destroy(&spa->spa_livelist_lock);
 	mutex_destroy(&spa->spa_async_lock);
 	mutex_destroy(&spa->spa_errlist_lock);
 	mutex_destroy(&spa->spa_errlog_lock);
@@ -2376,12 +2385,16 @@ spa_init(int mode)
 	metaslab_stat_init();
 	ddt_init();
 	zio_init();
+	zfs_rangelock_readers_init();
 	dmu_init();
 	zil_init();
 	vdev_cache_stat_init();
 	vdev_mirror_stat_init();
 	vdev_raidz_math_init();
 	vdev_file_init();
+#ifdef _KERNEL
+	vdev_disk_init();
+#endif
 	zfs_prop_init();
 	zpool_prop_init();
 	zpool_feature_init();
@@ -2390,6 +2403,7 @@ spa_init(int mode)
 	scan_init();
 	qat_init();
 	spa_import_progress_init();
+	dsl_destroy_init();
 }
 
 void
@@ -2399,12 +2413,19 @@ spa_fini(void)
 
 	spa_evict_all();
 
+	/* Unregisters the QAT compression accelerator */
+	qat_fini();
+
+#ifdef _KERNEL
+	vdev_disk_fini();
+#endif
 	vdev_file_fini();
 	vdev_cache_stat_fini();
 	vdev_mirror_stat_fini();
 	vdev_raidz_math_fini();
 	zil_fini();
 	dmu_fini();
+	zfs_rangelock_readers_fini();
 	zio_fini();
 	ddt_fini();
 	metaslab_stat_fini();
@@ -2413,8 +2434,8 @@ spa_fini(void)
 	zfs_refcount_fini();
 	fm_fini();
 	scan_fini();
-	qat_fini();
 	spa_import_progress_destroy();
+	dsl_destroy_fini();
 
 	avl_destroy(&spa_namespace_avl);
 	avl_destroy(&spa_spare_avl);
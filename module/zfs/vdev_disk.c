@@ -66,6 +66,67 @@ typedef struct dio_request {
 	struct bio		*dr_bio[0];	/* Attached bio's */
 } dio_request_t;
 
+/*
+ * Nearly all zios fit in a handful of bios, so dio_request_t's with room
+ * for up to VDEV_DISK_DIO_BIOS bios are taken from a kmem cache whose
+ * per-cpu magazines avoid a kmem_zalloc() per zio.  Larger requests are
+ * allocated individually.
+ */
+#define	VDEV_DISK_DIO_BIOS	16
+#define	VDEV_DISK_DIO_SIZE(n)	\
+	(sizeof (dio_request_t) + sizeof (struct bio *) * (n))
+
+static kmem_cache_t *vdev_disk_dio_cache;
+
+/*
+ * Polled completion for latency critical I/O.  When zfs_vdev_disk_poll_us
+ * is non-zero, zios whose priority is set in zfs_vdev_disk_poll_mask and
+ * which are issued to non-rotational disks (only to log devices when
+ * zfs_vdev_disk_poll_log_only is set) are not handed to the interrupt
+ * taskq when they complete.  The issuing thread instead waits up to
+ * zfs_vdev_disk_poll_us microseconds for the bios to complete, reaping
+ * them with blk_poll() where the kernel allows it, and then runs the rest
+ * of the zio pipeline itself.  A zio still outstanding when the time is up
+ * completes through the interrupt taskq as usual.  The poll time is capped
+ * at VDEV_DISK_POLL_MAX_US.
+ */
+#define	VDEV_DISK_POLL_MAX_US	1000
+
+static unsigned int zfs_vdev_disk_poll_us = 0;
+static unsigned int zfs_vdev_disk_poll_mask =
+	(1 << ZIO_PRIORITY_SYNC_READ) | (1 << ZIO_PRIORITY_SYNC_WRITE);
+static int zfs_vdev_disk_poll_log_only = 0;
+
+typedef struct vdev_disk_stats {
+	kstat_named_t vds_dios;
+	kstat_named_t vds_bios;
+	kstat_named_t vds_bio_segments;
+	kstat_named_t vds_poll_issued;
+	kstat_named_t vds_poll_inline;
+	kstat_named_t vds_poll_expired;
+} vdev_disk_stats_t;
+
+static vdev_disk_stats_t vdev_disk_stats = {
+	/* zios submitted as a dio_request */
+	{ "dios",			KSTAT_DATA_UINT64 },
+	/* bios submitted for those zios */
+	{ "bios",			KSTAT_DATA_UINT64 },
+	/* bio_vecs mapped into those bios */
+	{ "bio_segments",		KSTAT_DATA_UINT64 },
+	/* zios issued for polled completion */
+	{ "poll_issued",		KSTAT_DATA_UINT64 },
+	/* polled zios completed inline by the issuing thread */
+	{ "poll_inline",		KSTAT_DATA_UINT64 },
+	/* polled zios left to the interrupt taskq when the time ran out */
+	{ "poll_expired",		KSTAT_DATA_UINT64 },
+};
+
+#define	VDSTAT_BUMP(stat)	atomic_inc_64(&vdev_disk_stats.stat.value.ui64)
+#define	VDSTAT_INCR(stat, val) \
+	atomic_add_64(&vdev_disk_stats.stat.value.ui64, (val))
+
+static kstat_t *vdev_disk_ksp;
+
 
 #if defined(HAVE_OPEN_BDEV_EXCLUSIVE) || defined(HAVE_BLKDEV_GET_BY_PATH)
 static fmode_t
@@ -330,17 +391,18 @@ static dio_request_t *
 vdev_disk_dio_alloc(int bio_count)
 {
 	dio_request_t *dr;
-	int i;
 
-	dr = kmem_zalloc(sizeof (dio_request_t) +
-	    sizeof (struct bio *) * bio_count, KM_SLEEP);
+	if (bio_count <= VDEV_DISK_DIO_BIOS) {
+		dr = kmem_cache_alloc(vdev_disk_dio_cache, KM_SLEEP);
+		bzero(dr, VDEV_DISK_DIO_SIZE(bio_count));
+	} else {
+		dr = kmem_zalloc(VDEV_DISK_DIO_SIZE(bio_count), KM_SLEEP);
+	}
+
 	if (dr) {
 		atomic_set(&dr->dr_ref, 0);
 		dr->dr_bio_count = bio_count;
 		dr->dr_error = 0;
-
-		for (i = 0; i < dr->dr_bio_count; i++)
-			dr->dr_bio[i] = NULL;
 	}
 
 	return (dr);
@@ -355,8 +417,10 @@ vdev_disk_dio_free(dio_request_t *dr)
 		if (dr->dr_bio[i])
 			bio_put(dr->dr_bio[i]);
 
-	kmem_free(dr, sizeof (dio_request_t) +
-	    sizeof (struct bio *) * dr->dr_bio_count);
+	if (dr->dr_bio_count <= VDEV_DISK_DIO_BIOS)
+		kmem_cache_free(vdev_disk_dio_cache, dr);
+	else
+		kmem_free(dr, VDEV_DISK_DIO_SIZE(dr->dr_bio_count));
 }
 
 static void
@@ -365,8 +429,13 @@ vdev_disk_dio_get(dio_request_t *dr)
 	atomic_inc(&dr->dr_ref);
 }
 
+/*
+ * Drop a reference on the dio_request.  When the last reference is dropped
+ * the zio is completed through the interrupt taskq, unless 'polled' is set
+ * by a polling issuer which will then run the zio pipeline itself.
+ */
 static int
-vdev_disk_dio_put(dio_request_t *dr)
+vdev_disk_dio_put(dio_request_t *dr, boolean_t polled)
 {
 	int rc = atomic_dec_return(&dr->dr_ref);
 
@@ -386,7 +455,8 @@ vdev_disk_dio_put(dio_request_t *dr)
 			if (zio->io_error)
 				vdev_disk_error(zio);
 
-			zio_delay_interrupt(zio);
+			if (!polled)
+				zio_delay_interrupt(zio);
 		}
 	}
 
@@ -410,7 +480,7 @@ BIO_END_IO_PROTO(vdev_disk_physio_completion, bio, error)
 	}
 
 	/* Drop reference acquired by __vdev_disk_physio */
-	rc = vdev_disk_dio_put(dr);
+	rc = vdev_disk_dio_put(dr, B_FALSE);
 }
 
 static unsigned int
@@ -426,6 +496,11 @@ bio_map(struct bio *bio, void *bio_ptr, unsigned int bio_size)
 		if (bio_size <= 0)
 			break;
 
+#ifdef HAVE_BIO_MULTIPAGE_BVEC
+		/* The direct map is physically contiguous, add it whole */
+		if (!is_vmalloc_addr(bio_ptr))
+			size = bio_size;
+#endif
 		if (size > bio_size)
 			size = bio_size;
 
@@ -461,13 +536,25 @@ bio_map_abd_off(struct bio *bio, abd_t *abd, unsigned int size, size_t off)
 	return (abd_scatter_bio_map_off(bio, abd, size, off));
 }
 
-static inline void
+#ifdef HAVE_BLK_POLL
+typedef blk_qc_t vdev_bio_cookie_t;
+#define	VDEV_BIO_COOKIE_NONE	BLK_QC_T_NONE
+#else
+typedef int vdev_bio_cookie_t;
+#define	VDEV_BIO_COOKIE_NONE	0
+#endif
+
+static inline vdev_bio_cookie_t
 vdev_submit_bio_impl(struct bio *bio)
 {
-#ifdef HAVE_1ARG_SUBMIT_BIO
+#if defined(HAVE_BLK_POLL)
+	return (submit_bio(bio));
+#elif defined(HAVE_1ARG_SUBMIT_BIO)
 	submit_bio(bio);
+	return (VDEV_BIO_COOKIE_NONE);
 #else
 	submit_bio(0, bio);
+	return (VDEV_BIO_COOKIE_NONE);
 #endif
 }
 
@@ -503,31 +590,92 @@ bio_set_dev(struct bio *bio, struct block_device *bdev)
 }
 #endif /* HAVE_BIO_SET_DEV */
 
-static inline void
+static inline vdev_bio_cookie_t
 vdev_submit_bio(struct bio *bio)
 {
+	vdev_bio_cookie_t cookie;
 #ifdef HAVE_CURRENT_BIO_TAIL
 	struct bio **bio_tail = current->bio_tail;
 	current->bio_tail = NULL;
-	vdev_submit_bio_impl(bio);
+	cookie = vdev_submit_bio_impl(bio);
 	current->bio_tail = bio_tail;
 #else
 	struct bio_list *bio_list = current->bio_list;
 	current->bio_list = NULL;
-	vdev_submit_bio_impl(bio);
+	cookie = vdev_submit_bio_impl(bio);
 	current->bio_list = bio_list;
 #endif
+	return (cookie);
+}
+
+/*
+ * Should the completion of this zio be polled for by the issuing thread?
+ */
+static boolean_t
+vdev_disk_poll_wanted(zio_t *zio)
+{
+	vdev_t *v = zio->io_vd;
+
+	return (zfs_vdev_disk_poll_us != 0 &&
+	    zio->io_target_timestamp == 0 &&
+	    zio->io_priority < ZIO_PRIORITY_NUM_QUEUEABLE &&
+	    (zfs_vdev_disk_poll_mask & (1U << zio->io_priority)) &&
+	    v->vdev_nonrot &&
+	    (!zfs_vdev_disk_poll_log_only || v->vdev_top->vdev_islog));
 }
 
+/*
+ * Wait for the bios of a polled dio_request to complete, leaving only the
+ * issuer's reference.  Spin for at most zfs_vdev_disk_poll_us, reaping a
+ * REQ_HIPRI bio with blk_poll() or otherwise waiting on the interrupt
+ * completion.  A REQ_HIPRI bio on a polled queue may only complete by being
+ * polled, so past the deadline it is still reaped, but between sleeps.
+ */
+static void
+vdev_disk_dio_poll(struct block_device *bdev, dio_request_t *dr,
+    vdev_bio_cookie_t cookie)
+{
+	hrtime_t deadline = gethrtime() +
+	    USEC2NSEC(MIN(zfs_vdev_disk_poll_us, VDEV_DISK_POLL_MAX_US));
+
+	while (atomic_read(&dr->dr_ref) > 1) {
+		boolean_t expired = (gethrtime() >= deadline);
+
+#ifdef HAVE_BLK_POLL
+		if (cookie != VDEV_BIO_COOKIE_NONE) {
+			(void) blk_poll(bdev_get_queue(bdev), cookie, !expired);
+			if (expired)
+				usleep_range(10, 100);
+			else
+				cond_resched();
+			continue;
+		}
+#endif
+		if (expired)
+			break;
+
+		cpu_relax();
+		cond_resched();
+	}
+}
+
+/*
+ * Build and submit the bios for a zio.  When 'poll' is set the bios are
+ * polled for, and B_TRUE is returned in 'done' if they all completed
+ * before the poll ended.  The caller must then complete the zio itself.
+ */
 static int
 __vdev_disk_physio(struct block_device *bdev, zio_t *zio,
-    size_t io_size, uint64_t io_offset, int rw, int flags)
+    size_t io_size, uint64_t io_offset, int rw, int flags, boolean_t poll,
+    boolean_t *done)
 {
 	dio_request_t *dr;
 	uint64_t abd_offset;
 	uint64_t bio_offset;
-	int bio_size, bio_count = 16;
+	vdev_bio_cookie_t cookie = VDEV_BIO_COOKIE_NONE;
+	int bio_size, bio_count;
 	int i = 0, error = 0;
+	boolean_t hipri = B_FALSE;
 #if defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
 	struct blk_plug plug;
 #endif
@@ -541,6 +689,15 @@ __vdev_disk_physio(struct block_device *bdev, zio_t *zio,
 		return (SET_ERROR(EIO));
 	}
 
+	/*
+	 * Size the dio for the bios the ABD should map into, one per
+	 * BIO_MAX_PAGES bio_vecs.  With multi-page bvecs a scatter ABD needs
+	 * a bio_vec per contiguous chunk, so a 16M block written from a few
+	 * compound pages fits in a single bio.
+	 */
+	bio_count = MAX(DIV_ROUND_UP(abd_nr_bvecs_off(zio->io_abd, io_size, 0),
+	    BIO_MAX_PAGES), 1);
+
 retry:
 	dr = vdev_disk_dio_alloc(bio_count);
 	if (dr == NULL)
@@ -581,7 +738,7 @@ retry:
 
 		/* bio_alloc() with __GFP_WAIT never returns NULL */
 		dr->dr_bio[i] = bio_alloc(GFP_NOIO,
-		    MIN(abd_nr_pages_off(zio->io_abd, bio_size, abd_offset),
+		    MIN(abd_nr_bvecs_off(zio->io_abd, bio_size, abd_offset),
 		    BIO_MAX_PAGES));
 		if (unlikely(dr->dr_bio[i] == NULL)) {
 			vdev_disk_dio_free(dr);
@@ -609,22 +766,52 @@ retry:
 	/* Extra reference to protect dio_request during vdev_submit_bio */
 	vdev_disk_dio_get(dr);
 
+#if defined(HAVE_BLK_POLL)
+	/* Only a single bio on a polled queue can be reaped by its cookie */
+	if (poll && dr->dr_bio_count == 1 &&
+	    test_bit(QUEUE_FLAG_POLL, &bdev_get_queue(bdev)->queue_flags)) {
+		dr->dr_bio[0]->bi_opf |= REQ_HIPRI;
+		hipri = B_TRUE;
+	}
+#endif
+
 #if defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
 	if (dr->dr_bio_count > 1)
 		blk_start_plug(&plug);
 #endif
 
 	/* Submit all bio's associated with this dio */
-	for (i = 0; i < dr->dr_bio_count; i++)
-		if (dr->dr_bio[i])
-			vdev_submit_bio(dr->dr_bio[i]);
+	VDSTAT_BUMP(vds_dios);
+	for (i = 0; i < dr->dr_bio_count; i++) {
+		if (dr->dr_bio[i] == NULL)
+			continue;
+
+		VDSTAT_BUMP(vds_bios);
+		VDSTAT_INCR(vds_bio_segments, dr->dr_bio[i]->bi_vcnt);
+		cookie = vdev_submit_bio(dr->dr_bio[i]);
+	}
 
 #if defined(HAVE_BLK_QUEUE_HAVE_BLK_PLUG)
 	if (dr->dr_bio_count > 1)
 		blk_finish_plug(&plug);
 #endif
 
-	(void) vdev_disk_dio_put(dr);
+	if (poll) {
+		VDSTAT_BUMP(vds_poll_issued);
+		if (!hipri)
+			cookie = VDEV_BIO_COOKIE_NONE;
+		vdev_disk_dio_poll(bdev, dr, cookie);
+
+		/* Dropping the last reference leaves completion to us */
+		if (vdev_disk_dio_put(dr, B_TRUE) == 0) {
+			VDSTAT_BUMP(vds_poll_inline);
+			*done = B_TRUE;
+		} else {
+			VDSTAT_BUMP(vds_poll_expired);
+		}
+	} else {
+		(void) vdev_disk_dio_put(dr, B_FALSE);
+	}
 
 	return (error);
 }
@@ -679,6 +866,7 @@ vdev_disk_io_start(zio_t *zio)
 	vdev_t *v = zio->io_vd;
 	vdev_disk_t *vd = v->vdev_tsd;
 	unsigned long trim_flags = 0;
+	boolean_t done = B_FALSE;
 	int rw, flags, error;
 
 	/*
@@ -786,7 +974,8 @@ vdev_disk_io_start(zio_t *zio)
 
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 	error = __vdev_disk_physio(vd->vd_bdev, zio,
-	    zio->io_size, zio->io_offset, rw, flags);
+	    zio->io_size, zio->io_offset, rw, flags,
+	    vdev_disk_poll_wanted(zio), &done);
 	rw_exit(&vd->vd_lock);
 
 	if (error) {
@@ -794,6 +983,13 @@ vdev_disk_io_start(zio_t *zio)
 		zio_interrupt(zio);
 		return;
 	}
+
+	/*
+	 * Polled I/O completed, skip the interrupt taskq unless this thread
+	 * is already completing a zio inline or is short of stack.
+	 */
+	if (done)
+		zio_execute_inline(zio);
 }
 
 static void
@@ -861,6 +1057,34 @@ vdev_ops_t vdev_disk_ops = {
 	.vdev_op_leaf = B_TRUE			/* leaf vdev */
 };
 
+void
+vdev_disk_init(void)
+{
+	vdev_disk_dio_cache = kmem_cache_create("vdev_disk_dio",
+	    VDEV_DISK_DIO_SIZE(VDEV_DISK_DIO_BIOS), 0, NULL, NULL, NULL, NULL,
+	    NULL, 0);
+
+	vdev_disk_ksp = kstat_create("zfs", 0, "vdev_disk_stats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (vdev_disk_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (vdev_disk_ksp != NULL) {
+		vdev_disk_ksp->ks_data = &vdev_disk_stats;
+		kstat_install(vdev_disk_ksp);
+	}
+}
+
+void
+vdev_disk_fini(void)
+{
+	if (vdev_disk_ksp != NULL) {
+		kstat_delete(vdev_disk_ksp);
+		vdev_disk_ksp = NULL;
+	}
+
+	kmem_cache_destroy(vdev_disk_dio_cache);
+	vdev_disk_dio_cache = NULL;
+}
+
 /*
  * The zfs_vdev_scheduler module option has been deprecated. Setting this
  * value no longer has any effect.  It has not yet been entirely removed
@@ -883,3 +1107,15 @@ char *zfs_vdev_scheduler = "unused";
 module_param_call(zfs_vdev_scheduler, param_set_vdev_scheduler,
     param_get_charp, &zfs_vdev_scheduler, 0644);
 MODULE_PARM_DESC(zfs_vdev_scheduler, "I/O scheduler");
+
+module_param(zfs_vdev_disk_poll_us, uint, 0644);
+MODULE_PARM_DESC(zfs_vdev_disk_poll_us,
+	"Max microseconds (up to 1000) to poll for latency critical I/O");
+
+module_param(zfs_vdev_disk_poll_mask, uint, 0644);
+MODULE_PARM_DESC(zfs_vdev_disk_poll_mask,
+	"Bitmask of zio priorities eligible for polled completion");
+
+module_param(zfs_vdev_disk_poll_log_only, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_disk_poll_log_only,
+	"Only poll for completion of I/O to log devices");
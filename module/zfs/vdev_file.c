@@ -35,6 +35,10 @@
 #include <sys/abd.h>
 #include <sys/fcntl.h>
 #include <sys/vnode.h>
+#ifdef _KERNEL
+#include <linux/bio.h>
+#include <linux/uio.h>
+#endif
 
 /*
  * Virtual device vector for files.
@@ -42,6 +46,31 @@
 
 static taskq_t *vdev_file_taskq;
 
+/*
+ * When set, file vdevs whose backing filesystem supports O_DIRECT are
+ * additionally opened for direct I/O.  Reads and writes are then issued
+ * asynchronously straight from the zio's ABD pages and completed from
+ * the filesystem's completion callback.  I/Os which cannot be expressed
+ * this way fall back to the buffered, synchronous path.
+ */
+int zfs_vdev_file_aio = 1;
+
+typedef struct vdev_file_stats {
+	kstat_named_t vfs_aio_issued;
+	kstat_named_t vfs_aio_fallback;
+} vdev_file_stats_t;
+
+static vdev_file_stats_t vdev_file_stats = {
+	/* zios issued with asynchronous direct I/O */
+	{ "aio_issued",			KSTAT_DATA_UINT64 },
+	/* zios which could not be, and fell back to buffered I/O */
+	{ "aio_fallback",		KSTAT_DATA_UINT64 },
+};
+
+#define	VFSTAT_BUMP(stat)	atomic_inc_64(&vdev_file_stats.stat.value.ui64)
+
+static kstat_t *vdev_file_ksp;
+
 static void
 vdev_file_hold(vdev_t *vd)
 {
@@ -54,6 +83,221 @@ vdev_file_rele(vdev_t *vd)
 	ASSERT(vd->vdev_path != NULL);
 }
 
+#if defined(_KERNEL) && defined(HAVE_VFS_AIO_BVEC)
+typedef struct vdev_file_aio {
+	struct kiocb	vfa_iocb;	/* Must be first */
+	zio_t		*vfa_zio;	/* Parent zio */
+	uint_t		vfa_align;	/* Required bio_vec alignment */
+	int		vfa_nr;		/* Populated bio_vec's */
+	int		vfa_max;	/* Allocated bio_vec's */
+	struct bio_vec	vfa_bvec[0];	/* Pages of the zio's ABD */
+} vdev_file_aio_t;
+
+#define	VDEV_FILE_AIO_SIZE(max)	\
+	(sizeof (vdev_file_aio_t) + (max) * sizeof (struct bio_vec))
+
+/*
+ * Open a second O_DIRECT handle on the backing file.  Filesystems which
+ * do not implement direct I/O refuse the open, in which case all I/O
+ * goes through the buffered vnode.
+ */
+static void
+vdev_file_aio_open(vdev_t *vd, vdev_file_t *vf)
+{
+	struct block_device *bdev;
+	struct file *fp;
+	int flags = O_DIRECT | O_LARGEFILE;
+
+	if (!zfs_vdev_file_aio)
+		return;
+
+	flags |= (spa_mode(vd->vdev_spa) & FWRITE) ? O_RDWR : O_RDONLY;
+	fp = filp_open(vd->vdev_path, flags, 0);
+	if (IS_ERR(fp))
+		return;
+
+	if (fp->f_op->read_iter == NULL || fp->f_op->write_iter == NULL) {
+		(void) filp_close(fp, NULL);
+		return;
+	}
+
+	bdev = file_inode(fp)->i_sb->s_bdev;
+	vf->vf_dio_file = fp;
+	vf->vf_dio_align = (bdev != NULL) ?
+	    bdev_logical_block_size(bdev) : SPA_MINBLOCKSIZE;
+}
+
+static void
+vdev_file_aio_close(vdev_file_t *vf)
+{
+	if (vf->vf_dio_file != NULL) {
+		(void) filp_close(vf->vf_dio_file, NULL);
+		vf->vf_dio_file = NULL;
+	}
+}
+
+static void
+vdev_file_aio_completion(struct kiocb *iocb, long ret, long ret2)
+{
+	vdev_file_aio_t *vfa = (vdev_file_aio_t *)iocb;
+	zio_t *zio = vfa->vfa_zio;
+
+	if (ret < 0)
+		zio->io_error = -ret;
+	else if ((uint64_t)ret != zio->io_size)
+		zio->io_error = SET_ERROR(ENOSPC);
+
+	kmem_free(vfa, VDEV_FILE_AIO_SIZE(vfa->vfa_max));
+	zio_delay_interrupt(zio);
+}
+
+static int
+vdev_file_aio_map(struct page *page, size_t off, size_t len, void *private)
+{
+	vdev_file_aio_t *vfa = private;
+	struct bio_vec *bv;
+
+	if (((off | len) & (vfa->vfa_align - 1)) != 0)
+		return (SET_ERROR(EINVAL));
+
+	ASSERT3S(vfa->vfa_nr, <, vfa->vfa_max);
+	bv = &vfa->vfa_bvec[vfa->vfa_nr++];
+	bv->bv_page = page;
+	bv->bv_offset = off;
+	bv->bv_len = len;
+
+	return (0);
+}
+
+/*
+ * Issue the zio as asynchronous direct I/O against the ABD's pages.
+ * Returns non-zero without having issued anything when the zio must
+ * instead be handled by the buffered path: ABDs not backed by pages,
+ * requests which do not meet the direct I/O alignment, or filesystems
+ * rejecting the request outright.  Otherwise the zio is completed by
+ * vdev_file_aio_completion(), possibly before this function returns.
+ */
+static int
+vdev_file_aio_strategy(zio_t *zio)
+{
+	vdev_file_t *vf = zio->io_vd->vdev_tsd;
+	struct file *fp = vf->vf_dio_file;
+	int rw = (zio->io_type == ZIO_TYPE_READ) ? READ : WRITE;
+	vdev_file_aio_t *vfa;
+	struct iov_iter iter;
+	ssize_t ret;
+	int error, max;
+
+	if (((zio->io_offset | zio->io_size) & (vf->vf_dio_align - 1)) != 0)
+		return (SET_ERROR(EINVAL));
+
+	max = DIV_ROUND_UP(zio->io_size, PAGESIZE) + 1;
+	vfa = kmem_alloc(VDEV_FILE_AIO_SIZE(max), KM_SLEEP);
+	vfa->vfa_zio = zio;
+	vfa->vfa_align = vf->vf_dio_align;
+	vfa->vfa_nr = 0;
+	vfa->vfa_max = max;
+
+	error = abd_iterate_page_func(zio->io_abd, 0, zio->io_size,
+	    vdev_file_aio_map, vfa);
+	if (error != 0) {
+		kmem_free(vfa, VDEV_FILE_AIO_SIZE(max));
+		return (error);
+	}
+
+	init_sync_kiocb(&vfa->vfa_iocb, fp);
+	vfa->vfa_iocb.ki_pos = zio->io_offset;
+	vfa->vfa_iocb.ki_complete = vdev_file_aio_completion;
+#if defined(HAVE_IOV_ITER_TYPE)
+	iov_iter_bvec(&iter, rw, vfa->vfa_bvec, vfa->vfa_nr, zio->io_size);
+#else
+	iov_iter_bvec(&iter, ITER_BVEC | rw, vfa->vfa_bvec, vfa->vfa_nr,
+	    zio->io_size);
+#endif
+
+	if (rw == WRITE) {
+		file_start_write(fp);
+		ret = fp->f_op->write_iter(&vfa->vfa_iocb, &iter);
+		file_end_write(fp);
+	} else {
+		ret = fp->f_op->read_iter(&vfa->vfa_iocb, &iter);
+	}
+
+	/*
+	 * The request is in flight, or has already completed, and the
+	 * vdev_file_aio_t must no longer be referenced.
+	 */
+	if (ret == -EIOCBQUEUED)
+		return (0);
+
+	/*
+	 * The filesystem handled the request synchronously.  A misaligned
+	 * request is retried through the buffered path.
+	 */
+	if (ret == -EINVAL) {
+		kmem_free(vfa, VDEV_FILE_AIO_SIZE(max));
+		return (SET_ERROR(EINVAL));
+	}
+
+	vdev_file_aio_completion(&vfa->vfa_iocb, ret, 0);
+
+	return (0);
+}
+#endif /* _KERNEL && HAVE_VFS_AIO_BVEC */
+
+#if !defined(_KERNEL)
+typedef struct vdev_file_iov {
+	struct iovec	*vfi_iov;
+	int		vfi_cnt;
+	int		vfi_max;
+} vdev_file_iov_t;
+
+static int
+vdev_file_iov_map(void *buf, size_t len, void *private)
+{
+	vdev_file_iov_t *vfi = private;
+
+	ASSERT3S(vfi->vfi_cnt, <, vfi->vfi_max);
+	vfi->vfi_iov[vfi->vfi_cnt].iov_base = buf;
+	vfi->vfi_iov[vfi->vfi_cnt].iov_len = len;
+	vfi->vfi_cnt++;
+
+	return (0);
+}
+
+/*
+ * In userspace the ABD's chunks remain addressable after iteration,
+ * so they are passed directly to preadv(2)/pwritev(2) rather than
+ * being copied through a linear buffer.
+ */
+static void
+vdev_file_iov_strategy(zio_t *zio)
+{
+	vdev_file_t *vf = zio->io_vd->vdev_tsd;
+	vdev_file_iov_t vfi;
+	ssize_t resid;
+
+	vfi.vfi_max = zio->io_size / PAGESIZE + 2;
+	vfi.vfi_iov = kmem_alloc(vfi.vfi_max * sizeof (struct iovec),
+	    KM_SLEEP);
+	vfi.vfi_cnt = 0;
+
+	(void) abd_iterate_func(zio->io_abd, 0, zio->io_size,
+	    vdev_file_iov_map, &vfi);
+
+	zio->io_error = vn_rdwrv(zio->io_type == ZIO_TYPE_READ ?
+	    UIO_READ : UIO_WRITE, vf->vf_vnode, vfi.vfi_iov, vfi.vfi_cnt,
+	    zio->io_offset, &resid);
+
+	kmem_free(vfi.vfi_iov, vfi.vfi_max * sizeof (struct iovec));
+
+	if (resid != 0 && zio->io_error == 0)
+		zio->io_error = SET_ERROR(ENOSPC);
+
+	zio_interrupt_inline(zio);
+}
+#endif /* !_KERNEL */
+
 static int
 vdev_file_open(vdev_t *vd, uint64_t *psize, uint64_t *max_psize,
     uint64_t *ashift)
@@ -126,6 +370,10 @@ vdev_file_open(vdev_t *vd, uint64_t *psize, uint64_t *max_psize,
 		vd->vdev_stat.vs_aux = VDEV_AUX_OPEN_FAILED;
 		return (SET_ERROR(ENODEV));
 	}
+
+#if defined(HAVE_VFS_AIO_BVEC)
+	vdev_file_aio_open(vd, vf);
+#endif
 #endif
 
 skip_open:
@@ -159,6 +407,10 @@ vdev_file_close(vdev_t *vd)
 		    kcred, NULL);
 	}
 
+#if defined(_KERNEL) && defined(HAVE_VFS_AIO_BVEC)
+	vdev_file_aio_close(vf);
+#endif
+
 	vd->vdev_delayed_close = B_FALSE;
 	kmem_free(vf, sizeof (vdev_file_t));
 	vd->vdev_tsd = NULL;
@@ -173,6 +425,21 @@ vdev_file_io_strategy(void *arg)
 	ssize_t resid;
 	void *buf;
 
+#if defined(_KERNEL) && defined(HAVE_VFS_AIO_BVEC)
+	if (vf->vf_dio_file != NULL && zfs_vdev_file_aio) {
+		if (vdev_file_aio_strategy(zio) == 0) {
+			VFSTAT_BUMP(vfs_aio_issued);
+			return;
+		}
+		VFSTAT_BUMP(vfs_aio_fallback);
+	}
+#elif !defined(_KERNEL)
+	if (!abd_is_linear(zio->io_abd)) {
+		vdev_file_iov_strategy(zio);
+		return;
+	}
+#endif
+
 	if (zio->io_type == ZIO_TYPE_READ)
 		buf = abd_borrow_buf(zio->io_abd, zio->io_size);
 	else
@@ -190,7 +457,7 @@ vdev_file_io_strategy(void *arg)
 	if (resid != 0 && zio->io_error == 0)
 		zio->io_error = SET_ERROR(ENOSPC);
 
-	zio_delay_interrupt(zio);
+	zio_interrupt_inline(zio);
 }
 
 static void
@@ -201,7 +468,7 @@ vdev_file_io_fsync(void *arg)
 
 	zio->io_error = VOP_FSYNC(vf->vf_vnode, FSYNC | FDSYNC, kcred, NULL);
 
-	zio_interrupt(zio);
+	zio_interrupt_inline(zio);
 }
 
 static void
@@ -266,6 +533,12 @@ vdev_file_io_start(zio_t *zio)
 
 	zio->io_target_timestamp = zio_handle_io_delay(zio);
 
+	/*
+	 * Both the buffered and the direct I/O paths are issued from the
+	 * taskq.  Like vfs_fsync() above, the filesystem may need to write
+	 * back dirty pages, which is not safe with PF_FSTRANS set.  When
+	 * the direct I/O is queued the taskq thread returns immediately.
+	 */
 	VERIFY3U(taskq_dispatch(vdev_file_taskq, vdev_file_io_strategy, zio,
 	    TQ_SLEEP), !=, TASKQID_INVALID);
 }
@@ -299,14 +572,33 @@ vdev_file_init(void)
 	    minclsyspri, boot_ncpus, INT_MAX, TASKQ_DYNAMIC);
 
 	VERIFY(vdev_file_taskq);
+
+	vdev_file_ksp = kstat_create("zfs", 0, "vdev_file_stats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (vdev_file_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+	if (vdev_file_ksp != NULL) {
+		vdev_file_ksp->ks_data = &vdev_file_stats;
+		kstat_install(vdev_file_ksp);
+	}
 }
 
 void
 vdev_file_fini(void)
 {
+	if (vdev_file_ksp != NULL) {
+		kstat_delete(vdev_file_ksp);
+		vdev_file_ksp = NULL;
+	}
+
 	taskq_destroy(vdev_file_taskq);
 }
 
+#if defined(_KERNEL)
+module_param(zfs_vdev_file_aio, int, 0644);
+MODULE_PARM_DESC(zfs_vdev_file_aio,
+	"Use asynchronous direct I/O for file vdevs when supported");
+#endif
+
 /*
  * From userland we access disks just like files.
  */
@@ -462,6 +462,59 @@ zfs_unlinked_add(znode_t *zp, dmu_tx_t *tx)
 	dataset_kstats_update_nunlinks_kstat(&zfsvfs->z_kstat, 1);
 }
 
+/*
+ * Maximum number of unlinked set entries which are released concurrently
+ * by zfs_unlinked_drain().  Each one is handed to the pool's iput taskq,
+ * so that freeing a large file does not hold up the rest of the set.
+ */
+int zfs_unlinked_drain_threads = 16;
+
+typedef struct zfs_unlinked_drain_arg {
+	zfsvfs_t	*zuda_zfsvfs;
+	uint64_t	zuda_obj;
+} zfs_unlinked_drain_arg_t;
+
+/*
+ * Release a single entry from the unlinked set.
+ */
+static void
+zfs_unlinked_drain_obj(void *arg)
+{
+	zfs_unlinked_drain_arg_t *zuda = arg;
+	zfsvfs_t *zfsvfs = zuda->zuda_zfsvfs;
+	znode_t *zp;
+
+	/*
+	 * We need to re-mark these list entries for deletion,
+	 * so we pull them back into core and set zp->z_unlinked.
+	 *
+	 * We may pick up znodes that are already marked for deletion.
+	 * This could happen during the purge of an extended attribute
+	 * directory.  All we need to do is skip over them, since they
+	 * are already in the system marked z_unlinked.
+	 */
+	if (zfs_zget(zfsvfs, zuda->zuda_obj, &zp) == 0) {
+		zp->z_unlinked = B_TRUE;
+
+		/*
+		 * iput() is Linux's equivalent to illumos' VN_RELE(). It
+		 * will decrement the inode's ref count and may cause the
+		 * inode to be synchronously freed. We interrupt freeing of
+		 * this inode, by checking the return value of
+		 * dmu_objset_zfs_unmounting() in dmu_free_long_range(),
+		 * when an unmount is requested.
+		 */
+		iput(ZTOI(zp));
+		ASSERT3B(zfsvfs->z_unmounted, ==, B_FALSE);
+	}
+	kmem_free(zuda, sizeof (zfs_unlinked_drain_arg_t));
+
+	mutex_enter(&zfsvfs->z_drain_lock);
+	zfsvfs->z_drain_inflight--;
+	cv_broadcast(&zfsvfs->z_drain_cv);
+	mutex_exit(&zfsvfs->z_drain_lock);
+}
+
 /*
  * Clean up any znodes that had no links when we either crashed or
  * (force) umounted the file system.
@@ -470,10 +523,11 @@ static void
 zfs_unlinked_drain_task(void *arg)
 {
 	zfsvfs_t *zfsvfs = arg;
+	taskq_t *tq = dsl_pool_iput_taskq(dmu_objset_pool(zfsvfs->z_os));
+	zfs_unlinked_drain_arg_t *zuda;
 	zap_cursor_t	zc;
 	zap_attribute_t zap;
 	dmu_object_info_t doi;
-	znode_t		*zp;
 	int		error;
 
 	ASSERT3B(zfsvfs->z_draining, ==, B_TRUE);
@@ -496,35 +550,36 @@ zfs_unlinked_drain_task(void *arg)
 
 		ASSERT((doi.doi_type == DMU_OT_PLAIN_FILE_CONTENTS) ||
 		    (doi.doi_type == DMU_OT_DIRECTORY_CONTENTS));
-		/*
-		 * We need to re-mark these list entries for deletion,
-		 * so we pull them back into core and set zp->z_unlinked.
-		 */
-		error = zfs_zget(zfsvfs, zap.za_first_integer, &zp);
 
 		/*
-		 * We may pick up znodes that are already marked for deletion.
-		 * This could happen during the purge of an extended attribute
-		 * directory.  All we need to do is skip over them, since they
-		 * are already in the system marked z_unlinked.
+		 * Wait for a slot, then release the entry asynchronously.
 		 */
-		if (error != 0)
-			continue;
-
-		zp->z_unlinked = B_TRUE;
-
-		/*
-		 * iput() is Linux's equivalent to illumos' VN_RELE(). It will
-		 * decrement the inode's ref count and may cause the inode to be
-		 * synchronously freed. We interrupt freeing of this inode, by
-		 * checking the return value of dmu_objset_zfs_unmounting() in
-		 * dmu_free_long_range(), when an unmount is requested.
-		 */
-		iput(ZTOI(zp));
-		ASSERT3B(zfsvfs->z_unmounted, ==, B_FALSE);
+		mutex_enter(&zfsvfs->z_drain_lock);
+		while (zfsvfs->z_drain_inflight >=
+		    MAX(zfs_unlinked_drain_threads, 1))
+			cv_wait(&zfsvfs->z_drain_cv, &zfsvfs->z_drain_lock);
+		zfsvfs->z_drain_inflight++;
+		mutex_exit(&zfsvfs->z_drain_lock);
+
+		zuda = kmem_alloc(sizeof (zfs_unlinked_drain_arg_t), KM_SLEEP);
+		zuda->zuda_zfsvfs = zfsvfs;
+		zuda->zuda_obj = zap.za_first_integer;
+		if (taskq_dispatch(tq, zfs_unlinked_drain_obj, zuda,
+		    TQ_SLEEP) == TASKQID_INVALID)
+			zfs_unlinked_drain_obj(zuda);
 	}
 	zap_cursor_fini(&zc);
 
+	/*
+	 * Wait for every dispatched entry, including those still running
+	 * after a cancellation, so zfs_unlinked_drain_stop_wait() returns
+	 * only once no drain work remains.
+	 */
+	mutex_enter(&zfsvfs->z_drain_lock);
+	while (zfsvfs->z_drain_inflight != 0)
+		cv_wait(&zfsvfs->z_drain_cv, &zfsvfs->z_drain_lock);
+	mutex_exit(&zfsvfs->z_drain_lock);
+
 	zfsvfs->z_draining = B_FALSE;
 	zfsvfs->z_drain_task = TASKQID_INVALID;
 }
@@ -1209,3 +1264,11 @@ zfs_sticky_remove_access(znode_t *zdp, znode_t *zp, cred_t *cr)
 	else
 		return (secpolicy_vnode_remove(cr));
 }
+
+#if defined(_KERNEL)
+/* BEGIN CSTYLED */
+module_param(zfs_unlinked_drain_threads, int, 0644);
+MODULE_PARM_DESC(zfs_unlinked_drain_threads,
+	"Max unlinked set entries released concurrently at mount");
+/* END CSTYLED */
+#endif
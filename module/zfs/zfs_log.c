@@ -523,7 +523,12 @@ zfs_log_write(zilog_t *zilog, dmu_tx_t *tx, int txtype,
 		return;
 	}
 
-	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT)
+	/*
+	 * O_DIRECT is only passed by zfs_write() for data it wrote to disk
+	 * with dmu_write_direct_by_dbuf(); log its block pointer instead of
+	 * reading the data back into the ARC.
+	 */
+	if (zilog->zl_logbias == ZFS_LOGBIAS_THROUGHPUT || (ioflag & O_DIRECT))
 		write_state = WR_INDIRECT;
 	else if (!spa_has_slogs(zilog->zl_spa) &&
 	    resid >= zfs_immediate_write_sz)
@@ -94,11 +94,33 @@
  * So if the block size needs to be grown then the whole file is
  * exclusively locked, then later the caller will reduce the lock
  * range to just the range to be written using rangelock_reduce().
+ *
+ * Reader fast path
+ * ----------------
+ * Taking rl_lock and inserting into the AVL tree for every read makes the
+ * mutex the hottest lock when many threads read the same file.  Once a
+ * rangelock has seen concurrent readers it sets rl_fast.  While no writer
+ * holds or waits for a lock (rl_writers == 0) a reader then only adds
+ * itself to the reader list for its CPU under that list's rr_lock, and is
+ * granted the lock without touching rl_lock or the tree.  The per-CPU
+ * lists are allocated once and shared by every rangelock, so enabling the
+ * fast path costs no memory.  A writer first announces itself by
+ * incrementing rl_writers, which sends new readers down the regular path.
+ * Once the callback has settled the range it will lock, the writer walks
+ * each list looking for fast path readers of the same rangelock which
+ * overlap that range.  If it finds one it drops rl_lock, waits on rr_cv,
+ * and starts over.  Because readers check rl_writers while holding
+ * rr_lock, a reader either sees the writer and takes the regular path, or
+ * is on the list before the writer scans it.
  */
 
 #include <sys/zfs_context.h>
 #include <sys/zfs_rlock.h>
 
+static rangelock_readers_t **zfs_rangelock_readers;
+static uint_t zfs_rangelock_nreaders;
+static kmem_cache_t *zfs_rangelock_readers_cache;
+
 /*
  * AVL comparison function used to order range locks
  * Locks are ordered on the start offset of the range.
@@ -125,15 +147,170 @@ zfs_rangelock_init(rangelock_t *rl, rangelock_cb_t *cb, void *arg)
 	    sizeof (locked_range_t), offsetof(locked_range_t, lr_node));
 	rl->rl_cb = cb;
 	rl->rl_arg = arg;
+	rl->rl_fast = B_FALSE;
+	rl->rl_writers = 0;
+}
+
+/*
+ * Disable the fast path, returning the rangelock to the state
+ * zfs_rangelock_init() left it in.  Used when a cached znode is reused
+ * for a different file.  The rangelock must not be in use.
+ */
+void
+zfs_rangelock_reset(rangelock_t *rl)
+{
+	ASSERT0(rl->rl_writers);
+	ASSERT0(avl_numnodes(&rl->rl_tree));
+	rl->rl_fast = B_FALSE;
 }
 
 void
 zfs_rangelock_fini(rangelock_t *rl)
 {
+	zfs_rangelock_reset(rl);
 	mutex_destroy(&rl->rl_lock);
 	avl_destroy(&rl->rl_tree);
 }
 
+void
+zfs_rangelock_readers_init(void)
+{
+	uint_t n = MAX(1, boot_ncpus);
+
+	zfs_rangelock_readers_cache = kmem_cache_create(
+	    "zfs_rangelock_readers_cache", sizeof (rangelock_readers_t),
+	    64, NULL, NULL, NULL, NULL, NULL, 0);
+	zfs_rangelock_readers = kmem_alloc(n * sizeof (rangelock_readers_t *),
+	    KM_SLEEP);
+	for (uint_t i = 0; i < n; i++) {
+		rangelock_readers_t *rr;
+
+		rr = kmem_cache_alloc(zfs_rangelock_readers_cache, KM_SLEEP);
+		mutex_init(&rr->rr_lock, NULL, MUTEX_DEFAULT, NULL);
+		cv_init(&rr->rr_cv, NULL, CV_DEFAULT, NULL);
+		list_create(&rr->rr_list, sizeof (locked_range_t),
+		    offsetof(locked_range_t, lr_fast_node));
+		rr->rr_waiters = 0;
+		zfs_rangelock_readers[i] = rr;
+	}
+	zfs_rangelock_nreaders = n;
+}
+
+void
+zfs_rangelock_readers_fini(void)
+{
+	for (uint_t i = 0; i < zfs_rangelock_nreaders; i++) {
+		rangelock_readers_t *rr = zfs_rangelock_readers[i];
+
+		ASSERT0(rr->rr_waiters);
+		list_destroy(&rr->rr_list);
+		cv_destroy(&rr->rr_cv);
+		mutex_destroy(&rr->rr_lock);
+		kmem_cache_free(zfs_rangelock_readers_cache, rr);
+	}
+	kmem_free(zfs_rangelock_readers,
+	    zfs_rangelock_nreaders * sizeof (rangelock_readers_t *));
+	zfs_rangelock_readers = NULL;
+	zfs_rangelock_nreaders = 0;
+	kmem_cache_destroy(zfs_rangelock_readers_cache);
+}
+
+/*
+ * Try to grant a reader lock without taking rl_lock.  Returns B_FALSE if
+ * the fast path is not available, in which case the caller must use the
+ * tree.
+ */
+static boolean_t
+zfs_rangelock_enter_fast(rangelock_t *rl, locked_range_t *new)
+{
+	rangelock_readers_t *rr;
+	uint_t bucket;
+
+	if (!*(volatile boolean_t *)&rl->rl_fast ||
+	    *(volatile uint_t *)&rl->rl_writers != 0)
+		return (B_FALSE);
+
+	kpreempt_disable();
+	bucket = CPU_SEQID % zfs_rangelock_nreaders;
+	kpreempt_enable();
+
+	rr = zfs_rangelock_readers[bucket];
+	mutex_enter(&rr->rr_lock);
+	if (*(volatile uint_t *)&rl->rl_writers != 0) {
+		mutex_exit(&rr->rr_lock);
+		return (B_FALSE);
+	}
+	new->lr_fast = B_TRUE;
+	new->lr_bucket = bucket;
+	new->lr_count = 0;
+	list_insert_tail(&rr->rr_list, new);
+	mutex_exit(&rr->rr_lock);
+
+	return (B_TRUE);
+}
+
+static void
+zfs_rangelock_exit_fast(locked_range_t *lr)
+{
+	rangelock_readers_t *rr = zfs_rangelock_readers[lr->lr_bucket];
+
+	mutex_enter(&rr->rr_lock);
+	list_remove(&rr->rr_list, lr);
+	if (rr->rr_waiters != 0)
+		cv_broadcast(&rr->rr_cv);
+	mutex_exit(&rr->rr_lock);
+
+	kmem_free(lr, sizeof (locked_range_t));
+}
+
+/*
+ * Wait for a fast path reader which overlaps the writer's range.  Readers
+ * arriving after rl_writers was raised take the regular path, so only the
+ * readers already on the lists need to be checked.  rl_lock is dropped
+ * while waiting; returns B_TRUE if it was, in which case the caller must
+ * start over.
+ */
+static boolean_t
+zfs_rangelock_drain_fast(rangelock_t *rl, locked_range_t *new)
+{
+	uint64_t off = new->lr_offset;
+	uint64_t len = new->lr_length;
+
+	ASSERT(MUTEX_HELD(&rl->rl_lock));
+	ASSERT3U(rl->rl_writers, !=, 0);
+
+	if (!rl->rl_fast)
+		return (B_FALSE);
+
+	for (uint_t i = 0; i < zfs_rangelock_nreaders; i++) {
+		rangelock_readers_t *rr = zfs_rangelock_readers[i];
+		locked_range_t *lr;
+
+		mutex_enter(&rr->rr_lock);
+		for (lr = list_head(&rr->rr_list); lr != NULL;
+		    lr = list_next(&rr->rr_list, lr)) {
+			if (lr->lr_rangelock == rl &&
+			    lr->lr_offset < off + len &&
+			    lr->lr_offset + lr->lr_length > off)
+				break;
+		}
+		if (lr == NULL) {
+			mutex_exit(&rr->rr_lock);
+			continue;
+		}
+
+		mutex_exit(&rl->rl_lock);
+		rr->rr_waiters++;
+		cv_wait(&rr->rr_cv, &rr->rr_lock);
+		rr->rr_waiters--;
+		mutex_exit(&rr->rr_lock);
+		mutex_enter(&rl->rl_lock);
+		return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
 /*
  * Check if a write lock can be grabbed, or wait and recheck until available.
  */
@@ -163,6 +340,9 @@ zfs_rangelock_enter_writer(rangelock_t *rl, locked_range_t *new)
 		 */
 		ASSERT3U(new->lr_type, ==, RL_WRITER);
 
+		if (zfs_rangelock_drain_fast(rl, new))
+			goto retry;
+
 		/*
 		 * First check for the usual case of no locks
 		 */
@@ -196,7 +376,7 @@ wait:
 			lr->lr_write_wanted = B_TRUE;
 		}
 		cv_wait(&lr->lr_write_cv, &rl->rl_lock);
-
+retry:
 		/* reset to original */
 		new->lr_offset = orig_off;
 		new->lr_length = orig_len;
@@ -464,18 +644,31 @@ zfs_rangelock_enter(rangelock_t *rl, uint64_t off, uint64_t len,
 	new->lr_proxy = B_FALSE;
 	new->lr_write_wanted = B_FALSE;
 	new->lr_read_wanted = B_FALSE;
+	new->lr_fast = B_FALSE;
+	new->lr_bucket = 0;
+
+	if (type == RL_READER && zfs_rangelock_enter_fast(rl, new))
+		return (new);
 
 	mutex_enter(&rl->rl_lock);
 	if (type == RL_READER) {
 		/*
 		 * First check for the usual case of no locks
 		 */
-		if (avl_numnodes(&rl->rl_tree) == 0)
+		if (avl_numnodes(&rl->rl_tree) == 0) {
 			avl_add(&rl->rl_tree, new);
-		else
+		} else {
+			/*
+			 * Readers are sharing this rangelock; let the next
+			 * ones skip rl_lock while there are no writers.
+			 */
+			if (rl->rl_writers == 0)
+				rl->rl_fast = B_TRUE;
 			zfs_rangelock_enter_reader(rl, new);
+		}
 	} else {
 		/* RL_WRITER or RL_APPEND */
+		atomic_inc_32_nv(&rl->rl_writers);
 		zfs_rangelock_enter_writer(rl, new);
 	}
 	mutex_exit(&rl->rl_lock);
@@ -573,6 +766,12 @@ zfs_rangelock_exit(locked_range_t *lr)
 	ASSERT(lr->lr_count == 1 || lr->lr_count == 0);
 	ASSERT(!lr->lr_proxy);
 
+	if (lr->lr_fast) {
+		ASSERT3U(lr->lr_type, ==, RL_READER);
+		zfs_rangelock_exit_fast(lr);
+		return;
+	}
+
 	/*
 	 * The free list is used to defer the cv_destroy() and
 	 * subsequent kmem_free until after the mutex is dropped.
@@ -584,6 +783,7 @@ zfs_rangelock_exit(locked_range_t *lr)
 	if (lr->lr_type == RL_WRITER) {
 		/* writer locks can't be shared or split */
 		avl_remove(&rl->rl_tree, lr);
+		atomic_dec_32_nv(&rl->rl_writers);
 		if (lr->lr_write_wanted)
 			cv_broadcast(&lr->lr_write_cv);
 		if (lr->lr_read_wanted)
@@ -635,6 +835,7 @@ zfs_rangelock_reduce(locked_range_t *lr, uint64_t off, uint64_t len)
 #if defined(_KERNEL)
 EXPORT_SYMBOL(zfs_rangelock_init);
 EXPORT_SYMBOL(zfs_rangelock_fini);
+EXPORT_SYMBOL(zfs_rangelock_reset);
 EXPORT_SYMBOL(zfs_rangelock_enter);
 EXPORT_SYMBOL(zfs_rangelock_exit);
 EXPORT_SYMBOL(zfs_rangelock_reduce);
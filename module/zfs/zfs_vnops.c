@@ -38,6 +38,7 @@
 #include <sys/file.h>
 #include <sys/stat.h>
 #include <sys/kmem.h>
+#include <sys/kstat.h>
 #include <sys/taskq.h>
 #include <sys/uio.h>
 #include <sys/vmsystm.h>
@@ -69,6 +70,7 @@
 #include <sys/zpl.h>
 #include <sys/zil.h>
 #include <sys/sa_impl.h>
+#include <sys/abd.h>
 
 /*
  * Programming rules.
@@ -268,14 +270,12 @@ zfs_holey_common(struct inode *ip, int cmd, loff_t *off)
 
 	if (error == ESRCH)
 		return (SET_ERROR(ENXIO));
+	if (error)
+		return (error);
 
-	/* file was dirty, so fall back to using generic logic */
-	if (error == EBUSY) {
-		if (hole)
-			*off = file_sz;
-
-		return (0);
-	}
+	/* Data past the logical EOF (e.g. from a racing truncate) */
+	if (!hole && noff >= file_sz)
+		return (SET_ERROR(ENXIO));
 
 	/*
 	 * We could find a hole that begins after the logical end-of-file,
@@ -310,6 +310,66 @@ zfs_holey(struct inode *ip, int cmd, loff_t *off)
 	ZFS_EXIT(zfsvfs);
 	return (error);
 }
+
+/*
+ * FIEMAP support.  Reports the data regions of [start, start + len) as
+ * a series of extents by alternating SEEK_DATA and SEEK_HOLE lookups.
+ * ZFS has no stable mapping from file offset to a single device address
+ * so every extent is flagged FIEMAP_EXTENT_UNKNOWN with no physical
+ * location.  Like lseek(2), dirty and freed ranges not yet synced are
+ * reflected without waiting for the txg to sync.
+ */
+int
+zfs_fiemap(struct inode *ip, struct fiemap_extent_info *fei,
+    uint64_t start, uint64_t len)
+{
+	znode_t	*zp = ITOZ(ip);
+	zfsvfs_t *zfsvfs = ITOZSB(ip);
+	loff_t data, hole, end;
+	uint32_t flags;
+	int error = 0;
+
+	ZFS_ENTER(zfsvfs);
+	ZFS_VERIFY_ZP(zp);
+
+	if (len > MAXOFFSET_T - start)
+		end = MAXOFFSET_T;
+	else
+		end = start + len;
+
+	data = start;
+	while (data < end) {
+		error = zfs_holey_common(ip, SEEK_DATA, &data);
+		if (error == ENXIO) {
+			error = 0;
+			break;
+		}
+		if (error || data >= end)
+			break;
+
+		hole = data;
+		error = zfs_holey_common(ip, SEEK_HOLE, &hole);
+		if (error)
+			break;
+
+		flags = FIEMAP_EXTENT_UNKNOWN;
+		if (hole >= zp->z_size)
+			flags |= FIEMAP_EXTENT_LAST;
+
+		/* Returns 1 once the caller's extent array is full. */
+		error = fiemap_fill_next_extent(fei, data, 0, hole - data,
+		    flags);
+		if (error) {
+			error = (error == 1) ? 0 : -error;
+			break;
+		}
+
+		data = hole;
+	}
+
+	ZFS_EXIT(zfsvfs);
+	return (error);
+}
 #endif /* SEEK_HOLE && SEEK_DATA */
 
 #if defined(_KERNEL)
@@ -417,6 +477,80 @@ mappedread(struct inode *ip, int nbytes, uio_t *uio)
 unsigned long zfs_read_chunk_size = 1024 * 1024; /* Tunable */
 unsigned long zfs_delete_blocks = DMU_MAX_DELETEBLKCNT;
 
+/*
+ * Decide whether I/O to this file may bypass the ARC, as controlled by
+ * the "direct" property.  Memory mapped files always use the buffered
+ * path so that the page cache stays coherent, and the caller is still
+ * responsible for only sending whole, block-aligned ranges this way.
+ */
+static boolean_t
+zfs_direct_enabled(znode_t *zp, int ioflag)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+
+	switch (zfsvfs->z_os->os_direct) {
+	case ZFS_DIRECT_DISABLED:
+		return (B_FALSE);
+	case ZFS_DIRECT_STANDARD:
+		if (!(ioflag & O_DIRECT))
+			return (B_FALSE);
+		break;
+	default:
+		break;
+	}
+
+	return (!zp->z_is_mapped && ISP2(zp->z_blksz));
+}
+
+/*
+ * Set up an ABD holding the next full block of a direct write.  The user's
+ * pages may only be written from in place when 'pages' is supplied, which
+ * the caller does for encrypted datasets alone: the zio then reads them
+ * exactly once, to encrypt them, and everything after that, checksumming
+ * and each vdev child's write, uses the ciphertext.  Otherwise the checksum
+ * and the writes would each read the application's buffer, and one
+ * modified meanwhile would leave a block which fails its checksum, so the
+ * data is copied into a kernel buffer.  Either way this is done before
+ * entering the transaction, so that a page fault can't hold it up.
+ */
+static int
+zfs_direct_write_abd(uio_t *uio, size_t size, struct page **pages,
+    uint_t *npages, abd_t **abdp)
+{
+	size_t cbytes;
+	abd_t *abd;
+	int error;
+
+	if (pages != NULL &&
+	    uio_get_user_pages(uio, size, UIO_WRITE, pages, npages) == 0) {
+		*abdp = abd_get_from_pages(pages, *npages, size);
+		return (0);
+	}
+
+	*npages = 0;
+	abd = abd_alloc_linear(size, B_FALSE);
+	if ((error = uiocopy(abd_to_buf(abd), size, UIO_WRITE, uio,
+	    &cbytes))) {
+		abd_free(abd);
+		return (error);
+	}
+	ASSERT(cbytes == size);
+	*abdp = abd;
+
+	return (0);
+}
+
+static void
+zfs_direct_write_abd_free(abd_t *abd, struct page **pages, uint_t npages)
+{
+	if (npages != 0) {
+		abd_put(abd);
+		uio_put_user_pages(pages, npages, UIO_WRITE);
+	} else {
+		abd_free(abd);
+	}
+}
+
 /*
  * Read bytes from specified file into supplied buffer.
  *
@@ -501,6 +635,21 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	ssize_t n = MIN(uio->uio_resid, zp->z_size - uio->uio_loffset);
 	ssize_t start_resid = n;
 
+	/*
+	 * Reads of whole blocks (or running to end-of-file) may be served
+	 * straight from disk.  Read at least a block at a time so that a
+	 * large block is never fetched more than once, and no more than
+	 * SPA_MAXBLOCKSIZE at a time, which dmu_read_uio_direct() maps at
+	 * once.
+	 */
+	boolean_t direct = zfs_direct_enabled(zp, ioflag) &&
+	    P2PHASE(uio->uio_loffset, zp->z_blksz) == 0 &&
+	    (P2PHASE(n, zp->z_blksz) == 0 ||
+	    uio->uio_loffset + n == zp->z_size);
+	ssize_t chunk = zfs_read_chunk_size;
+	if (direct)
+		chunk = P2ROUNDUP(MIN(chunk, SPA_MAXBLOCKSIZE), zp->z_blksz);
+
 #ifdef HAVE_UIO_ZEROCOPY
 	xuio_t *xuio = NULL;
 	if ((uio->uio_extflg == UIO_XUIO) &&
@@ -534,10 +683,13 @@ zfs_read(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 #endif /* HAVE_UIO_ZEROCOPY */
 
 	while (n > 0) {
-		ssize_t nbytes = MIN(n, zfs_read_chunk_size -
-		    P2PHASE(uio->uio_loffset, zfs_read_chunk_size));
+		ssize_t nbytes = MIN(n, chunk -
+		    P2PHASE(uio->uio_loffset, chunk));
 
-		if (zp->z_is_mapped && !(ioflag & O_DIRECT)) {
+		if (direct) {
+			error = dmu_read_uio_direct(sa_get_db(zp->z_sa_hdl),
+			    uio, nbytes);
+		} else if (zp->z_is_mapped) {
 			error = mappedread(ip, nbytes, uio);
 		} else {
 			error = dmu_read_uio_dbuf(sa_get_db(zp->z_sa_hdl),
@@ -564,6 +716,107 @@ out:
 	return (error);
 }
 
+/*
+ * Pass bytes of a file to the caller without copying them where possible,
+ * for splice(2) and sendfile(2).  Data the ARC holds uncompressed in pages
+ * is handed to pagefunc, which may take references to the pages; all other
+ * data is handed to copyfunc.  See dmu_read_pages_dbuf().
+ *
+ *	IN:	ip	- inode of file to be read from.
+ *		off	- offset to start reading at.
+ *		len	- number of bytes to read.
+ *		pagefunc - called for each referenceable page.
+ *		copyfunc - called for each range which must be copied.
+ *		private	- argument passed to pagefunc and copyfunc.
+ *		ioflag	- FSYNC flags; used to provide FRSYNC semantics.
+ *		cr	- credentials of caller.
+ *
+ *	RETURN:	0 on success, error code on failure.  ENOTSUP if the file
+ *		is memory mapped, in which case the page cache may hold
+ *		newer data and the caller must use zfs_read() instead.
+ *		A non-zero return from pagefunc or copyfunc stops the read
+ *		and is returned.
+ *
+ * Side Effects:
+ *	The caller is responsible for updating the atime.
+ */
+/* ARGSUSED */
+int
+zfs_read_pages(struct inode *ip, offset_t off, size_t len,
+    abd_iter_page_func_t *pagefunc, abd_iter_func_t *copyfunc, void *private,
+    int ioflag, cred_t *cr)
+{
+	int error = 0;
+	boolean_t frsync = B_FALSE;
+
+	znode_t *zp = ITOZ(ip);
+	zfsvfs_t *zfsvfs = ITOZSB(ip);
+	ZFS_ENTER(zfsvfs);
+	ZFS_VERIFY_ZP(zp);
+
+	if (zp->z_pflags & ZFS_AV_QUARANTINED) {
+		ZFS_EXIT(zfsvfs);
+		return (SET_ERROR(EACCES));
+	}
+
+	if (off < (offset_t)0) {
+		ZFS_EXIT(zfsvfs);
+		return (SET_ERROR(EINVAL));
+	}
+
+	if (len == 0) {
+		ZFS_EXIT(zfsvfs);
+		return (0);
+	}
+
+#ifdef FRSYNC
+	frsync = !!(ioflag & FRSYNC);
+#endif
+	if (zfsvfs->z_log &&
+	    (frsync || zfsvfs->z_os->os_sync == ZFS_SYNC_ALWAYS))
+		zil_commit(zfsvfs->z_log, zp->z_id);
+
+	locked_range_t *lr = zfs_rangelock_enter(&zp->z_rangelock,
+	    off, len, RL_READER);
+
+	if (zp->z_is_mapped) {
+		error = SET_ERROR(ENOTSUP);
+		goto out;
+	}
+
+	if (off >= zp->z_size)
+		goto out;
+
+	ssize_t n = MIN(len, zp->z_size - off);
+	ssize_t start_resid = n;
+
+	while (n > 0) {
+		ssize_t nbytes = MIN(n, zfs_read_chunk_size -
+		    P2PHASE(off, zfs_read_chunk_size));
+
+		error = dmu_read_pages_dbuf(sa_get_db(zp->z_sa_hdl), off,
+		    nbytes, pagefunc, copyfunc, private);
+		if (error) {
+			/* convert checksum errors into IO errors */
+			if (error == ECKSUM)
+				error = SET_ERROR(EIO);
+			break;
+		}
+
+		off += nbytes;
+		n -= nbytes;
+	}
+
+	int64_t nread = start_resid - n;
+	dataset_kstats_update_read_kstats(&zfsvfs->z_kstat, nread);
+	task_io_account_read(nread);
+out:
+	zfs_rangelock_exit(lr);
+
+	ZFS_EXIT(zfsvfs);
+	return (error);
+}
+
 /*
  * Write the bytes to a file.
  *
@@ -706,6 +959,12 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 
 	uint64_t end_size = MAX(zp->z_size, woff + n);
 	zilog_t *zilog = zfsvfs->z_log;
+	boolean_t direct = zfs_direct_enabled(zp, ioflag);
+	size_t dpages_size = (max_blksz >> PAGE_SHIFT) * sizeof (struct page *);
+	struct page **dpages = NULL;
+	uint_t dnpages = 0;
+	if (direct && dpages_size > 0 && zfsvfs->z_os->os_encrypted)
+		dpages = vmem_alloc(dpages_size, KM_SLEEP);
 #ifdef HAVE_UIO_ZEROCOPY
 	int		i_iov = 0;
 	const iovec_t	*iovp = uio->uio_iov;
@@ -733,6 +992,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		}
 
 		arc_buf_t *abuf = NULL;
+		abd_t *dabd = NULL;
 		const iovec_t *aiov = NULL;
 		if (xuio) {
 #ifdef HAVE_UIO_ZEROCOPY
@@ -746,6 +1006,17 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			    aiov->iov_len == arc_buf_size(abuf)));
 			i_iov++;
 #endif
+		} else if (direct && n >= max_blksz &&
+		    P2PHASE(woff, max_blksz) == 0 &&
+		    zp->z_blksz == max_blksz) {
+			/*
+			 * Full block direct write.  The data is written
+			 * straight to disk without being cached.
+			 */
+			error = zfs_direct_write_abd(uio, max_blksz, dpages,
+			    &dnpages, &dabd);
+			if (error != 0)
+				break;
 		} else if (n >= max_blksz && woff >= zp->z_size &&
 		    P2PHASE(woff, max_blksz) == 0 &&
 		    zp->z_blksz == max_blksz) {
@@ -786,6 +1057,9 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			dmu_tx_abort(tx);
 			if (abuf != NULL)
 				dmu_return_arcbuf(abuf);
+			if (dabd != NULL)
+				zfs_direct_write_abd_free(dabd, dpages,
+				    dnpages);
 			break;
 		}
 
@@ -798,17 +1072,23 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		if (lr->lr_length == UINT64_MAX) {
 			uint64_t new_blksz;
 
-			if (zp->z_blksz > max_blksz) {
+			if (zp->z_blksz > max_blksz && !ISP2(zp->z_blksz)) {
 				/*
 				 * File's blocksize is already larger than the
 				 * "recordsize" property.  Only let it grow to
 				 * the next power of 2.
 				 */
-				ASSERT(!ISP2(zp->z_blksz));
 				new_blksz = MIN(end_size,
 				    1 << highbit64(zp->z_blksz));
 			} else {
-				new_blksz = MIN(end_size, max_blksz);
+				/*
+				 * Appending past a full first record may
+				 * promote the file to "appendrecordsize".
+				 */
+				new_blksz = zfs_append_blocksize(zp, woff,
+				    end_size);
+				if (new_blksz == 0)
+					new_blksz = MIN(end_size, max_blksz);
 			}
 			zfs_grow_blocksize(zp, new_blksz, tx);
 			zfs_rangelock_reduce(lr, woff, n);
@@ -821,7 +1101,18 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 		ssize_t nbytes = MIN(n, max_blksz - P2PHASE(woff, max_blksz));
 
 		ssize_t tx_bytes;
-		if (abuf == NULL) {
+		if (dabd != NULL) {
+			tx_bytes = nbytes;
+			ASSERT3S(tx_bytes, ==, max_blksz);
+			error = dmu_write_direct_by_dbuf(sa_get_db(zp->z_sa_hdl),
+			    woff, dabd, tx);
+			zfs_direct_write_abd_free(dabd, dpages, dnpages);
+			if (error != 0) {
+				dmu_tx_commit(tx);
+				break;
+			}
+			uioskip(uio, tx_bytes);
+		} else if (abuf == NULL) {
 			tx_bytes = uio->uio_resid;
 			uio->uio_fault_disable = B_TRUE;
 			error = dmu_write_uio_dbuf(sa_get_db(zp->z_sa_hdl),
@@ -868,7 +1159,7 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 			ASSERT(tx_bytes <= uio->uio_resid);
 			uioskip(uio, tx_bytes);
 		}
-		if (tx_bytes && zp->z_is_mapped && !(ioflag & O_DIRECT)) {
+		if (tx_bytes && zp->z_is_mapped) {
 			update_pages(ip, woff,
 			    tx_bytes, zfsvfs->z_os, zp->z_id);
 		}
@@ -932,7 +1223,13 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 
 		error = sa_bulk_update(zp->z_sa_hdl, bulk, count, tx);
 
-		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes, ioflag,
+		/*
+		 * A block written directly is already on disk, so it is
+		 * logged by reference rather than read back in to be copied
+		 * into the log; see zfs_log_write().
+		 */
+		zfs_log_write(zilog, tx, TX_WRITE, zp, woff, tx_bytes,
+		    (ioflag & ~O_DIRECT) | (dabd != NULL ? O_DIRECT : 0),
 		    NULL, NULL);
 		dmu_tx_commit(tx);
 
@@ -952,6 +1249,9 @@ zfs_write(struct inode *ip, uio_t *uio, int ioflag, cred_t *cr)
 	zfs_inode_update(zp);
 	zfs_rangelock_exit(lr);
 
+	if (dpages != NULL)
+		vmem_free(dpages, dpages_size);
+
 	/*
 	 * If we're in replay mode, or we made no progress, return error.
 	 * Otherwise, it's at least a partial write, so it's successful.
@@ -1102,9 +1402,13 @@ zfs_get_data(void *arg, lr_write_t *lr, char *buf, struct lwb *lwb, zio_t *zio)
 			zil_fault_io = 0;
 		}
 #endif
+		/*
+		 * dmu_sync() reads the block in only if it must, so that a
+		 * block written with direct I/O is not pulled into the ARC.
+		 */
 		if (error == 0)
-			error = dmu_buf_hold(os, object, offset, zgd, &db,
-			    DMU_READ_NO_PREFETCH);
+			error = dmu_buf_hold_noread(os, object, offset, zgd,
+			    &db);
 
 		if (error == 0) {
 			blkptr_t *bp = &lr->lr_blkptr;
@@ -2241,6 +2545,172 @@ out:
 	return (error);
 }
 
+/*
+ * Directory entry dnode prefetch statistics, exported as the
+ * "zfs_readdir_prefetch" kstat.  The hit rate is hits / blocks.
+ */
+typedef struct zfs_readdir_prefetch_stats {
+	/* Batches of upcoming directory entries prefetched */
+	kstat_named_t zrps_windows;
+	/* Directory entries in those batches */
+	kstat_named_t zrps_entries;
+	/* Distinct dnode blocks referenced by those entries */
+	kstat_named_t zrps_blocks;
+	/* Dnode blocks which were already cached */
+	kstat_named_t zrps_hits;
+	/* Dnode blocks which had a prefetch read issued */
+	kstat_named_t zrps_misses;
+} zfs_readdir_prefetch_stats_t;
+
+static zfs_readdir_prefetch_stats_t zfs_readdir_prefetch_stats = {
+	{ "windows",			KSTAT_DATA_UINT64 },
+	{ "entries",			KSTAT_DATA_UINT64 },
+	{ "blocks",			KSTAT_DATA_UINT64 },
+	{ "hits",			KSTAT_DATA_UINT64 },
+	{ "misses",			KSTAT_DATA_UINT64 },
+};
+
+#define	ZRPSTAT_INCR(stat, val) \
+	atomic_add_64(&zfs_readdir_prefetch_stats.stat.value.ui64, (val))
+#define	ZRPSTAT_BUMP(stat)	ZRPSTAT_INCR(stat, 1)
+
+static kstat_t *zfs_readdir_prefetch_ksp;
+
+/*
+ * zfs_readdir() reads ahead of the entries it returns with a second ZAP
+ * cursor and prefetches the dnode blocks of the upcoming entries.  The
+ * read ahead window starts at zfs_readdir_prefetch_min entries and is
+ * doubled each time it is refilled and some of its dnode blocks were not
+ * already cached, up to zfs_readdir_prefetch_max entries.  Setting
+ * zfs_readdir_prefetch_max to 0 disables the read ahead.
+ */
+int zfs_readdir_prefetch_min = 32;
+int zfs_readdir_prefetch_max = 1024;
+
+typedef struct zfs_readdir_prefetch {
+	zap_cursor_t	zrp_zc;		/* cursor ahead of the reader */
+	zap_attribute_t	zrp_za;
+	uint64_t	*zrp_objs;	/* objects of the next window */
+	int		zrp_window;	/* entries to read ahead next */
+	int		zrp_max;	/* maximum window size */
+	int		zrp_ahead;	/* entries prefetched, not yet read */
+	boolean_t	zrp_eof;	/* zrp_zc reached the end */
+} zfs_readdir_prefetch_t;
+
+void
+zfs_readdir_prefetch_init(void)
+{
+	zfs_readdir_prefetch_ksp = kstat_create("zfs", 0,
+	    "zfs_readdir_prefetch", "misc", KSTAT_TYPE_NAMED,
+	    sizeof (zfs_readdir_prefetch_stats) / sizeof (kstat_named_t),
+	    KSTAT_FLAG_VIRTUAL);
+
+	if (zfs_readdir_prefetch_ksp != NULL) {
+		zfs_readdir_prefetch_ksp->ks_data = &zfs_readdir_prefetch_stats;
+		kstat_install(zfs_readdir_prefetch_ksp);
+	}
+}
+
+void
+zfs_readdir_prefetch_fini(void)
+{
+	if (zfs_readdir_prefetch_ksp != NULL) {
+		kstat_delete(zfs_readdir_prefetch_ksp);
+		zfs_readdir_prefetch_ksp = NULL;
+	}
+}
+
+/*
+ * Prefetch the dnode blocks of a batch of directory entries, issuing a
+ * single read for each distinct dnode block.  The objs array is sorted.
+ * Returns B_TRUE if every dnode block was already cached.
+ */
+static boolean_t
+zfs_readdir_prefetch_dnodes(objset_t *os, uint64_t *objs, int count)
+{
+	int nblks, hits;
+
+	if (count == 0)
+		return (B_TRUE);
+
+	hits = dmu_prefetch_dnodes(os, objs, count, ZIO_PRIORITY_SYNC_READ,
+	    &nblks);
+
+	ZRPSTAT_BUMP(zrps_windows);
+	ZRPSTAT_INCR(zrps_entries, count);
+	ZRPSTAT_INCR(zrps_blocks, nblks);
+	ZRPSTAT_INCR(zrps_hits, hits);
+	ZRPSTAT_INCR(zrps_misses, nblks - hits);
+
+	return (hits == nblks);
+}
+
+static zfs_readdir_prefetch_t *
+zfs_readdir_prefetch_create(objset_t *os, uint64_t zapobj, uint64_t offset)
+{
+	zfs_readdir_prefetch_t *zrp;
+	int max = zfs_readdir_prefetch_max;
+
+	if (max <= 0)
+		return (NULL);
+
+	zrp = kmem_zalloc(sizeof (zfs_readdir_prefetch_t), KM_SLEEP);
+	zrp->zrp_objs = vmem_alloc(max * sizeof (uint64_t), KM_SLEEP);
+	zrp->zrp_max = max;
+	zrp->zrp_window = MAX(MIN(zfs_readdir_prefetch_min, max), 1);
+
+	if (offset <= 3)
+		zap_cursor_init(&zrp->zrp_zc, os, zapobj);
+	else
+		zap_cursor_init_serialized(&zrp->zrp_zc, os, zapobj, offset);
+
+	return (zrp);
+}
+
+static void
+zfs_readdir_prefetch_destroy(zfs_readdir_prefetch_t *zrp)
+{
+	zap_cursor_fini(&zrp->zrp_zc);
+	vmem_free(zrp->zrp_objs, zrp->zrp_max * sizeof (uint64_t));
+	kmem_free(zrp, sizeof (zfs_readdir_prefetch_t));
+}
+
+/*
+ * Called before each directory entry is read.  Once fewer than half a
+ * window of prefetched entries remain, read the next window ahead.
+ */
+static void
+zfs_readdir_prefetch(objset_t *os, zfs_readdir_prefetch_t *zrp)
+{
+	zap_attribute_t *za = &zrp->zrp_za;
+	int n;
+
+	if (zrp->zrp_ahead > 0)
+		zrp->zrp_ahead--;
+
+	if (zrp->zrp_eof || zrp->zrp_ahead > zrp->zrp_window / 2)
+		return;
+
+	for (n = 0; n < zrp->zrp_window; n++) {
+		if (zap_cursor_retrieve(&zrp->zrp_zc, za) != 0) {
+			zrp->zrp_eof = B_TRUE;
+			break;
+		}
+
+		if (za->za_integer_length == 8 && za->za_num_integers > 0)
+			zrp->zrp_objs[n] = ZFS_DIRENT_OBJ(za->za_first_integer);
+		else
+			zrp->zrp_objs[n] = 0;
+
+		zap_cursor_advance(&zrp->zrp_zc);
+	}
+
+	zrp->zrp_ahead += n;
+
+	if (!zfs_readdir_prefetch_dnodes(os, zrp->zrp_objs, n))
+		zrp->zrp_window = MIN(zrp->zrp_window * 2, zrp->zrp_max);
+}
+
 /*
  * Read directory entries from the given directory cursor position and emit
  * name and position for each entry.
@@ -2269,8 +2739,8 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 	objset_t	*os;
 	zap_cursor_t	zc;
 	zap_attribute_t	zap;
+	zfs_readdir_prefetch_t *zrp = NULL;
 	int		error;
-	uint8_t		prefetch;
 	uint8_t		type;
 	int		done = 0;
 	uint64_t	parent;
@@ -2292,7 +2762,6 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 	error = 0;
 	os = zfsvfs->z_os;
 	offset = ctx->pos;
-	prefetch = zp->z_zn_prefetch;
 
 	/*
 	 * Initialize the iterator cursor.
@@ -2309,6 +2778,9 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 		zap_cursor_init_serialized(&zc, os, zp->z_id, offset);
 	}
 
+	if (zp->z_zn_prefetch)
+		zrp = zfs_readdir_prefetch_create(os, zp->z_id, offset);
+
 	/*
 	 * Transform to file-system independent format
 	 */
@@ -2333,6 +2805,9 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 			objnum = ZFSCTL_INO_ROOT;
 			type = DT_DIR;
 		} else {
+			if (zrp != NULL)
+				zfs_readdir_prefetch(os, zrp);
+
 			/*
 			 * Grab next entry.
 			 */
@@ -2372,12 +2847,6 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 		if (done)
 			break;
 
-		/* Prefetch znode */
-		if (prefetch) {
-			dmu_prefetch(os, objnum, 0, 0, 0,
-			    ZIO_PRIORITY_SYNC_READ);
-		}
-
 		/*
 		 * Move to the next entry, fill in the previous offset.
 		 */
@@ -2393,6 +2862,8 @@ zfs_readdir(struct inode *ip, zpl_dir_context_t *ctx, cred_t *cr)
 
 update:
 	zap_cursor_fini(&zc);
+	if (zrp != NULL)
+		zfs_readdir_prefetch_destroy(zrp);
 	if (error == ENOENT)
 		error = 0;
 out:
@@ -2401,6 +2872,200 @@ out:
 	return (error);
 }
 
+/*
+ * Maximum number of directory entries zfs_readdirplus() reads ahead of
+ * the attribute lookups, so that all of their dnodes can be prefetched
+ * together.  This roughly matches the number of entries in a ZAP leaf.
+ */
+int zfs_readdirplus_batch = 256;
+
+typedef struct zfs_readdirplus_ent {
+	uint64_t	re_obj;
+	uint64_t	re_cookie;
+	uint8_t		re_type;
+	char		re_name[ZAP_MAXNAMELEN];
+} zfs_readdirplus_ent_t;
+
+/*
+ * Read directory entries along with their attributes.
+ *
+ *	IN:	ip	- inode of directory to read.
+ *		uio	- buffer to fill with zfs_direntplus_t records.
+ *		cookiep	- position to resume reading from, 0 for the start.
+ *		cr	- credentials of caller.
+ *
+ *	OUT:	uio	- updated past the records returned.
+ *		cookiep	- position after the last record returned.
+ *		countp	- number of records returned.
+ *		eofp	- set once the end of the directory was reached.
+ *
+ *	RETURN:	0 on success, error code on failure.
+ *
+ * Unlike zfs_readdir() no dot entries are returned and the attributes
+ * are read straight from each entry's SA.  Entries are read from the
+ * ZAP in batches and the dnodes for a whole batch are prefetched before
+ * any of their attributes are looked up, rather than stalling on one
+ * dnode block read per entry.  The uio may be a user or kernel buffer so
+ * this can be used by in-kernel consumers as well as the ioctl.
+ */
+int
+zfs_readdirplus(struct inode *ip, uio_t *uio, uint64_t *cookiep,
+    uint32_t *countp, boolean_t *eofp, cred_t *cr)
+{
+	znode_t		*zp = ITOZ(ip);
+	zfsvfs_t	*zfsvfs = ITOZSB(ip);
+	objset_t	*os;
+	zap_cursor_t	zc;
+	zap_attribute_t	*zap;
+	zfs_readdirplus_ent_t *ents;
+	zfs_direntplus_t *zde;
+	uint64_t	*objs;
+	boolean_t	eof = B_FALSE;
+	boolean_t	full = B_FALSE;
+	int		batch, n, i;
+	int		error = 0;
+
+	ZFS_ENTER(zfsvfs);
+	ZFS_VERIFY_ZP(zp);
+
+	*countp = 0;
+	*eofp = B_FALSE;
+
+	/*
+	 * Quit if directory has been removed (posix)
+	 */
+	if (zp->z_unlinked) {
+		*eofp = B_TRUE;
+		ZFS_EXIT(zfsvfs);
+		return (0);
+	}
+
+	/*
+	 * Returning the entries' attributes is equivalent to a lookup of
+	 * each of them, which requires search permission on the directory.
+	 */
+	if ((error = zfs_zaccess(zp, ACE_EXECUTE, 0, B_FALSE, cr)) != 0) {
+		ZFS_EXIT(zfsvfs);
+		return (error);
+	}
+
+	os = zfsvfs->z_os;
+	batch = MAX(zfs_readdirplus_batch, 1);
+	ents = vmem_alloc(batch * sizeof (zfs_readdirplus_ent_t), KM_SLEEP);
+	objs = vmem_alloc(batch * sizeof (uint64_t), KM_SLEEP);
+	zap = kmem_alloc(sizeof (zap_attribute_t), KM_SLEEP);
+	zde = kmem_alloc(ZFS_DIRENTPLUS_RECLEN(ZAP_MAXNAMELEN), KM_SLEEP);
+
+	if (*cookiep == 0)
+		zap_cursor_init(&zc, os, zp->z_id);
+	else
+		zap_cursor_init_serialized(&zc, os, zp->z_id, *cookiep);
+
+	while (!eof && !full && error == 0) {
+		size_t resid = uio->uio_resid;
+
+		/*
+		 * Read ahead as many entries as will fit in the buffer.
+		 */
+		for (n = 0; n < batch; n++) {
+			zfs_readdirplus_ent_t *re = &ents[n];
+			size_t reclen;
+
+			if ((error = zap_cursor_retrieve(&zc, zap)) != 0) {
+				if (error == ENOENT) {
+					error = 0;
+					eof = B_TRUE;
+				}
+				break;
+			}
+
+			if (zap->za_integer_length != 8 ||
+			    zap->za_num_integers == 0) {
+				error = SET_ERROR(ENXIO);
+				break;
+			}
+
+			reclen = ZFS_DIRENTPLUS_RECLEN(strlen(zap->za_name));
+			if (reclen > resid) {
+				full = B_TRUE;
+				break;
+			}
+			resid -= reclen;
+
+			re->re_obj = ZFS_DIRENT_OBJ(zap->za_first_integer);
+			re->re_type = ZFS_DIRENT_TYPE(zap->za_first_integer);
+			(void) strlcpy(re->re_name, zap->za_name,
+			    sizeof (re->re_name));
+
+			zap_cursor_advance(&zc);
+			re->re_cookie = zap_cursor_serialize(&zc);
+		}
+
+		for (i = 0; i < n; i++)
+			objs[i] = ents[i].re_obj;
+		(void) zfs_readdir_prefetch_dnodes(os, objs, n);
+
+		for (i = 0; i < n; i++) {
+			zfs_readdirplus_ent_t *re = &ents[i];
+			size_t namelen = strlen(re->re_name);
+			size_t reclen = ZFS_DIRENTPLUS_RECLEN(namelen);
+			int err;
+
+			bzero(zde, reclen);
+			err = zfs_obj_to_direntplus(zfsvfs, re->re_obj, zde);
+			if (err == ENOENT) {
+				/* Removed since the entry was read, skip it */
+				*cookiep = re->re_cookie;
+				continue;
+			} else if (err != 0) {
+				error = err;
+				break;
+			}
+
+			zde->zde_uid = zfs_fuid_map_id(zfsvfs, zde->zde_uid,
+			    cr, ZFS_OWNER);
+			zde->zde_gid = zfs_fuid_map_id(zfsvfs, zde->zde_gid,
+			    cr, ZFS_GROUP);
+			zde->zde_ino = re->re_obj;
+			zde->zde_cookie = re->re_cookie;
+			zde->zde_reclen = reclen;
+			zde->zde_namelen = namelen;
+			zde->zde_type = re->re_type;
+			bcopy(re->re_name, zde->zde_name, namelen);
+
+			if ((err = uiomove(zde, reclen, UIO_READ, uio)) != 0) {
+				error = err;
+				break;
+			}
+
+			*cookiep = re->re_cookie;
+			(*countp)++;
+		}
+	}
+
+	zap_cursor_fini(&zc);
+
+	kmem_free(zde, ZFS_DIRENTPLUS_RECLEN(ZAP_MAXNAMELEN));
+	kmem_free(zap, sizeof (zap_attribute_t));
+	vmem_free(objs, batch * sizeof (uint64_t));
+	vmem_free(ents, batch * sizeof (zfs_readdirplus_ent_t));
+
+	/*
+	 * Return what was read before an error.  The cookie allows the
+	 * caller to resume and see the error on the next call.
+	 */
+	if (error != 0 && *countp > 0)
+		error = 0;
+	else if (error == 0 && eof)
+		*eofp = B_TRUE;
+	else if (error == 0 && *countp == 0 && full)
+		error = SET_ERROR(EINVAL);
+
+	ZFS_EXIT(zfsvfs);
+
+	return (error);
+}
+
 ulong_t zfs_fsync_sync_cnt = 4;
 
 int
@@ -4751,41 +5416,37 @@ zfs_seek(struct inode *ip, offset_t ooff, offset_t *noffp)
 }
 
 /*
- * Fill pages with data from the disk.
+ * Fill pages with data from the disk.  The pages must be contiguous in
+ * the file.  All of the dbufs backing the range are held with a single
+ * dmu_buf_hold_array call, so the reads for every record in a readahead
+ * window are issued together, and each record is then copied into the
+ * pages it covers.  Any part of a page beyond the end of the file is
+ * zero filled.
  */
 static int
 zfs_fillpage(struct inode *ip, struct page *pl[], int nr_pages)
 {
 	znode_t *zp = ITOZ(ip);
-	zfsvfs_t *zfsvfs = ITOZSB(ip);
-	objset_t *os;
-	struct page *cur_pp;
-	u_offset_t io_off, total;
+	dmu_buf_t **dbp = NULL;
+	u_offset_t io_off, off;
 	size_t io_len;
 	loff_t i_size;
-	unsigned page_idx;
+	int numbufs = 0;
+	int page_idx, i = 0;
 	int err;
 
-	os = zfsvfs->z_os;
 	io_len = nr_pages << PAGE_SHIFT;
 	i_size = i_size_read(ip);
 	io_off = page_offset(pl[0]);
 
-	if (io_off + io_len > i_size)
+	if (io_off >= i_size)
+		io_len = 0;
+	else if (io_off + io_len > i_size)
 		io_len = i_size - io_off;
 
-	/*
-	 * Iterate over list of pages and read each page individually.
-	 */
-	page_idx = 0;
-	for (total = io_off + io_len; io_off < total; io_off += PAGESIZE) {
-		caddr_t va;
-
-		cur_pp = pl[page_idx++];
-		va = kmap(cur_pp);
-		err = dmu_read(os, zp->z_id, io_off, PAGESIZE, va,
-		    DMU_READ_PREFETCH);
-		kunmap(cur_pp);
+	if (io_len > 0) {
+		err = dmu_buf_hold_array_by_bonus(sa_get_db(zp->z_sa_hdl),
+		    io_off, io_len, TRUE, FTAG, &numbufs, &dbp);
 		if (err) {
 			/* convert checksum errors into IO errors */
 			if (err == ECKSUM)
@@ -4794,6 +5455,32 @@ zfs_fillpage(struct inode *ip, struct page *pl[], int nr_pages)
 		}
 	}
 
+	off = 0;
+	for (page_idx = 0; page_idx < nr_pages; page_idx++) {
+		size_t pgoff = 0;
+		caddr_t va;
+
+		va = kmap(pl[page_idx]);
+		while (pgoff < PAGESIZE && off < io_len) {
+			dmu_buf_t *db = dbp[i];
+			uint64_t bufoff = io_off + off - db->db_offset;
+			size_t tocpy = MIN(db->db_size - bufoff,
+			    MIN(PAGESIZE - pgoff, io_len - off));
+
+			bcopy((char *)db->db_data + bufoff, va + pgoff, tocpy);
+			pgoff += tocpy;
+			off += tocpy;
+			if (bufoff + tocpy == db->db_size)
+				i++;
+		}
+		if (pgoff < PAGESIZE)
+			bzero(va + pgoff, PAGESIZE - pgoff);
+		kunmap(pl[page_idx]);
+	}
+
+	if (dbp != NULL)
+		dmu_buf_rele_array(dbp, numbufs, FTAG);
+
 	return (0);
 }
 
@@ -5238,6 +5925,7 @@ zfs_retzcbuf(struct inode *ip, xuio_t *xuio, cred_t *cr)
 EXPORT_SYMBOL(zfs_open);
 EXPORT_SYMBOL(zfs_close);
 EXPORT_SYMBOL(zfs_read);
+EXPORT_SYMBOL(zfs_read_pages);
 EXPORT_SYMBOL(zfs_write);
 EXPORT_SYMBOL(zfs_access);
 EXPORT_SYMBOL(zfs_lookup);
@@ -5247,6 +5935,7 @@ EXPORT_SYMBOL(zfs_remove);
 EXPORT_SYMBOL(zfs_mkdir);
 EXPORT_SYMBOL(zfs_rmdir);
 EXPORT_SYMBOL(zfs_readdir);
+EXPORT_SYMBOL(zfs_readdirplus);
 EXPORT_SYMBOL(zfs_fsync);
 EXPORT_SYMBOL(zfs_getattr);
 EXPORT_SYMBOL(zfs_getattr_fast);
@@ -5270,6 +5959,18 @@ module_param(zfs_delete_blocks, ulong, 0644);
 MODULE_PARM_DESC(zfs_delete_blocks, "Delete files larger than N blocks async");
 module_param(zfs_read_chunk_size, ulong, 0644);
 MODULE_PARM_DESC(zfs_read_chunk_size, "Bytes to read per chunk");
+
+module_param(zfs_readdir_prefetch_min, int, 0644);
+MODULE_PARM_DESC(zfs_readdir_prefetch_min,
+	"Initial number of directory entries to prefetch dnodes for");
+
+module_param(zfs_readdir_prefetch_max, int, 0644);
+MODULE_PARM_DESC(zfs_readdir_prefetch_max,
+	"Maximum number of directory entries to prefetch dnodes for");
+
+module_param(zfs_readdirplus_batch, int, 0644);
+MODULE_PARM_DESC(zfs_readdirplus_batch,
+	"Directory entries to prefetch together for readdirplus");
 /* END CSTYLED */
 
 #endif
@@ -108,7 +108,8 @@ zfs_rangelock_cb(locked_range_t *new, void *arg)
 	 */
 	uint64_t end_size = MAX(zp->z_size, new->lr_offset + new->lr_length);
 	if (end_size > zp->z_blksz && (!ISP2(zp->z_blksz) ||
-	    zp->z_blksz < ZTOZSB(zp)->z_max_blksz)) {
+	    zp->z_blksz < ZTOZSB(zp)->z_max_blksz ||
+	    zfs_append_blocksize(zp, new->lr_offset, end_size) != 0)) {
 		new->lr_offset = 0;
 		new->lr_length = UINT64_MAX;
 	}
@@ -539,6 +540,7 @@ zfs_znode_alloc(zfsvfs_t *zfsvfs, dmu_buf_t *db, int blksz,
 	ASSERT(zp->z_dirlocks == NULL);
 	ASSERT3P(zp->z_acl_cached, ==, NULL);
 	ASSERT3P(zp->z_xattr_cached, ==, NULL);
+	zfs_rangelock_reset(&zp->z_rangelock);
 	zp->z_unlinked = B_FALSE;
 	zp->z_atime_dirty = B_FALSE;
 	zp->z_moved = B_FALSE;
@@ -1464,6 +1466,43 @@ zfs_grow_blocksize(znode_t *zp, uint64_t size, dmu_tx_t *tx)
 	dmu_object_size_from_db(sa_get_db(zp->z_sa_hdl), &zp->z_blksz, &dummy);
 }
 
+/*
+ * Return the block size an appending write should promote the file to,
+ * or 0 if the file's block size should be left alone.
+ *
+ * Once a file is longer than one block its block size is fixed, so a
+ * file that is appended to stays at "recordsize" forever.  When the
+ * "appendrecordsize" property is larger than that, a file whose single
+ * block has filled up to "recordsize" and which is then appended to is
+ * given the larger block size before it grows a second block.  Small
+ * files are unaffected, while streaming logs end up with fewer, larger
+ * blocks and correspondingly fewer indirect blocks.
+ *
+ *	IN:	zp	- znode of file being written.
+ *		off	- offset of the write.
+ *		end	- end-of-file after the write.
+ *
+ * NOTE: this function assumes that the znode's range lock is held, or
+ *	 is called with the rangelock_t's rl_lock held.
+ */
+uint64_t
+zfs_append_blocksize(znode_t *zp, uint64_t off, uint64_t end)
+{
+	zfsvfs_t *zfsvfs = ZTOZSB(zp);
+	uint64_t blksz = zfsvfs->z_append_blksz;
+
+	if (blksz <= zp->z_blksz || !ISP2(zp->z_blksz) ||
+	    zp->z_blksz < zfsvfs->z_max_blksz)
+		return (0);
+
+	/* Only an append which crosses the end of the first block. */
+	if (off != zp->z_size || zp->z_size > zp->z_blksz ||
+	    end <= zp->z_blksz)
+		return (0);
+
+	return (blksz);
+}
+
 /*
  * Increase the file length
  *
@@ -2231,6 +2270,85 @@ zfs_obj_to_stats(objset_t *osp, uint64_t obj, zfs_stat_t *sb,
 }
 
 #if defined(_KERNEL)
+/*
+ * Fill in the stat(2) attributes of a zfs_direntplus_t directly from the
+ * object's SA, without instantiating a znode and inode for it.  If the
+ * znode is already in core its atime is used since it may not have been
+ * written back yet.
+ */
+int
+zfs_obj_to_direntplus(zfsvfs_t *zfsvfs, uint64_t obj, zfs_direntplus_t *zde)
+{
+	znode_hold_t *zh;
+	sa_handle_t *hdl, *zhdl;
+	dmu_buf_t *db;
+	sa_bulk_attr_t bulk[10];
+	uint64_t rdev = 0;
+	uint32_t blksize;
+	u_longlong_t nblocks;
+	dev_t dev;
+	int count = 0;
+	int error;
+
+	zh = zfs_znode_hold_enter(zfsvfs, obj);
+
+	error = zfs_grab_sa_handle(zfsvfs->z_os, obj, &hdl, &db, FTAG);
+	if (error != 0) {
+		zfs_znode_hold_exit(zfsvfs, zh);
+		return (error);
+	}
+
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MODE(zfsvfs), NULL,
+	    &zde->zde_mode, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_GEN(zfsvfs), NULL,
+	    &zde->zde_gen, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_LINKS(zfsvfs), NULL,
+	    &zde->zde_nlink, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_UID(zfsvfs), NULL,
+	    &zde->zde_uid, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_GID(zfsvfs), NULL,
+	    &zde->zde_gid, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_SIZE(zfsvfs), NULL,
+	    &zde->zde_size, 8);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_ATIME(zfsvfs), NULL,
+	    &zde->zde_atime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_MTIME(zfsvfs), NULL,
+	    &zde->zde_mtime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CTIME(zfsvfs), NULL,
+	    &zde->zde_ctime, 16);
+	SA_ADD_BULK_ATTR(bulk, count, SA_ZPL_CRTIME(zfsvfs), NULL,
+	    &zde->zde_crtime, 16);
+
+	error = sa_bulk_lookup(hdl, bulk, count);
+	if (error == 0 && (S_ISCHR(zde->zde_mode) || S_ISBLK(zde->zde_mode)))
+		error = sa_lookup(hdl, SA_ZPL_RDEV(zfsvfs), &rdev, 8);
+	if (error != 0)
+		goto out;
+
+	dev = zfs_cmpldev(rdev);
+	zde->zde_rdev_major = MAJOR(dev);
+	zde->zde_rdev_minor = MINOR(dev);
+
+	sa_object_size(hdl, &blksize, &nblocks);
+	zde->zde_blksize = blksize;
+	zde->zde_blocks = nblocks;
+
+	zhdl = dmu_buf_get_user(db);
+	if (zhdl != NULL) {
+		znode_t *zp = sa_get_userdata(zhdl);
+
+		ASSERT3P(zp, !=, NULL);
+		mutex_enter(&zp->z_lock);
+		ZFS_TIME_ENCODE(&ZTOI(zp)->i_atime, zde->zde_atime);
+		mutex_exit(&zp->z_lock);
+	}
+out:
+	zfs_release_sa_handle(hdl, db, FTAG);
+	zfs_znode_hold_exit(zfsvfs, zh);
+
+	return (error);
+}
+
 EXPORT_SYMBOL(zfs_create_fs);
 EXPORT_SYMBOL(zfs_obj_to_path);
 
@@ -65,6 +65,29 @@ const char *zio_type_name[ZIO_TYPES] = {
 int zio_dva_throttle_enabled = B_TRUE;
 int zio_deadman_log_all = B_FALSE;
 
+/*
+ * Asynchronous writes which will be compressed are issued to the pool's
+ * per-node compression queues rather than the write issue taskq.  Their
+ * workers run the CPU bound stages of the pipeline (compression,
+ * encryption and checksumming) and hand the zio back to the issue taskq
+ * before block allocation.
+ */
+int zio_compress_offload = B_TRUE;
+int zio_compress_batch = 8;
+#define	ZIO_COMPRESS_BATCH_MAX	64
+
+/*
+ * Small zios may run their cheap stages inline in the issuing or
+ * completing thread instead of being dispatched to a zio taskq.  A zio
+ * qualifies when the data it will checksum, compress or decompress is at
+ * most zio_inline_max_size bytes and nothing left in its pipeline can
+ * block on other I/O.  Inline completion is never nested, and the
+ * completing thread is treated as an interrupt thread for the blocking
+ * stages of any zio it goes on to execute.  Zero disables it.
+ */
+int zio_inline_max_size = 16384;
+static uint_t zio_inline_tsd_key;
+
 /*
  * ==========================================================================
  * I/O kmem caches
@@ -72,6 +95,7 @@ int zio_deadman_log_all = B_FALSE;
  */
 kmem_cache_t *zio_cache;
 kmem_cache_t *zio_link_cache;
+static kmem_cache_t *zio_compress_entry_cache;
 kmem_cache_t *zio_buf_cache[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 kmem_cache_t *zio_data_buf_cache[SPA_MAXBLOCKSIZE >> SPA_MINBLOCKSHIFT];
 #if defined(ZFS_DEBUG) && !defined(_KERNEL)
@@ -134,10 +158,183 @@ int zio_buf_debug_limit = 16384;
 int zio_buf_debug_limit = 0;
 #endif
 
+/*
+ * NUMA nodes with cpus, which are the nodes per-node taskqs and queues are
+ * created for.  zio_node_id[] lists them in ascending order and
+ * zio_node_index[] maps a node back to its position in that list, or -1.
+ */
+uint_t zio_nnodes;
+static int *zio_node_id;
+static int *zio_node_index;
+
+/*
+ * Per-NUMA node zio statistics.  A zio is homed on the node holding its
+ * data (see zio_create()).  Dispatches to taskqs which are split between
+ * nodes are counted as local when they went to a taskq bound to that
+ * node and remote otherwise; dispatches to taskqs which are not split are
+ * counted as unbound.  Stages run inline in place of an issue or
+ * interrupt dispatch are counted separately.
+ */
+typedef enum zio_node_stat {
+	ZNS_DISPATCH_LOCAL,
+	ZNS_DISPATCH_REMOTE,
+	ZNS_DISPATCH_UNBOUND,
+	ZNS_INLINE_ISSUE,
+	ZNS_INLINE_INTERRUPT,
+	ZNS_COUNT
+} zio_node_stat_t;
+
+typedef struct zio_node_stats {
+	kstat_named_t zns_stat[ZNS_COUNT];
+} zio_node_stats_t;
+
+static const zio_node_stats_t zio_node_stats_template = { {
+	{ "dispatch_local",		KSTAT_DATA_UINT64 },
+	{ "dispatch_remote",		KSTAT_DATA_UINT64 },
+	{ "dispatch_unbound",		KSTAT_DATA_UINT64 },
+	{ "inline_issue",		KSTAT_DATA_UINT64 },
+	{ "inline_interrupt",		KSTAT_DATA_UINT64 },
+} };
+
+/*
+ * The counters are bumped on every dispatch, so they are kept per cpu,
+ * each cpu's counters for all nodes on their own cache lines, and summed
+ * when the kstats are read.
+ */
+static uint64_t *zio_node_counts;
+static size_t zio_node_counts_stride;
+static zio_node_stats_t *zio_node_stats;
+static kstat_t **zio_node_ksp;
+
+#define	ZNSTAT_BUMP(node, stat)	zio_node_stat_bump((node), (stat))
+
 static inline void __zio_execute(zio_t *zio);
 
 static void zio_taskq_dispatch(zio_t *, zio_taskq_type_t, boolean_t);
 
+int
+zio_node_to_index(int node)
+{
+	if (node < 0 || node >= max_nnodes)
+		return (-1);
+
+	return (zio_node_index[node]);
+}
+
+int
+zio_index_to_node(uint_t index)
+{
+	ASSERT3U(index, <, zio_nnodes);
+	return (zio_node_id[index]);
+}
+
+static void
+zio_node_stat_bump(int node, zio_node_stat_t stat)
+{
+	int index = zio_node_to_index(node);
+	uint64_t *counts;
+
+	if (index < 0)
+		return;
+
+	kpreempt_disable();
+	counts = (uint64_t *)((char *)zio_node_counts +
+	    (CPU_SEQID % max_ncpus) * zio_node_counts_stride);
+	kpreempt_enable();
+
+	atomic_inc_64(&counts[index * ZNS_COUNT + stat]);
+}
+
+static int
+zio_node_stats_update(kstat_t *ksp, int rw)
+{
+	zio_node_stats_t *zns = ksp->ks_data;
+	uint_t index = (uint_t)(uintptr_t)ksp->ks_private;
+
+	if (rw == KSTAT_WRITE)
+		return (SET_ERROR(EACCES));
+
+	for (int s = 0; s < ZNS_COUNT; s++) {
+		uint64_t sum = 0;
+
+		for (uint_t c = 0; c < max_ncpus; c++) {
+			uint64_t *counts = (uint64_t *)((char *)
+			    zio_node_counts + c * zio_node_counts_stride);
+
+			sum += counts[index * ZNS_COUNT + s];
+		}
+		zns->zns_stat[s].value.ui64 = sum;
+	}
+
+	return (0);
+}
+
+static void
+zio_node_stats_init(void)
+{
+	int node;
+
+	zio_node_index = kmem_alloc(max_nnodes * sizeof (int), KM_SLEEP);
+	zio_node_id = kmem_alloc(max_nnodes * sizeof (int), KM_SLEEP);
+	for (node = 0; node < max_nnodes; node++)
+		zio_node_index[node] = -1;
+
+	zio_nnodes = 0;
+	for_each_node_state(node, N_CPU) {
+		zio_node_index[node] = zio_nnodes;
+		zio_node_id[zio_nnodes++] = node;
+	}
+	ASSERT3U(zio_nnodes, >, 0);
+
+	zio_node_counts_stride = P2ROUNDUP(zio_nnodes * ZNS_COUNT *
+	    sizeof (uint64_t), 64);
+	zio_node_counts = kmem_zalloc(max_ncpus * zio_node_counts_stride,
+	    KM_SLEEP);
+	zio_node_stats = kmem_alloc(zio_nnodes * sizeof (zio_node_stats_t),
+	    KM_SLEEP);
+	zio_node_ksp = kmem_zalloc(zio_nnodes * sizeof (kstat_t *), KM_SLEEP);
+
+	for (uint_t i = 0; i < zio_nnodes; i++) {
+		char name[KSTAT_STRLEN];
+		kstat_t *ksp;
+
+		zio_node_stats[i] = zio_node_stats_template;
+		(void) snprintf(name, sizeof (name), "zio_node_%d",
+		    zio_node_id[i]);
+		ksp = kstat_create("zfs", 0, name, "misc", KSTAT_TYPE_NAMED,
+		    sizeof (zio_node_stats_t) / sizeof (kstat_named_t),
+		    KSTAT_FLAG_VIRTUAL);
+		if (ksp != NULL) {
+			ksp->ks_data = &zio_node_stats[i];
+			ksp->ks_private = (void *)(uintptr_t)i;
+			ksp->ks_update = zio_node_stats_update;
+			kstat_install(ksp);
+		}
+		zio_node_ksp[i] = ksp;
+	}
+}
+
+static void
+zio_node_stats_fini(void)
+{
+	for (uint_t i = 0; i < zio_nnodes; i++) {
+		if (zio_node_ksp[i] != NULL)
+			kstat_delete(zio_node_ksp[i]);
+	}
+
+	kmem_free(zio_node_ksp, zio_nnodes * sizeof (kstat_t *));
+	kmem_free(zio_node_stats, zio_nnodes * sizeof (zio_node_stats_t));
+	kmem_free(zio_node_counts, max_ncpus * zio_node_counts_stride);
+	kmem_free(zio_node_id, max_nnodes * sizeof (int));
+	kmem_free(zio_node_index, max_nnodes * sizeof (int));
+	zio_node_ksp = NULL;
+	zio_node_stats = NULL;
+	zio_node_counts = NULL;
+	zio_node_id = NULL;
+	zio_node_index = NULL;
+	zio_nnodes = 0;
+}
+
 void
 zio_init(void)
 {
@@ -148,6 +345,8 @@ zio_init(void)
 	    sizeof (zio_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 	zio_link_cache = kmem_cache_create("zio_link_cache",
 	    sizeof (zio_link_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
+	zio_compress_entry_cache = kmem_cache_create("zio_compress_entry_cache",
+	    sizeof (spa_compress_entry_t), 0, NULL, NULL, NULL, NULL, NULL, 0);
 
 	/*
 	 * For small buffers, we want a cache for each multiple of
@@ -227,6 +426,9 @@ zio_init(void)
 	zio_inject_init();
 
 	lz4_init();
+	zio_compress_init();
+	zio_node_stats_init();
+	tsd_create(&zio_inline_tsd_key, NULL);
 }
 
 void
@@ -265,12 +467,16 @@ zio_fini(void)
 		zio_data_buf_cache[c] = NULL;
 	}
 
+	kmem_cache_destroy(zio_compress_entry_cache);
 	kmem_cache_destroy(zio_link_cache);
 	kmem_cache_destroy(zio_cache);
 
 	zio_inject_fini();
 
 	lz4_fini();
+	zio_compress_fini();
+	zio_node_stats_fini();
+	tsd_destroy(&zio_inline_tsd_key);
 }
 
 /*
@@ -855,6 +1061,17 @@ zio_create(zio_t *pio, spa_t *spa, uint64_t txg, const blkptr_t *bp,
 		zio_add_child(pio, zio);
 	}
 
+	/*
+	 * Home the zio on the NUMA node holding its data so the pipeline
+	 * stages which touch it can be run there.  Fall back to the parent's
+	 * node, and then to the issuing cpu's.
+	 */
+	zio->io_node = (data != NULL) ? abd_node(data) : NUMA_NO_NODE;
+	if (zio->io_node == NUMA_NO_NODE && pio != NULL)
+		zio->io_node = pio->io_node;
+	if (zio_node_to_index(zio->io_node) < 0)
+		zio->io_node = CPU_NODEID;
+
 	taskq_init_ent(&zio->io_tqent);
 
 	return (zio);
@@ -1616,7 +1833,8 @@ zio_write_compress(zio_t *zio)
 	if (compress != ZIO_COMPRESS_OFF &&
 	    !(zio->io_flags & ZIO_FLAG_RAW_COMPRESS)) {
 		void *cbuf = zio_buf_alloc(lsize);
-		psize = zio_compress_data(compress, zio->io_abd, cbuf, lsize);
+		psize = zio_compress_data_adaptive(compress, zio->io_abd, cbuf,
+		    lsize, zp->zp_compress_history, zio->io_bookmark.zb_blkid);
 		if (psize == 0 || psize == lsize) {
 			compress = ZIO_COMPRESS_OFF;
 			zio_buf_free(cbuf, lsize);
@@ -1801,8 +2019,13 @@ zio_taskq_dispatch(zio_t *zio, zio_taskq_type_t q, boolean_t cutinline)
 	 * to dispatch the zio to another taskq at the same time.
 	 */
 	ASSERT(taskq_empty_ent(&zio->io_tqent));
-	spa_taskq_dispatch_ent(spa, t, q, (task_func_t *)zio_execute, zio,
-	    flags, &zio->io_tqent);
+	if (spa_taskq_dispatch_ent(spa, t, q, (task_func_t *)zio_execute, zio,
+	    flags, &zio->io_tqent, zio->io_node))
+		ZNSTAT_BUMP(zio->io_node, ZNS_DISPATCH_LOCAL);
+	else if (spa->spa_zio_taskq[t][q].stqs_nodes != 0)
+		ZNSTAT_BUMP(zio->io_node, ZNS_DISPATCH_REMOTE);
+	else
+		ZNSTAT_BUMP(zio->io_node, ZNS_DISPATCH_UNBOUND);
 }
 
 static boolean_t
@@ -1823,10 +2046,164 @@ zio_taskq_member(zio_t *zio, zio_taskq_type_t q)
 	return (B_FALSE);
 }
 
+/*
+ * Drain a compression queue.  Up to zio_compress_batch entries are removed
+ * each time scq_lock is taken, to amortize the lock, and their zios are
+ * then run one after another in issue order.
+ */
+static void
+zio_compress_drain(void *arg)
+{
+	spa_compress_worker_t *scw = arg;
+	spa_compress_queue_t *scq = scw->scw_queue;
+	spa_compress_entry_t *batch[ZIO_COMPRESS_BATCH_MAX];
+	int max = MIN(MAX(zio_compress_batch, 1), ZIO_COMPRESS_BATCH_MAX);
+
+	for (;;) {
+		int n = 0;
+
+		mutex_enter(&scq->scq_lock);
+		while (n < max &&
+		    (batch[n] = list_remove_head(&scq->scq_list)) != NULL)
+			n++;
+
+		if (n == 0) {
+			list_insert_head(&scq->scq_idle, scw);
+			mutex_exit(&scq->scq_lock);
+			return;
+		}
+
+		scq->scq_stats.scqs_depth.value.ui64 -= n;
+		scq->scq_stats.scqs_batches.value.ui64++;
+		mutex_exit(&scq->scq_lock);
+
+		for (int i = 0; i < n; i++) {
+			zio_t *zio = batch[i]->sce_zio;
+
+			kmem_cache_free(zio_compress_entry_cache, batch[i]);
+			zio_execute(zio);
+		}
+	}
+}
+
+static boolean_t
+zio_compress_offloadable(zio_t *zio)
+{
+	zio_prop_t *zp = &zio->io_prop;
+
+	return (zio_compress_offload &&
+	    zio->io_spa->spa_compress_nqueues != 0 &&
+	    zio->io_type == ZIO_TYPE_WRITE &&
+	    zio->io_child_type == ZIO_CHILD_LOGICAL &&
+	    zio->io_priority == ZIO_PRIORITY_ASYNC_WRITE &&
+	    (zio->io_pipeline & ZIO_STAGE_WRITE_COMPRESS) &&
+	    !(zio->io_flags & (ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE |
+	    ZIO_FLAG_RAW_COMPRESS)) &&
+	    zp->zp_compress != ZIO_COMPRESS_OFF && !zp->zp_dedup);
+}
+
+/*
+ * Queue a write on the compression queue of the NUMA node holding its
+ * data, and start an idle worker for the queue if there is one.
+ */
+static void
+zio_compress_dispatch(zio_t *zio)
+{
+	spa_t *spa = zio->io_spa;
+	int index = MAX(zio_node_to_index(zio->io_node), 0);
+	spa_compress_queue_t *scq = &spa->spa_compress_queue[index %
+	    spa->spa_compress_nqueues];
+	spa_compress_queue_stats_t *scqs = &scq->scq_stats;
+	spa_compress_entry_t *sce;
+	spa_compress_worker_t *scw;
+
+	sce = kmem_cache_alloc(zio_compress_entry_cache, KM_SLEEP);
+	sce->sce_zio = zio;
+	list_link_init(&sce->sce_node);
+
+	mutex_enter(&scq->scq_lock);
+	list_insert_tail(&scq->scq_list, sce);
+	scqs->scqs_zios.value.ui64++;
+	if (++scqs->scqs_depth.value.ui64 > scqs->scqs_max_depth.value.ui64)
+		scqs->scqs_max_depth.value.ui64 = scqs->scqs_depth.value.ui64;
+	scw = list_remove_head(&scq->scq_idle);
+	mutex_exit(&scq->scq_lock);
+
+	if (scw != NULL) {
+		taskq_dispatch_ent(scq->scq_taskq, zio_compress_drain, scw, 0,
+		    &scw->scw_tqent);
+	}
+}
+
+static boolean_t
+zio_compress_member(zio_t *zio)
+{
+	spa_t *spa = zio->io_spa;
+
+	for (uint_t i = 0; i < spa->spa_compress_nqueues; i++) {
+		if (taskq_member(spa->spa_compress_queue[i].scq_taskq,
+		    zio->io_executor))
+			return (B_TRUE);
+	}
+
+	return (B_FALSE);
+}
+
+/*
+ * Is the current thread completing a zio inline?  See zio_execute_inline().
+ */
+static inline boolean_t
+zio_inline_member(void)
+{
+	return (tsd_get(zio_inline_tsd_key) != NULL);
+}
+
+/*
+ * Can the rest of this write's pipeline run in the issuing thread?  Only
+ * small writes which neither allocate nor dedup qualify, such as ZIL
+ * blocks and rewrites; everything else is left to the issue taskqs so
+ * the caller isn't serialized behind allocation or large checksums.
+ */
+static boolean_t
+zio_issue_inline(zio_t *zio)
+{
+	enum zio_stage remaining = zio->io_pipeline & ~(zio->io_stage - 1);
+
+	if (zio_inline_max_size == 0 || zio->io_type != ZIO_TYPE_WRITE)
+		return (B_FALSE);
+
+	if (MAX(zio->io_lsize, zio->io_size) > zio_inline_max_size)
+		return (B_FALSE);
+
+	if (remaining & (ZIO_STAGE_DVA_ALLOCATE | ZIO_STAGE_DDT_WRITE |
+	    ZIO_STAGE_GANG_ASSEMBLE))
+		return (B_FALSE);
+
+	if (zio->io_flags & (ZIO_FLAG_CONFIG_WRITER | ZIO_FLAG_PROBE))
+		return (B_FALSE);
+
+	/*
+	 * Interrupt threads and compression workers would only hand the
+	 * zio to the issue taskq at VDEV_IO_START anyway.
+	 */
+	if (zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT) ||
+	    zio_compress_member(zio) || zio_inline_member())
+		return (B_FALSE);
+
+	return (!zio_execute_stack_check(zio));
+}
+
 static zio_t *
 zio_issue_async(zio_t *zio)
 {
-	zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_FALSE);
+	if (zio_compress_offloadable(zio)) {
+		zio_compress_dispatch(zio);
+	} else if (zio_issue_inline(zio)) {
+		ZNSTAT_BUMP(zio->io_node, ZNS_INLINE_ISSUE);
+		return (zio);
+	} else {
+		zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, B_FALSE);
+	}
 
 	return (NULL);
 }
@@ -1837,6 +2214,74 @@ zio_interrupt(zio_t *zio)
 	zio_taskq_dispatch(zio, ZIO_TASKQ_INTERRUPT, B_FALSE);
 }
 
+/*
+ * Can this completed zio, and the parents it will go on to complete, be
+ * executed by the current thread?  The remaining stages are cheap for a
+ * successful zio whose logical I/O is small: they verify a checksum and
+ * decompress or decrypt at most zio_inline_max_size bytes.  Failed zios
+ * may be reissued, so they're always dispatched.
+ */
+static boolean_t
+zio_interrupt_cheap(zio_t *zio)
+{
+	zio_t *lio = (zio->io_logical != NULL) ? zio->io_logical : zio;
+
+	if (zio_inline_max_size == 0 || zio->io_error != 0 ||
+	    zio->io_target_timestamp != 0)
+		return (B_FALSE);
+
+	if (MAX(lio->io_lsize, zio->io_size) > zio_inline_max_size)
+		return (B_FALSE);
+
+#ifdef _KERNEL
+	if (in_interrupt() || irqs_disabled())
+		return (B_FALSE);
+#endif
+
+	/*
+	 * Guard the stack: don't complete a zio from within its own issue
+	 * (e.g. a bio completed by submit_bio()), and never nest.
+	 */
+	return (zio->io_executor != curthread && !zio_inline_member());
+}
+
+/*
+ * Complete a zio from a vdev's own worker thread.  When the remaining
+ * work is cheap it runs here rather than being dispatched to the
+ * interrupt taskq, otherwise this is zio_delay_interrupt().  Callers must
+ * not hold locks which the zio pipeline may take.
+ */
+void
+zio_interrupt_inline(zio_t *zio)
+{
+	if (!zio_interrupt_cheap(zio)) {
+		zio_delay_interrupt(zio);
+		return;
+	}
+
+	ZNSTAT_BUMP(zio->io_node, ZNS_INLINE_INTERRUPT);
+	zio_execute_inline(zio);
+}
+
+/*
+ * Run the rest of a completed zio's pipeline in the current thread, which
+ * may itself be executing a zio.  Only one such zio may run per thread, so
+ * when one already is, or the stack is too small to recurse, the zio is
+ * dispatched to the interrupt taskq instead.
+ */
+void
+zio_execute_inline(zio_t *zio)
+{
+	if (zio_inline_member() || zio_execute_stack_check(zio) ||
+	    tsd_set(zio_inline_tsd_key, zio) != 0) {
+		zio_interrupt(zio);
+		return;
+	}
+
+	zio_execute(zio);
+	(void) tsd_set(zio_inline_tsd_key, NULL);
+}
+
 void
 zio_delay_interrupt(zio_t *zio)
 {
@@ -2070,9 +2515,14 @@ __zio_execute(zio_t *zio)
 		 *
 		 * For VDEV_IO_START, we cut in line so that the io will
 		 * be sent to disk promptly.
+		 *
+		 * Compression workers and threads completing zios inline
+		 * likewise hand zios back to the issue taskq rather than
+		 * block in allocation.
 		 */
 		if ((stage & ZIO_BLOCKING_STAGES) && zio->io_vd == NULL &&
-		    zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT)) {
+		    (zio_taskq_member(zio, ZIO_TASKQ_INTERRUPT) ||
+		    zio_compress_member(zio) || zio_inline_member())) {
 			boolean_t cut = (stage == ZIO_STAGE_VDEV_IO_START) ?
 			    zio_requeue_io_start_cut_in_line : B_FALSE;
 			zio_taskq_dispatch(zio, ZIO_TASKQ_ISSUE, cut);
@@ -2833,6 +3283,7 @@ zio_write_gang_block(zio_t *pio)
 		zp.zp_dedup_verify = B_FALSE;
 		zp.zp_nopwrite = B_FALSE;
 		zp.zp_encrypt = gio->io_prop.zp_encrypt;
+		zp.zp_compress_history = NULL;
 		zp.zp_byteorder = gio->io_prop.zp_byteorder;
 		bzero(zp.zp_salt, ZIO_DATA_SALT_LEN);
 		bzero(zp.zp_iv, ZIO_DATA_IV_LEN);
@@ -4827,10 +5278,10 @@ zio_done(zio_t *zio)
 			 * Hand it off to the otherwise-unused claim taskq.
 			 */
 			ASSERT(taskq_empty_ent(&zio->io_tqent));
-			spa_taskq_dispatch_ent(zio->io_spa,
+			(void) spa_taskq_dispatch_ent(zio->io_spa,
 			    ZIO_TYPE_CLAIM, ZIO_TASKQ_ISSUE,
 			    (task_func_t *)zio_reexecute, zio, 0,
-			    &zio->io_tqent);
+			    &zio->io_tqent, zio->io_node);
 		}
 		return (NULL);
 	}
@@ -5083,6 +5534,18 @@ module_param(zio_dva_throttle_enabled, int, 0644);
 MODULE_PARM_DESC(zio_dva_throttle_enabled,
 	"Throttle block allocations in the ZIO pipeline");
 
+module_param(zio_compress_offload, int, 0644);
+MODULE_PARM_DESC(zio_compress_offload,
+	"Compress asynchronous writes on dedicated per-node taskqs");
+
+module_param(zio_compress_batch, int, 0644);
+MODULE_PARM_DESC(zio_compress_batch,
+	"Max writes removed from a compression queue per lock acquisition");
+
+module_param(zio_inline_max_size, int, 0644);
+MODULE_PARM_DESC(zio_inline_max_size,
+	"Max size of zios whose cheap stages may run without a taskq dispatch");
+
 module_param(zio_deadman_log_all, int, 0644);
 MODULE_PARM_DESC(zio_deadman_log_all,
 	"Log all slow ZIOs, not just those with vdevs");
@@ -43,6 +43,89 @@
  */
 unsigned long zio_decompress_fail_fraction = 0;
 
+/*
+ * Early abort heuristic.  Before running an expensive compressor on a new
+ * write, estimate the entropy of a sample of the block and, if it looks
+ * random, confirm with a cheap lz4 pass.  Blocks which fail both checks are
+ * written uncompressed without running the requested compressor.
+ *
+ * Each dataset keeps a history of whether its recent blocks compressed.
+ * While few of them were incompressible the heuristic is only run on one
+ * block in zfs_compress_early_abort_sample, so compressible datasets do not
+ * pay for the probe.
+ */
+int zfs_compress_early_abort = 1;
+int zfs_compress_early_abort_entropy = 90;
+int zfs_compress_early_abort_sample = 16;
+
+/*
+ * Number of incompressible blocks among the last 64 written to a dataset
+ * before the heuristic is run on every block.
+ */
+#define	ZIO_COMPRESS_HISTORY_MIN	4
+
+/*
+ * The entropy estimate reads ZIO_COMPRESS_SAMPLE_LEN bytes at up to
+ * ZIO_COMPRESS_SAMPLES evenly spaced offsets, which keeps the byte counts
+ * within 16 bits.
+ */
+#define	ZIO_COMPRESS_SAMPLES		512
+#define	ZIO_COMPRESS_SAMPLE_LEN		32
+
+typedef struct zio_compress_sample {
+	uint64_t	zs_off;
+	uint64_t	zs_stride;
+	uint64_t	zs_samples;
+	uint16_t	zs_count[256];
+} zio_compress_sample_t;
+
+typedef struct zio_compress_stats {
+	kstat_named_t zcs_early_abort_skipped;
+	kstat_named_t zcs_early_abort_probes;
+	kstat_named_t zcs_early_abort_low_entropy;
+	kstat_named_t zcs_early_abort_lz4_pass;
+	kstat_named_t zcs_early_abort_aborts;
+	kstat_named_t zcs_early_abort_missed;
+	kstat_named_t zcs_accel_compress;
+	kstat_named_t zcs_accel_decompress;
+	kstat_named_t zcs_accel_fallback;
+} zio_compress_stats_t;
+
+static zio_compress_stats_t zio_compress_stats = {
+	{ "early_abort_skipped",	KSTAT_DATA_UINT64 },
+	{ "early_abort_probes",		KSTAT_DATA_UINT64 },
+	{ "early_abort_low_entropy",	KSTAT_DATA_UINT64 },
+	{ "early_abort_lz4_pass",	KSTAT_DATA_UINT64 },
+	{ "early_abort_aborts",		KSTAT_DATA_UINT64 },
+	{ "early_abort_missed",		KSTAT_DATA_UINT64 },
+	{ "accel_compress",		KSTAT_DATA_UINT64 },
+	{ "accel_decompress",		KSTAT_DATA_UINT64 },
+	{ "accel_fallback",		KSTAT_DATA_UINT64 },
+};
+
+#define	ZCSTAT_BUMP(stat) \
+	atomic_inc_64(&zio_compress_stats.stat.value.ui64)
+
+static kstat_t *zio_compress_ksp;
+
+/*
+ * Registered compression accelerators, consulted in order before the
+ * software implementation of an algorithm.  zio_compress_accel_count is
+ * updated under the write lock and checked without it, so that the
+ * common case of no accelerators does not touch the lock at all.
+ */
+static krwlock_t zio_compress_accel_lock;
+static list_t zio_compress_accel_list;
+static uint32_t zio_compress_accel_count;
+
+/*
+ * Software stand-in for a compression accelerator, used to exercise the
+ * accelerator path without hardware.  When set to 1 it handles every block
+ * using the software implementation; when set to 2 every request fails and
+ * falls back to software.
+ */
+int zfs_compress_accel_sw = 0;
+
 /*
  * Compression vectors.
  */
@@ -52,15 +135,24 @@ zio_compress_info_t zio_compress_table[ZIO_COMPRESS_FUNCTIONS] = {
 	{"uncompressed",	0,	NULL,		NULL},
 	{"lzjb",		0,	lzjb_compress,	lzjb_decompress},
 	{"empty",		0,	NULL,		NULL},
-	{"gzip-1",		1,	gzip_compress,	gzip_decompress},
-	{"gzip-2",		2,	gzip_compress,	gzip_decompress},
-	{"gzip-3",		3,	gzip_compress,	gzip_decompress},
-	{"gzip-4",		4,	gzip_compress,	gzip_decompress},
-	{"gzip-5",		5,	gzip_compress,	gzip_decompress},
-	{"gzip-6",		6,	gzip_compress,	gzip_decompress},
-	{"gzip-7",		7,	gzip_compress,	gzip_decompress},
-	{"gzip-8",		8,	gzip_compress,	gzip_decompress},
-	{"gzip-9",		9,	gzip_compress,	gzip_decompress},
+	{"gzip-1",		1,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-2",		2,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-3",		3,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-4",		4,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-5",		5,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-6",		6,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-7",		7,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-8",		8,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
+	{"gzip-9",		9,	gzip_compress,	gzip_decompress,
+	    gzip_compress_abd,	gzip_decompress_abd},
 	{"zle",			64,	zle_compress,	zle_decompress},
 	{"lz4",			0,	lz4_compress_zfs, lz4_decompress_zfs}
 };
@@ -101,13 +193,271 @@ zio_compress_zeroed_cb(void *data, size_t len, void *private)
 	return (0);
 }
 
+static int
+zio_compress_sample_cb(void *buf, size_t len, void *private)
+{
+	zio_compress_sample_t *zs = private;
+	uint8_t *data = buf;
+	uint64_t start = zs->zs_off;
+	uint64_t end = start + len;
+
+	for (uint64_t s = start - start % zs->zs_stride; s < end;
+	    s += zs->zs_stride) {
+		uint64_t lo = MAX(s, start);
+		uint64_t hi = MIN(s + ZIO_COMPRESS_SAMPLE_LEN, end);
+
+		for (uint64_t i = lo; i < hi; i++)
+			zs->zs_count[data[i - start]]++;
+		if (hi > lo)
+			zs->zs_samples += hi - lo;
+	}
+	zs->zs_off = end;
+
+	return (0);
+}
+
+/*
+ * Base 2 logarithm of x >= 1 in fixed point with 8 fractional bits.
+ */
+static uint64_t
+zio_compress_log2(uint64_t x)
+{
+	int n = highbit64(x) - 1;
+	uint64_t r = (uint64_t)n << 8;
+	uint64_t y = (n >= 16) ? x >> (n - 16) : x << (16 - n);
+
+	/* y is x scaled into [1, 2) with 16 fractional bits. */
+	for (int i = 7; i >= 0; i--) {
+		y = (y * y) >> 16;
+		if (y >= (2ULL << 16)) {
+			y >>= 1;
+			r |= 1ULL << i;
+		}
+	}
+
+	return (r);
+}
+
+/*
+ * Estimate the order-0 entropy of a sample of the block and return
+ * B_TRUE if it is close enough to 8 bits per byte that the block is
+ * unlikely to compress.
+ */
+static boolean_t
+zio_compress_high_entropy(abd_t *src, size_t s_len)
+{
+	zio_compress_sample_t *zs;
+	uint64_t sum = 0, entropy;
+
+	zs = kmem_zalloc(sizeof (zio_compress_sample_t), KM_SLEEP);
+	zs->zs_stride = MAX(s_len / ZIO_COMPRESS_SAMPLES,
+	    ZIO_COMPRESS_SAMPLE_LEN);
+	(void) abd_iterate_func(src, 0, s_len, zio_compress_sample_cb, zs);
+
+	for (int i = 0; i < 256; i++) {
+		if (zs->zs_count[i] != 0)
+			sum += zs->zs_count[i] *
+			    zio_compress_log2(zs->zs_count[i]);
+	}
+	entropy = zio_compress_log2(zs->zs_samples) - sum / zs->zs_samples;
+	kmem_free(zs, sizeof (zio_compress_sample_t));
+
+	return (entropy * 100 >= zfs_compress_early_abort_entropy * 8 * 256);
+}
+
+static boolean_t
+zio_compress_early_abort_enabled(enum zio_compress c)
+{
+	/* lz4 and zle are as cheap as the probe itself. */
+	return (zfs_compress_early_abort && c != ZIO_COMPRESS_LZ4 &&
+	    c != ZIO_COMPRESS_ZLE && c != ZIO_COMPRESS_EMPTY);
+}
+
+/*
+ * Decide whether compressing a new write can be skipped.  The lz4 probe
+ * uses 'dst' as scratch space.
+ */
+static boolean_t
+zio_compress_early_abort(abd_t *src, void *dst, size_t s_len,
+    uint64_t history, uint64_t blkid)
+{
+	size_t c_len, d_len;
+	int incompressible;
+	void *tmp;
+
+	for (incompressible = 0; history != 0; incompressible++)
+		history &= history - 1;
+
+	if (incompressible < ZIO_COMPRESS_HISTORY_MIN &&
+	    zfs_compress_early_abort_sample > 1 &&
+	    blkid % zfs_compress_early_abort_sample != 0) {
+		ZCSTAT_BUMP(zcs_early_abort_skipped);
+		return (B_FALSE);
+	}
+
+	ZCSTAT_BUMP(zcs_early_abort_probes);
+	if (!zio_compress_high_entropy(src, s_len)) {
+		ZCSTAT_BUMP(zcs_early_abort_low_entropy);
+		return (B_FALSE);
+	}
+
+	d_len = s_len - (s_len >> 3);
+	tmp = abd_borrow_buf_copy(src, s_len);
+	c_len = lz4_compress_zfs(tmp, dst, s_len, d_len, 0);
+	abd_return_buf(src, tmp, s_len);
+	if (c_len <= d_len) {
+		ZCSTAT_BUMP(zcs_early_abort_lz4_pass);
+		return (B_FALSE);
+	}
+
+	ZCSTAT_BUMP(zcs_early_abort_aborts);
+	return (B_TRUE);
+}
+
+void
+zio_compress_accel_register(zio_compress_accel_t *zca)
+{
+	rw_enter(&zio_compress_accel_lock, RW_WRITER);
+	list_insert_tail(&zio_compress_accel_list, zca);
+	atomic_inc_32(&zio_compress_accel_count);
+	rw_exit(&zio_compress_accel_lock);
+}
+
+void
+zio_compress_accel_unregister(zio_compress_accel_t *zca)
+{
+	rw_enter(&zio_compress_accel_lock, RW_WRITER);
+	list_remove(&zio_compress_accel_list, zca);
+	atomic_dec_32(&zio_compress_accel_count);
+	rw_exit(&zio_compress_accel_lock);
+}
+
+static boolean_t
+zio_compress_accel_use(enum zio_compress c, size_t len)
+{
+	boolean_t use = B_FALSE;
+
+	if (*(volatile uint32_t *)&zio_compress_accel_count == 0)
+		return (B_FALSE);
+
+	rw_enter(&zio_compress_accel_lock, RW_READER);
+	for (zio_compress_accel_t *zca = list_head(&zio_compress_accel_list);
+	    zca != NULL && !use; zca = list_next(&zio_compress_accel_list, zca))
+		use = zca->zca_use(c, len);
+	rw_exit(&zio_compress_accel_lock);
+
+	return (use);
+}
+
+/*
+ * Compress or decompress linear buffers with the first accelerator which
+ * accepts the block.  Returns nonzero if the software implementation must
+ * be used instead.
+ */
+static int
+zio_compress_accel(boolean_t compress, enum zio_compress c, void *src,
+    void *dst, size_t s_len, size_t d_len, size_t *c_len)
+{
+	size_t len = compress ? s_len : d_len;
+	int err = ENOTSUP;
+
+	rw_enter(&zio_compress_accel_lock, RW_READER);
+	for (zio_compress_accel_t *zca = list_head(&zio_compress_accel_list);
+	    zca != NULL; zca = list_next(&zio_compress_accel_list, zca)) {
+		if (!zca->zca_use(c, len))
+			continue;
+
+		if (compress) {
+			err = zca->zca_compress(c, src, dst, s_len, d_len,
+			    c_len);
+		} else {
+			err = zca->zca_decompress(c, src, dst, s_len, d_len);
+		}
+		break;
+	}
+	rw_exit(&zio_compress_accel_lock);
+
+	if (err == 0 && compress)
+		ZCSTAT_BUMP(zcs_accel_compress);
+	else if (err == 0)
+		ZCSTAT_BUMP(zcs_accel_decompress);
+	else
+		ZCSTAT_BUMP(zcs_accel_fallback);
+
+	return (err);
+}
+
+/*ARGSUSED*/
+static boolean_t
+zio_compress_accel_sw_use(enum zio_compress c, size_t len)
+{
+	return (zfs_compress_accel_sw != 0);
+}
+
+static int
+zio_compress_accel_sw_compress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len, size_t *c_len)
+{
+	zio_compress_info_t *ci = &zio_compress_table[c];
+
+	if (zfs_compress_accel_sw != 1)
+		return (SET_ERROR(EIO));
+
+	*c_len = ci->ci_compress(src, dst, s_len, d_len, ci->ci_level);
+	return (0);
+}
+
+static int
+zio_compress_accel_sw_decompress(enum zio_compress c, void *src, void *dst,
+    size_t s_len, size_t d_len)
+{
+	zio_compress_info_t *ci = &zio_compress_table[c];
+
+	if (zfs_compress_accel_sw != 1)
+		return (SET_ERROR(EIO));
+
+	return (ci->ci_decompress(src, dst, s_len, d_len, ci->ci_level));
+}
+
+static zio_compress_accel_t zio_compress_accel_sw = {
+	.zca_name = "sw",
+	.zca_use = zio_compress_accel_sw_use,
+	.zca_compress = zio_compress_accel_sw_compress,
+	.zca_decompress = zio_compress_accel_sw_decompress,
+};
+static boolean_t zio_compress_accel_sw_registered = B_FALSE;
+
+/*
+ * The stand-in is only registered while enabled, so that the common case
+ * of no accelerators costs no more than a check of the count.  The registry
+ * lock also serializes concurrent updates of the tunable.
+ */
+static void
+zio_compress_accel_sw_update(void)
+{
+	rw_enter(&zio_compress_accel_lock, RW_WRITER);
+	if (zfs_compress_accel_sw != 0 && !zio_compress_accel_sw_registered) {
+		list_insert_tail(&zio_compress_accel_list,
+		    &zio_compress_accel_sw);
+		atomic_inc_32(&zio_compress_accel_count);
+		zio_compress_accel_sw_registered = B_TRUE;
+	} else if (zfs_compress_accel_sw == 0 &&
+	    zio_compress_accel_sw_registered) {
+		list_remove(&zio_compress_accel_list, &zio_compress_accel_sw);
+		atomic_dec_32(&zio_compress_accel_count);
+		zio_compress_accel_sw_registered = B_FALSE;
+	}
+	rw_exit(&zio_compress_accel_lock);
+}
+
 size_t
 zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
 {
 	size_t c_len, d_len;
-	zio_compress_info_t *ci = &zio_compress_table[c];
+	zio_compress_info_t *ci;
 
 	ASSERT((uint_t)c < ZIO_COMPRESS_FUNCTIONS);
+	ci = &zio_compress_table[c];
 	ASSERT((uint_t)c == ZIO_COMPRESS_EMPTY || ci->ci_compress != NULL);
 
 	/*
@@ -123,10 +473,28 @@ zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
 	/* Compress at least 12.5% */
 	d_len = s_len - (s_len >> 3);
 
-	/* No compression algorithms can read from ABDs directly */
-	void *tmp = abd_borrow_buf_copy(src, s_len);
-	c_len = ci->ci_compress(tmp, dst, s_len, d_len, ci->ci_level);
-	abd_return_buf(src, tmp, s_len);
+	/*
+	 * Scatter ABDs are passed to the algorithm directly when it can
+	 * read from them.  Otherwise, or when an accelerator will handle the
+	 * block, they must be copied to a linear buffer, which is free for
+	 * linear ABDs.
+	 */
+	if (zio_compress_accel_use(c, s_len)) {
+		void *tmp = abd_borrow_buf_copy(src, s_len);
+		if (zio_compress_accel(B_TRUE, c, tmp, dst, s_len, d_len,
+		    &c_len) != 0) {
+			c_len = ci->ci_compress(tmp, dst, s_len, d_len,
+			    ci->ci_level);
+		}
+		abd_return_buf(src, tmp, s_len);
+	} else if (ci->ci_compress_abd != NULL && !abd_is_linear(src)) {
+		c_len = ci->ci_compress_abd(src, dst, s_len, d_len,
+		    ci->ci_level);
+	} else {
+		void *tmp = abd_borrow_buf_copy(src, s_len);
+		c_len = ci->ci_compress(tmp, dst, s_len, d_len, ci->ci_level);
+		abd_return_buf(src, tmp, s_len);
+	}
 
 	if (c_len > d_len)
 		return (s_len);
@@ -135,14 +503,55 @@ zio_compress_data(enum zio_compress c, abd_t *src, void *dst, size_t s_len)
 	return (c_len);
 }
 
+/*
+ * Compress a block for a new write, applying the early abort heuristic.
+ * 'history' records the outcome of the dataset's recent writes, and is
+ * NULL when every block must be compressed as zio_compress_data() would,
+ * e.g. for dedup where identical blocks must produce identical output.
+ */
+size_t
+zio_compress_data_adaptive(enum zio_compress c, abd_t *src, void *dst,
+    size_t s_len, uint64_t *history, uint64_t blkid)
+{
+	size_t c_len;
+
+	if (history == NULL || !zio_compress_early_abort_enabled(c))
+		return (zio_compress_data(c, src, dst, s_len));
+
+	if (zio_compress_early_abort(src, dst, s_len, *history, blkid)) {
+		c_len = s_len;
+	} else {
+		c_len = zio_compress_data(c, src, dst, s_len);
+		if (c_len == s_len)
+			ZCSTAT_BUMP(zcs_early_abort_missed);
+	}
+
+	/*
+	 * Concurrent writers may race on the history; a lost update only
+	 * delays the next change of mode.
+	 */
+	*history = (*history << 1) | (c_len == s_len);
+
+	return (c_len);
+}
+
 int
 zio_decompress_data_buf(enum zio_compress c, void *src, void *dst,
     size_t s_len, size_t d_len)
 {
-	zio_compress_info_t *ci = &zio_compress_table[c];
-	if ((uint_t)c >= ZIO_COMPRESS_FUNCTIONS || ci->ci_decompress == NULL)
+	zio_compress_info_t *ci;
+
+	if ((uint_t)c >= ZIO_COMPRESS_FUNCTIONS)
 		return (SET_ERROR(EINVAL));
 
+	ci = &zio_compress_table[c];
+	if (ci->ci_decompress == NULL)
+		return (SET_ERROR(EINVAL));
+
+	if (zio_compress_accel_use(c, d_len) &&
+	    zio_compress_accel(B_FALSE, c, src, dst, s_len, d_len, NULL) == 0)
+		return (0);
+
 	return (ci->ci_decompress(src, dst, s_len, d_len, ci->ci_level));
 }
 
@@ -150,9 +559,21 @@ int
 zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
     size_t s_len, size_t d_len)
 {
-	void *tmp = abd_borrow_buf_copy(src, s_len);
-	int ret = zio_decompress_data_buf(c, tmp, dst, s_len, d_len);
-	abd_return_buf(src, tmp, s_len);
+	zio_compress_info_t *ci = NULL;
+	int ret;
+
+	if ((uint_t)c < ZIO_COMPRESS_FUNCTIONS)
+		ci = &zio_compress_table[c];
+
+	if (ci != NULL && ci->ci_decompress_abd != NULL &&
+	    !abd_is_linear(src) && !zio_compress_accel_use(c, d_len)) {
+		ret = ci->ci_decompress_abd(src, dst, s_len, d_len,
+		    ci->ci_level);
+	} else {
+		void *tmp = abd_borrow_buf_copy(src, s_len);
+		ret = zio_decompress_data_buf(c, tmp, dst, s_len, d_len);
+		abd_return_buf(src, tmp, s_len);
+	}
 
 	/*
 	 * Decompression shouldn't fail, because we've already verified
@@ -165,3 +586,75 @@ zio_decompress_data(enum zio_compress c, abd_t *src, void *dst,
 
 	return (ret);
 }
+
+void
+zio_compress_init(void)
+{
+	rw_init(&zio_compress_accel_lock, NULL, RW_DEFAULT, NULL);
+	list_create(&zio_compress_accel_list, sizeof (zio_compress_accel_t),
+	    offsetof(zio_compress_accel_t, zca_node));
+	zio_compress_accel_sw_update();
+
+	zio_compress_ksp = kstat_create("zfs", 0, "compress_stats", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zio_compress_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (zio_compress_ksp != NULL) {
+		zio_compress_ksp->ks_data = &zio_compress_stats;
+		kstat_install(zio_compress_ksp);
+	}
+}
+
+void
+zio_compress_fini(void)
+{
+	if (zio_compress_ksp != NULL) {
+		kstat_delete(zio_compress_ksp);
+		zio_compress_ksp = NULL;
+	}
+
+	zfs_compress_accel_sw = 0;
+	zio_compress_accel_sw_update();
+	ASSERT(list_is_empty(&zio_compress_accel_list));
+	list_destroy(&zio_compress_accel_list);
+	rw_destroy(&zio_compress_accel_lock);
+}
+
+#if defined(_KERNEL)
+#include <linux/mod_compat.h>
+
+module_param(zfs_compress_early_abort, int, 0644);
+MODULE_PARM_DESC(zfs_compress_early_abort,
+	"Skip compressing blocks which are estimated to be incompressible");
+
+module_param(zfs_compress_early_abort_entropy, int, 0644);
+MODULE_PARM_DESC(zfs_compress_early_abort_entropy,
+	"Sampled entropy, as a percentage of 8 bits per byte, above which "
+	"a block is probed with lz4");
+
+module_param(zfs_compress_early_abort_sample, int, 0644);
+MODULE_PARM_DESC(zfs_compress_early_abort_sample,
+	"Run the early abort heuristic on 1 in this many blocks of datasets "
+	"whose recent writes compressed");
+
+static int
+param_set_compress_accel_sw(const char *val, zfs_kernel_param_t *kp)
+{
+	int ret;
+
+	ret = param_set_int(val, kp);
+	if (ret)
+		return (ret);
+
+	if (spa_mode_global != 0)
+		zio_compress_accel_sw_update();
+
+	return (0);
+}
+
+module_param_call(zfs_compress_accel_sw, param_set_compress_accel_sw,
+    param_get_int, &zfs_compress_accel_sw, 0644);
+MODULE_PARM_DESC(zfs_compress_accel_sw,
+	"Route compression through a software accelerator stand-in "
+	"(1 = handle, 2 = fail and fall back)");
+#endif
@@ -27,6 +27,10 @@
 #ifdef CONFIG_COMPAT
 #include <linux/compat.h>
 #endif
+#ifdef HAVE_SPLICE_TO_PIPE
+#include <linux/pipe_fs_i.h>
+#include <linux/splice.h>
+#endif
 #include <sys/file.h>
 #include <sys/dmu_objset.h>
 #include <sys/zfs_vfsops.h>
@@ -34,6 +38,84 @@
 #include <sys/zfs_znode.h>
 #include <sys/zfs_project.h>
 
+/*
+ * When preallocating space with fallocate(2), require this percentage of
+ * the requested size to be available.  Padding the request accounts for
+ * metadata, parity and the blocks of other writers which are not yet
+ * charged to the dataset.  Setting this to 0 disables preallocation and
+ * fallocate(2) mode 0 returns EOPNOTSUPP as it did previously.
+ */
+unsigned int zfs_fallocate_reserve_percent = 110;
+
+/*
+ * Page cache fill statistics, exported as the "zpl_readahead" kstat.
+ */
+typedef struct zpl_readahead_stats {
+	/* Number of readahead windows passed to .readpages() */
+	kstat_named_t zras_windows;
+	/* Total pages requested by those windows */
+	kstat_named_t zras_window_pages;
+	/* Pages skipped because they were already in the page cache */
+	kstat_named_t zras_cached_pages;
+	/* Contiguous runs of pages filled with a single zfs_getpage() */
+	kstat_named_t zras_batches;
+	/* Pages filled by readahead */
+	kstat_named_t zras_filled_pages;
+	/* Pages which could not be filled due to an error */
+	kstat_named_t zras_error_pages;
+	/* Single pages filled on demand by .readpage() */
+	kstat_named_t zras_readpage;
+} zpl_readahead_stats_t;
+
+static zpl_readahead_stats_t zpl_readahead_stats = {
+	{ "windows",			KSTAT_DATA_UINT64 },
+	{ "window_pages",		KSTAT_DATA_UINT64 },
+	{ "cached_pages",		KSTAT_DATA_UINT64 },
+	{ "batches",			KSTAT_DATA_UINT64 },
+	{ "filled_pages",		KSTAT_DATA_UINT64 },
+	{ "error_pages",		KSTAT_DATA_UINT64 },
+	{ "readpage",			KSTAT_DATA_UINT64 },
+};
+
+#define	ZRASTAT_INCR(stat, val) \
+	atomic_add_64(&zpl_readahead_stats.stat.value.ui64, (val))
+#define	ZRASTAT_BUMP(stat)	ZRASTAT_INCR(stat, 1)
+
+static kstat_t *zpl_readahead_ksp;
+
+#ifdef HAVE_SPLICE_TO_PIPE
+/*
+ * splice(2) and sendfile(2) statistics, exported as the "zpl_splice" kstat.
+ * Only present when .splice_read() is implemented here.
+ */
+typedef struct zpl_splice_stats {
+	/* Calls to .splice_read() */
+	kstat_named_t zsps_calls;
+	/* Pages handed to the pipe by reference to the ARC's copy */
+	kstat_named_t zsps_ref_pages;
+	/* Bytes handed to the pipe by reference */
+	kstat_named_t zsps_ref_bytes;
+	/* Pages allocated to hold data which had to be copied */
+	kstat_named_t zsps_copy_pages;
+	/* Bytes copied into those pages */
+	kstat_named_t zsps_copy_bytes;
+} zpl_splice_stats_t;
+
+static zpl_splice_stats_t zpl_splice_stats = {
+	{ "calls",			KSTAT_DATA_UINT64 },
+	{ "ref_pages",			KSTAT_DATA_UINT64 },
+	{ "ref_bytes",			KSTAT_DATA_UINT64 },
+	{ "copy_pages",			KSTAT_DATA_UINT64 },
+	{ "copy_bytes",			KSTAT_DATA_UINT64 },
+};
+
+#define	ZSPSTAT_INCR(stat, val) \
+	atomic_add_64(&zpl_splice_stats.stat.value.ui64, (val))
+#define	ZSPSTAT_BUMP(stat)	ZSPSTAT_INCR(stat, 1)
+
+static kstat_t *zpl_splice_ksp;
+#endif /* HAVE_SPLICE_TO_PIPE */
+
 
 static int
 zpl_open(struct inode *ip, struct file *filp)
@@ -283,22 +365,11 @@ zpl_read_common(struct inode *ip, const char *buf, size_t len, loff_t *ppos,
 	    flags, cr, 0));
 }
 
-static ssize_t
-zpl_iter_read_common(struct kiocb *kiocb, const struct iovec *iovp,
-    unsigned long nr_segs, size_t count, uio_seg_t seg, size_t skip)
+static void
+zpl_file_accessed(struct file *filp)
 {
-	cred_t *cr = CRED();
-	struct file *filp = kiocb->ki_filp;
 	struct inode *ip = filp->f_mapping->host;
 	zfsvfs_t *zfsvfs = ZTOZSB(ITOZ(ip));
-	ssize_t read;
-	unsigned int f_flags = filp->f_flags;
-
-	f_flags |= zfs_io_flags(kiocb);
-	crhold(cr);
-	read = zpl_read_common_iovec(filp->f_mapping->host, iovp, count,
-	    nr_segs, &kiocb->ki_pos, seg, f_flags, cr, skip);
-	crfree(cr);
 
 	/*
 	 * If relatime is enabled, call file_accessed() only if
@@ -313,6 +384,24 @@ zpl_iter_read_common(struct kiocb *kiocb, const struct iovec *iovp,
 	} else {
 		file_accessed(filp);
 	}
+}
+
+static ssize_t
+zpl_iter_read_common(struct kiocb *kiocb, const struct iovec *iovp,
+    unsigned long nr_segs, size_t count, uio_seg_t seg, size_t skip)
+{
+	cred_t *cr = CRED();
+	struct file *filp = kiocb->ki_filp;
+	ssize_t read;
+	unsigned int f_flags = filp->f_flags;
+
+	f_flags |= zfs_io_flags(kiocb);
+	crhold(cr);
+	read = zpl_read_common_iovec(filp->f_mapping->host, iovp, count,
+	    nr_segs, &kiocb->ki_pos, seg, f_flags, cr, skip);
+	crfree(cr);
+
+	zpl_file_accessed(filp);
 
 	return (read);
 }
@@ -350,6 +439,227 @@ zpl_aio_read(struct kiocb *kiocb, const struct iovec *iovp,
 }
 #endif /* HAVE_VFS_RW_ITERATE */
 
+#ifdef HAVE_SPLICE_TO_PIPE
+/*
+ * Pages gathered by .splice_read() for splice_to_pipe().  Pages are either
+ * references to the ARC's own copy of the data, or pages allocated here
+ * and filled by copying; zs_copied is set when the last page is one of
+ * the latter and may have room for more data.
+ */
+typedef struct zpl_splice {
+	struct page		*zs_pages[PIPE_DEF_BUFFERS];
+	struct partial_page	zs_partial[PIPE_DEF_BUFFERS];
+	unsigned int		zs_nr_pages;
+	boolean_t		zs_copied;
+	size_t			zs_bytes;
+} zpl_splice_t;
+
+/*
+ * ARC pages must never be stolen: they may be part of a compound page
+ * and their contents are shared with other readers.
+ */
+#ifdef HAVE_PIPE_BUF_OPERATIONS_TRY_STEAL
+/* ARGSUSED */
+static bool
+zpl_pipe_buf_try_steal(struct pipe_inode_info *pipe, struct pipe_buffer *buf)
+{
+	return (false);
+}
+
+static const struct pipe_buf_operations zpl_pipe_buf_ops = {
+	.release	= generic_pipe_buf_release,
+	.try_steal	= zpl_pipe_buf_try_steal,
+	.get		= generic_pipe_buf_get,
+};
+#else
+/* ARGSUSED */
+static int
+zpl_pipe_buf_steal(struct pipe_inode_info *pipe, struct pipe_buffer *buf)
+{
+	return (1);
+}
+
+static const struct pipe_buf_operations zpl_pipe_buf_ops = {
+	.confirm	= generic_pipe_buf_confirm,
+	.release	= generic_pipe_buf_release,
+	.steal		= zpl_pipe_buf_steal,
+	.get		= generic_pipe_buf_get,
+};
+#endif /* HAVE_PIPE_BUF_OPERATIONS_TRY_STEAL */
+
+static void
+zpl_splice_release(struct splice_pipe_desc *spd, unsigned int i)
+{
+	put_page(spd->pages[i]);
+}
+
+/*
+ * Called with the ARC hash lock held, so this must not block.
+ */
+static int
+zpl_splice_page_cb(struct page *page, size_t off, size_t len, void *private)
+{
+	zpl_splice_t *zs = private;
+	unsigned int i = zs->zs_nr_pages;
+
+	if (i == PIPE_DEF_BUFFERS)
+		return (SET_ERROR(ENOSPC));
+
+	get_page(page);
+	zs->zs_pages[i] = page;
+	zs->zs_partial[i].offset = off;
+	zs->zs_partial[i].len = len;
+	zs->zs_partial[i].private = 0;
+	zs->zs_nr_pages++;
+	zs->zs_copied = B_FALSE;
+	zs->zs_bytes += len;
+
+	ZSPSTAT_BUMP(zsps_ref_pages);
+	ZSPSTAT_INCR(zsps_ref_bytes, len);
+
+	return (0);
+}
+
+static int
+zpl_splice_copy_cb(void *buf, size_t len, void *private)
+{
+	zpl_splice_t *zs = private;
+
+	while (len > 0) {
+		struct partial_page *pp;
+		size_t n;
+
+		if (!zs->zs_copied ||
+		    zs->zs_partial[zs->zs_nr_pages - 1].len == PAGE_SIZE) {
+			struct page *page;
+
+			if (zs->zs_nr_pages == PIPE_DEF_BUFFERS)
+				return (SET_ERROR(ENOSPC));
+
+			page = alloc_page(GFP_KERNEL);
+			if (page == NULL)
+				return (SET_ERROR(ENOMEM));
+
+			zs->zs_pages[zs->zs_nr_pages] = page;
+			zs->zs_partial[zs->zs_nr_pages].offset = 0;
+			zs->zs_partial[zs->zs_nr_pages].len = 0;
+			zs->zs_partial[zs->zs_nr_pages].private = 0;
+			zs->zs_nr_pages++;
+			zs->zs_copied = B_TRUE;
+			ZSPSTAT_BUMP(zsps_copy_pages);
+		}
+
+		pp = &zs->zs_partial[zs->zs_nr_pages - 1];
+		n = MIN(len, PAGE_SIZE - pp->len);
+		memcpy(page_address(zs->zs_pages[zs->zs_nr_pages - 1]) +
+		    pp->len, buf, n);
+		pp->len += n;
+		buf = (char *)buf + n;
+		len -= n;
+		zs->zs_bytes += n;
+		ZSPSTAT_INCR(zsps_copy_bytes, n);
+	}
+
+	return (0);
+}
+
+/*
+ * Memory mapped files may have newer data in the page cache than in the
+ * ARC, so read them with zfs_read() into pages of our own.
+ */
+static int
+zpl_splice_read_mapped(struct inode *ip, loff_t pos, size_t len,
+    zpl_splice_t *zs, int flags, cred_t *cr)
+{
+	while (len > 0 && zs->zs_nr_pages < PIPE_DEF_BUFFERS) {
+		struct page *page;
+		ssize_t read;
+
+		page = alloc_page(GFP_KERNEL);
+		if (page == NULL)
+			return (-ENOMEM);
+
+		read = zpl_read_common(ip, page_address(page),
+		    MIN(len, PAGE_SIZE), &pos, UIO_SYSSPACE, flags, cr);
+		if (read <= 0) {
+			put_page(page);
+			return (read);
+		}
+
+		zs->zs_pages[zs->zs_nr_pages] = page;
+		zs->zs_partial[zs->zs_nr_pages].offset = 0;
+		zs->zs_partial[zs->zs_nr_pages].len = read;
+		zs->zs_partial[zs->zs_nr_pages].private = 0;
+		zs->zs_nr_pages++;
+		zs->zs_bytes += read;
+		ZSPSTAT_BUMP(zsps_copy_pages);
+		ZSPSTAT_INCR(zsps_copy_bytes, read);
+
+		if (read < PAGE_SIZE)
+			break;
+		len -= read;
+	}
+
+	return (0);
+}
+
+/*
+ * Move file data into a pipe for splice(2) and sendfile(2).  Data which
+ * the ARC caches uncompressed in pages is passed to the pipe by reference
+ * to those pages, so serving a cached file to a socket does not copy it.
+ * Everything else is copied into newly allocated pages.
+ */
+static ssize_t
+zpl_splice_read(struct file *filp, loff_t *ppos,
+    struct pipe_inode_info *pipe, size_t len, unsigned int flags)
+{
+	cred_t *cr = CRED();
+	struct inode *ip = filp->f_mapping->host;
+	struct splice_pipe_desc spd = {
+		.nr_pages_max = PIPE_DEF_BUFFERS,
+		.ops = &zpl_pipe_buf_ops,
+		.spd_release = zpl_splice_release,
+	};
+	zpl_splice_t *zs;
+	fstrans_cookie_t cookie;
+	ssize_t ret;
+	int error;
+
+	ZSPSTAT_BUMP(zsps_calls);
+
+	len = MIN(len, PIPE_DEF_BUFFERS * PAGE_SIZE);
+	zs = kmem_zalloc(sizeof (zpl_splice_t), KM_SLEEP);
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	error = -zfs_read_pages(ip, *ppos, len, zpl_splice_page_cb,
+	    zpl_splice_copy_cb, zs, filp->f_flags, cr);
+	spl_fstrans_unmark(cookie);
+	if (error == -ENOTSUP) {
+		error = zpl_splice_read_mapped(ip, *ppos, len, zs,
+		    filp->f_flags, cr);
+	}
+	crfree(cr);
+
+	if (zs->zs_nr_pages > 0) {
+		/* Return what was gathered before any error. */
+		spd.pages = zs->zs_pages;
+		spd.partial = zs->zs_partial;
+		spd.nr_pages = zs->zs_nr_pages;
+		ret = splice_to_pipe(pipe, &spd);
+		if (ret > 0)
+			*ppos += ret;
+	} else {
+		ret = (error == -ENOSPC) ? 0 : error;
+	}
+
+	kmem_free(zs, sizeof (zpl_splice_t));
+	zpl_file_accessed(filp);
+
+	return (ret);
+}
+#endif /* HAVE_SPLICE_TO_PIPE */
+
 static ssize_t
 zpl_write_common_iovec(struct inode *ip, const struct iovec *iovp, size_t count,
     unsigned long nr_segs, loff_t *ppos, uio_seg_t segment, int flags,
@@ -631,10 +941,7 @@ zpl_mmap(struct file *filp, struct vm_area_struct *vma)
  * Populate a page with data for the Linux page cache.  This function is
  * only used to support mmap(2).  There will be an identical copy of the
  * data in the ARC which is kept up to date via .write() and .writepage().
- *
- * Current this function relies on zpl_read_common() and the O_DIRECT
- * flag to read in a page.  This works but the more correct way is to
- * update zfs_fillpage() to be Linux friendly and use that interface.
+ * Readahead is handled in larger batches by zpl_readpages().
  */
 static int
 zpl_readpage(struct file *filp, struct page *pp)
@@ -648,6 +955,8 @@ zpl_readpage(struct file *filp, struct page *pp)
 	ip = pp->mapping->host;
 	pl[0] = pp;
 
+	ZRASTAT_BUMP(zras_readpage);
+
 	cookie = spl_fstrans_mark();
 	error = -zfs_getpage(ip, pl, 1);
 	spl_fstrans_unmark(cookie);
@@ -665,18 +974,140 @@ zpl_readpage(struct file *filp, struct page *pp)
 	return (error);
 }
 
+/*
+ * Fill a run of locked, contiguous pages which were just added to the
+ * page cache, then mark them up to date and unlock them.
+ */
+static void
+zpl_readpages_batch(struct inode *ip, struct page **pl, unsigned nr_pages)
+{
+	fstrans_cookie_t cookie;
+	unsigned i;
+	int error;
+
+	cookie = spl_fstrans_mark();
+	error = -zfs_getpage(ip, pl, nr_pages);
+	spl_fstrans_unmark(cookie);
+
+	ZRASTAT_BUMP(zras_batches);
+	if (error)
+		ZRASTAT_INCR(zras_error_pages, nr_pages);
+	else
+		ZRASTAT_INCR(zras_filled_pages, nr_pages);
+
+	for (i = 0; i < nr_pages; i++) {
+		struct page *pp = pl[i];
+
+		if (error) {
+			SetPageError(pp);
+			ClearPageUptodate(pp);
+		} else {
+			ClearPageError(pp);
+			SetPageUptodate(pp);
+			flush_dcache_page(pp);
+		}
+		unlock_page(pp);
+	}
+}
+
 /*
  * Populate a set of pages with data for the Linux page cache.  This
  * function will only be called for read ahead and never for demand
- * paging.  For simplicity, the code relies on read_cache_pages() to
- * correctly lock each page for IO and call zpl_readpage().
+ * paging.  Rather than filling each page individually through
+ * zpl_readpage(), the pages are added to the page cache and handed to
+ * zfs_getpage() in contiguous runs.  This allows every record covering
+ * the readahead window to be read with a single dmu_buf_hold_array and
+ * copied out in one pass.  Pages which are already cached split the
+ * window into multiple runs.
  */
 static int
 zpl_readpages(struct file *filp, struct address_space *mapping,
     struct list_head *pages, unsigned nr_pages)
 {
-	return (read_cache_pages(mapping, pages,
-	    (filler_t *)zpl_readpage, filp));
+	struct inode *ip = mapping->host;
+	struct page **pl;
+	unsigned npages = 0;
+
+	ZRASTAT_BUMP(zras_windows);
+	ZRASTAT_INCR(zras_window_pages, nr_pages);
+
+	pl = kmem_alloc(nr_pages * sizeof (struct page *), KM_SLEEP);
+
+	while (!list_empty(pages)) {
+		struct page *pp = list_entry(pages->prev, struct page, lru);
+
+		list_del(&pp->lru);
+		if (add_to_page_cache_lru(pp, mapping, pp->index,
+		    mapping_gfp_mask(mapping))) {
+			ZRASTAT_BUMP(zras_cached_pages);
+			put_page(pp);
+			continue;
+		}
+
+		/* The page cache now holds the reference on the page. */
+		put_page(pp);
+
+		if (npages > 0 && pl[npages - 1]->index + 1 != pp->index) {
+			zpl_readpages_batch(ip, pl, npages);
+			npages = 0;
+		}
+		pl[npages++] = pp;
+	}
+
+	if (npages > 0)
+		zpl_readpages_batch(ip, pl, npages);
+
+	kmem_free(pl, nr_pages * sizeof (struct page *));
+
+	return (0);
+}
+
+void
+zpl_readahead_init(void)
+{
+	zpl_readahead_ksp = kstat_create("zfs", 0, "zpl_readahead", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zpl_readahead_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (zpl_readahead_ksp != NULL) {
+		zpl_readahead_ksp->ks_data = &zpl_readahead_stats;
+		kstat_install(zpl_readahead_ksp);
+	}
+}
+
+void
+zpl_readahead_fini(void)
+{
+	if (zpl_readahead_ksp != NULL) {
+		kstat_delete(zpl_readahead_ksp);
+		zpl_readahead_ksp = NULL;
+	}
+}
+
+void
+zpl_splice_init(void)
+{
+#ifdef HAVE_SPLICE_TO_PIPE
+	zpl_splice_ksp = kstat_create("zfs", 0, "zpl_splice", "misc",
+	    KSTAT_TYPE_NAMED, sizeof (zpl_splice_stats) /
+	    sizeof (kstat_named_t), KSTAT_FLAG_VIRTUAL);
+
+	if (zpl_splice_ksp != NULL) {
+		zpl_splice_ksp->ks_data = &zpl_splice_stats;
+		kstat_install(zpl_splice_ksp);
+	}
+#endif
+}
+
+void
+zpl_splice_fini(void)
+{
+#ifdef HAVE_SPLICE_TO_PIPE
+	if (zpl_splice_ksp != NULL) {
+		kstat_delete(zpl_splice_ksp);
+		zpl_splice_ksp = NULL;
+	}
+#endif
 }
 
 int
@@ -754,9 +1185,21 @@ zpl_writepage(struct page *pp, struct writeback_control *wbc)
 }
 
 /*
- * The only flag combination which matches the behavior of zfs_space()
- * is FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE.  The FALLOC_FL_PUNCH_HOLE
- * flag was introduced in the 2.6.38 kernel.
+ * Since ZFS is copy-on-write it cannot preallocate blocks for a file;
+ * writing zeros would only be replaced by new blocks on the next write.
+ * Fallocate modes are therefore implemented as metadata operations:
+ *
+ * - FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE frees the range with
+ *   zfs_space().  The FALLOC_FL_PUNCH_HOLE flag was introduced in the
+ *   2.6.38 kernel.
+ *
+ * - FALLOC_FL_ZERO_RANGE frees the range the same way, so it reads back
+ *   as zeros, and extends the file unless FALLOC_FL_KEEP_SIZE is given.
+ *
+ * - Mode 0 and FALLOC_FL_KEEP_SIZE verify that the requested space is
+ *   available to the file, taking quotas and the pool's free space into
+ *   account (padded by zfs_fallocate_reserve_percent), and then extend
+ *   the file if needed.  No data blocks are written.
  */
 #if defined(HAVE_FILE_FALLOCATE) || defined(HAVE_INODE_FALLOCATE)
 long
@@ -769,31 +1212,86 @@ zpl_fallocate_common(struct inode *ip, int mode, loff_t offset, loff_t len)
 	flock64_t bf;
 	loff_t olen;
 	fstrans_cookie_t cookie;
+	int test_mode = FALLOC_FL_PUNCH_HOLE;
+#ifdef FALLOC_FL_ZERO_RANGE
+	test_mode |= FALLOC_FL_ZERO_RANGE;
+#endif
+
+	if (mode & ~(FALLOC_FL_KEEP_SIZE | test_mode))
+		return (error);
 
-	if (mode != (FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
+	/* FALLOC_FL_PUNCH_HOLE must be paired with FALLOC_FL_KEEP_SIZE. */
+	if ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE))
 		return (error);
 
+	/* Only one of the hole punching modes may be given. */
+	if (!ISP2(mode & test_mode) && (mode & test_mode) != 0)
+		return (-EINVAL);
+
 	if (offset < 0 || len <= 0)
 		return (-EINVAL);
 
+	if (offset > MAXOFFSET_T - len)
+		return (-EFBIG);
+
 	spl_inode_lock(ip);
 	olen = i_size_read(ip);
 
-	if (offset > olen) {
-		spl_inode_unlock(ip);
-		return (0);
-	}
-	if (offset + len > olen)
-		len = olen - offset;
 	bf.l_type = F_WRLCK;
 	bf.l_whence = SEEK_SET;
 	bf.l_start = offset;
 	bf.l_len = len;
 	bf.l_pid = 0;
 
+	if (mode & FALLOC_FL_KEEP_SIZE) {
+		if (offset >= olen) {
+			spl_inode_unlock(ip);
+			return (0);
+		}
+		if (offset + len > olen)
+			bf.l_len = olen - offset;
+	}
+
 	crhold(cr);
 	cookie = spl_fstrans_mark();
-	error = -zfs_space(ip, F_FREESP, &bf, FWRITE, offset, cr);
+
+	if ((mode & test_mode) == 0) {
+		struct kstatfs statfs;
+		uint64_t percent = zfs_fallocate_reserve_percent;
+		uint64_t needed;
+
+		/* Preallocation disabled, callers fall back to writing. */
+		if (percent == 0)
+			goto out;
+
+		/*
+		 * Only the part of the range beyond the end of the file
+		 * needs new space.  zfs_statvfs() accounts for project
+		 * quotas as well as the dataset's available space.
+		 */
+		error = -zfs_statvfs(ip, &statfs);
+		if (error)
+			goto out;
+
+		needed = (offset + len > olen) ?
+		    offset + len - MAX(offset, olen) : 0;
+		if (needed >
+		    statfs.f_bavail * (statfs.f_bsize * 100 / percent)) {
+			error = -ENOSPC;
+			goto out;
+		}
+
+		/* Nothing to do unless the file is being extended. */
+		if ((mode & FALLOC_FL_KEEP_SIZE) || offset + len <= olen)
+			goto out;
+
+		/* Extend the file without freeing any existing data. */
+		bf.l_start = offset + len;
+		bf.l_len = 0;
+	}
+
+	error = -zfs_space(ip, F_FREESP, &bf, FWRITE, bf.l_start, cr);
+out:
 	spl_fstrans_unmark(cookie);
 	spl_inode_unlock(ip);
 
@@ -982,6 +1480,50 @@ zpl_ioctl_setxattr(struct file *filp, void __user *arg)
 	return (err);
 }
 
+static int
+zpl_ioctl_readdirplus(struct file *filp, void __user *arg)
+{
+	struct inode *ip = file_inode(filp);
+	zfs_readdirplus_t zrp;
+	struct iovec iov;
+	uio_t uio = { { 0 }, 0 };
+	fstrans_cookie_t cookie;
+	boolean_t eof;
+	cred_t *cr = CRED();
+	int err;
+
+	if (!S_ISDIR(ip->i_mode))
+		return (-ENOTDIR);
+
+	if (copy_from_user(&zrp, arg, sizeof (zrp)))
+		return (-EFAULT);
+
+	iov.iov_base = (void __user *)(uintptr_t)zrp.zrp_buf;
+	iov.iov_len = zrp.zrp_buflen;
+
+	uio.uio_iov = &iov;
+	uio.uio_iovcnt = 1;
+	uio.uio_loffset = 0;
+	uio.uio_segflg = UIO_USERSPACE;
+	uio.uio_limit = MAXOFFSET_T;
+	uio.uio_resid = zrp.zrp_buflen;
+
+	crhold(cr);
+	cookie = spl_fstrans_mark();
+	err = -zfs_readdirplus(ip, &uio, &zrp.zrp_cookie, &zrp.zrp_count,
+	    &eof, cr);
+	spl_fstrans_unmark(cookie);
+	crfree(cr);
+	if (err)
+		return (err);
+
+	zrp.zrp_flags = eof ? ZRP_EOF : 0;
+	if (copy_to_user(arg, &zrp, sizeof (zrp)))
+		return (-EFAULT);
+
+	return (0);
+}
+
 static long
 zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
@@ -994,6 +1536,8 @@ zpl_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		return (zpl_ioctl_getxattr(filp, (void *)arg));
 	case ZFS_IOC_FSSETXATTR:
 		return (zpl_ioctl_setxattr(filp, (void *)arg));
+	case ZFS_IOC_READDIRPLUS:
+		return (zpl_ioctl_readdirplus(filp, (void *)arg));
 	default:
 		return (-ENOTTY);
 	}
@@ -1010,6 +1554,8 @@ zpl_compat_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case FS_IOC32_SETFLAGS:
 		cmd = FS_IOC_SETFLAGS;
 		break;
+	case ZFS_IOC_READDIRPLUS:
+		break;
 	default:
 		return (-ENOTTY);
 	}
@@ -1042,6 +1588,9 @@ const struct file_operations zpl_file_operations = {
 	.write		= do_sync_write,
 	.aio_read	= zpl_aio_read,
 	.aio_write	= zpl_aio_write,
+#endif
+#ifdef HAVE_SPLICE_TO_PIPE
+	.splice_read	= zpl_splice_read,
 #endif
 	.mmap		= zpl_mmap,
 	.fsync		= zpl_fsync,
@@ -1073,3 +1622,9 @@ const struct file_operations zpl_dir_file_operations = {
 	.compat_ioctl   = zpl_compat_ioctl,
 #endif
 };
+
+/* BEGIN CSTYLED */
+module_param(zfs_fallocate_reserve_percent, uint, 0644);
+MODULE_PARM_DESC(zfs_fallocate_reserve_percent,
+	"Percentage of length to use for the available capacity check");
+/* END CSTYLED */
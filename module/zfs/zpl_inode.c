@@ -661,6 +661,33 @@ zpl_fallocate(struct inode *ip, int mode, loff_t offset, loff_t len)
 }
 #endif /* HAVE_INODE_FALLOCATE */
 
+#if defined(SEEK_HOLE) && defined(SEEK_DATA)
+static int
+zpl_fiemap(struct inode *ip, struct fiemap_extent_info *fei,
+    u64 start, u64 len)
+{
+	fstrans_cookie_t cookie;
+	int error;
+
+#ifdef HAVE_FIEMAP_PREP
+	error = fiemap_prep(ip, fei, start, &len, FIEMAP_FLAG_SYNC);
+#else
+	error = fiemap_check_flags(fei, FIEMAP_FLAG_SYNC);
+	if (error == 0 && (fei->fi_flags & FIEMAP_FLAG_SYNC))
+		error = filemap_write_and_wait(ip->i_mapping);
+#endif /* HAVE_FIEMAP_PREP */
+	if (error)
+		return (error);
+
+	cookie = spl_fstrans_mark();
+	error = -zfs_fiemap(ip, fei, start, len);
+	spl_fstrans_unmark(cookie);
+	ASSERT3S(error, <=, 0);
+
+	return (error);
+}
+#endif /* SEEK_HOLE && SEEK_DATA */
+
 static int
 #ifdef HAVE_D_REVALIDATE_NAMEIDATA
 zpl_revalidate(struct dentry *dentry, struct nameidata *nd)
@@ -729,6 +756,9 @@ const struct inode_operations zpl_inode_operations = {
 #ifdef HAVE_INODE_FALLOCATE
 	.fallocate	= zpl_fallocate,
 #endif /* HAVE_INODE_FALLOCATE */
+#if defined(SEEK_HOLE) && defined(SEEK_DATA)
+	.fiemap		= zpl_fiemap,
+#endif /* SEEK_HOLE && SEEK_DATA */
 #if defined(CONFIG_FS_POSIX_ACL)
 #if defined(HAVE_SET_ACL)
 	.set_acl	= zpl_set_acl,
@@ -0,0 +1,79 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Write a file to stdout by faulting it in through a read-only mmap(2),
+ * so that the file system's readpage and readpages paths are exercised.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+int
+main(int argc, char **argv)
+{
+	struct stat st;
+	char *map;
+	off_t off;
+	ssize_t n;
+	int fd;
+
+	if (argc != 2) {
+		(void) fprintf(stderr, "Usage: %s <file>\n", argv[0]);
+		return (2);
+	}
+
+	if ((fd = open(argv[1], O_RDONLY)) == -1) {
+		perror(argv[1]);
+		return (1);
+	}
+
+	if (fstat(fd, &st) != 0) {
+		perror("fstat");
+		return (1);
+	}
+
+	if (st.st_size == 0)
+		return (0);
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		return (1);
+	}
+
+	for (off = 0; off < st.st_size; off += n) {
+		n = write(STDOUT_FILENO, map + off, st.st_size - off);
+		if (n <= 0) {
+			perror("write");
+			return (1);
+		}
+	}
+
+	(void) munmap(map, st.st_size);
+	(void) close(fd);
+
+	return (0);
+}
@@ -0,0 +1,104 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * List a directory with the ZFS_IOC_READDIRPLUS ioctl, printing one
+ * "<name> <inode> <mode> <links> <uid> <gid> <size> <mtime>" line per
+ * entry in the same format as stat -c '%n %i %f %h %u %g %s %Y'.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/zfs_readdirplus.h>
+
+static void
+usage(char *name)
+{
+	(void) fprintf(stderr, "Usage: %s [-b buflen] <directory>\n", name);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	zfs_readdirplus_t zrp = { 0 };
+	zfs_direntplus_t *zde;
+	size_t buflen = 64 * 1024;
+	char *buf, *p;
+	uint32_t i;
+	int c, fd;
+
+	while ((c = getopt(argc, argv, "b:")) != -1) {
+		switch (c) {
+		case 'b':
+			buflen = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	if ((fd = open(argv[optind], O_RDONLY | O_DIRECTORY)) < 0) {
+		perror("open");
+		return (1);
+	}
+
+	if ((buf = malloc(buflen)) == NULL) {
+		perror("malloc");
+		return (1);
+	}
+
+	do {
+		zrp.zrp_buf = (uint64_t)(uintptr_t)buf;
+		zrp.zrp_buflen = buflen;
+
+		if (ioctl(fd, ZFS_IOC_READDIRPLUS, &zrp) == -1) {
+			perror("ioctl(ZFS_IOC_READDIRPLUS)");
+			return (1);
+		}
+
+		for (i = 0, p = buf; i < zrp.zrp_count; i++) {
+			zde = (zfs_direntplus_t *)p;
+			(void) printf("%s %llu %llx %llu %llu %llu %llu %llu\n",
+			    zde->zde_name,
+			    (unsigned long long)zde->zde_ino,
+			    (unsigned long long)zde->zde_mode,
+			    (unsigned long long)zde->zde_nlink,
+			    (unsigned long long)zde->zde_uid,
+			    (unsigned long long)zde->zde_gid,
+			    (unsigned long long)zde->zde_size,
+			    (unsigned long long)zde->zde_mtime[0]);
+			p += zde->zde_reclen;
+		}
+	} while (!(zrp.zrp_flags & ZRP_EOF));
+
+	free(buf);
+	(void) close(fd);
+
+	return (0);
+}
@@ -0,0 +1,146 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Print the data regions of a file, one "<start> <end>" pair per line,
+ * using either lseek(2) SEEK_DATA/SEEK_HOLE or the FS_IOC_FIEMAP ioctl.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+
+#define	FIEMAP_EXTENTS	32
+
+static void
+usage(char *name)
+{
+	(void) fprintf(stderr, "Usage: %s [-f] <file>\n", name);
+	exit(2);
+}
+
+static int
+seek_extents(int fd)
+{
+	off_t data, hole = 0;
+
+	for (;;) {
+		data = lseek(fd, hole, SEEK_DATA);
+		if (data == -1) {
+			if (errno == ENXIO)
+				return (0);
+			perror("lseek(SEEK_DATA)");
+			return (1);
+		}
+
+		hole = lseek(fd, data, SEEK_HOLE);
+		if (hole == -1) {
+			perror("lseek(SEEK_HOLE)");
+			return (1);
+		}
+
+		(void) printf("%lld %lld\n", (long long)data, (long long)hole);
+	}
+}
+
+static int
+fiemap_extents(int fd)
+{
+	struct fiemap *fm;
+	struct fiemap_extent *fe;
+	uint64_t start = 0;
+	uint32_t i;
+	int last = 0;
+
+	fm = calloc(1, sizeof (struct fiemap) +
+	    FIEMAP_EXTENTS * sizeof (struct fiemap_extent));
+	if (fm == NULL) {
+		perror("calloc");
+		return (1);
+	}
+
+	while (!last) {
+		fm->fm_start = start;
+		fm->fm_length = FIEMAP_MAX_OFFSET - start;
+		fm->fm_flags = 0;
+		fm->fm_extent_count = FIEMAP_EXTENTS;
+		fm->fm_mapped_extents = 0;
+
+		if (ioctl(fd, FS_IOC_FIEMAP, fm) == -1) {
+			perror("ioctl(FS_IOC_FIEMAP)");
+			free(fm);
+			return (1);
+		}
+
+		if (fm->fm_mapped_extents == 0)
+			break;
+
+		for (i = 0; i < fm->fm_mapped_extents; i++) {
+			fe = &fm->fm_extents[i];
+			(void) printf("%llu %llu\n",
+			    (unsigned long long)fe->fe_logical,
+			    (unsigned long long)(fe->fe_logical +
+			    fe->fe_length));
+			start = fe->fe_logical + fe->fe_length;
+			if (fe->fe_flags & FIEMAP_EXTENT_LAST)
+				last = 1;
+		}
+	}
+
+	free(fm);
+	return (0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	int c, fd, error, fiemap = 0;
+
+	while ((c = getopt(argc, argv, "f")) != -1) {
+		switch (c) {
+		case 'f':
+			fiemap = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	if ((fd = open(argv[optind], O_RDONLY)) < 0) {
+		perror("open");
+		return (1);
+	}
+
+	error = fiemap ? fiemap_extents(fd) : seek_extents(fd);
+	(void) close(fd);
+
+	return (error);
+}
@@ -0,0 +1,139 @@
+/*
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at usr/src/OPENSOLARIS.LICENSE
+ * or http://www.opensolaris.org/os/licensing.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at usr/src/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+/*
+ * Copy a file to another file using splice(2) through a pipe, or with
+ * sendfile(2) when -s is given, so that the source file system's
+ * splice_read path is exercised.
+ */
+
+#ifndef _GNU_SOURCE
+#define	_GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/sendfile.h>
+
+#define	SPLICE_CHUNK	(1024 * 1024)
+
+static void
+usage(char *name)
+{
+	(void) fprintf(stderr, "Usage: %s [-s] <source> <destination>\n",
+	    name);
+	exit(2);
+}
+
+static int
+copy_splice(int in, int out)
+{
+	int pfd[2];
+	ssize_t n, m;
+
+	if (pipe(pfd) != 0) {
+		perror("pipe");
+		return (1);
+	}
+
+	for (;;) {
+		n = splice(in, NULL, pfd[1], NULL, SPLICE_CHUNK, SPLICE_F_MOVE);
+		if (n == -1) {
+			perror("splice(in)");
+			return (1);
+		}
+		if (n == 0)
+			break;
+
+		while (n > 0) {
+			m = splice(pfd[0], NULL, out, NULL, n, SPLICE_F_MOVE);
+			if (m <= 0) {
+				perror("splice(out)");
+				return (1);
+			}
+			n -= m;
+		}
+	}
+
+	(void) close(pfd[0]);
+	(void) close(pfd[1]);
+
+	return (0);
+}
+
+static int
+copy_sendfile(int in, int out)
+{
+	ssize_t n;
+
+	do {
+		n = sendfile(out, in, NULL, SPLICE_CHUNK);
+		if (n == -1) {
+			perror("sendfile");
+			return (1);
+		}
+	} while (n > 0);
+
+	return (0);
+}
+
+int
+main(int argc, char **argv)
+{
+	int use_sendfile = 0;
+	int c, in, out, error;
+
+	while ((c = getopt(argc, argv, "s")) != -1) {
+		switch (c) {
+		case 's':
+			use_sendfile = 1;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	if (argc - optind != 2)
+		usage(argv[0]);
+
+	if ((in = open(argv[optind], O_RDONLY)) == -1) {
+		perror(argv[optind]);
+		return (1);
+	}
+
+	if ((out = open(argv[optind + 1], O_WRONLY | O_CREAT | O_TRUNC,
+	    0644)) == -1) {
+		perror(argv[optind + 1]);
+		return (1);
+	}
+
+	if (use_sendfile)
+		error = copy_sendfile(in, out);
+	else
+		error = copy_splice(in, out);
+
+	(void) close(in);
+	(void) close(out);
+
+	return (error);
+}